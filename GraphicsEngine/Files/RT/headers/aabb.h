@@ -0,0 +1,49 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "Files/ThirdParty/glm/glm.hpp"
+
+#include <cmath>
+
+struct AABB
+{
+	AABB() : m_min(glm::vec3(INFINITY)), m_max(glm::vec3(-INFINITY))
+	{}
+
+	AABB(const glm::vec3& min, const glm::vec3& max) : m_min(min), m_max(max)
+	{}
+
+	void Grow(const glm::vec3& point)
+	{
+		m_min = glm::min(m_min, point);
+		m_max = glm::max(m_max, point);
+	}
+
+	void Grow(const AABB& box)
+	{
+		m_min = glm::min(m_min, box.m_min);
+		m_max = glm::max(m_max, box.m_max);
+	}
+
+	bool IsEmpty() const { return m_min.x > m_max.x; }
+	glm::vec3 Centroid() const { return (m_min + m_max) * 0.5f; }
+	glm::vec3 Extent() const { return m_max - m_min; }
+
+	float SurfaceArea() const
+	{
+		if (IsEmpty()) return 0.f;
+		const glm::vec3 e = Extent();
+		return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	int LongestAxis() const
+	{
+		const glm::vec3 e = Extent();
+		if (e.x > e.y && e.x > e.z) return 0;
+		return e.y > e.z ? 1 : 2;
+	}
+
+	glm::vec3 m_min, m_max;
+};
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/aabb.h"
+#include "Files/RT/headers/raypacket.h"
+#include "Files/RT/headers/rtstats.h"
+
+#define BVH_STACK_SIZE 64
+
+struct BVHNode
+{
+	glm::vec3 m_boundsMin;
+	unsigned int m_leftFirst; // Index of the left child (inner node) or of the first primitive (leaf)
+	glm::vec3 m_boundsMax;
+	unsigned int m_primCount; // 0 for inner nodes
+
+	bool IsLeaf() const { return m_primCount > 0; }
+};
+
+// Read only view of the nodes or primitive indices of a BVH, wherever they are stored.
+// Named like the standard containers it stands in for.
+template <typename T>
+class BVHArray
+{
+public:
+	BVHArray(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	const T& operator[](size_t i) const { return m_data[i]; }
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+private:
+	const T* m_data;
+	size_t m_size;
+};
+
+// Bounding volume hierarchy built with the surface area heuristic.
+// It only knows the bounds of the primitives, the intersection of the
+// primitives themselves is done by the callbacks given to the traversal.
+class BVH
+{
+public:
+	BVH();
+	~BVH();
+
+	// primsPerTest is the number of primitives the leaves intersect at once,
+	// the SAH counts the cost of a leaf in intersection tests
+	void Build(const std::vector<AABB>& primBounds, int maxLeafSize = 4, int primsPerTest = 1);
+
+	// Updates the bounds of the nodes to primitives that moved, keeping the tree as
+	// it is. primBounds has the same primitives in the same order as for the build.
+	// The tree gets worse as the primitives wander away from where it was built.
+	void Refit(const std::vector<AABB>& primBounds);
+	void Clear();
+
+	// Takes the nodes and primitive indices of a BVH built before, as Nodes() and
+	// PrimIndices() gave them. They are swapped in, the vectors get the old ones back.
+	void Assign(std::vector<BVHNode>& nodes, std::vector<unsigned int>& primIndices, int primsPerTest);
+
+	// Same traversing the arrays where they are, in memory storage keeps alive, such as a
+	// mapped file. They are never written, Refit copies them first. The copies of the BVH
+	// share storage.
+	void AssignExternal(const BVHNode* nodes, size_t numNodes, const unsigned int* primIndices, size_t numPrimIndices,
+		int primsPerTest, const std::shared_ptr<const void>& storage);
+
+	bool IsEmpty() const { return NumNodes() == 0; }
+	BVHArray<BVHNode> Nodes() const { return BVHArray<BVHNode>(NodeData(), NumNodes()); }
+	BVHArray<unsigned int> PrimIndices() const { return BVHArray<unsigned int>(PrimIndexData(), NumPrimIndices()); }
+	int PrimsPerTest() const { return m_primsPerTest; }
+
+	// Expected cost of tracing a ray, relative to the root surface area
+	float SAHCost() const;
+
+	// Closest hit traversal. intersectPrim(primIndex, tMax) must return true and
+	// shorten tMax when the primitive is hit closer than tMax.
+	// The traversals add the nodes and primitives they test to stats if it is given.
+	template <typename IntersectFunc>
+	bool Traverse(const glm::vec3& origin, const glm::vec3& direction, float& tMax, IntersectFunc intersectPrim, RTStats* stats = nullptr) const;
+
+	// Same visiting whole leaves. intersectLeaf(first, count, tMax) intersects the
+	// primitives PrimIndices()[first] to PrimIndices()[first + count - 1].
+	template <typename IntersectFunc>
+	bool TraverseLeaves(const glm::vec3& origin, const glm::vec3& direction, float& tMax, IntersectFunc intersectLeaf, RTStats* stats = nullptr) const;
+
+	// Any hit traversal, returns as soon as occludedPrim(primIndex, tMax) returns true
+	template <typename OccludedFunc>
+	bool TraverseAny(const glm::vec3& origin, const glm::vec3& direction, float tMax, OccludedFunc occludedPrim, RTStats* stats = nullptr) const;
+
+	// Same visiting whole leaves with occludedLeaf(first, count, tMax)
+	template <typename OccludedFunc>
+	bool TraverseAnyLeaves(const glm::vec3& origin, const glm::vec3& direction, float tMax, OccludedFunc occludedLeaf, RTStats* stats = nullptr) const;
+
+	// Closest hit traversal of a ray packet. intersectLeaf(first, count, activeLanes, tMax)
+	// intersects the primitives of the leaf with the active lanes and shortens their tMax on hit.
+	template <typename IntersectFunc>
+	void TraversePacket(const RayPacket& packet, vfloat& tMax, IntersectFunc intersectLeaf, RTStats* stats = nullptr) const;
+
+	static float IntersectBounds(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax);
+	static vmask IntersectBounds(const BVHNode& node, const RayPacket& packet, const vfloat& tMax);
+
+private:
+	struct BuildPrim
+	{
+		AABB m_bounds;
+		glm::vec3 m_centroid;
+	};
+
+	void Subdivide(unsigned int nodeIndex, const std::vector<BuildPrim>& prims, int maxLeafSize, int depth);
+	void UpdateNodeBounds(BVHNode& node, const std::vector<BuildPrim>& prims) const;
+	float FindBestSplit(const BVHNode& node, const std::vector<BuildPrim>& prims, int& axis, int& splitBin, AABB& centroidBounds) const;
+	float LeafCost(int primCount) const { return (float)((primCount + m_primsPerTest - 1) / m_primsPerTest); }
+
+	const BVHNode* NodeData() const { return m_storage ? m_externalNodes : m_nodes.data(); }
+	const unsigned int* PrimIndexData() const { return m_storage ? m_externalPrimIndices : m_primIndices.data(); }
+	size_t NumNodes() const { return m_storage ? m_numExternalNodes : m_nodes.size(); }
+	size_t NumPrimIndices() const { return m_storage ? m_numExternalPrimIndices : m_primIndices.size(); }
+
+private:
+	std::vector<BVHNode> m_nodes;
+	std::vector<unsigned int> m_primIndices;
+	int m_primsPerTest;
+
+	// Arrays given to AssignExternal, used instead of the vectors while storage is set
+	std::shared_ptr<const void> m_storage;
+	const BVHNode* m_externalNodes;
+	size_t m_numExternalNodes;
+	const unsigned int* m_externalPrimIndices;
+	size_t m_numExternalPrimIndices;
+};
+
+inline float BVH::IntersectBounds(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax)
+{
+	const glm::vec3 t0 = (node.m_boundsMin - origin) * invDir;
+	const glm::vec3 t1 = (node.m_boundsMax - origin) * invDir;
+	const glm::vec3 tNear = glm::min(t0, t1);
+	const glm::vec3 tFar = glm::max(t0, t1);
+
+	const float tEnter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.f));
+	const float tExit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, tMax));
+
+	return tEnter <= tExit ? tEnter : INFINITY;
+}
+
+inline vmask BVH::IntersectBounds(const BVHNode& node, const RayPacket& packet, const vfloat& tMax)
+{
+	const vfloat t0x = (vfloat(node.m_boundsMin.x) - packet.m_originX) * packet.m_invDirX;
+	const vfloat t1x = (vfloat(node.m_boundsMax.x) - packet.m_originX) * packet.m_invDirX;
+	const vfloat t0y = (vfloat(node.m_boundsMin.y) - packet.m_originY) * packet.m_invDirY;
+	const vfloat t1y = (vfloat(node.m_boundsMax.y) - packet.m_originY) * packet.m_invDirY;
+	const vfloat t0z = (vfloat(node.m_boundsMin.z) - packet.m_originZ) * packet.m_invDirZ;
+	const vfloat t1z = (vfloat(node.m_boundsMax.z) - packet.m_originZ) * packet.m_invDirZ;
+
+	const vfloat tEnter = Max(Max(Min(t0x, t1x), Min(t0y, t1y)), Max(Min(t0z, t1z), vfloat(0.f)));
+	const vfloat tExit = Min(Min(Max(t0x, t1x), Max(t0y, t1y)), Min(Max(t0z, t1z), tMax));
+
+	return tEnter <= tExit;
+}
+
+template <typename IntersectFunc>
+bool BVH::Traverse(const glm::vec3& origin, const glm::vec3& direction, float& tMax, IntersectFunc intersectPrim, RTStats* stats) const
+{
+	const unsigned int* primIndices = PrimIndexData();
+	return TraverseLeaves(origin, direction, tMax, [&](unsigned int first, unsigned int count, float& t)
+	{
+		bool hit = false;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			if (intersectPrim(primIndices[first + i], t))
+				hit = true;
+		}
+		return hit;
+	}, stats);
+}
+
+template <typename IntersectFunc>
+bool BVH::TraverseLeaves(const glm::vec3& origin, const glm::vec3& direction, float& tMax, IntersectFunc intersectLeaf, RTStats* stats) const
+{
+	if (IsEmpty()) return false;
+	const BVHNode* nodes = NodeData();
+
+	const glm::vec3 invDir = 1.f / direction;
+	bool hit = false;
+
+	unsigned int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	const BVHNode* node = &nodes[0];
+	unsigned int nodesVisited = 1, primTests = 0;
+
+	if (IntersectBounds(*node, origin, invDir, tMax) == INFINITY)
+	{
+		if (stats) stats->m_nodesVisited++;
+		return false;
+	}
+
+	while (true)
+	{
+		if (node->IsLeaf())
+		{
+			primTests += node->m_primCount;
+			if (intersectLeaf(node->m_leftFirst, node->m_primCount, tMax))
+				hit = true;
+
+			if (stackSize == 0) break;
+			node = &nodes[stack[--stackSize]];
+			continue;
+		}
+
+		// Visit the closer child first and push the other one
+		unsigned int nearIndex = node->m_leftFirst;
+		unsigned int farIndex = node->m_leftFirst + 1;
+		float tNear = IntersectBounds(nodes[nearIndex], origin, invDir, tMax);
+		float tFar = IntersectBounds(nodes[farIndex], origin, invDir, tMax);
+		nodesVisited += 2;
+
+		if (tFar < tNear)
+		{
+			std::swap(nearIndex, farIndex);
+			std::swap(tNear, tFar);
+		}
+
+		if (tNear == INFINITY)
+		{
+			if (stackSize == 0) break;
+			node = &nodes[stack[--stackSize]];
+		}
+		else
+		{
+			node = &nodes[nearIndex];
+			if (tFar != INFINITY) stack[stackSize++] = farIndex;
+		}
+	}
+
+	if (stats)
+	{
+		stats->m_nodesVisited += nodesVisited;
+		stats->m_primTests += primTests;
+	}
+
+	return hit;
+}
+
+template <typename OccludedFunc>
+bool BVH::TraverseAny(const glm::vec3& origin, const glm::vec3& direction, float tMax, OccludedFunc occludedPrim, RTStats* stats) const
+{
+	const unsigned int* primIndices = PrimIndexData();
+	return TraverseAnyLeaves(origin, direction, tMax, [&](unsigned int first, unsigned int count, float t)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			if (occludedPrim(primIndices[first + i], t))
+				return true;
+		}
+		return false;
+	}, stats);
+}
+
+template <typename OccludedFunc>
+bool BVH::TraverseAnyLeaves(const glm::vec3& origin, const glm::vec3& direction, float tMax, OccludedFunc occludedLeaf, RTStats* stats) const
+{
+	if (IsEmpty()) return false;
+	const BVHNode* nodes = NodeData();
+
+	const glm::vec3 invDir = 1.f / direction;
+	bool occluded = false;
+
+	unsigned int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	unsigned int nodesVisited = 0, primTests = 0;
+
+	while (stackSize > 0)
+	{
+		const BVHNode& node = nodes[stack[--stackSize]];
+
+		nodesVisited++;
+		if (IntersectBounds(node, origin, invDir, tMax) == INFINITY) continue;
+
+		if (node.IsLeaf())
+		{
+			primTests += node.m_primCount;
+			if (occludedLeaf(node.m_leftFirst, node.m_primCount, tMax))
+			{
+				occluded = true;
+				break;
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.m_leftFirst + 1;
+			stack[stackSize++] = node.m_leftFirst;
+		}
+	}
+
+	if (stats)
+	{
+		stats->m_nodesVisited += nodesVisited;
+		stats->m_primTests += primTests;
+	}
+
+	return occluded;
+}
+
+template <typename IntersectFunc>
+void BVH::TraversePacket(const RayPacket& packet, vfloat& tMax, IntersectFunc intersectLeaf, RTStats* stats) const
+{
+	if (IsEmpty()) return;
+	const BVHNode* nodes = NodeData();
+
+	unsigned int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	unsigned int nodesVisited = 0, primTests = 0;
+
+	while (stackSize > 0)
+	{
+		const BVHNode& node = nodes[stack[--stackSize]];
+
+		// Lanes that miss the node are masked out for the whole subtree
+		const vmask active = IntersectBounds(node, packet, tMax) & packet.m_active;
+		nodesVisited++;
+		if (None(active)) continue;
+
+		if (node.IsLeaf())
+		{
+			primTests += node.m_primCount * CountLanes(active);
+			intersectLeaf(node.m_leftFirst, node.m_primCount, active, tMax);
+			continue;
+		}
+
+		// Order the children along the representative ray, the far one is pushed first
+		const BVHNode& left = nodes[node.m_leftFirst];
+		const BVHNode& right = nodes[node.m_leftFirst + 1];
+		const float leftDist = glm::dot(left.m_boundsMin + left.m_boundsMax, packet.m_firstDirection);
+		const float rightDist = glm::dot(right.m_boundsMin + right.m_boundsMax, packet.m_firstDirection);
+
+		if (leftDist < rightDist)
+		{
+			stack[stackSize++] = node.m_leftFirst + 1;
+			stack[stackSize++] = node.m_leftFirst;
+		}
+		else
+		{
+			stack[stackSize++] = node.m_leftFirst;
+			stack[stackSize++] = node.m_leftFirst + 1;
+		}
+	}
+
+	// Every node is tested against all the rays of the packet
+	if (stats)
+	{
+		stats->m_nodesVisited += nodesVisited * CountLanes(packet.m_active);
+		stats->m_primTests += primTests;
+	}
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <vector>
+
+#include "Files/RT/headers/ray.h"
+#include "Files/RT/headers/simd.h"
+
+// Edge avoiding a-trous wavelet filter of a rendering with few samples (Dammertz et al. 2010).
+// The lighting is filtered apart from the albedo so the textures stay sharp, the neighbours
+// are weighted by how close their normal and depth are and by their luminance difference
+// relative to the noise of the pixel, like SVGF (Schied et al. 2017).
+//
+// The passes go over bands of rows on several threads, the pixels of a row are filtered
+// RT_SIMD_WIDTH at a time from planes with a replicated border so no tap needs a test.
+class Denoiser
+{
+public:
+	Denoiser();
+
+	// colors, features and variances have width * height pixels, variances is the variance
+	// of the mean luminance of each pixel. Without it the noise is estimated from the
+	// neighbours. result can be colors.
+	void Denoise(int width, int height, const Color* colors, const PixelFeatures* features, const float* variances, int numThreads, Color* result);
+
+private:
+	typedef std::vector<float, AlignedAllocator<float> > Plane;
+
+	void LoadPlanes(const Color* colors, const PixelFeatures* features, const float* variances);
+	void FilterRow(int pass, int y);
+	void FillBorders(Plane& plane, int y);
+	void RunOnRows(int numThreads, int pass);
+
+	float* Row(Plane& plane, int y) { return &plane[y * m_stride + m_border]; }
+
+private:
+	int m_width, m_height;
+	int m_stride, m_border;
+
+	// The filtered passes go back and forth between the two sets of lighting planes
+	Plane m_lighting[2][3];
+	Plane m_variance[2];
+	Plane m_normal[3];
+	Plane m_inverseDepth;
+	std::vector<Color> m_albedo;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef RAY_H
+#define RAY_H
+
+#include "Files/ThirdParty/glm/glm.hpp"
+
+struct RTMaterial;
+
+typedef glm::vec3 Color;
+
+// Relative luminance of a linear color (Rec. 709)
+inline float Luminance(const Color& color)
+{
+	return glm::dot(color, Color(0.2126f, 0.7152f, 0.0722f));
+}
+
+struct Ray
+{
+	Ray() : m_origin(glm::vec3(0.f)), m_direction(glm::vec3(0.f))
+	{}
+
+	Ray(const glm::vec3& origin, const glm::vec3& direction) : m_origin(origin), m_direction(direction)
+	{}
+
+	glm::vec3 m_origin, m_direction;
+};
+
+struct HitInfo
+{
+	HitInfo() : m_distanceHit(0.f), m_positionHit(glm::vec3(0.f)), m_normalHit(glm::vec3(0.f)), m_colorHit(glm::vec3(0.f)), m_isInside(false), m_material(nullptr),
+		m_instance(-1), m_mesh(-1), m_prim(-1)
+	{}
+
+	float m_distanceHit;
+	glm::vec3 m_positionHit, m_normalHit, m_colorHit;
+	bool m_isInside;
+	const RTMaterial* m_material;
+
+	// What was hit, the same way as an Occluder
+	int m_instance; // Index of the instance, -1 for the spheres and meshes of the scene itself
+	int m_mesh; // Index of the mesh, -1 for the spheres. 0 for the mesh of the object of an instance.
+	int m_prim; // Sphere index or triangle of the mesh
+};
+
+// Surface seen through a pixel, written by the tracer to guide the denoiser. Mirrors
+// are looked through, the normal and albedo are those of the first diffuse surface or
+// glass. The background has a zero normal and a white albedo.
+struct PixelFeatures
+{
+	PixelFeatures() : m_normal(0.f), m_albedo(0.f), m_depth(0.f)
+	{}
+
+	glm::vec3 m_normal;
+	Color m_albedo;
+	float m_depth; // Distance of the camera hit, 0 for the background
+};
+
+// Surface seen through the center of a pixel, kept to find the pixel again in the next
+// frame. Only diffuse surfaces are valid, the color of the others changes with the view.
+struct PixelSurface
+{
+	PixelSurface() : m_position(0.f), m_normal(0.f), m_valid(false)
+	{}
+
+	glm::vec3 m_position, m_normal;
+	bool m_valid;
+};
+
+#endif
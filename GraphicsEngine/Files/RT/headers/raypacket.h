@@ -0,0 +1,46 @@
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/ray.h"
+#include "Files/RT/headers/simd.h"
+
+// RT_SIMD_WIDTH coherent rays traced together, one ray per SIMD lane.
+// Lanes past the number of rays given are inactive.
+struct RayPacket
+{
+	RayPacket(const Ray* rays, int count)
+	{
+		RT_ALIGN(64) float values[9][RT_SIMD_WIDTH];
+
+		for (int lane = 0; lane < RT_SIMD_WIDTH; ++lane)
+		{
+			// Inactive lanes repeat the first ray so they never produce NaNs
+			const Ray& ray = rays[lane < count ? lane : 0];
+			for (int c = 0; c < 3; ++c)
+			{
+				values[c][lane] = ray.m_origin[c];
+				values[3 + c][lane] = ray.m_direction[c];
+				values[6 + c][lane] = 1.f / ray.m_direction[c];
+			}
+		}
+
+		m_originX = LoadFloats(values[0]); m_originY = LoadFloats(values[1]); m_originZ = LoadFloats(values[2]);
+		m_dirX = LoadFloats(values[3]); m_dirY = LoadFloats(values[4]); m_dirZ = LoadFloats(values[5]);
+		m_invDirX = LoadFloats(values[6]); m_invDirY = LoadFloats(values[7]); m_invDirZ = LoadFloats(values[8]);
+
+		m_active = FirstLanes(count);
+		m_firstOrigin = rays[0].m_origin;
+		m_firstDirection = rays[0].m_direction;
+	}
+
+	vfloat m_originX, m_originY, m_originZ;
+	vfloat m_dirX, m_dirY, m_dirZ;
+	vfloat m_invDirX, m_invDirY, m_invDirZ;
+	vmask m_active;
+
+	// Representative ray used to order the traversal front to back
+	glm::vec3 m_firstOrigin, m_firstDirection;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef RAYQUEUE_H
+#define RAYQUEUE_H
+
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/ray.h"
+#include "Files/RT/headers/simd.h"
+
+typedef std::vector<float, AlignedAllocator<float> > RayFloatArray;
+
+// Rays of one bounce of a wavefront in SoA layout. Each ray carries the weight
+// of its contribution to the pixel it was spawned for, so the colors of the
+// children only have to be added to the pixel instead of returned to a parent.
+// Path traced rays also keep the density they were sampled with, 0 for the
+// camera rays and the specular bounces.
+struct RayQueue
+{
+	int Size() const { return (int)m_pixel.size(); }
+
+	void Clear()
+	{
+		m_originX.clear(); m_originY.clear(); m_originZ.clear();
+		m_dirX.clear(); m_dirY.clear(); m_dirZ.clear();
+		m_weightR.clear(); m_weightG.clear(); m_weightB.clear();
+		m_pdf.clear();
+		m_pixel.clear();
+	}
+
+	void Push(const Ray& ray, const Color& weight, int pixel, float pdf = 0.f)
+	{
+		m_originX.push_back(ray.m_origin.x); m_originY.push_back(ray.m_origin.y); m_originZ.push_back(ray.m_origin.z);
+		m_dirX.push_back(ray.m_direction.x); m_dirY.push_back(ray.m_direction.y); m_dirZ.push_back(ray.m_direction.z);
+		m_weightR.push_back(weight.r); m_weightG.push_back(weight.g); m_weightB.push_back(weight.b);
+		m_pdf.push_back(pdf);
+		m_pixel.push_back(pixel);
+	}
+
+	Ray GetRay(int i) const { return Ray(glm::vec3(m_originX[i], m_originY[i], m_originZ[i]), glm::vec3(m_dirX[i], m_dirY[i], m_dirZ[i])); }
+	Color Weight(int i) const { return Color(m_weightR[i], m_weightG[i], m_weightB[i]); }
+
+	RayFloatArray m_originX, m_originY, m_originZ;
+	RayFloatArray m_dirX, m_dirY, m_dirZ;
+	RayFloatArray m_weightR, m_weightG, m_weightB;
+	RayFloatArray m_pdf;
+	std::vector<int> m_pixel;
+};
+
+// Shadow rays towards the lights. Their contribution is added to the pixel
+// if nothing lies between the origin and the light.
+struct ShadowQueue
+{
+	int Size() const { return (int)m_pixel.size(); }
+
+	void Clear()
+	{
+		m_originX.clear(); m_originY.clear(); m_originZ.clear();
+		m_dirX.clear(); m_dirY.clear(); m_dirZ.clear();
+		m_maxDistance.clear();
+		m_contributionR.clear(); m_contributionG.clear(); m_contributionB.clear();
+		m_light.clear();
+		m_pixel.clear();
+	}
+
+	void Push(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, int light, const Color& contribution, int pixel)
+	{
+		m_originX.push_back(origin.x); m_originY.push_back(origin.y); m_originZ.push_back(origin.z);
+		m_dirX.push_back(direction.x); m_dirY.push_back(direction.y); m_dirZ.push_back(direction.z);
+		m_maxDistance.push_back(maxDistance);
+		m_contributionR.push_back(contribution.r); m_contributionG.push_back(contribution.g); m_contributionB.push_back(contribution.b);
+		m_light.push_back(light);
+		m_pixel.push_back(pixel);
+	}
+
+	glm::vec3 Origin(int i) const { return glm::vec3(m_originX[i], m_originY[i], m_originZ[i]); }
+	glm::vec3 Direction(int i) const { return glm::vec3(m_dirX[i], m_dirY[i], m_dirZ[i]); }
+	Color Contribution(int i) const { return Color(m_contributionR[i], m_contributionG[i], m_contributionB[i]); }
+
+	RayFloatArray m_originX, m_originY, m_originZ;
+	RayFloatArray m_dirX, m_dirY, m_dirZ;
+	RayFloatArray m_maxDistance;
+	RayFloatArray m_contributionR, m_contributionG, m_contributionB;
+	std::vector<int> m_light;
+	std::vector<int> m_pixel;
+};
+
+// Buffers of the wavefront tracing of one thread, kept between the waves
+// and the rows so they are only allocated once
+struct Wavefront
+{
+	RayQueue m_rays, m_nextRays;
+	ShadowQueue m_shadowRays;
+
+	std::vector<HitInfo> m_hitInfos;
+	std::vector<char> m_hits;
+	std::vector<int> m_diffuseHits, m_specularHits; // Rays of the wave sorted by the kind of material hit
+};
+
+#endif
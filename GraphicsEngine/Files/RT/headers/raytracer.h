@@ -0,0 +1,149 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/ray.h"
+#include "Files/RT/headers/rtcamera.h"
+#include "Files/RT/headers/rtmaterial.h"
+#include "Files/RT/headers/rtsampler.h"
+#include "Files/RT/headers/rtscene.h"
+#include "Files/RT/headers/tracecontext.h"
+
+// How the light reaching the camera is computed
+enum RTIntegrator { RT_WHITTED = 0, RT_PATH_TRACING = 1 };
+
+// Parameters of a rendering, copied by the renderer so they can change while it runs
+struct RenderSettings
+{
+	RenderSettings() : m_width(0), m_height(0), m_maxRayDepth(1), m_backgroundColor(0.9f), m_epsilonFactor(1e-4f),
+		m_samplesPerPixel(1), m_preview(false), m_adaptive(false), m_adaptiveThreshold(0.02f),
+		m_integrator(RT_WHITTED), m_nextEventEstimation(true), m_denoise(false), m_lightSelection(RT_LIGHTS_TREE),
+		m_shadowRays(4), m_sampler(RT_SAMPLER_SOBOL), m_temporalReuse(false), m_numThreads(0) {}
+
+	int m_width;
+	int m_height;
+	RTCamera m_camera;
+	int m_maxRayDepth;
+	Color m_backgroundColor;
+	float m_epsilonFactor;
+
+	int m_samplesPerPixel; // Jittered inside the pixels, a single sample goes through their center
+	bool m_preview; // Quick low resolution pass shown before the samples
+
+	// Adaptive sampling spends the samples where the pixels are still noisy,
+	// m_samplesPerPixel is then the average budget over the image
+	bool m_adaptive;
+	float m_adaptiveThreshold; // Relative error under which a pixel gets no more samples
+
+	RTIntegrator m_integrator; // The path tracer takes m_maxRayDepth as the number of bounces
+	bool m_nextEventEstimation; // Path tracing samples the lights directly, only turned off to measure its benefit
+	bool m_denoise; // The finished image is filtered, guided by the surfaces seen by the pixels
+
+	// Shadow rays of a diffuse hit. With more lights than that they are picked at random
+	// and the rays weighted by how likely their light was, the cost stays the same.
+	// The Whitted lights do not fall off with distance, they are always picked by power.
+	RTLightSelection m_lightSelection;
+	int m_shadowRays;
+
+	// Numbers of the jitter and of the paths, keyed by pixel and sample so the image
+	// is the same whatever the number of threads
+	RTSamplerType m_sampler;
+
+	// A frame rendered after the camera moved starts from the pixels of the previous frame
+	// that still see the same diffuse surface, only the others are traced in the first pass
+	bool m_temporalReuse;
+	int m_numThreads; // 0 uses all the cores
+};
+
+// Whitted style ray tracing of a scene. It has no state of its own, any number of
+// threads can trace with it at once, each with its own TraceContext.
+//
+// Rows and pixel lists are traced as wavefronts: all the rays of a bounce are
+// kept in a queue and intersected together, the hits are sorted by material,
+// the diffuse ones queue their shadow rays and the mirrors and glass queue
+// their children, weighted by their share of the pixel, for the next wave.
+// TraceRay is the recursive equivalent for a single ray.
+//
+// The path tracer goes through the same waves with one ray per path. Diffuse
+// surfaces bounce a cosine distributed ray and sample each light sphere
+// directly, both estimates are combined with multiple importance sampling.
+// Long paths are cut short by Russian roulette.
+//
+// The jitter and the random choices of a path come from the sampler of the
+// settings, each at its own dimension of the sample of the pixel.
+//
+// Both send at most m_shadowRays shadow rays from a diffuse surface, to lights
+// picked by the light sampler of the scene when there are more of them.
+class RayTracer
+{
+public:
+	RayTracer(const RTScene& scene, const RenderSettings& settings);
+
+	const RenderSettings& Settings() const { return m_settings; }
+
+	// Only between two frames, no thread may be tracing
+	void SetCamera(const RTCamera& camera) { m_settings.m_camera = camera; }
+
+	Ray CameraRay(float x, float y)const;
+
+	// Traces the pixels 0, pixelStep, 2 * pixelStep... of row y into colors, sample is
+	// the index of the sample in these pixels the sampler draws its numbers for.
+	// startDepth = m_maxRayDepth skips the reflections and refractions.
+	// The surfaces seen by the pixels are written to features if it is given.
+	void TraceRow(int y, int pixelStep, int sample, bool jitter, int startDepth, TraceContext& context, Color* colors, PixelFeatures* features = nullptr)const;
+
+	// Traces the count pixels of the list into colors, each given as y * width + x
+	// with the index of its sample in samples
+	void TracePixels(const int* pixels, const int* samples, int count, bool jitter, int startDepth, TraceContext& context, Color* colors, PixelFeatures* features = nullptr)const;
+
+	// Diffuse surfaces seen through the centers of the count pixels of the list, to
+	// reproject them into the next frame
+	void TraceSurfaces(const int* pixels, int count, TraceContext& context, PixelSurface* surfaces)const;
+
+	Color TraceRay(Ray& ray, const int &depth, TraceContext& context)const;
+	Color ShadeHit(const Ray& ray, const HitInfo& closestHitInfo, const int &depth, TraceContext& context)const;
+
+private:
+	// Traces the camera rays queued in context.m_wavefront.m_rays, colors must start at zero
+	void TraceCameraRays(int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const;
+	void TraceWavefront(int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const;
+	void IntersectWave(Wavefront& wavefront, RTStats& stats)const;
+	void ShadeWave(int depth, TraceContext& context, Color* colors, PixelFeatures* features)const;
+	void TraceShadowRays(TraceContext& context, Color* colors)const;
+
+	void TracePaths(int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const;
+	void ShadePathWave(int depth, TraceContext& context, Color* colors, PixelFeatures* features)const;
+	void SampleLights(const HitInfo& hitInfo, const glm::vec3& origin, const Color& weight, int pixel, int dimension, TraceContext& context)const;
+
+	RTLightSelection LightSelection()const;
+
+	// Numbers of the sample of the pixel-th pixel traced, see BounceDimension for the dimensions
+	float Sample1D(const TraceContext& context, int pixel, int dimension)const;
+	glm::vec2 Sample2D(const TraceContext& context, int pixel, int dimension)const;
+	int BounceDimension(int depth)const;
+
+	// Light the ray-th shadow ray of a diffuse hit goes to, each light gets one when the budget allows.
+	// share is the weight of the ray, one over the number of rays the light gets on average.
+	// The pick takes the number of the dimension of the pixel, the recursive tracer has no
+	// pixel (-1) and draws from the context. Returns the index in the light sampler, -1 if
+	// no light was picked.
+	int NumShadowRays()const;
+	int PickLight(int ray, const glm::vec3& point, TraceContext& context, int pixel, int dimension, float& share)const;
+	Color LightRadiance(int light)const;
+	float LightPdf(int light, const glm::vec3& point)const;
+
+	float FresnelWeight(const glm::vec3& rayDir, const glm::vec3& normalHit)const;
+
+	Color BlendReflRefrColors(const RTMaterial* material, const glm::vec3 &rayDir, const glm::vec3 &normalHit, const Color &reflColor, const Color &refrColor)const;
+
+	Ray CalcReflectionRay(const Ray& ray, const HitInfo& hitInfo)const;
+	Ray CalcRefractionRay(const Ray& ray, const HitInfo& hitInfo, const RTMaterial* material)const;
+	Color CalcDiffuseColor(const HitInfo& hitInfo, const RTMaterial* material, TraceContext& context)const;
+
+private:
+	const RTScene& m_scene;
+	RenderSettings m_settings;
+	RTSampler m_sampler;
+};
+
+#endif
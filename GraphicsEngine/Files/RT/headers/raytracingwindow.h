@@ -1,39 +1,20 @@
 #include <QWidget>
+#include <QTimer>
+#include <QImage>
+#include <memory>
 #include "ui_raytracingwindow.h"
 
 #include "Files/ThirdParty/glm/glm.hpp"
 #include "Files/definitions.h"
 #include "Files/sphere.h"
+#include "Files/model.h"
+#include "Files/RT/headers/ray.h"
+#include "Files/RT/headers/rtscene.h"
+#include "Files/RT/headers/renderjob.h"
 #include "AbstractWindow.h"
 
 class MainWindow;
 
-typedef glm::vec3 Color;
-
-struct Ray
-{
-	Ray() : m_origin(glm::vec3(0.f)), m_direction(glm::vec3(0.f))
-	{}
-
-	Ray(glm::vec3& origin, glm::vec3& direction) : m_origin(origin), m_direction(direction)
-	{}
-
-	glm::vec3 m_origin, m_direction;
-};
-
-struct HitInfo
-{
-	HitInfo() : m_distanceHit(0.f), m_positionHit(glm::vec3(0.f)), m_normalHit(glm::vec3(0.f)), m_colorHit(glm::vec3(0.f)), m_isInside(m_isInside)
-	{}
-
-	HitInfo(float& distanceHit, glm::vec3& positionHit, glm::vec3& normalHit, glm::vec3& colorHit, bool& isInside) : m_distanceHit(distanceHit), m_positionHit(positionHit), m_normalHit(normalHit), m_colorHit(colorHit), m_isInside(isInside)
-	{}
-
-	float m_distanceHit;
-	glm::vec3 m_positionHit, m_normalHit, m_colorHit;
-	bool m_isInside;
-};
-
 class RayTracingWindow : public AbstractWindow
 {
 	Q_OBJECT
@@ -46,31 +27,37 @@ private slots:
 	void DockUndock() override;
 	void RaytraceScene();
 	void MaxRayDepthChanged(int value);
+	void SceneModelChanged(int index);
 	void ShowRenderProgressChanged(bool value);
 	void OnSave();
+	void SamplesChanged(int value);
+	void AdaptiveChanged(bool value);
+	void IntegratorChanged(int index);
+	void DenoiseChanged(bool value);
+	void ToneMapChanged(bool value);
+	void RefreshRender();
+	void CancelRender();
+
+protected:
+	// First person camera on the view: W, S, A, D, Q and E move, a left drag turns, R resets
+	bool eventFilter(QObject* object, QEvent* event) override;
 
 signals:
 	void RenderingProgress(int);
 	
 private:
 	void InitGUI();
-	void RenderIntoTexture(glm::vec3* image, int width, int height);
-	void ClearImage(glm::vec3* image, int width, int height);
+	void RenderIntoTexture(const Color* image, int width, int height);
+	void AddSceneModel();
 
 
 	// Ray Tracing
-	Color TraceRay(Ray& ray, const int &depth)const;
-
-	void Render();
-	
-	bool Intersection(const Sphere &sphere, const Ray& ray, HitInfo& hitInfo)const;
+	void StartRender();
+	bool IsRendering() const;
 
-	Color& BlendReflRefrColors(const Sphere* sphere, const glm::vec3 &rayDir, const glm::vec3 &normalHit, const Color &reflColor, const Color &refrColor)const;
-
-	Ray& CalcReflectionRay(const Ray& ray, const HitInfo& hitInfo)const;
-	Ray& CalcRefractionRay(const Ray& ray, const HitInfo& hitInfo, const Sphere* sphere)const;
-	Color& CalcDiffuseColor(HitInfo& hitInfo, Sphere* sphere)const;
-	
+	// The job goes on to a frame from the new camera, starting from the one it rendered
+	void CameraChanged();
+	void RestartFromCamera();
 
 private:
 	/* Attributes */
@@ -85,7 +72,29 @@ private:
 	
 	Ui::RayTracingWindow m_ui;
 
-	std::vector<Sphere> m_spheres;
+	RTScene m_scene;
+
+	// Model traced along with the spheres, loaded on demand
+	Model m_model;
+	QString m_modelFilename;
+	QString m_loadedModelFilename;
 
 	float m_epsilonFactor;
+
+	// Camera of the renders, a move waits for the first pass of the current frame
+	RTCamera m_camera;
+	bool m_cameraMoved = false;
+	QPoint m_lastMousePos;
+
+	// Rendering in the background, the view is refreshed from a timer
+	std::unique_ptr<RenderJob> m_renderJob;
+	QTimer m_refreshTimer;
+	unsigned int m_shownVersion;
+	std::vector<Color> m_image; // Copy of the image of the job shown in the view
+
+	// The view keeps its scene and pixmap item, each refresh only converts the
+	// image into the framebuffer and hands it to the item
+	QGraphicsScene* m_viewScene;
+	QGraphicsPixmapItem* m_imageItem;
+	QImage m_framebuffer;
 };
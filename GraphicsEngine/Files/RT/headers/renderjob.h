@@ -0,0 +1,187 @@
+#ifndef RENDERJOB_H
+#define RENDERJOB_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Files/RT/headers/denoiser.h"
+#include "Files/RT/headers/raytracer.h"
+
+// Rendering of an image on background threads. The job owns its framebuffer,
+// the threads take rows one at a time and the progress is kept in atomic
+// counters so the caller can poll it at its own pace. The scene must not
+// change until the job is finished or cancelled.
+//
+// With adaptive sampling the image is rendered in rounds of tiles. Every pixel
+// first gets a few samples, then each round gives more samples to the pixels
+// whose estimated error, or the error of a neighbour, is still above the
+// threshold. The noisiest tiles go first, until the error is low enough
+// everywhere or the budget is spent.
+//
+// With denoising the surfaces seen by the samples are averaged along with their
+// colors, the last thread done filters the image before the job is finished.
+//
+// A finished job can be started again to render another frame of a scene that
+// changed in between, with the same threads and buffers. The threads wait for
+// the next frame until the job is destroyed.
+//
+// With temporal reuse the pixels keep the diffuse surface seen through their
+// center. When the next frame starts, from a camera that may have moved, each
+// surface is projected into the previous frame: a pixel whose four neighbours
+// there saw the same plane starts from their closest one's samples. The first
+// pass only traces the other pixels, disoccluded, at an edge, or seeing a
+// mirror or glass whose color depends on the view, the next passes refine them
+// all. Adaptive sampling does not reuse anything.
+class RenderJob
+{
+public:
+	RenderJob(const RTScene& scene, const RenderSettings& settings);
+	~RenderJob();
+
+	// Starts rendering a frame and returns right away. The previous frame must be
+	// finished, its image and counters are cleared.
+	void Start();
+
+	// Camera of the next frame, only while the job is finished
+	void SetCamera(const RTCamera& camera) { m_tracer.SetCamera(camera); }
+
+	// Stops the threads once they finish their current row and waits for them.
+	// The image keeps what was rendered.
+	void Cancel();
+
+	// Waits for the threads to finish the frame
+	void Wait();
+
+	bool IsFinished() const { return m_runningThreads == 0; }
+	bool IsCancelled() const { return m_cancel; }
+	const RenderSettings& Settings() const { return m_tracer.Settings(); }
+
+	// Fraction of the rows done, counting every sample pass
+	float Progress() const;
+
+	// Samples per pixel that every pixel already has
+	int SamplesDone() const;
+
+	// Camera samples traced so far, over all the pixels
+	long long SamplesTraced() const { return m_samplesTraced; }
+
+	// Every row has its first sample, or the pixels reused from the previous frame
+	bool FirstPassDone() const { return m_firstPassRows == m_tracer.Settings().m_height; }
+
+	// Pixels of the frame that started from the previous one
+	long long ReusedPixels() const { return m_reusedPixels; }
+
+	// Changes every time rows are written to the image
+	unsigned int Version() const { return m_version; }
+
+	void CopyImage(std::vector<Color>& image) const;
+
+	// Work done by the threads that are finished, all of it once the job is finished,
+	// and the wall time from the start to the last thread done
+	RTStats Stats() const;
+	double ElapsedSeconds() const;
+
+private:
+	// Samples to add to a tile in the current adaptive round
+	struct TileWork
+	{
+		int m_tile;
+		int m_samples;
+	};
+
+	void RenderThread(int threadIndex);
+	bool WaitForFrame(unsigned int& frame);
+	void FinishFrame(TraceContext& context);
+	void ResetFrame();
+	void RenderPreviewRow(int y, TraceContext& context, std::vector<Color>& colors);
+	void RenderSampleRow(int y, int sample, TraceContext& context, std::vector<Color>& colors, std::vector<PixelFeatures>& features);
+	void RenderTemporalRow(int y, int sample, TraceContext& context, std::vector<Color>& colors, std::vector<PixelFeatures>& features);
+
+	// Pixel of the previous frame that saw the surface, -1 if it cannot be reused
+	int ReprojectPixel(const PixelSurface& surface) const;
+	void ReusePixel(int pixel, int previous);
+	int PixelSamples(int pixel) const;
+	bool TemporalReuse() const;
+
+	void RenderAdaptive(TraceContext& context);
+	void RenderTile(const TileWork& work, TraceContext& context, std::vector<Color>& colors, std::vector<PixelFeatures>& features);
+
+	// Adds the features of the samples of a pixel to its sums
+	void AccumulateFeatures(int pixel, const PixelFeatures& features);
+	void DenoiseImage();
+
+	// Waits for the next tile of the round, plans the next round once the current one
+	// is done. Returns false when there is nothing left to do.
+	bool NextTile(TileWork& work);
+	void FinishTile();
+	bool PlanNextRound();
+	float PixelError(int pixel) const;
+	void TileBounds(int tile, int& x0, int& y0, int& x1, int& y1) const;
+
+private:
+	RayTracer m_tracer;
+	std::vector<std::thread> m_threads;
+
+	// A work item is a preview row or a row of one sample pass
+	int m_numPreviewItems;
+	int m_numItems;
+	std::atomic<int> m_nextItem;
+	std::atomic<int> m_itemsDone;
+	std::atomic<int> m_runningThreads;
+	std::atomic<int> m_renderingThreads; // Running threads that are not done with the samples
+	std::atomic<bool> m_cancel;
+	std::atomic<unsigned int> m_version;
+
+	// The threads wait for a new frame number, or to quit, between two frames
+	std::mutex m_frameMutex;
+	std::condition_variable m_frameCondition;
+	unsigned int m_frame;
+	bool m_quit;
+
+	mutable std::mutex m_imageMutex;
+	std::vector<Color> m_image;
+	std::vector<Color> m_accumulation; // Sum of the samples of each pixel
+	std::vector<int> m_rowSamples;
+	std::condition_variable m_rowCondition; // A row got its next sample
+	std::atomic<long long> m_samplesTraced;
+	std::atomic<int> m_firstPassRows;
+	std::vector<float> m_luminance2; // Sum of the squared luminance of the samples of each pixel
+	std::vector<PixelFeatures> m_featureSums;
+	Denoiser m_denoiser;
+	std::chrono::steady_clock::time_point m_startTime;
+	RTStats m_stats; // Covered by the image mutex
+	double m_elapsedSeconds;
+
+	// Temporal reuse, the surfaces and sample counts are covered by the image mutex too.
+	// The buffers of the previous frame are swapped in when a frame starts.
+	RTCamera m_frameCamera;
+	bool m_reproject; // The frame starts from the previous one
+	std::atomic<long long> m_reusedPixels;
+	std::vector<int> m_baseSamples; // Samples of a pixel not counted by its row: the reused ones, minus the first pass
+	std::vector<PixelSurface> m_surfaces;
+	RTCamera m_previousCamera;
+	std::vector<PixelSurface> m_previousSurfaces;
+	std::vector<Color> m_previousAccumulation;
+	std::vector<float> m_previousLuminance2;
+	std::vector<PixelFeatures> m_previousFeatureSums;
+	std::vector<int> m_previousSamples;
+
+	// Adaptive sampling, the pixel samples are covered by the image mutex too
+	int m_tilesX, m_tilesY;
+	long long m_sampleBudget;
+	std::vector<int> m_pixelSamples;
+	std::vector<char> m_pixelActive; // Pixels sampled in the current round
+
+	std::mutex m_scheduleMutex;
+	std::condition_variable m_roundCondition;
+	std::vector<TileWork> m_round;
+	size_t m_nextTile;
+	size_t m_tilesDone;
+	std::atomic<bool> m_scheduleDone;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef RTANIMATION_H
+#define RTANIMATION_H
+
+#include <string>
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+
+class RTScene;
+
+// Position and size of a sphere at a time, in seconds
+struct SphereKeyframe
+{
+	float m_time;
+	glm::vec3 m_center;
+	float m_radius;
+};
+
+// Keyframed spheres of the scene. Between two keys a sphere moves in a straight
+// line, before the first key and after the last one it stays where they put it.
+// The materials do not change, only the geometry the BVH is refit to.
+class RTAnimation
+{
+public:
+	void AddKey(int sphere, const SphereKeyframe& key);
+	void Clear() { m_tracks.clear(); }
+	bool IsEmpty() const { return m_tracks.empty(); }
+
+	// Time of the last key
+	float Duration() const;
+
+	// Text file with one key per line: "time sphere x y z radius", # starts a comment.
+	// The sphere is its index in the scene, the lights can be moved too.
+	bool Load(const std::string& filename, std::string& error);
+
+	// One turn of the non light spheres around the vertical axis through their
+	// middle, in duration seconds. The ground sphere stays where it is.
+	static RTAnimation Turntable(const RTScene& scene, float duration);
+
+	// Moves the spheres to where they are at time. Returns false if a key is for
+	// a sphere the scene does not have.
+	bool Apply(RTScene& scene, float time) const;
+
+private:
+	struct Track
+	{
+		int m_sphere;
+		std::vector<SphereKeyframe> m_keys;
+	};
+
+	std::vector<Track> m_tracks;
+};
+
+#endif
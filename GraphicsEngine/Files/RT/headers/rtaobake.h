@@ -0,0 +1,41 @@
+#ifndef RTAOBAKE_H
+#define RTAOBAKE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Files/model.h"
+
+struct RTAOBakeSettings
+{
+	int m_rays = 256; // Ambient occlusion rays of a vertex
+	float m_radius = 0.f; // Longest ray in the units of the model, 0 for a tenth of its size
+	float m_epsilonFactor = 1e-4f; // Offset of the rays from the surface, relative to the size of the model
+	int m_numThreads = 0; // 0 for one per core
+};
+
+// Ambient visibility of each corner of the triangles of the model, in the order of
+// its VBOs: the fraction of the cosine weighted hemisphere around the normal that no
+// geometry closer than the radius hides. The corners sharing a position and a normal
+// are a single vertex, baked once. The rays are traced against a BVH of the model,
+// the vertices are spread over the threads.
+void BakeAmbientOcclusion(const Model& model, const RTAOBakeSettings& settings, std::vector<float>& visibility);
+
+// The mesh cache keeps the baked attribute next to the model, keyed by a hash of the
+// geometry so a model that changed since it was baked does not load stale values
+std::string AOCacheFilename(const std::string& modelFilename);
+uint64_t ModelGeometryHash(const Model& model);
+bool SaveAOCache(const std::string& filename, const Model& model, const RTAOBakeSettings& settings, const std::vector<float>& visibility);
+bool LoadAOCache(const std::string& filename, const Model& model, std::vector<float>& visibility);
+
+struct RTAOBakeOptions
+{
+	std::string m_modelFilename;
+	RTAOBakeSettings m_settings;
+};
+
+// Bakes the model into its cache for --bake-ao. Returns the exit code of the application.
+int RunAOBake(const RTAOBakeOptions& options);
+
+#endif
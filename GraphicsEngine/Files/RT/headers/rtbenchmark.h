@@ -0,0 +1,8 @@
+#ifndef RTBENCHMARK_H
+#define RTBENCHMARK_H
+
+// Ray tracing benchmarks, results are printed on the standard output.
+// Returns the exit code of the application.
+int RunRTBenchmark();
+
+#endif
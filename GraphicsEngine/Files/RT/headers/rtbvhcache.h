@@ -0,0 +1,55 @@
+#ifndef RTBVHCACHE_H
+#define RTBVHCACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Files/RT/headers/aabb.h"
+#include "Files/RT/headers/bvh.h"
+
+// What a cached BVH was built from. The BVH only depends on the bounds of the
+// primitives and the parameters of the build.
+struct RTBVHCacheKey
+{
+	uint64_t m_geometryHash; // Of the bounds of the primitives, in order
+	uint32_t m_primCount;
+	uint32_t m_maxLeafSize;
+	uint32_t m_primsPerTest;
+};
+
+// Built BVHs kept in a directory, one file per key, so a model is only built once.
+// A file is a 64 byte header followed by the nodes and the primitive indices exactly
+// as the BVH holds them in memory, at 64 byte aligned offsets. The nodes point to
+// each other by index, the file is mapped and traversed where it is (read in two
+// blocks on Windows). It is written in the byte order and node layout of the machine,
+// a file from another one is rejected and built again.
+class RTBVHCache
+{
+public:
+	explicit RTBVHCache(const std::string& directory);
+
+	// Loads the BVH of primBounds built with these parameters, or builds it and saves it.
+	// Returns true if it was loaded.
+	bool Build(BVH& bvh, const std::vector<AABB>& primBounds, int maxLeafSize, int primsPerTest);
+
+	static RTBVHCacheKey Key(const std::vector<AABB>& primBounds, int maxLeafSize, int primsPerTest);
+	std::string Filename(const RTBVHCacheKey& key) const;
+
+	static bool Save(const std::string& filename, const RTBVHCacheKey& key, const BVH& bvh);
+	// False if the file is missing, from another key or too short, bvh is left as it was.
+	// Only the header and the sizes are checked, the nodes are trusted like the build that
+	// wrote them: the loader must not touch every page of a file the traversal may not need.
+	static bool Load(const std::string& filename, const RTBVHCacheKey& key, BVH& bvh);
+
+	const std::string& Directory() const { return m_directory; }
+	int NumLoaded() const { return m_numLoaded; }
+	int NumSaved() const { return m_numSaved; }
+
+private:
+	std::string m_directory;
+	int m_numLoaded;
+	int m_numSaved;
+};
+
+#endif
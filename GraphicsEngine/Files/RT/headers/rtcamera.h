@@ -0,0 +1,46 @@
+#ifndef RTCAMERA_H
+#define RTCAMERA_H
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/ray.h"
+
+// First person camera of the ray tracer, turned by yaw and pitch like the FPS camera
+// of the SSAO view. The default one is the fixed camera the tracer always had: at the
+// origin, looking down -z with a vertical field of view of 30 degrees.
+class RTCamera
+{
+public:
+	RTCamera();
+
+	const glm::vec3& Position() const { return m_position; }
+	const glm::vec3& Front() const { return m_front; }
+	float Yaw() const { return m_yaw; }
+	float Pitch() const { return m_pitch; }
+	float FieldOfView() const { return m_fov; }
+
+	// Angles in degrees, a zero yaw looks down -z
+	void Set(const glm::vec3& position, float yaw, float pitch, float fov);
+
+	// Moves along the front, right and up axes of the camera
+	void Move(float forward, float right, float up);
+	void Turn(float yaw, float pitch);
+
+	// Ray through the point (x, y) of an image of width x height pixels
+	Ray GenerateRay(float x, float y, int width, int height) const;
+
+	// Image coordinates of a point, false if it is behind the camera or outside the image
+	bool Project(const glm::vec3& point, int width, int height, float& x, float& y) const;
+
+	bool operator==(const RTCamera& other) const;
+	bool operator!=(const RTCamera& other) const { return !(*this == other); }
+
+private:
+	void UpdateVectors();
+
+	glm::vec3 m_position;
+	float m_yaw, m_pitch, m_fov;
+	float m_tanHalfFov;
+	glm::vec3 m_front, m_right, m_up;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef RTDISTRIBUTED_H
+#define RTDISTRIBUTED_H
+
+#include <string>
+#include <vector>
+
+#include "Files/RT/headers/raytracer.h"
+
+class RTScene;
+
+// Where the tiles of a distributed rendering go
+struct RTDistributedOptions
+{
+	RTDistributedOptions() : m_numLocalWorkers(0), m_workerThreads(1) {}
+
+	bool IsEnabled() const { return m_numLocalWorkers > 0 || !m_address.empty(); }
+
+	std::string m_address; // "tcp:host:port" or "unix:path" the workers connect to, a local socket if empty
+	int m_numLocalWorkers; // Worker processes started on this machine, others can connect from anywhere
+	std::string m_workerProgram; // Executable started with --rt-worker for the local workers
+	int m_workerThreads; // Threads of each local worker
+};
+
+// Renders the image with worker processes, coordinated from this one. The scene
+// is serialized once and sent to each worker as it connects, then the image is
+// handed out in tiles, a couple at a time per worker so none waits for the network.
+// The tiles of a worker that disconnects go to the others. Once no tile is left,
+// the tiles held for much longer than usual by a slow worker are given to the idle
+// ones too and the first result wins. Every tile draws its samples from a sequence
+// seeded by its position, whichever worker renders it gives the same pixels.
+//
+// Adaptive sampling and denoising need the whole image and are not distributed.
+// Returns false when the image could not be rendered, after telling why on cerr.
+bool RenderDistributed(const RTScene& scene, const RenderSettings& settings, const RTDistributedOptions& options, std::vector<Color>& image);
+
+// Worker side: connects to the coordinator at address and renders the tiles it
+// sends with numThreads threads until it is done. Returns the exit code.
+int RunRTWorker(const std::string& address, int numThreads);
+
+#endif
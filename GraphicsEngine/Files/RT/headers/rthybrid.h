@@ -0,0 +1,105 @@
+#ifndef RTHYBRID_H
+#define RTHYBRID_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/rtsampler.h"
+#include "Files/RT/headers/rtscene.h"
+
+// First hits of a rasterized frame read back from the G-buffer, in the view space of the
+// frame and with the rows from the bottom like glReadPixels gives them
+struct RTGBuffer
+{
+	RTGBuffer() : m_width(0), m_height(0), m_viewToScene(1.f), m_lightPosition(0.f) {}
+
+	int m_width;
+	int m_height;
+	std::vector<glm::vec4> m_positions; // w is 0 where nothing was drawn
+	std::vector<glm::vec4> m_normals;
+	glm::mat4 m_viewToScene; // From the view space to the space of the scene, without any shear
+	glm::vec3 m_lightPosition; // In view space
+};
+
+struct RTHybridSettings
+{
+	int m_ambientRays = 8;
+	float m_ambientRadius = 2.f; // Longest ambient occlusion ray, in view space
+	float m_epsilonFactor = 1e-4f; // Offset of the rays from the surface, relative to its distance to the camera
+	int m_numThreads = 0; // 0 for one per core
+};
+
+// Secondary rays of a rasterized frame traced on the CPU: the G-buffer gives the
+// first hit of every pixel, so the primary rays are never traced. Each pixel gets
+// ambient occlusion rays and a shadow ray to the light, its shading holds the
+// fraction of each that got through.
+//
+// The frames are shaded by a thread of the shader, the one submitted while it is
+// busy waits and is replaced by the next one, so the GPU never waits for the CPU
+// and the shading shown lags the rasterized frames by the time to trace one.
+// The rows of a frame are shared with worker threads started with the shader,
+// they wait for the next frame in between.
+class RTHybridShader
+{
+public:
+	RTHybridShader(const RTScene& scene, const RTHybridSettings& settings);
+	~RTHybridShader();
+
+	// Takes the G-buffer to shade next, gbuffer gets a buffer back to fill the next time
+	void Submit(RTGBuffer& gbuffer);
+
+	// The shading of the last frame done, false if there was none since the last call.
+	// shading has ambient and light visibility, row by row from the bottom.
+	bool TakeResult(std::vector<glm::vec2>& shading, int& width, int& height);
+
+	// Shades a frame right away, the calling thread is one of the m_numThreads.
+	// One frame is shaded at a time, a second caller waits for the first.
+	void Shade(const RTGBuffer& gbuffer, std::vector<glm::vec2>& shading);
+
+	// Rays and time of the last frame done
+	long long LastRays() const { return m_lastRays; }
+	double LastSeconds() const { return m_lastSeconds; }
+
+private:
+	void ShadeThread();
+	void WorkerThread();
+	void ShadeRows();
+	glm::vec2 ShadePixel(const RTGBuffer& gbuffer, int x, int y, long long& rays) const;
+
+private:
+	const RTScene& m_scene;
+	RTHybridSettings m_settings;
+	RTSampler m_sampler;
+
+	std::thread m_thread;
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_quit;
+
+	// Frame the workers help with, m_frame changes when a new one starts
+	std::mutex m_shadeMutex;
+	unsigned int m_frame;
+	int m_busyWorkers;
+	const RTGBuffer* m_frameGBuffer;
+	std::vector<glm::vec2>* m_frameShading;
+	std::atomic<int> m_nextRow;
+	std::atomic<long long> m_frameRays;
+
+	bool m_hasPending;
+	RTGBuffer m_pending;
+	RTGBuffer m_shading; // Frame being shaded
+	bool m_hasResult;
+	std::vector<glm::vec2> m_result;
+	int m_resultWidth;
+	int m_resultHeight;
+
+	mutable std::atomic<long long> m_lastRays;
+	std::atomic<double> m_lastSeconds;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef RTIMAGE_H
+#define RTIMAGE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Files/RT/headers/ray.h"
+
+// How the linear colors of the tracer become 8 bit pixels, in the window and the .png and .ppm files
+enum RTToneMap
+{
+	RT_TONEMAP_CLAMP, // Clamped to [0, 1], the bytes stay linear
+	RT_TONEMAP_FILMIC // ACES filmic curve then sRGB encoding, the highlights of the path tracer roll off instead of clipping
+};
+
+// Writing of rendered images without Qt, for the headless modes.
+// The format is chosen from the extension: .pfm keeps the linear floats,
+// .png and .ppm are 8 bits per channel converted like the window shows them.
+bool SaveRTImage(const std::string& filename, const std::vector<Color>& image, int width, int height, RTToneMap toneMap = RT_TONEMAP_CLAMP);
+
+// True if the extension of the file is one SaveRTImage can write
+bool IsRTImageFormat(const std::string& filename);
+
+// Converts count colors to 0xffRRGGBB pixels, the layout of QImage::Format_RGB32, the same
+// way as the 8 bit files so the window shows the same image. The channels are converted
+// RT_SIMD_WIDTH at a time, a row can be written straight into QImage::scanLine.
+void ColorsToRGB32(const Color* colors, int count, uint32_t* pixels, RTToneMap toneMap = RT_TONEMAP_CLAMP);
+
+bool SavePFM(const std::string& filename, const std::vector<Color>& image, int width, int height);
+bool SavePPM(const std::string& filename, const std::vector<Color>& image, int width, int height, RTToneMap toneMap = RT_TONEMAP_CLAMP);
+
+// The PNG is written with uncompressed deflate blocks, every viewer reads it
+// and it needs no zlib
+bool SavePNG(const std::string& filename, const std::vector<Color>& image, int width, int height, RTToneMap toneMap = RT_TONEMAP_CLAMP);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef RTLIGHTS_H
+#define RTLIGHTS_H
+
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/sphere.h"
+#include "Files/RT/headers/bvh.h"
+#include "Files/RT/headers/ray.h"
+
+// How a light is picked when a hit cannot afford a shadow ray to each of them
+enum RTLightSelection
+{
+	RT_LIGHTS_POWER, // In proportion to the power of the lights
+	RT_LIGHTS_TREE // Down a BVH of the lights, by the power of each side over its squared distance
+};
+
+// A light sphere of the scene, packed for the shading
+struct RTLight
+{
+	glm::vec3 m_center;
+	float m_radius;
+	float m_power; // Luminance of the emission over the area of the sphere, up to a constant
+	int m_sphere; // Index in the scene spheres
+};
+
+// Compact list of the lights of the scene and the structures to pick them at
+// random: a table of their cumulated power and a BVH over them, whose nodes
+// know the power they hold. The same BVH finds the lights hit by a ray.
+//
+// The picks take a random number in [0, 1) and give the probability of the
+// light they return, Pdf gives it back for any light.
+class RTLightSampler
+{
+public:
+	RTLightSampler() : m_totalPower(0.f) {}
+
+	void Build(const std::vector<Sphere>& spheres);
+	void Clear();
+
+	int Size() const { return (int)m_lights.size(); }
+	const std::vector<RTLight>& Lights() const { return m_lights; }
+	const BVH& GetBVH() const { return m_bvh; }
+
+	// Index of the light of a sphere of the scene, -1 if it does not emit
+	int LightIndex(int sphere) const { return sphere < (int)m_lightOfSphere.size() ? m_lightOfSphere[sphere] : -1; }
+
+	// Light to sample from point, -1 if no light can be picked
+	int Sample(RTLightSelection selection, const glm::vec3& point, float u, float& pdf) const;
+	float Pdf(RTLightSelection selection, int light, const glm::vec3& point) const;
+
+private:
+	int SamplePower(float u, float& pdf) const;
+	int SampleTree(const glm::vec3& point, float u, float& pdf) const;
+	float TreePdf(int light, const glm::vec3& point) const;
+
+	// Power over the squared distance, never closer than the size of the bounds
+	float Importance(int node, const glm::vec3& point) const;
+	float Importance(const RTLight& light, const glm::vec3& point) const;
+
+	// Picks one of the lights of a leaf in proportion to their importance
+	int SampleLeaf(const BVHNode& leaf, const glm::vec3& point, float u, float& pdf) const;
+	float LeafPdf(const BVHNode& leaf, int light, const glm::vec3& point) const;
+
+private:
+	std::vector<RTLight> m_lights;
+	std::vector<int> m_lightOfSphere;
+	std::vector<float> m_cumulatedPower; // m_cumulatedPower[i] is the power of the lights before i + 1
+	float m_totalPower;
+
+	BVH m_bvh;
+	std::vector<float> m_nodePower;
+	std::vector<int> m_parents; // -1 for the root
+	std::vector<int> m_leafOfLight;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef RTMATERIAL_H
+#define RTMATERIAL_H
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/sphere.h"
+#include "Files/model.h"
+
+// Shading parameters of a ray traced surface, shared by spheres and triangle meshes
+struct RTMaterial
+{
+	RTMaterial() : m_surfaceColor(glm::vec3(0.f)), m_lightColor(glm::vec3(0.f)), m_emission(0.f),
+		m_transparency(0.f), m_refractionIndex(0.f), m_reflects(false)
+	{}
+
+	static RTMaterial FromSphere(const Sphere& sphere)
+	{
+		RTMaterial material;
+		material.m_surfaceColor = sphere.getSurfaceColor();
+		material.m_lightColor = sphere.getLightColor();
+		material.m_emission = sphere.emissionFactor();
+		material.m_transparency = sphere.transparencyFactor();
+		material.m_refractionIndex = sphere.getRefractionIndex();
+		material.m_reflects = sphere.reflectsLight();
+		return material;
+	}
+
+	// Maps the MTL illumination models to the Whitted materials: 3 is a mirror
+	// tinted by Ks, 4, 6 and 7 (or d < 1) are refractive with index Ni.
+	static RTMaterial FromMTL(const Material& mtl)
+	{
+		RTMaterial material;
+		material.m_surfaceColor = glm::vec3(mtl.diffuse[0], mtl.diffuse[1], mtl.diffuse[2]);
+
+		const bool refractive = mtl.opacity < 1.0f || mtl.illum == 4 || mtl.illum == 6 || mtl.illum == 7;
+		if (refractive || mtl.illum == 3)
+		{
+			material.m_surfaceColor = glm::vec3(mtl.specular[0], mtl.specular[1], mtl.specular[2]);
+			material.m_reflects = true;
+		}
+		if (refractive)
+		{
+			material.m_transparency = 1.0f - mtl.opacity;
+			material.m_refractionIndex = mtl.refractionIndex;
+		}
+		return material;
+	}
+
+	bool IsLight() const { return m_emission > 0.f; }
+	bool RefractsLight() const { return m_refractionIndex != 0.f; }
+	bool ReflectsLight() const { return m_reflects; }
+
+	glm::vec3 m_surfaceColor;
+	glm::vec3 m_lightColor;
+	float m_emission;
+	float m_transparency; // in the range [0.0, 1.0]
+	float m_refractionIndex;
+	bool m_reflects;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef RTOBJECT_H
+#define RTOBJECT_H
+
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/sphere.h"
+#include "Files/model.h"
+#include "Files/RT/headers/aabb.h"
+#include "Files/RT/headers/bvh.h"
+#include "Files/RT/headers/rtmaterial.h"
+#include "Files/RT/headers/rtstream.h"
+#include "Files/RT/headers/spheresoa.h"
+#include "Files/RT/headers/tracecontext.h"
+#include "Files/RT/headers/trianglemesh.h"
+
+// Primitive of an object hit by a ray, in the space of the object
+struct ObjectHit
+{
+	ObjectHit() : m_sphere(-1), m_triangle(-1), m_u(0.f), m_v(0.f) {}
+
+	int m_sphere; // Index of the sphere, -1 for the mesh
+	int m_triangle;
+	float m_u, m_v; // Barycentric coordinates of a triangle hit
+};
+
+// Geometry shared by the instances of the scene, in its own space: spheres and a
+// triangle mesh, each with its BVH. Objects are the bottom level of the scene,
+// an instance only adds a transform so the memory grows with the unique geometry.
+// The spheres of an object that emit light glow but do not light the scene.
+//
+// The queries take rays with a normalized direction, like the scene.
+class RTObject
+{
+public:
+	RTObject();
+	~RTObject();
+
+	void AddSphere(const Sphere& sphere);
+	void SetMesh(const Model& model, const glm::mat4& transform, RTBVHCache* bvhCache = nullptr);
+	void Clear();
+
+	// Builds the BVH of the spheres, the mesh has its own already
+	void Build();
+
+	// The spheres and the mesh, the BVHs are built again when read
+	void Write(RTStreamWriter& stream) const;
+	bool Read(RTStreamReader& stream);
+
+	bool IsEmpty() const { return m_spheres.empty() && m_mesh.IsEmpty(); }
+	const AABB& Bounds() const { return m_bounds; }
+	const std::vector<Sphere>& Spheres() const { return m_spheres; }
+	const TriangleMesh& Mesh() const { return m_mesh; }
+
+	// Closest sphere or triangle hit before tMax, shortens tMax on hit
+	bool ClosestHit(const glm::vec3& origin, const glm::vec3& direction, float& tMax, ObjectHit& hit, RTStats* stats = nullptr) const;
+
+	// True if anything is hit before tMax. The primitive found is written to
+	// occluder, with m_mesh 0 for the mesh and -1 for the spheres.
+	bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax, Occluder* occluder, RTStats* stats = nullptr) const;
+	bool OccludedBy(const Occluder& occluder, const glm::vec3& origin, const glm::vec3& direction, float tMax) const;
+
+	// Normal at the hit point, in the space of the object
+	glm::vec3 Normal(const ObjectHit& hit, const glm::vec3& position) const;
+	const RTMaterial& GetMaterial(const ObjectHit& hit) const;
+
+private:
+	std::vector<Sphere> m_spheres;
+	std::vector<RTMaterial> m_sphereMaterials;
+	SphereSoA m_sphereSoA; // BVH leaf order
+	BVH m_sphereBVH;
+	TriangleMesh m_mesh;
+	AABB m_bounds;
+};
+
+// An object placed in the scene. Only the world to object transform is kept: rays
+// are brought into the object with it, and normals out with its transpose.
+struct RTInstance
+{
+	glm::mat4x3 m_worldToObject;
+	int m_object;
+};
+
+// Serialization of the spheres, shared by the scene and the objects
+void WriteSphere(RTStreamWriter& stream, const Sphere& sphere);
+Sphere ReadSphere(RTStreamReader& stream);
+
+#endif
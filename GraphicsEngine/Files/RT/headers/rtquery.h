@@ -0,0 +1,68 @@
+#ifndef RTQUERY_H
+#define RTQUERY_H
+
+#include <cmath>
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/rtscene.h"
+
+// Rays of a batch query, one array per component. The directions must be unit
+// length, the rays only see the surfaces between m_tMin and m_tMax along them.
+struct RTRayBatch
+{
+	void Resize(size_t count);
+	size_t Size() const { return m_tMax.size(); }
+	void SetRay(size_t i, const glm::vec3& origin, const glm::vec3& direction, float tMin = 0.f, float tMax = INFINITY);
+
+	std::vector<float> m_originX, m_originY, m_originZ;
+	std::vector<float> m_directionX, m_directionY, m_directionZ;
+	std::vector<float> m_tMin, m_tMax;
+};
+
+// Closest hits of a batch, ray i got hit i
+struct RTHitBatch
+{
+	void Resize(size_t count);
+	size_t Size() const { return m_distance.size(); }
+	bool Hit(size_t i) const { return m_distance[i] != INFINITY; }
+
+	std::vector<float> m_distance; // From the origin of the ray, INFINITY for the rays that hit nothing
+	std::vector<float> m_normalX, m_normalY, m_normalZ; // Facing the ray
+	std::vector<int> m_instance, m_mesh, m_prim; // What was hit, like in HitInfo
+};
+
+struct RTQuerySettings
+{
+	int m_numThreads = 0; // 0 for one per core
+	bool m_packets = true; // Closest hits traced RT_SIMD_WIDTH rays at a time
+};
+
+// Visibility queries against a scene for the tools that do not render it: picking,
+// placement, line of sight. The scene must have its acceleration structure built and
+// must not change while a query runs. The batches are cut in chunks spread over the
+// threads, each query waits for the whole batch.
+class RTRayQuery
+{
+public:
+	RTRayQuery(const RTScene& scene, const RTQuerySettings& settings = RTQuerySettings());
+
+	// Closest surface of every ray
+	void Closest(const RTRayBatch& rays, RTHitBatch& hits) const;
+
+	// occluded[i] is 1 if ray i hits anything, it stops at the first surface found
+	void Any(const RTRayBatch& rays, std::vector<unsigned char>& occluded) const;
+
+private:
+	template <typename ChunkFunc>
+	void ForEachChunk(size_t count, ChunkFunc queryChunk) const;
+
+	void ClosestChunk(const RTRayBatch& rays, size_t begin, size_t end, RTHitBatch& hits) const;
+	void AnyChunk(const RTRayBatch& rays, size_t begin, size_t end, std::vector<unsigned char>& occluded) const;
+
+private:
+	const RTScene& m_scene;
+	RTQuerySettings m_settings;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef RTRANDOM_H
+#define RTRANDOM_H
+
+#include <stdint.h>
+
+// Small and fast random number generator (PCG32) for the sampling of the ray tracer.
+// Each rendering thread owns one, seeded differently.
+struct RTRandom
+{
+	explicit RTRandom(uint64_t seed = 0x853c49e6748fea9bULL) : m_state(0)
+	{
+		Next();
+		m_state += seed;
+		Next();
+	}
+
+	uint32_t Next()
+	{
+		const uint64_t oldState = m_state;
+		m_state = oldState * 6364136223846793005ULL + 1442695040888963407ULL;
+		const uint32_t xorShifted = (uint32_t)(((oldState >> 18u) ^ oldState) >> 27u);
+		const uint32_t rot = (uint32_t)(oldState >> 59u);
+		return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+	}
+
+	// Uniform in [0, 1)
+	float NextFloat() { return (Next() >> 8) * (1.f / 16777216.f); }
+
+	uint64_t m_state;
+};
+
+#endif
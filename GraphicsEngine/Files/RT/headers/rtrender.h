@@ -0,0 +1,42 @@
+#ifndef RTRENDER_H
+#define RTRENDER_H
+
+#include <string>
+
+#include "Files/RT/headers/raytracer.h"
+#include "Files/RT/headers/rtdistributed.h"
+#include "Files/RT/headers/rtimage.h"
+
+// What the headless render draws and where it writes it
+struct RTRenderOptions
+{
+	RTRenderOptions() : m_toneMap(RT_TONEMAP_CLAMP), m_numFrames(0), m_framesPerSecond(24.f), m_rebuildThreshold(1.5f), m_numInstances(0), m_numLights(0), m_acceleration(RT_ACCELERATION_AUTO) {}
+
+	RenderSettings m_settings;
+	std::string m_modelFilename; // Model standing in the default scene instead of its spheres, empty for the spheres
+	std::string m_outFilename; // .png, .ppm or .pfm
+	RTToneMap m_toneMap; // Of the .png and .ppm files, a .pfm stays linear
+	std::string m_statsFilename; // JSON file the counters of the tracer are written to, none if empty
+	RTDistributedOptions m_distributed; // Renders with worker processes when enabled
+
+	// Animation rendered as numbered images, render.png gives render_0000.png, render_0001.png...
+	int m_numFrames; // 0 renders a single image
+	float m_framesPerSecond;
+	std::string m_animationFilename; // Keyframes of the spheres, a turntable over the frames if empty
+	float m_rebuildThreshold; // The BVH is built again once refitting made its SAH cost that much worse, a grid every frame
+
+	// Copies of the model, or of a few spheres without one, instanced in rows on the floor. 0 renders a single one.
+	int m_numInstances;
+
+	int m_numLights; // Small lights replacing the three of the default scene, 0 keeps them
+	RTAcceleration m_acceleration; // Grid or BVH for the spheres, picked from their sizes by default
+	std::string m_bvhCacheDirectory; // Where the BVHs are kept between runs, none if empty
+};
+
+// Renders the image without any window and writes it to m_outFilename.
+// With frames, the spheres are moved between the frames and the BVH refit,
+// the same threads and buffers render them all.
+// Returns the exit code of the application.
+int RunRTRender(const RTRenderOptions& options);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef RTSAMPLER_H
+#define RTSAMPLER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/definitions.h"
+
+// Where the numbers of the samples come from
+enum RTSamplerType
+{
+	RT_SAMPLER_RANDOM, // Independent numbers, hashed from the pixel, the sample and the dimension
+	RT_SAMPLER_SOBOL, // Owen scrambled Sobol points, the samples of a pixel cover each pair of dimensions evenly
+	RT_SAMPLER_BLUE_NOISE // Sobol points shifted by a blue noise tile, neighbouring pixels get different errors
+};
+
+// Stateless source of the numbers of the samples. A number only depends on the
+// pixel, the index of the sample in the pixel and the dimension, its rank along
+// the path, so an image comes out the same whatever thread traces which sample.
+//
+// The Sobol sampler takes the first two dimensions of the Sobol sequence for
+// every pair of dimensions of the path, each pair with its own shuffle of the
+// sample index and its own nested uniform scramble (Burley 2020). The blue
+// noise sampler gives the same Sobol points to every pixel, shifted by a void
+// and cluster tile read at an offset for each dimension (Georgiev and Fajardo 2016).
+class RTSampler
+{
+public:
+	explicit RTSampler(RTSamplerType type = RT_SAMPLER_SOBOL, uint32_t seed = 0);
+
+	RTSamplerType Type() const { return m_type; }
+
+	// Numbers in [0, 1) of a dimension, and of the one after it for 2D
+	float Get1D(int x, int y, int sample, int dimension) const;
+	glm::vec2 Get2D(int x, int y, int sample, int dimension) const;
+
+	// Avalanche of the bits of a 32 bit integer, a stateless random number generator when
+	// fed with a counter
+	static uint32_t Hash(uint32_t x);
+	static uint32_t HashCombine(uint32_t seed, uint32_t value);
+
+private:
+	uint32_t PixelSeed(int x, int y, int dimension) const;
+
+	// Shift of a pixel in a dimension, in 32 bit fixed point
+	uint32_t BlueNoise(int x, int y, int dimension) const;
+
+private:
+	RTSamplerType m_type;
+	uint32_t m_seed;
+	const std::vector<uint16_t>* m_blueNoise; // Rank of each texel, shared by all the samplers
+};
+
+// Orthonormal basis around a unit vector (Duff et al. 2017)
+inline void BuildBasis(const glm::vec3& n, glm::vec3& t, glm::vec3& b)
+{
+	const float sign = std::copysign(1.f, n.z);
+	const float a = -1.f / (sign + n.z);
+	const float c = n.x * n.y * a;
+	t = glm::vec3(1.f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+	b = glm::vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+// Cosine distributed direction around the normal of the basis from the numbers u, its
+// density is its cosine with the normal over PI. The cosine is written to cosine if given.
+inline glm::vec3 SampleCosineHemisphere(const glm::vec2& u, const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent, float* cosine = nullptr)
+{
+	const float r = std::sqrt(u.x), phi = 2.f * PI * u.y;
+	const float cosTheta = std::sqrt(std::max(0.f, 1.f - u.x));
+	if (cosine) *cosine = cosTheta;
+	return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * cosTheta;
+}
+
+#endif
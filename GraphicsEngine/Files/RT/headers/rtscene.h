@@ -0,0 +1,168 @@
+#ifndef RTSCENE_H
+#define RTSCENE_H
+
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/sphere.h"
+#include "Files/model.h"
+#include "Files/RT/headers/bvh.h"
+#include "Files/RT/headers/ray.h"
+#include "Files/RT/headers/raypacket.h"
+#include "Files/RT/headers/rtbvhcache.h"
+#include "Files/RT/headers/rtlights.h"
+#include "Files/RT/headers/rtmaterial.h"
+#include "Files/RT/headers/rtobject.h"
+#include "Files/RT/headers/rtstream.h"
+#include "Files/RT/headers/spheresoa.h"
+#include "Files/RT/headers/tracecontext.h"
+#include "Files/RT/headers/trianglemesh.h"
+#include "Files/RT/headers/uniformgrid.h"
+
+// What finds the spheres of the scene. A uniform grid builds in linear time and suits
+// many spheres of about the same size, a BVH suits anything else. AUTO picks one from
+// the sizes of the spheres every time the acceleration structure is built.
+enum RTAcceleration
+{
+	RT_ACCELERATION_AUTO,
+	RT_ACCELERATION_BVH,
+	RT_ACCELERATION_GRID
+};
+
+// Geometry of the ray traced scene and its acceleration structures.
+// Lights are kept with the rest of the spheres but are not added to the BVH.
+// The spheres of the BVH are intersected from an SoA copy laid out in the
+// order of its leaves, m_sphereMaterials is their material table. The spheres
+// can go in a uniform grid instead, the SoA copy then has a sphere in each
+// cell it overlaps, laid out cell after cell.
+//
+// Objects used many times are instanced: the scene keeps each object once with
+// its own BVHs and a top level BVH over the transformed bounds of the instances.
+// A ray that reaches an instance is brought into its object to go on there.
+class RTScene
+{
+public:
+	RTScene();
+	~RTScene();
+
+	void Clear();
+	void AddSphere(const Sphere& sphere);
+	void AddMesh(const Model& model, const glm::mat4& transform);
+
+	// Lights and floor of the default scene, plus its spheres if asked to.
+	// numLights small lights of random colors spread above the scene replace its
+	// three lights if it is not 0, they light the Whitted tracer as much together.
+	void LoadDefaultScene(bool withSpheres = true, int numLights = 0);
+
+	// Adds the model scaled to fit in front of the camera, standing on the floor of the default scene
+	void AddModelOnFloor(const Model& model);
+
+	// Adds an object shared by instances, builds its BVHs and returns its index
+	int AddObject(const RTObject& object);
+
+	// Places the object in the scene, transform goes from the object to the world.
+	// An object without any geometry is not instanced.
+	void AddInstance(int object, const glm::mat4& transform);
+
+	// count instances of the object in rows on the floor of the default scene,
+	// each of them turned and scaled at random
+	void AddInstancesOnFloor(int object, int count);
+
+	// Taken into account by the next build, AUTO until set
+	void SetAcceleration(RTAcceleration acceleration) { m_acceleration = acceleration; }
+	RTAcceleration Acceleration() const { return m_acceleration; }
+
+	// The meshes added and the BVH of the spheres are loaded from the cache, or built
+	// and saved to it, until it is set back to nullptr. The scene does not own it.
+	void SetBVHCache(RTBVHCache* bvhCache) { m_bvhCache = bvhCache; }
+	RTBVHCache* BVHCache() const { return m_bvhCache; }
+	void BuildAccelerationStructure();
+
+	// Moves or resizes a sphere of an animation, a light must stay a light and
+	// the other spheres must not become one. Returns false if it would change.
+	// The acceleration structure must be refit or built again after.
+	bool SetSphere(int index, const Sphere& sphere);
+
+	// Updates the acceleration structure to spheres moved by SetSphere, much
+	// faster than building it again but it gets worse as the spheres wander off.
+	// A grid is built again, that is as fast and stays as good.
+	void RefitAccelerationStructure();
+
+	// The spheres and meshes, to render the same scene in another process.
+	// Read replaces the scene, its acceleration structure must be built after.
+	void Write(RTStreamWriter& stream) const;
+	bool Read(RTStreamReader& stream);
+
+	const std::vector<Sphere>& Spheres() const { return m_spheres; }
+	const std::vector<TriangleMesh>& Meshes() const { return m_meshes; }
+	const std::vector<int>& Lights() const { return m_lights; } // Indices of the light spheres
+	const RTLightSampler& LightSampler() const { return m_lightSampler; }
+	const BVH& GetBVH() const { return m_bvh; }
+	const UniformGrid& Grid() const { return m_grid; }
+	bool UsesGrid() const { return m_useGrid; } // Set by the last build
+	const std::vector<RTObject>& Objects() const { return m_objects; }
+	const std::vector<RTInstance>& Instances() const { return m_instances; }
+	const BVH& InstanceBVH() const { return m_instanceBVH; }
+
+	// Closest surface hit by the ray with its shading information.
+	// The queries count their BVH nodes and primitive tests in stats if it is given.
+	bool Intersect(const Ray& ray, HitInfo& hitInfo, RTStats* stats = nullptr) const;
+
+	// Same for up to RT_SIMD_WIDTH coherent rays traced as a packet. hits[i] tells if rays[i]
+	// hit anything and hitInfos[i] has its shading information.
+	void IntersectPacket(const Ray* rays, int count, HitInfo* hitInfos, bool* hits, RTStats* stats = nullptr) const;
+
+	// Index of the closest light sphere hit before maxDistance, -1 if there is none.
+	// The lights are not in the BVH of the scene but in the one of the light
+	// sampler, only the path tracer sees them.
+	int IntersectLight(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+	// Index of the closest non light sphere hit by the ray, -1 if there is none
+	int ClosestHit(const glm::vec3& origin, const glm::vec3& direction, float& distance, RTStats* stats = nullptr) const;
+
+	// True if any non light sphere or triangle is hit by the ray before maxDistance.
+	// Only answers yes or no and stops at the first occluder found. lastOccluder
+	// is tested before anything else and updated with the occluder found.
+	bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = INFINITY, Occluder* lastOccluder = nullptr, RTStats* stats = nullptr) const;
+
+	static float HitDistance(const Sphere& sphere, const glm::vec3& origin, const glm::vec3& direction);
+
+private:
+	void SphereBounds(std::vector<AABB>& bounds) const;
+	void BuildGrid(const std::vector<AABB>& bounds);
+	int ClosestMeshHit(const Ray& ray, float& distance, int& triangle, float& u, float& v, RTStats* stats) const;
+	int ClosestInstanceHit(const Ray& ray, float& distance, ObjectHit& hit, RTStats* stats) const;
+	void FillHitInfo(const Ray& ray, float distance, int sphereIndex, int meshIndex, int triangle, float u, float v, HitInfo& hitInfo) const;
+	void FillInstanceHitInfo(const Ray& ray, float distance, int instance, const ObjectHit& hit, HitInfo& hitInfo) const;
+	AABB InstanceBounds(const RTInstance& instance) const;
+	bool OccludedBy(const Occluder& occluder, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+private:
+	std::vector<Sphere> m_spheres;
+	std::vector<RTMaterial> m_sphereMaterials;
+	std::vector<int> m_lights;
+	std::vector<int> m_bvhSpheres; // BVH primitive -> index in m_spheres
+	SphereSoA m_sphereSoA; // BVH leaf or grid cell order, the material index is the index in m_spheres
+	BVH m_bvh;
+	UniformGrid m_grid;
+	RTAcceleration m_acceleration;
+	bool m_useGrid;
+	RTBVHCache* m_bvhCache;
+
+	std::vector<TriangleMesh> m_meshes;
+	RTLightSampler m_lightSampler; // Built with the BVH, it also finds the lights hit by the rays
+
+	std::vector<RTObject> m_objects;
+	std::vector<RTInstance> m_instances;
+	BVH m_instanceBVH; // Top level, over the bounds of the instances in the world
+};
+
+// Distance to the first intersection in front of the origin, INFINITY if missed
+inline float RTScene::HitDistance(const Sphere& sphere, const glm::vec3& origin, const glm::vec3& direction)
+{
+	float t0, t1;
+	if (!sphere.intersect(origin, direction, t0, t1)) return INFINITY;
+	return t0 < 0 ? t1 : t0;
+}
+
+#endif
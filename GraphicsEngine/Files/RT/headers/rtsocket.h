@@ -0,0 +1,50 @@
+#ifndef RTSOCKET_H
+#define RTSOCKET_H
+
+#include <stddef.h>
+#include <string>
+
+// Blocking stream socket of the distributed rendering, over TCP or a Unix domain
+// socket. Addresses are written "tcp:host:port" or "unix:path". Only POSIX systems
+// are supported, elsewhere every call fails.
+class RTSocket
+{
+public:
+	RTSocket();
+	~RTSocket();
+
+	RTSocket(RTSocket&& other);
+	RTSocket& operator=(RTSocket&& other);
+	RTSocket(const RTSocket&) = delete;
+	RTSocket& operator=(const RTSocket&) = delete;
+
+	// On failure error says why
+	bool Listen(const std::string& address, std::string& error);
+	bool Connect(const std::string& address, std::string& error);
+
+	// Next connection of a listening socket, invalid on failure
+	RTSocket Accept();
+
+	void Close();
+	bool IsValid() const { return m_handle >= 0; }
+	int Handle() const { return m_handle; } // For poll
+
+	// Address a listening socket can be reached at, with the port picked by the
+	// system if 0 was asked for
+	std::string Address() const;
+
+	// A send blocked longer than this fails, a peer that stopped reading cannot hang the sender
+	void SetSendTimeout(double seconds);
+
+	bool SendAll(const void* data, size_t size);
+	bool ReceiveAll(void* data, size_t size);
+
+	// Whatever has arrived, up to size bytes. 0 once the peer closed, -1 on error.
+	long Receive(void* data, size_t size);
+
+private:
+	int m_handle;
+	std::string m_unixPath; // Removed when the listening socket is closed
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef RTSTATS_H
+#define RTSTATS_H
+
+#include <stdint.h>
+#include <string>
+
+enum RTRayType
+{
+	RT_RAY_PRIMARY,
+	RT_RAY_REFLECTION,
+	RT_RAY_REFRACTION,
+	RT_RAY_DIFFUSE, // Bounces of the path tracer off diffuse surfaces
+	RT_RAY_SHADOW,
+	RT_RAY_TYPE_COUNT
+};
+
+// Parts of the tracing of a wave that are timed
+enum RTPhase
+{
+	RT_PHASE_PRIMARY, // Intersection of the camera rays
+	RT_PHASE_SECONDARY, // Intersection of the reflected, refracted and bounced rays
+	RT_PHASE_SHADOW, // Shadow rays
+	RT_PHASE_SHADING,
+	RT_PHASE_COUNT
+};
+
+// Counters of the work done by the ray tracer. Each thread counts in the RTStats of
+// its TraceContext, without any synchronization, and the job sums them at the end.
+// The traversals count in locals and add them once per ray or packet.
+struct RTStats
+{
+	RTStats() { Clear(); }
+
+	void Clear();
+	void Add(const RTStats& other);
+
+	uint64_t TotalRays() const;
+
+	// Figures of a rendering that took seconds of wall time, for the window and as JSON
+	std::string Summary(double seconds) const;
+	std::string ToJSON(double seconds) const;
+
+	uint64_t m_rays[RT_RAY_TYPE_COUNT];
+	uint64_t m_nodesVisited; // Ray against BVH node or grid cell tests, a packet counts its active lanes
+	uint64_t m_primTests; // Ray against sphere or triangle tests, counted the same way
+
+	// Depth of the rays of the waves, the camera rays are at depth 0
+	uint64_t m_waveRays;
+	uint64_t m_waveDepthSum;
+	int m_maxDepth;
+
+	// Work avoided
+	uint64_t m_occluderHits; // Shadow rays stopped by the last occluder of their light without traversal
+	uint64_t m_rouletteStops; // Paths ended by Russian roulette
+
+	double m_phaseSeconds[RT_PHASE_COUNT]; // Summed over the threads
+};
+
+#endif
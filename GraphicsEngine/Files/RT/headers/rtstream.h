@@ -0,0 +1,121 @@
+#ifndef RTSTREAM_H
+#define RTSTREAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+
+// Binary encoding of the scenes and tiles sent to the render workers. The values
+// are written little endian whatever the host so the workers can run anywhere.
+struct RTStreamWriter
+{
+	void WriteUInt32(uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i) m_data.push_back((unsigned char)(value >> (8 * i)));
+	}
+
+	void WriteInt32(int value) { WriteUInt32((uint32_t)value); }
+
+	void WriteFloat(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		WriteUInt32(bits);
+	}
+
+	void WriteVec3(const glm::vec3& value)
+	{
+		WriteFloat(value.x);
+		WriteFloat(value.y);
+		WriteFloat(value.z);
+	}
+
+	void WriteFloats(const float* values, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) WriteFloat(values[i]);
+	}
+
+	std::vector<unsigned char> m_data;
+};
+
+// FNV-1a over 32 bit words, the key of the files cached from some geometry
+struct RTHash
+{
+	RTHash() : m_value(14695981039346656037ull) {}
+
+	void AddFloats(const float* values, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t bits;
+			memcpy(&bits, &values[i], sizeof(bits));
+			m_value ^= bits;
+			m_value *= 1099511628211ull;
+		}
+	}
+
+	void AddVec3(const glm::vec3& value) { AddFloats(&value.x, 3); }
+
+	uint64_t m_value;
+};
+
+// Reads what RTStreamWriter wrote. Reading past the end returns zeros and sets
+// m_failed, so a message can be decoded fully and checked once.
+struct RTStreamReader
+{
+	RTStreamReader(const unsigned char* data, size_t size) : m_data(data), m_size(size), m_position(0), m_failed(false) {}
+
+	uint32_t ReadUInt32()
+	{
+		if (m_position + 4 > m_size)
+		{
+			m_failed = true;
+			return 0;
+		}
+
+		uint32_t value = 0;
+		for (int i = 0; i < 4; ++i) value |= (uint32_t)m_data[m_position + i] << (8 * i);
+		m_position += 4;
+		return value;
+	}
+
+	int ReadInt32() { return (int)ReadUInt32(); }
+
+	float ReadFloat()
+	{
+		const uint32_t bits = ReadUInt32();
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	glm::vec3 ReadVec3()
+	{
+		const float x = ReadFloat();
+		const float y = ReadFloat();
+		const float z = ReadFloat();
+		return glm::vec3(x, y, z);
+	}
+
+	// Count of the array that follows, checked against the bytes left so a corrupt
+	// message cannot make the reader allocate anything huge
+	uint32_t ReadCount(size_t elementSize)
+	{
+		const uint32_t count = ReadUInt32();
+		if (count > (m_size - m_position) / elementSize)
+		{
+			m_failed = true;
+			return 0;
+		}
+		return count;
+	}
+
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_position;
+	bool m_failed;
+};
+
+#endif
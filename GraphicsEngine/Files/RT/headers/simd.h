@@ -0,0 +1,313 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin wrappers over the SIMD registers used by the ray tracer. The width
+// is chosen at compile time from the instruction sets enabled in the build:
+// 16 lanes with AVX-512, 8 with AVX, 4 with SSE2 and a scalar fallback.
+
+#include <bitset>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#if defined(__AVX512F__)
+#define RT_SIMD_AVX512
+#define RT_SIMD_WIDTH 16
+#include <immintrin.h>
+#elif defined(__AVX__)
+#define RT_SIMD_AVX
+#define RT_SIMD_WIDTH 8
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RT_SIMD_SSE
+#define RT_SIMD_WIDTH 4
+#include <emmintrin.h>
+#else
+#define RT_SIMD_SCALAR
+#define RT_SIMD_WIDTH 1
+#endif
+
+#if defined(_MSC_VER)
+#define RT_ALIGN(n) __declspec(align(n))
+#else
+#define RT_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+#define RT_SIMD_ALIGNMENT (RT_SIMD_WIDTH * 4)
+
+#if defined(RT_SIMD_AVX512)
+
+struct vmask
+{
+	vmask() {}
+	vmask(__mmask16 m) : m_m(m) {}
+	__mmask16 m_m;
+};
+
+struct vfloat
+{
+	vfloat() {}
+	vfloat(__m512 v) : m_v(v) {}
+	vfloat(float f) : m_v(_mm512_set1_ps(f)) {}
+	__m512 m_v;
+};
+
+struct vint
+{
+	vint() {}
+	vint(__m512i v) : m_v(v) {}
+	vint(int i) : m_v(_mm512_set1_epi32(i)) {}
+	__m512i m_v;
+};
+
+inline vfloat operator+(const vfloat& a, const vfloat& b) { return _mm512_add_ps(a.m_v, b.m_v); }
+inline vfloat operator-(const vfloat& a, const vfloat& b) { return _mm512_sub_ps(a.m_v, b.m_v); }
+inline vfloat operator*(const vfloat& a, const vfloat& b) { return _mm512_mul_ps(a.m_v, b.m_v); }
+inline vfloat operator/(const vfloat& a, const vfloat& b) { return _mm512_div_ps(a.m_v, b.m_v); }
+inline vfloat Min(const vfloat& a, const vfloat& b) { return _mm512_min_ps(a.m_v, b.m_v); }
+inline vfloat Max(const vfloat& a, const vfloat& b) { return _mm512_max_ps(a.m_v, b.m_v); }
+inline vfloat Sqrt(const vfloat& a) { return _mm512_sqrt_ps(a.m_v); }
+
+inline vmask operator<(const vfloat& a, const vfloat& b) { return _mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_LT_OQ); }
+inline vmask operator<=(const vfloat& a, const vfloat& b) { return _mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_LE_OQ); }
+inline vmask operator>(const vfloat& a, const vfloat& b) { return _mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_GT_OQ); }
+inline vmask operator>=(const vfloat& a, const vfloat& b) { return _mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_GE_OQ); }
+
+inline vmask operator&(const vmask& a, const vmask& b) { return (__mmask16)(a.m_m & b.m_m); }
+inline vmask operator|(const vmask& a, const vmask& b) { return (__mmask16)(a.m_m | b.m_m); }
+inline vmask AndNot(const vmask& a, const vmask& b) { return (__mmask16)(a.m_m & ~b.m_m); }
+inline int MaskBits(const vmask& m) { return (int)m.m_m; }
+
+inline vfloat Select(const vmask& m, const vfloat& a, const vfloat& b) { return _mm512_mask_blend_ps(m.m_m, b.m_v, a.m_v); }
+inline vint Select(const vmask& m, const vint& a, const vint& b) { return _mm512_mask_blend_epi32(m.m_m, b.m_v, a.m_v); }
+
+inline vfloat LoadFloats(const float* p) { return _mm512_load_ps(p); }
+inline vfloat LoadFloatsUnaligned(const float* p) { return _mm512_loadu_ps(p); }
+inline void StoreFloats(float* p, const vfloat& a) { _mm512_store_ps(p, a.m_v); }
+inline vint LoadInts(const int* p) { return _mm512_load_si512((const void*)p); }
+inline void StoreInts(int* p, const vint& a) { _mm512_store_si512((void*)p, a.m_v); }
+inline vint ToInts(const vfloat& a) { return _mm512_cvttps_epi32(a.m_v); } // Truncated
+
+inline vfloat LaneIndices() { return _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0); }
+
+#elif defined(RT_SIMD_AVX)
+
+struct vmask
+{
+	vmask() {}
+	vmask(__m256 m) : m_m(m) {}
+	__m256 m_m;
+};
+
+struct vfloat
+{
+	vfloat() {}
+	vfloat(__m256 v) : m_v(v) {}
+	vfloat(float f) : m_v(_mm256_set1_ps(f)) {}
+	__m256 m_v;
+};
+
+struct vint
+{
+	vint() {}
+	vint(__m256i v) : m_v(v) {}
+	vint(int i) : m_v(_mm256_set1_epi32(i)) {}
+	__m256i m_v;
+};
+
+inline vfloat operator+(const vfloat& a, const vfloat& b) { return _mm256_add_ps(a.m_v, b.m_v); }
+inline vfloat operator-(const vfloat& a, const vfloat& b) { return _mm256_sub_ps(a.m_v, b.m_v); }
+inline vfloat operator*(const vfloat& a, const vfloat& b) { return _mm256_mul_ps(a.m_v, b.m_v); }
+inline vfloat operator/(const vfloat& a, const vfloat& b) { return _mm256_div_ps(a.m_v, b.m_v); }
+inline vfloat Min(const vfloat& a, const vfloat& b) { return _mm256_min_ps(a.m_v, b.m_v); }
+inline vfloat Max(const vfloat& a, const vfloat& b) { return _mm256_max_ps(a.m_v, b.m_v); }
+inline vfloat Sqrt(const vfloat& a) { return _mm256_sqrt_ps(a.m_v); }
+
+inline vmask operator<(const vfloat& a, const vfloat& b) { return _mm256_cmp_ps(a.m_v, b.m_v, _CMP_LT_OQ); }
+inline vmask operator<=(const vfloat& a, const vfloat& b) { return _mm256_cmp_ps(a.m_v, b.m_v, _CMP_LE_OQ); }
+inline vmask operator>(const vfloat& a, const vfloat& b) { return _mm256_cmp_ps(a.m_v, b.m_v, _CMP_GT_OQ); }
+inline vmask operator>=(const vfloat& a, const vfloat& b) { return _mm256_cmp_ps(a.m_v, b.m_v, _CMP_GE_OQ); }
+
+inline vmask operator&(const vmask& a, const vmask& b) { return _mm256_and_ps(a.m_m, b.m_m); }
+inline vmask operator|(const vmask& a, const vmask& b) { return _mm256_or_ps(a.m_m, b.m_m); }
+inline vmask AndNot(const vmask& a, const vmask& b) { return _mm256_andnot_ps(b.m_m, a.m_m); }
+inline int MaskBits(const vmask& m) { return _mm256_movemask_ps(m.m_m); }
+
+inline vfloat Select(const vmask& m, const vfloat& a, const vfloat& b) { return _mm256_blendv_ps(b.m_v, a.m_v, m.m_m); }
+inline vint Select(const vmask& m, const vint& a, const vint& b)
+{
+	return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.m_v), _mm256_castsi256_ps(a.m_v), m.m_m));
+}
+
+inline vfloat LoadFloats(const float* p) { return _mm256_load_ps(p); }
+inline vfloat LoadFloatsUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+inline void StoreFloats(float* p, const vfloat& a) { _mm256_store_ps(p, a.m_v); }
+inline vint LoadInts(const int* p) { return _mm256_load_si256((const __m256i*)p); }
+inline void StoreInts(int* p, const vint& a) { _mm256_store_si256((__m256i*)p, a.m_v); }
+inline vint ToInts(const vfloat& a) { return _mm256_cvttps_epi32(a.m_v); } // Truncated
+
+inline vfloat LaneIndices() { return _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0); }
+
+#elif defined(RT_SIMD_SSE)
+
+struct vmask
+{
+	vmask() {}
+	vmask(__m128 m) : m_m(m) {}
+	__m128 m_m;
+};
+
+struct vfloat
+{
+	vfloat() {}
+	vfloat(__m128 v) : m_v(v) {}
+	vfloat(float f) : m_v(_mm_set1_ps(f)) {}
+	__m128 m_v;
+};
+
+struct vint
+{
+	vint() {}
+	vint(__m128i v) : m_v(v) {}
+	vint(int i) : m_v(_mm_set1_epi32(i)) {}
+	__m128i m_v;
+};
+
+inline vfloat operator+(const vfloat& a, const vfloat& b) { return _mm_add_ps(a.m_v, b.m_v); }
+inline vfloat operator-(const vfloat& a, const vfloat& b) { return _mm_sub_ps(a.m_v, b.m_v); }
+inline vfloat operator*(const vfloat& a, const vfloat& b) { return _mm_mul_ps(a.m_v, b.m_v); }
+inline vfloat operator/(const vfloat& a, const vfloat& b) { return _mm_div_ps(a.m_v, b.m_v); }
+inline vfloat Min(const vfloat& a, const vfloat& b) { return _mm_min_ps(a.m_v, b.m_v); }
+inline vfloat Max(const vfloat& a, const vfloat& b) { return _mm_max_ps(a.m_v, b.m_v); }
+inline vfloat Sqrt(const vfloat& a) { return _mm_sqrt_ps(a.m_v); }
+
+inline vmask operator<(const vfloat& a, const vfloat& b) { return _mm_cmplt_ps(a.m_v, b.m_v); }
+inline vmask operator<=(const vfloat& a, const vfloat& b) { return _mm_cmple_ps(a.m_v, b.m_v); }
+inline vmask operator>(const vfloat& a, const vfloat& b) { return _mm_cmpgt_ps(a.m_v, b.m_v); }
+inline vmask operator>=(const vfloat& a, const vfloat& b) { return _mm_cmpge_ps(a.m_v, b.m_v); }
+
+inline vmask operator&(const vmask& a, const vmask& b) { return _mm_and_ps(a.m_m, b.m_m); }
+inline vmask operator|(const vmask& a, const vmask& b) { return _mm_or_ps(a.m_m, b.m_m); }
+inline vmask AndNot(const vmask& a, const vmask& b) { return _mm_andnot_ps(b.m_m, a.m_m); }
+inline int MaskBits(const vmask& m) { return _mm_movemask_ps(m.m_m); }
+
+inline vfloat Select(const vmask& m, const vfloat& a, const vfloat& b)
+{
+	return _mm_or_ps(_mm_and_ps(m.m_m, a.m_v), _mm_andnot_ps(m.m_m, b.m_v));
+}
+inline vint Select(const vmask& m, const vint& a, const vint& b)
+{
+	const __m128i mi = _mm_castps_si128(m.m_m);
+	return _mm_or_si128(_mm_and_si128(mi, a.m_v), _mm_andnot_si128(mi, b.m_v));
+}
+
+inline vfloat LoadFloats(const float* p) { return _mm_load_ps(p); }
+inline vfloat LoadFloatsUnaligned(const float* p) { return _mm_loadu_ps(p); }
+inline void StoreFloats(float* p, const vfloat& a) { _mm_store_ps(p, a.m_v); }
+inline vint LoadInts(const int* p) { return _mm_load_si128((const __m128i*)p); }
+inline void StoreInts(int* p, const vint& a) { _mm_store_si128((__m128i*)p, a.m_v); }
+inline vint ToInts(const vfloat& a) { return _mm_cvttps_epi32(a.m_v); } // Truncated
+
+inline vfloat LaneIndices() { return _mm_set_ps(3, 2, 1, 0); }
+
+#else
+
+struct vmask
+{
+	vmask() {}
+	vmask(bool m) : m_m(m) {}
+	bool m_m;
+};
+
+struct vfloat
+{
+	vfloat() {}
+	vfloat(float f) : m_v(f) {}
+	float m_v;
+};
+
+struct vint
+{
+	vint() {}
+	vint(int i) : m_v(i) {}
+	int m_v;
+};
+
+inline vfloat operator+(const vfloat& a, const vfloat& b) { return a.m_v + b.m_v; }
+inline vfloat operator-(const vfloat& a, const vfloat& b) { return a.m_v - b.m_v; }
+inline vfloat operator*(const vfloat& a, const vfloat& b) { return a.m_v * b.m_v; }
+inline vfloat operator/(const vfloat& a, const vfloat& b) { return a.m_v / b.m_v; }
+inline vfloat Min(const vfloat& a, const vfloat& b) { return a.m_v < b.m_v ? a.m_v : b.m_v; }
+inline vfloat Max(const vfloat& a, const vfloat& b) { return a.m_v > b.m_v ? a.m_v : b.m_v; }
+inline vfloat Sqrt(const vfloat& a) { return std::sqrt(a.m_v); }
+
+inline vmask operator<(const vfloat& a, const vfloat& b) { return a.m_v < b.m_v; }
+inline vmask operator<=(const vfloat& a, const vfloat& b) { return a.m_v <= b.m_v; }
+inline vmask operator>(const vfloat& a, const vfloat& b) { return a.m_v > b.m_v; }
+inline vmask operator>=(const vfloat& a, const vfloat& b) { return a.m_v >= b.m_v; }
+
+inline vmask operator&(const vmask& a, const vmask& b) { return a.m_m && b.m_m; }
+inline vmask operator|(const vmask& a, const vmask& b) { return a.m_m || b.m_m; }
+inline vmask AndNot(const vmask& a, const vmask& b) { return a.m_m && !b.m_m; }
+inline int MaskBits(const vmask& m) { return m.m_m ? 1 : 0; }
+
+inline vfloat Select(const vmask& m, const vfloat& a, const vfloat& b) { return m.m_m ? a : b; }
+inline vint Select(const vmask& m, const vint& a, const vint& b) { return m.m_m ? a : b; }
+
+inline vfloat LoadFloats(const float* p) { return *p; }
+inline vfloat LoadFloatsUnaligned(const float* p) { return *p; }
+inline void StoreFloats(float* p, const vfloat& a) { *p = a.m_v; }
+inline vint LoadInts(const int* p) { return *p; }
+inline void StoreInts(int* p, const vint& a) { *p = a.m_v; }
+inline vint ToInts(const vfloat& a) { return (int)a.m_v; } // Truncated
+
+inline vfloat LaneIndices() { return 0.f; }
+
+#endif
+
+inline bool Any(const vmask& m) { return MaskBits(m) != 0; }
+inline bool None(const vmask& m) { return MaskBits(m) == 0; }
+inline int CountLanes(const vmask& m) { return (int)std::bitset<RT_SIMD_WIDTH>(MaskBits(m)).count(); }
+
+// Mask with the first count lanes active
+inline vmask FirstLanes(int count) { return LaneIndices() < vfloat((float)count); }
+
+// std::vector allocator for arrays loaded with LoadFloats and LoadInts
+template <typename T>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	AlignedAllocator() {}
+	template <typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		const size_t size = n * sizeof(T);
+#if defined(_MSC_VER)
+		void* p = _aligned_malloc(size, RT_SIMD_ALIGNMENT);
+#else
+		void* p = nullptr;
+		if (posix_memalign(&p, RT_SIMD_ALIGNMENT < sizeof(void*) ? sizeof(void*) : RT_SIMD_ALIGNMENT, size) != 0) p = nullptr;
+#endif
+		if (!p) throw std::bad_alloc();
+		return (T*)p;
+	}
+
+	void deallocate(T* p, size_t)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	template <typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template <typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SPHERESOA_H
+#define SPHERESOA_H
+
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/sphere.h"
+#include "Files/RT/headers/simd.h"
+
+// Structure of arrays copy of the geometry of the spheres. Only the data needed
+// to intersect them is kept here, in separate aligned arrays, so RT_SIMD_WIDTH
+// spheres are tested at once. The shading data stays in a separate material
+// table indexed by MaterialIndex().
+class SphereSoA
+{
+public:
+	SphereSoA();
+	~SphereSoA();
+
+	// Copies spheres[order[i]] into slot i, order[i] is kept as its material index
+	void Load(const std::vector<Sphere>& spheres, const std::vector<int>& order);
+	void Clear();
+
+	int Size() const { return m_size; }
+	int MaterialIndex(int slot) const { return m_material[slot]; }
+	glm::vec3 Center(int slot) const { return glm::vec3(m_centerX[slot], m_centerY[slot], m_centerZ[slot]); }
+	float Radius2(int slot) const { return m_radius2[slot]; }
+
+	// Slot of the closest sphere among [first, first + count) hit closer than tMax,
+	// -1 if there is none. tMax is shortened to the hit distance.
+	int ClosestHit(int first, int count, const glm::vec3& origin, const glm::vec3& direction, float& tMax) const;
+
+	// True if any sphere among [first, first + count) is hit closer than tMax,
+	// its slot is written to hitSlot if given
+	bool AnyHit(int first, int count, const glm::vec3& origin, const glm::vec3& direction, float tMax, int* hitSlot = nullptr) const;
+
+private:
+	// Distance to the hit of RT_SIMD_WIDTH spheres starting at slot, INFINITY on the lanes that miss
+	vfloat HitDistances(int slot, const vfloat& originX, const vfloat& originY, const vfloat& originZ,
+		const vfloat& dirX, const vfloat& dirY, const vfloat& dirZ) const;
+
+private:
+	typedef std::vector<float, AlignedAllocator<float> > FloatArray;
+
+	// The arrays are padded with RT_SIMD_WIDTH spheres that are never hit
+	// so the last slots can be loaded as a full register
+	FloatArray m_centerX, m_centerY, m_centerZ, m_radius2;
+	std::vector<int> m_material;
+	int m_size;
+};
+
+inline vfloat SphereSoA::HitDistances(int slot, const vfloat& originX, const vfloat& originY, const vfloat& originZ,
+	const vfloat& dirX, const vfloat& dirY, const vfloat& dirZ) const
+{
+	const vfloat radius2 = LoadFloatsUnaligned(&m_radius2[slot]);
+	const vfloat lx = LoadFloatsUnaligned(&m_centerX[slot]) - originX;
+	const vfloat ly = LoadFloatsUnaligned(&m_centerY[slot]) - originY;
+	const vfloat lz = LoadFloatsUnaligned(&m_centerZ[slot]) - originZ;
+	const vfloat tca = lx * dirX + ly * dirY + lz * dirZ;
+	const vfloat ox = lx - tca * dirX, oy = ly - tca * dirY, oz = lz - tca * dirZ;
+	const vfloat d2 = ox * ox + oy * oy + oz * oz;
+
+	// Same test as Sphere::intersect, the first hit in front of the origin is kept
+	const vmask hit = (tca >= vfloat(0.f)) & (d2 <= radius2);
+	const vfloat thc = Sqrt(Max(radius2 - d2, vfloat(0.f)));
+	const vfloat t0 = tca - thc;
+	const vfloat t = Select(t0 < vfloat(0.f), tca + thc, t0);
+
+	return Select(hit, t, vfloat(INFINITY));
+}
+
+#endif
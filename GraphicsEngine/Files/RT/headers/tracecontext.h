@@ -0,0 +1,49 @@
+#ifndef TRACECONTEXT_H
+#define TRACECONTEXT_H
+
+#include <vector>
+
+#include "Files/RT/headers/rayqueue.h"
+#include "Files/RT/headers/rtrandom.h"
+#include "Files/RT/headers/rtstats.h"
+
+// Primitive that blocked a shadow ray
+struct Occluder
+{
+	Occluder() : m_instance(-1), m_mesh(-1), m_prim(-1) {}
+
+	bool IsValid() const { return m_prim >= 0; }
+
+	int m_instance; // Index of the instance, -1 for the spheres and meshes of the scene itself
+	int m_mesh; // Index of the mesh, -1 for the spheres. 0 for the mesh of the object of an instance.
+	int m_prim; // Sphere index or triangle of the mesh, -1 if there is none
+};
+
+// State carried along the rays traced by one thread. It refers to primitives
+// of the scene so it must not be kept after the scene is rebuilt.
+struct TraceContext
+{
+	explicit TraceContext(uint64_t seed = 0) : m_random(seed) {}
+
+	// Last occluder found towards each light, indexed like the scene spheres.
+	// Shadow rays of neighbouring pixels are usually blocked by the same primitive.
+	Occluder& LastOccluder(int light)
+	{
+		if (light >= (int)m_lastOccluders.size()) m_lastOccluders.resize(light + 1);
+		return m_lastOccluders[light];
+	}
+
+	std::vector<Occluder> m_lastOccluders;
+
+	// Image pixel, y * width + x, and index of the sample of each pixel being traced,
+	// indexed like its colors. The sampler draws the numbers of a path from them.
+	std::vector<int> m_samplePixels;
+	std::vector<int> m_sampleIndices;
+
+	// Only the recursive tracer, which has no pixel, draws from the sequence of the context
+	RTRandom m_random;
+	Wavefront m_wavefront;
+	RTStats m_stats;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef TRIANGLEMESH_H
+#define TRIANGLEMESH_H
+
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/model.h"
+#include "Files/RT/headers/bvh.h"
+#include "Files/RT/headers/rtbvhcache.h"
+#include "Files/RT/headers/rtmaterial.h"
+#include "Files/RT/headers/rtstream.h"
+
+struct Triangle
+{
+	unsigned int m_vertex[3];
+	int m_material;
+};
+
+// Ray dependent constants of the watertight ray-triangle test
+// (Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection", JCGT 2013)
+struct WatertightRay
+{
+	WatertightRay(const glm::vec3& origin, const glm::vec3& direction);
+
+	glm::vec3 m_origin;
+	int m_kx, m_ky, m_kz;
+	float m_sx, m_sy, m_sz;
+};
+
+// Triangles of a loaded Model, transformed to the ray tracing scene, with its BVH
+class TriangleMesh
+{
+public:
+	TriangleMesh();
+	~TriangleMesh();
+
+	// The BVH is taken from bvhCache when it has it, built and saved to it otherwise
+	void Load(const Model& model, const glm::mat4& transform, RTBVHCache* bvhCache = nullptr);
+	void Clear();
+
+	// The transformed triangles and their materials, the BVH is built again when read
+	void Write(RTStreamWriter& stream) const;
+	bool Read(RTStreamReader& stream);
+
+	bool IsEmpty() const { return m_triangles.empty(); }
+	int NumTriangles() const { return (int)m_triangles.size(); }
+	const BVH& GetBVH() const { return m_bvh; }
+
+	// Closest triangle hit before tMax, -1 if there is none. Shortens tMax on hit.
+	int ClosestHit(const glm::vec3& origin, const glm::vec3& direction, float& tMax, float& u, float& v, RTStats* stats = nullptr) const;
+	// True if any triangle is hit before tMax, the triangle is written to occluder if given
+	bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax, int* occluder = nullptr, RTStats* stats = nullptr) const;
+
+	glm::vec3 Normal(int triangle, float u, float v) const;
+	const RTMaterial& GetMaterial(int triangle) const { return m_materials[m_triangles[triangle].m_material]; }
+
+	bool IntersectTriangle(int triangle, const WatertightRay& ray, float tMax, float& t, float& u, float& v) const;
+
+private:
+	void BuildBVH(RTBVHCache* bvhCache);
+
+private:
+	std::vector<glm::vec3> m_vertices;
+	std::vector<glm::vec3> m_normals; // Three per triangle, empty if the model has no normals
+	std::vector<glm::vec3> m_faceNormals;
+	std::vector<Triangle> m_triangles;
+	std::vector<RTMaterial> m_materials;
+	BVH m_bvh;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef UNIFORMGRID_H
+#define UNIFORMGRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Files/ThirdParty/glm/glm.hpp"
+#include "Files/RT/headers/aabb.h"
+#include "Files/RT/headers/rtstats.h"
+
+#define RT_GRID_CELLS_PER_PRIM 2.0f // Cells of the grid for each primitive
+
+// Uniform grid over the bounds of the primitives, the other acceleration structure
+// of the spheres. A primitive is listed in every cell it overlaps and the rays walk
+// the cells they cross front to back (3D-DDA, Amanatides and Woo 1987).
+// The build sorts the primitives into the cells by counting, linear in the
+// primitives and cells and spread over the threads, where the BVH build is
+// O(n log n). It traces about as fast when the primitives are many, of about the
+// same size and spread evenly, so it pays off when the scene changes every frame.
+//
+// Like the BVH it only knows the bounds of the primitives. The primitives of each
+// cell are contiguous in PrimIndices(), a primitive overlapping several cells is
+// listed once in each of them.
+class UniformGrid
+{
+public:
+	UniformGrid();
+	~UniformGrid();
+
+	void Build(const std::vector<AABB>& primBounds, float cellsPerPrim = RT_GRID_CELLS_PER_PRIM, int numThreads = 0);
+	void Clear();
+
+	bool IsEmpty() const { return m_primIndices.empty(); }
+	const glm::ivec3& Resolution() const { return m_resolution; }
+	const AABB& Bounds() const { return m_bounds; }
+	const glm::vec3& CellSize() const { return m_cellSize; }
+	const std::vector<unsigned int>& PrimIndices() const { return m_primIndices; }
+	size_t MemoryBytes() const { return (m_cellStart.size() + m_primIndices.size()) * sizeof(unsigned int); }
+
+	// True if the sizes of the primitives suit a grid better than a BVH: enough of
+	// them, without outliers many times larger than the rest that would fill the cells
+	static bool Suits(const std::vector<AABB>& primBounds);
+
+	// Closest hit traversal visiting whole cells. intersectCell(first, count, tMax)
+	// intersects PrimIndices()[first] to PrimIndices()[first + count - 1], it must
+	// return true and shorten tMax when one of them is hit closer than tMax.
+	// The traversals add the cells and primitives they test to stats if it is given.
+	template <typename IntersectFunc>
+	bool TraverseCells(const glm::vec3& origin, const glm::vec3& direction, float& tMax, IntersectFunc intersectCell, RTStats* stats = nullptr) const;
+
+	// Any hit traversal, returns as soon as occludedCell(first, count, tMax) returns true
+	template <typename OccludedFunc>
+	bool TraverseAnyCells(const glm::vec3& origin, const glm::vec3& direction, float tMax, OccludedFunc occludedCell, RTStats* stats = nullptr) const;
+
+private:
+	// Walks the cells crossed by the ray up to tMax, visitCell(cell, tExit) is called for
+	// each of them with the distance at which the ray leaves it and stops the walk if it
+	// returns true
+	template <typename VisitFunc>
+	void Walk(const glm::vec3& origin, const glm::vec3& direction, float tMax, VisitFunc visitCell) const;
+
+	int CellIndex(int x, int y, int z) const { return (z * m_resolution.y + y) * m_resolution.x + x; }
+	glm::ivec3 CellOf(const glm::vec3& point) const;
+
+private:
+	AABB m_bounds;
+	glm::ivec3 m_resolution;
+	glm::vec3 m_cellSize;
+	glm::vec3 m_invCellSize;
+	std::vector<unsigned int> m_cellStart; // Primitives of cell c are m_primIndices[m_cellStart[c]] up to m_cellStart[c + 1]
+	std::vector<unsigned int> m_primIndices;
+};
+
+inline glm::ivec3 UniformGrid::CellOf(const glm::vec3& point) const
+{
+	const glm::ivec3 cell((point - m_bounds.m_min) * m_invCellSize);
+	return glm::clamp(cell, glm::ivec3(0), m_resolution - 1);
+}
+
+template <typename VisitFunc>
+void UniformGrid::Walk(const glm::vec3& origin, const glm::vec3& direction, float tMax, VisitFunc visitCell) const
+{
+	// Clip the ray to the bounds of the grid, an axis the ray does not move along
+	// must have the origin inside
+	float tEnter = 0.f, tExit = tMax;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (direction[axis] == 0.f)
+		{
+			if (origin[axis] < m_bounds.m_min[axis] || origin[axis] > m_bounds.m_max[axis]) return;
+			continue;
+		}
+
+		const float invDir = 1.f / direction[axis];
+		float t0 = (m_bounds.m_min[axis] - origin[axis]) * invDir;
+		float t1 = (m_bounds.m_max[axis] - origin[axis]) * invDir;
+		if (t0 > t1) std::swap(t0, t1);
+		tEnter = std::max(tEnter, t0);
+		tExit = std::min(tExit, t1);
+	}
+	if (tEnter > tExit) return;
+
+	// The entry point is rounded and may land past a boundary the ray only crosses after
+	// tEnter, the cells before it would be skipped. The first cell is moved back on such
+	// an axis so that the ray enters it no later than tEnter.
+	glm::ivec3 cell = CellOf(origin + direction * tEnter);
+	glm::ivec3 step, end;
+	glm::vec3 tNext, tDelta;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (direction[axis] > 0.f)
+		{
+			if (cell[axis] > 0 && (m_bounds.m_min[axis] + cell[axis] * m_cellSize[axis] - origin[axis]) / direction[axis] > tEnter) cell[axis]--;
+
+			step[axis] = 1;
+			end[axis] = m_resolution[axis];
+			tNext[axis] = (m_bounds.m_min[axis] + (cell[axis] + 1) * m_cellSize[axis] - origin[axis]) / direction[axis];
+			tDelta[axis] = m_cellSize[axis] / direction[axis];
+		}
+		else if (direction[axis] < 0.f)
+		{
+			if (cell[axis] < m_resolution[axis] - 1 && (m_bounds.m_min[axis] + (cell[axis] + 1) * m_cellSize[axis] - origin[axis]) / direction[axis] > tEnter) cell[axis]++;
+
+			step[axis] = -1;
+			end[axis] = -1;
+			tNext[axis] = (m_bounds.m_min[axis] + cell[axis] * m_cellSize[axis] - origin[axis]) / direction[axis];
+			tDelta[axis] = -m_cellSize[axis] / direction[axis];
+		}
+		else
+		{
+			step[axis] = 0;
+			end[axis] = -1;
+			tNext[axis] = INFINITY;
+			tDelta[axis] = INFINITY;
+		}
+	}
+
+	while (true)
+	{
+		const int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+		if (visitCell(CellIndex(cell.x, cell.y, cell.z), std::min(tNext[axis], tExit))) return;
+
+		if (tNext[axis] > tExit) return;
+		cell[axis] += step[axis];
+		if (cell[axis] == end[axis]) return;
+		tNext[axis] += tDelta[axis];
+	}
+}
+
+template <typename IntersectFunc>
+bool UniformGrid::TraverseCells(const glm::vec3& origin, const glm::vec3& direction, float& tMax, IntersectFunc intersectCell, RTStats* stats) const
+{
+	if (m_primIndices.empty()) return false;
+
+	bool hit = false;
+	unsigned int cellsVisited = 0, primTests = 0;
+
+	Walk(origin, direction, tMax, [&](int cell, float tCellExit)
+	{
+		cellsVisited++;
+		const unsigned int first = m_cellStart[cell], count = m_cellStart[cell + 1] - first;
+		if (count == 0) return false;
+
+		primTests += count;
+		if (intersectCell(first, count, tMax)) hit = true;
+
+		// A primitive of this cell may be hit in a later one, the walk goes on until the
+		// closest hit is inside the cells already visited
+		return tMax <= tCellExit;
+	});
+
+	if (stats)
+	{
+		stats->m_nodesVisited += cellsVisited;
+		stats->m_primTests += primTests;
+	}
+
+	return hit;
+}
+
+template <typename OccludedFunc>
+bool UniformGrid::TraverseAnyCells(const glm::vec3& origin, const glm::vec3& direction, float tMax, OccludedFunc occludedCell, RTStats* stats) const
+{
+	if (m_primIndices.empty()) return false;
+
+	bool occluded = false;
+	unsigned int cellsVisited = 0, primTests = 0;
+
+	Walk(origin, direction, tMax, [&](int cell, float)
+	{
+		cellsVisited++;
+		const unsigned int first = m_cellStart[cell], count = m_cellStart[cell + 1] - first;
+		if (count == 0) return false;
+
+		primTests += count;
+		occluded = occludedCell(first, count, tMax);
+		return occluded;
+	});
+
+	if (stats)
+	{
+		stats->m_nodesVisited += cellsVisited;
+		stats->m_primTests += primTests;
+	}
+
+	return occluded;
+}
+
+#endif
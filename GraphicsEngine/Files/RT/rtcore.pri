@@ -0,0 +1,73 @@
+# Ray tracing core, without Qt. The editor builds it in, RTCore.pro builds it as a library
+# for the tools that only query the scenes.
+
+HEADERS += $$PWD/../definitions.h \
+			$$PWD/../model.h \
+			$$PWD/../sphere.h \
+			$$PWD/headers/aabb.h \
+			$$PWD/headers/ray.h \
+			$$PWD/headers/rtmaterial.h \
+			$$PWD/headers/trianglemesh.h \
+			$$PWD/headers/simd.h \
+			$$PWD/headers/raypacket.h \
+			$$PWD/headers/rayqueue.h \
+			$$PWD/headers/spheresoa.h \
+			$$PWD/headers/bvh.h \
+			$$PWD/headers/rtrandom.h \
+			$$PWD/headers/tracecontext.h \
+			$$PWD/headers/rtscene.h \
+			$$PWD/headers/raytracer.h \
+			$$PWD/headers/denoiser.h \
+			$$PWD/headers/renderjob.h \
+			$$PWD/headers/rtbenchmark.h \
+			$$PWD/headers/rtimage.h \
+			$$PWD/headers/rtrender.h \
+			$$PWD/headers/rtstream.h \
+			$$PWD/headers/rtsocket.h \
+			$$PWD/headers/rtdistributed.h \
+			$$PWD/headers/rtstats.h \
+			$$PWD/headers/rtanimation.h \
+			$$PWD/headers/rtobject.h \
+			$$PWD/headers/rtlights.h \
+			$$PWD/headers/rtsampler.h \
+			$$PWD/headers/rtcamera.h \
+			$$PWD/headers/rthybrid.h \
+			$$PWD/headers/rtaobake.h \
+			$$PWD/headers/rtquery.h \
+			$$PWD/headers/uniformgrid.h \
+			$$PWD/headers/rtbvhcache.h \
+
+SOURCES += $$PWD/../model.cpp \
+			$$PWD/sources/bvh.cpp \
+			$$PWD/sources/spheresoa.cpp \
+			$$PWD/sources/rtscene.cpp \
+			$$PWD/sources/trianglemesh.cpp \
+			$$PWD/sources/raytracer.cpp \
+			$$PWD/sources/denoiser.cpp \
+			$$PWD/sources/renderjob.cpp \
+			$$PWD/sources/rtbenchmark.cpp \
+			$$PWD/sources/rtimage.cpp \
+			$$PWD/sources/rtrender.cpp \
+			$$PWD/sources/rtsocket.cpp \
+			$$PWD/sources/rtdistributed.cpp \
+			$$PWD/sources/rtstats.cpp \
+			$$PWD/sources/rtanimation.cpp \
+			$$PWD/sources/rtobject.cpp \
+			$$PWD/sources/rtlights.cpp \
+			$$PWD/sources/rtsampler.cpp \
+			$$PWD/sources/rtcamera.cpp \
+			$$PWD/sources/rthybrid.cpp \
+			$$PWD/sources/rtaobake.cpp \
+			$$PWD/sources/rtquery.cpp \
+			$$PWD/sources/uniformgrid.cpp \
+			$$PWD/sources/rtbvhcache.cpp \
+
+# Wider SIMD for the ray tracer packets, the default build uses SSE2 (4 rays per packet).
+# Enable with: qmake CONFIG+=rt_avx2 or qmake CONFIG+=rt_avx512
+rt_avx512 {
+	msvc: QMAKE_CXXFLAGS += /arch:AVX512
+	else: QMAKE_CXXFLAGS += -mavx512f -mavx2 -mfma
+} else: rt_avx2 {
+	msvc: QMAKE_CXXFLAGS += /arch:AVX2
+	else: QMAKE_CXXFLAGS += -mavx2 -mfma
+}
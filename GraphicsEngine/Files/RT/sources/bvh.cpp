@@ -0,0 +1,249 @@
+#include "Files/RT/headers/bvh.h"
+
+#define BVH_BINS 16
+#define BVH_TRAVERSAL_COST 1.0f
+
+BVH::BVH() : m_primsPerTest(1), m_externalNodes(nullptr), m_numExternalNodes(0), m_externalPrimIndices(nullptr), m_numExternalPrimIndices(0) { }
+
+BVH::~BVH() { }
+
+void BVH::Clear()
+{
+	m_nodes.clear();
+	m_primIndices.clear();
+	m_storage.reset();
+}
+
+void BVH::Assign(std::vector<BVHNode>& nodes, std::vector<unsigned int>& primIndices, int primsPerTest)
+{
+	m_storage.reset();
+	m_nodes.swap(nodes);
+	m_primIndices.swap(primIndices);
+	m_primsPerTest = std::max(1, primsPerTest);
+}
+
+void BVH::AssignExternal(const BVHNode* nodes, size_t numNodes, const unsigned int* primIndices, size_t numPrimIndices,
+	int primsPerTest, const std::shared_ptr<const void>& storage)
+{
+	Clear();
+	m_storage = storage;
+	m_externalNodes = nodes;
+	m_numExternalNodes = numNodes;
+	m_externalPrimIndices = primIndices;
+	m_numExternalPrimIndices = numPrimIndices;
+	m_primsPerTest = std::max(1, primsPerTest);
+}
+
+void BVH::Build(const std::vector<AABB>& primBounds, int maxLeafSize, int primsPerTest)
+{
+	Clear();
+	m_primsPerTest = std::max(1, primsPerTest);
+
+	if (primBounds.empty()) return;
+
+	std::vector<BuildPrim> prims(primBounds.size());
+	m_primIndices.resize(primBounds.size());
+
+	for (size_t i = 0; i < primBounds.size(); ++i)
+	{
+		prims[i].m_bounds = primBounds[i];
+		prims[i].m_centroid = primBounds[i].Centroid();
+		m_primIndices[i] = (unsigned int)i;
+	}
+
+	// A binary tree never has more than 2N - 1 nodes
+	m_nodes.reserve(2 * primBounds.size() - 1);
+
+	BVHNode root;
+	root.m_leftFirst = 0;
+	root.m_primCount = (unsigned int)primBounds.size();
+	UpdateNodeBounds(root, prims);
+	m_nodes.push_back(root);
+
+	Subdivide(0, prims, std::max(1, maxLeafSize), 0);
+
+	m_nodes.shrink_to_fit();
+}
+
+void BVH::Refit(const std::vector<AABB>& primBounds)
+{
+	// External arrays are read only, the refit bounds go to a copy
+	if (m_storage)
+	{
+		m_nodes.assign(m_externalNodes, m_externalNodes + m_numExternalNodes);
+		m_primIndices.assign(m_externalPrimIndices, m_externalPrimIndices + m_numExternalPrimIndices);
+		m_storage.reset();
+	}
+
+	// The children are always stored after their parent, going backwards updates them first
+	for (int i = (int)m_nodes.size() - 1; i >= 0; --i)
+	{
+		BVHNode& node = m_nodes[i];
+		AABB bounds;
+
+		if (node.IsLeaf())
+		{
+			for (unsigned int p = 0; p < node.m_primCount; ++p)
+			{
+				bounds.Grow(primBounds[m_primIndices[node.m_leftFirst + p]]);
+			}
+		}
+		else
+		{
+			const BVHNode& left = m_nodes[node.m_leftFirst];
+			const BVHNode& right = m_nodes[node.m_leftFirst + 1];
+			bounds = AABB(glm::min(left.m_boundsMin, right.m_boundsMin), glm::max(left.m_boundsMax, right.m_boundsMax));
+		}
+
+		node.m_boundsMin = bounds.m_min;
+		node.m_boundsMax = bounds.m_max;
+	}
+}
+
+void BVH::UpdateNodeBounds(BVHNode& node, const std::vector<BuildPrim>& prims) const
+{
+	AABB bounds;
+	for (unsigned int i = 0; i < node.m_primCount; ++i)
+	{
+		bounds.Grow(prims[m_primIndices[node.m_leftFirst + i]].m_bounds);
+	}
+
+	node.m_boundsMin = bounds.m_min;
+	node.m_boundsMax = bounds.m_max;
+}
+
+float BVH::FindBestSplit(const BVHNode& node, const std::vector<BuildPrim>& prims, int& axis, int& splitBin, AABB& centroidBounds) const
+{
+	centroidBounds = AABB();
+	for (unsigned int i = 0; i < node.m_primCount; ++i)
+	{
+		centroidBounds.Grow(prims[m_primIndices[node.m_leftFirst + i]].m_centroid);
+	}
+
+	float bestCost = INFINITY;
+
+	for (int a = 0; a < 3; ++a)
+	{
+		const float boundsMin = centroidBounds.m_min[a];
+		const float boundsMax = centroidBounds.m_max[a];
+		if (boundsMin == boundsMax) continue;
+
+		AABB binBounds[BVH_BINS];
+		int binCount[BVH_BINS] = { 0 };
+		const float scale = BVH_BINS / (boundsMax - boundsMin);
+
+		for (unsigned int i = 0; i < node.m_primCount; ++i)
+		{
+			const BuildPrim& prim = prims[m_primIndices[node.m_leftFirst + i]];
+			const int bin = std::min(BVH_BINS - 1, (int)((prim.m_centroid[a] - boundsMin) * scale));
+			binCount[bin]++;
+			binBounds[bin].Grow(prim.m_bounds);
+		}
+
+		// Sweep from both sides to get the area and count at each side of every plane
+		float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+		int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+		AABB leftBox, rightBox;
+		int leftSum = 0, rightSum = 0;
+
+		for (int i = 0; i < BVH_BINS - 1; ++i)
+		{
+			leftSum += binCount[i];
+			leftCount[i] = leftSum;
+			leftBox.Grow(binBounds[i]);
+			leftArea[i] = leftBox.SurfaceArea();
+
+			rightSum += binCount[BVH_BINS - 1 - i];
+			rightCount[BVH_BINS - 2 - i] = rightSum;
+			rightBox.Grow(binBounds[BVH_BINS - 1 - i]);
+			rightArea[BVH_BINS - 2 - i] = rightBox.SurfaceArea();
+		}
+
+		for (int i = 0; i < BVH_BINS - 1; ++i)
+		{
+			if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+
+			const float cost = LeafCost(leftCount[i]) * leftArea[i] + LeafCost(rightCount[i]) * rightArea[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				axis = a;
+				splitBin = i + 1;
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+void BVH::Subdivide(unsigned int nodeIndex, const std::vector<BuildPrim>& prims, int maxLeafSize, int depth)
+{
+	BVHNode& node = m_nodes[nodeIndex];
+
+	if ((int)node.m_primCount <= maxLeafSize || depth >= BVH_STACK_SIZE - 2) return;
+
+	int axis = -1, splitBin = 0;
+	AABB centroidBounds;
+	const float splitCost = FindBestSplit(node, prims, axis, splitBin, centroidBounds);
+
+	// All the centroids are in the same spot, nothing to split
+	if (axis < 0) return;
+
+	const AABB nodeBounds(node.m_boundsMin, node.m_boundsMax);
+	const float nodeArea = nodeBounds.SurfaceArea();
+	const float leafCost = LeafCost(node.m_primCount);
+	const float cost = nodeArea > 0.f ? BVH_TRAVERSAL_COST + splitCost / nodeArea : INFINITY;
+
+	if (cost >= leafCost) return;
+
+	// Partition the primitives in place
+	const float boundsMin = centroidBounds.m_min[axis];
+	const float scale = BVH_BINS / (centroidBounds.m_max[axis] - boundsMin);
+
+	unsigned int* first = &m_primIndices[node.m_leftFirst];
+	unsigned int* last = first + node.m_primCount;
+	unsigned int* middle = std::partition(first, last, [&](unsigned int primIndex)
+	{
+		const int bin = std::min(BVH_BINS - 1, (int)((prims[primIndex].m_centroid[axis] - boundsMin) * scale));
+		return bin < splitBin;
+	});
+
+	const unsigned int leftCount = (unsigned int)(middle - first);
+	if (leftCount == 0 || leftCount == node.m_primCount) return;
+
+	BVHNode left, right;
+	left.m_leftFirst = node.m_leftFirst;
+	left.m_primCount = leftCount;
+	right.m_leftFirst = node.m_leftFirst + leftCount;
+	right.m_primCount = node.m_primCount - leftCount;
+	UpdateNodeBounds(left, prims);
+	UpdateNodeBounds(right, prims);
+
+	// The node reference is not valid anymore after pushing the children
+	const unsigned int leftIndex = (unsigned int)m_nodes.size();
+	m_nodes.push_back(left);
+	m_nodes.push_back(right);
+	m_nodes[nodeIndex].m_leftFirst = leftIndex;
+	m_nodes[nodeIndex].m_primCount = 0;
+
+	Subdivide(leftIndex, prims, maxLeafSize, depth + 1);
+	Subdivide(leftIndex + 1, prims, maxLeafSize, depth + 1);
+}
+
+float BVH::SAHCost() const
+{
+	if (IsEmpty()) return 0.f;
+
+	const BVHArray<BVHNode> nodes = Nodes();
+	const float rootArea = AABB(nodes[0].m_boundsMin, nodes[0].m_boundsMax).SurfaceArea();
+	if (rootArea <= 0.f) return 0.f;
+
+	float cost = 0.f;
+	for (const BVHNode& node : nodes)
+	{
+		const float area = AABB(node.m_boundsMin, node.m_boundsMax).SurfaceArea();
+		cost += area * (node.IsLeaf() ? LeafCost(node.m_primCount) : BVH_TRAVERSAL_COST);
+	}
+
+	return cost / rootArea;
+}
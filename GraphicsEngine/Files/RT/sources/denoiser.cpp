@@ -0,0 +1,299 @@
+#include "Files/RT/headers/denoiser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+// Each pass doubles the spacing of the 5x5 taps, the last one reaches 2 << (RT_DENOISE_PASSES - 1) pixels
+#define RT_DENOISE_PASSES 5
+#define RT_DENOISE_BAND_ROWS 8
+
+// Edge stopping: luminance differences in units of the noise of the pixel, squared distance
+// of the normals and relative depth difference per pixel of the tap offset. The depth
+// tolerance stops growing after a few pixels so the background never blends with a surface.
+#define RT_DENOISE_LUMINANCE_SIGMA 4.f
+#define RT_DENOISE_NORMAL_SIGMA2 0.1f
+#define RT_DENOISE_DEPTH_SIGMA 0.05f
+#define RT_DENOISE_DEPTH_MAX_DISTANCE 4
+
+// Darker albedos are not divided out, the lighting of black surfaces would blow up
+#define RT_DENOISE_MIN_ALBEDO 0.01f
+#define RT_DENOISE_MIN_NOISE 1e-4f
+
+static const float s_kernel[3] = { 3.f / 8.f, 1.f / 4.f, 1.f / 16.f }; // B3 spline
+
+static vfloat Luminance(const vfloat& r, const vfloat& g, const vfloat& b)
+{
+	return r * vfloat(0.2126f) + g * vfloat(0.7152f) + b * vfloat(0.0722f);
+}
+
+static vfloat Abs(const vfloat& a)
+{
+	return Max(a, vfloat(0.f) - a);
+}
+
+// (1 - x / 8)^8 follows exp(-x) closely and reaches zero, no exp is needed in the lanes
+static vfloat Falloff(const vfloat& x)
+{
+	vfloat w = Max(vfloat(0.f), vfloat(1.f) - x * vfloat(0.125f));
+	w = w * w;
+	w = w * w;
+	return w * w;
+}
+
+static Color Demodulation(const Color& albedo)
+{
+	return glm::max(albedo, Color(RT_DENOISE_MIN_ALBEDO));
+}
+
+Denoiser::Denoiser() : m_width(0), m_height(0), m_stride(0), m_border(0) { }
+
+void Denoiser::Denoise(int width, int height, const Color* colors, const PixelFeatures* features, const float* variances, int numThreads, Color* result)
+{
+	if (width <= 0 || height <= 0) return;
+
+	m_width = width;
+	m_height = height;
+
+	// The border covers the widest taps of the lanes past the last pixel too
+	m_border = ((2 << (RT_DENOISE_PASSES - 1)) + RT_SIMD_WIDTH - 1) / RT_SIMD_WIDTH * RT_SIMD_WIDTH;
+	m_stride = m_border * 2 + (width + RT_SIMD_WIDTH - 1) / RT_SIMD_WIDTH * RT_SIMD_WIDTH;
+
+	LoadPlanes(colors, features, variances);
+
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int pass = 0; pass < RT_DENOISE_PASSES; ++pass)
+	{
+		RunOnRows(numThreads, pass);
+	}
+
+	// The texture goes back on the filtered lighting
+	Plane* lighting = m_lighting[RT_DENOISE_PASSES & 1];
+	for (int y = 0; y < height; ++y)
+	{
+		const float* r = Row(lighting[0], y);
+		const float* g = Row(lighting[1], y);
+		const float* b = Row(lighting[2], y);
+		for (int x = 0; x < width; ++x)
+		{
+			const int pixel = y * width + x;
+			result[pixel] = Color(r[x], g[x], b[x]) * Demodulation(m_albedo[pixel]);
+		}
+	}
+}
+
+void Denoiser::LoadPlanes(const Color* colors, const PixelFeatures* features, const float* variances)
+{
+	const size_t size = (size_t)m_stride * m_height;
+	for (int set = 0; set < 2; ++set)
+	{
+		for (int c = 0; c < 3; ++c) m_lighting[set][c].assign(size, 0.f);
+		m_variance[set].assign(size, 0.f);
+	}
+	for (int c = 0; c < 3; ++c) m_normal[c].assign(size, 0.f);
+	m_inverseDepth.assign(size, 0.f);
+	m_albedo.resize(m_width * m_height);
+
+	for (int y = 0; y < m_height; ++y)
+	{
+		for (int x = 0; x < m_width; ++x)
+		{
+			const int pixel = y * m_width + x;
+			const PixelFeatures& pixelFeatures = features[pixel];
+			const Color demodulation = Demodulation(pixelFeatures.m_albedo);
+			const Color lighting = colors[pixel] / demodulation;
+
+			m_albedo[pixel] = pixelFeatures.m_albedo;
+			Row(m_lighting[0][0], y)[x] = lighting.r;
+			Row(m_lighting[0][1], y)[x] = lighting.g;
+			Row(m_lighting[0][2], y)[x] = lighting.b;
+			Row(m_normal[0], y)[x] = pixelFeatures.m_normal.x;
+			Row(m_normal[1], y)[x] = pixelFeatures.m_normal.y;
+			Row(m_normal[2], y)[x] = pixelFeatures.m_normal.z;
+			Row(m_inverseDepth, y)[x] = pixelFeatures.m_depth > 0.f ? 1.f / pixelFeatures.m_depth : 0.f;
+
+			// The noise of the lighting is the noise of the color without the albedo
+			if (variances)
+			{
+				const float albedoLuminance = Luminance(demodulation);
+				Row(m_variance[0], y)[x] = variances[pixel] / (albedoLuminance * albedoLuminance);
+			}
+		}
+	}
+
+	// With a single sample per pixel the noise is taken from the 3x3 neighbourhood
+	if (!variances)
+	{
+		for (int y = 0; y < m_height; ++y)
+		{
+			for (int x = 0; x < m_width; ++x)
+			{
+				float sum = 0.f, sum2 = 0.f;
+				int count = 0;
+				for (int ny = std::max(0, y - 1); ny <= std::min(m_height - 1, y + 1); ++ny)
+				{
+					for (int nx = std::max(0, x - 1); nx <= std::min(m_width - 1, x + 1); ++nx)
+					{
+						const float luminance = Luminance(Color(Row(m_lighting[0][0], ny)[nx], Row(m_lighting[0][1], ny)[nx], Row(m_lighting[0][2], ny)[nx]));
+						sum += luminance;
+						sum2 += luminance * luminance;
+						++count;
+					}
+				}
+				const float mean = sum / count;
+				Row(m_variance[0], y)[x] = std::max(0.f, sum2 / count - mean * mean);
+			}
+		}
+	}
+
+	for (int y = 0; y < m_height; ++y)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			FillBorders(m_lighting[0][c], y);
+			FillBorders(m_normal[c], y);
+		}
+		FillBorders(m_variance[0], y);
+		FillBorders(m_inverseDepth, y);
+	}
+}
+
+void Denoiser::RunOnRows(int numThreads, int pass)
+{
+	const int numBands = (m_height + RT_DENOISE_BAND_ROWS - 1) / RT_DENOISE_BAND_ROWS;
+	std::atomic<int> nextBand(0);
+
+	// The rows of a pass only read the planes of the previous one, the bands go in any order
+	auto filterBands = [&]()
+	{
+		for (int band = nextBand++; band < numBands; band = nextBand++)
+		{
+			const int lastRow = std::min(m_height, (band + 1) * RT_DENOISE_BAND_ROWS);
+			for (int y = band * RT_DENOISE_BAND_ROWS; y < lastRow; ++y) FilterRow(pass, y);
+		}
+	};
+
+	numThreads = std::min(numThreads, numBands);
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; ++t) threads.push_back(std::thread(filterBands));
+
+	filterBands();
+
+	for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+}
+
+void Denoiser::FilterRow(int pass, int y)
+{
+	const int step = 1 << pass;
+	Plane* lighting = m_lighting[pass & 1];
+	Plane* filtered = m_lighting[(pass & 1) ^ 1];
+	Plane& variance = m_variance[pass & 1];
+	Plane& filteredVariance = m_variance[(pass & 1) ^ 1];
+
+	// Rows of the taps, clamped to the image
+	const float* lightingRows[3][5];
+	const float* varianceRows[5];
+	const float* normalRows[3][5];
+	const float* depthRows[5];
+	for (int dy = -2; dy <= 2; ++dy)
+	{
+		const int row = std::min(m_height - 1, std::max(0, y + dy * step));
+		for (int c = 0; c < 3; ++c)
+		{
+			lightingRows[c][dy + 2] = Row(lighting[c], row);
+			normalRows[c][dy + 2] = Row(m_normal[c], row);
+		}
+		varianceRows[dy + 2] = Row(variance, row);
+		depthRows[dy + 2] = Row(m_inverseDepth, row);
+	}
+
+	const float* nearVarianceRows[3];
+	for (int dy = -1; dy <= 1; ++dy) nearVarianceRows[dy + 1] = Row(variance, std::min(m_height - 1, std::max(0, y + dy)));
+
+	// The depth tolerance grows with the distance of the tap
+	float depthScales[5][5];
+	for (int dy = -2; dy <= 2; ++dy)
+	{
+		for (int dx = -2; dx <= 2; ++dx)
+		{
+			const float distance = (float)std::min(step * std::max(std::abs(dx), std::abs(dy)), RT_DENOISE_DEPTH_MAX_DISTANCE);
+			depthScales[dy + 2][dx + 2] = distance > 0.f ? 1.f / (RT_DENOISE_DEPTH_SIGMA * RT_DENOISE_DEPTH_SIGMA * distance * distance) : 0.f;
+		}
+	}
+
+	const vfloat centerWeight(s_kernel[0] * s_kernel[0]);
+	const vfloat invNormalSigma2(1.f / RT_DENOISE_NORMAL_SIGMA2);
+
+	for (int x = 0; x < m_width; x += RT_SIMD_WIDTH)
+	{
+		const vfloat r = LoadFloats(lightingRows[0][2] + x), g = LoadFloats(lightingRows[1][2] + x), b = LoadFloats(lightingRows[2][2] + x);
+		const vfloat nx = LoadFloats(normalRows[0][2] + x), ny = LoadFloats(normalRows[1][2] + x), nz = LoadFloats(normalRows[2][2] + x);
+		const vfloat depth = LoadFloats(depthRows[2] + x);
+		const vfloat luminance = Luminance(r, g, b);
+
+		// The noise is smoothed over 3x3 pixels, a single pixel estimate is too noisy itself
+		vfloat noise(0.f);
+		for (int dy = 0; dy < 3; ++dy)
+		{
+			const float ky = dy == 1 ? 0.5f : 0.25f;
+			noise = noise + vfloat(ky * 0.25f) * LoadFloatsUnaligned(nearVarianceRows[dy] + x - 1)
+				+ vfloat(ky * 0.5f) * LoadFloats(nearVarianceRows[dy] + x)
+				+ vfloat(ky * 0.25f) * LoadFloatsUnaligned(nearVarianceRows[dy] + x + 1);
+		}
+		const vfloat invLuminanceSigma = vfloat(1.f) / (vfloat(RT_DENOISE_LUMINANCE_SIGMA) * Sqrt(Max(noise, vfloat(0.f))) + vfloat(RT_DENOISE_MIN_NOISE));
+		const vfloat invDepth2 = vfloat(1.f) / (depth * depth + vfloat(1e-12f));
+
+		vfloat weightSum = centerWeight;
+		vfloat sumR = r * centerWeight, sumG = g * centerWeight, sumB = b * centerWeight;
+		vfloat varianceSum = LoadFloats(varianceRows[2] + x) * centerWeight * centerWeight;
+
+		for (int dy = 0; dy < 5; ++dy)
+		{
+			for (int dx = 0; dx < 5; ++dx)
+			{
+				if (dx == 2 && dy == 2) continue;
+
+				const int offset = x + (dx - 2) * step;
+				const vfloat qr = LoadFloatsUnaligned(lightingRows[0][dy] + offset);
+				const vfloat qg = LoadFloatsUnaligned(lightingRows[1][dy] + offset);
+				const vfloat qb = LoadFloatsUnaligned(lightingRows[2][dy] + offset);
+
+				const vfloat dnx = nx - LoadFloatsUnaligned(normalRows[0][dy] + offset);
+				const vfloat dny = ny - LoadFloatsUnaligned(normalRows[1][dy] + offset);
+				const vfloat dnz = nz - LoadFloatsUnaligned(normalRows[2][dy] + offset);
+				const vfloat dDepth = depth - LoadFloatsUnaligned(depthRows[dy] + offset);
+
+				const vfloat distance = Abs(luminance - Luminance(qr, qg, qb)) * invLuminanceSigma
+					+ (dnx * dnx + dny * dny + dnz * dnz) * invNormalSigma2
+					+ dDepth * dDepth * invDepth2 * vfloat(depthScales[dy][dx]);
+
+				const vfloat weight = vfloat(s_kernel[std::abs(dy - 2)] * s_kernel[std::abs(dx - 2)]) * Falloff(distance);
+
+				weightSum = weightSum + weight;
+				sumR = sumR + qr * weight;
+				sumG = sumG + qg * weight;
+				sumB = sumB + qb * weight;
+				varianceSum = varianceSum + LoadFloatsUnaligned(varianceRows[dy] + offset) * weight * weight;
+			}
+		}
+
+		const vfloat invWeightSum = vfloat(1.f) / weightSum;
+		StoreFloats(Row(filtered[0], y) + x, sumR * invWeightSum);
+		StoreFloats(Row(filtered[1], y) + x, sumG * invWeightSum);
+		StoreFloats(Row(filtered[2], y) + x, sumB * invWeightSum);
+		StoreFloats(Row(filteredVariance, y) + x, varianceSum * invWeightSum * invWeightSum);
+	}
+
+	for (int c = 0; c < 3; ++c) FillBorders(filtered[c], y);
+	FillBorders(filteredVariance, y);
+}
+
+void Denoiser::FillBorders(Plane& plane, int y)
+{
+	// The edge pixels are repeated, this also overwrites the lanes written past the last pixel
+	float* row = Row(plane, y);
+	std::fill(row - m_border, row, row[0]);
+	std::fill(row + m_width, row - m_border + m_stride, row[m_width - 1]);
+}
@@ -0,0 +1,700 @@
+#include "Files/RT/headers/raytracer.h"
+#include "Files/definitions.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Whitted lights light the surfaces as points without any falloff. Their radiance as
+// area lights is scaled so a light about 10 units away gives the same irradiance.
+#define RT_PATH_LIGHT_RADIANCE_SCALE 25.f
+
+// Paths longer than this are continued with a probability given by their weight
+#define RT_PATH_ROULETTE_DEPTH 3
+
+// Dimensions of the sampler taken by a sample: the jitter in the pixel, then at each
+// bounce the side picked on a specular surface, the diffuse bounce, the roulette and
+// the light pick and the cone direction of each shadow ray
+#define RT_DIMENSION_JITTER 0
+#define RT_DIMENSION_FIRST_BOUNCE 2
+#define RT_BOUNCE_SPECULAR 0
+#define RT_BOUNCE_DIRECTION 1
+#define RT_BOUNCE_ROULETTE 3
+#define RT_BOUNCE_LIGHTS 4
+#define RT_LIGHT_DIMENSIONS 3
+#define RT_LIGHT_CONE 1
+
+// Power heuristic of multiple importance sampling, a zero density is a specular
+// or camera ray that only the other strategy could not have sampled
+static float MISWeight(float pdf, float otherPdf)
+{
+	if (pdf <= 0.f) return 1.f;
+	return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
+}
+
+// The features of a pixel start unset, the camera hit gives its depth and the first
+// diffuse surface, glass or the background its normal and albedo
+static void RecordDepth(PixelFeatures* features, int pixel, float distance)
+{
+	if (features && features[pixel].m_depth < 0.f) features[pixel].m_depth = distance;
+}
+
+static void RecordSurface(PixelFeatures* features, int pixel, const glm::vec3& normal, const Color& albedo)
+{
+	if (!features || features[pixel].m_albedo.r >= 0.f) return;
+	features[pixel].m_normal = normal;
+	features[pixel].m_albedo = albedo;
+}
+
+typedef std::chrono::steady_clock TraceClock;
+
+// Adds the time since start to the phase and starts timing the next one
+static void EndPhase(RTStats& stats, RTPhase phase, TraceClock::time_point& start)
+{
+	const TraceClock::time_point now = TraceClock::now();
+	stats.m_phaseSeconds[phase] += std::chrono::duration<double>(now - start).count();
+	start = now;
+}
+
+static void CountWave(RTStats& stats, int depth, int numRays)
+{
+	stats.m_waveRays += numRays;
+	stats.m_waveDepthSum += (uint64_t)numRays * depth;
+	stats.m_maxDepth = std::max(stats.m_maxDepth, depth);
+}
+
+RayTracer::RayTracer(const RTScene& scene, const RenderSettings& settings) : m_scene(scene), m_settings(settings), m_sampler(settings.m_sampler) { }
+
+Color RayTracer::TraceRay(Ray& ray, const int &depth, TraceContext& context)const
+{
+	ray.m_direction = glm::normalize(ray.m_direction);
+
+	HitInfo closestHitInfo;
+
+	if (depth == 0) ++context.m_stats.m_rays[RT_RAY_PRIMARY];
+
+	if(!m_scene.Intersect(ray, closestHitInfo, &context.m_stats))
+	{
+		// If no collision take the background color
+		return m_settings.m_backgroundColor;
+	}
+
+	return ShadeHit(ray, closestHitInfo, depth, context);
+}
+
+Color RayTracer::ShadeHit(const Ray& ray, const HitInfo& closestHitInfo, const int &depth, TraceContext& context)const
+{
+	const RTMaterial* material = closestHitInfo.m_material;
+
+	/*if (material->IsLight())
+	{
+		// If the closest intersection is a light return its color
+		return material->m_lightColor; // *material->m_emission;
+	}*/
+
+	// ---------------------------------------
+
+	Color colorRay(0.f);
+
+	if((material->RefractsLight() || material->ReflectsLight()) && depth < m_settings.m_maxRayDepth)
+	{
+		// Reflection
+		Ray reflectRay = CalcReflectionRay(ray, closestHitInfo);
+		++context.m_stats.m_rays[RT_RAY_REFLECTION];
+
+		const Color reflColor = TraceRay(reflectRay, depth + 1, context);
+
+
+		// Refraction
+		Color refrColor(0.f);
+
+		if (material->RefractsLight())
+		{
+			// Calc refraction ray
+			Ray refractionRay = CalcRefractionRay(ray, closestHitInfo, material);
+			++context.m_stats.m_rays[RT_RAY_REFRACTION];
+
+			refrColor = TraceRay(refractionRay, depth + 1, context);
+		}
+
+		colorRay = BlendReflRefrColors(material, ray.m_direction, closestHitInfo.m_normalHit, reflColor, refrColor);
+	}
+	else
+	{
+		// Diffuse object
+
+		colorRay = CalcDiffuseColor(closestHitInfo, material, context);
+	}
+
+
+	return colorRay + material->m_lightColor * material->m_emission;
+}
+
+Ray RayTracer::CameraRay(float x, float y)const
+{
+	return m_settings.m_camera.GenerateRay(x, y, m_settings.m_width, m_settings.m_height);
+}
+
+void RayTracer::TraceRow(int y, int pixelStep, int sample, bool jitter, int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	RayQueue& cameraRays = context.m_wavefront.m_rays;
+	cameraRays.Clear();
+
+	const int numPixels = (m_settings.m_width + pixelStep - 1) / pixelStep;
+	context.m_samplePixels.resize(numPixels);
+	context.m_sampleIndices.assign(numPixels, sample);
+
+	for (int i = 0; i < numPixels; ++i)
+	{
+		context.m_samplePixels[i] = y * m_settings.m_width + i * pixelStep;
+
+		const glm::vec2 offset = jitter ? Sample2D(context, i, RT_DIMENSION_JITTER) : glm::vec2(0.5f);
+		cameraRays.Push(CameraRay(i * pixelStep + offset.x, y + offset.y), Color(1.f), i);
+		colors[i] = Color(0.f);
+	}
+
+	TraceCameraRays(startDepth, context, colors, features);
+}
+
+void RayTracer::TracePixels(const int* pixels, const int* samples, int count, bool jitter, int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	RayQueue& cameraRays = context.m_wavefront.m_rays;
+	cameraRays.Clear();
+
+	context.m_samplePixels.assign(pixels, pixels + count);
+	context.m_sampleIndices.assign(samples, samples + count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const int x = pixels[i] % m_settings.m_width;
+		const int y = pixels[i] / m_settings.m_width;
+		const glm::vec2 offset = jitter ? Sample2D(context, i, RT_DIMENSION_JITTER) : glm::vec2(0.5f);
+		cameraRays.Push(CameraRay(x + offset.x, y + offset.y), Color(1.f), i);
+		colors[i] = Color(0.f);
+	}
+
+	TraceCameraRays(startDepth, context, colors, features);
+}
+
+void RayTracer::TraceSurfaces(const int* pixels, int count, TraceContext& context, PixelSurface* surfaces)const
+{
+	Wavefront& wavefront = context.m_wavefront;
+	RayQueue& cameraRays = wavefront.m_rays;
+	cameraRays.Clear();
+
+	for (int i = 0; i < count; ++i)
+	{
+		const int x = pixels[i] % m_settings.m_width;
+		const int y = pixels[i] / m_settings.m_width;
+		cameraRays.Push(CameraRay(x + 0.5f, y + 0.5f), Color(1.f), i);
+	}
+
+	context.m_stats.m_rays[RT_RAY_PRIMARY] += count;
+	IntersectWave(wavefront, context.m_stats);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const HitInfo& hitInfo = wavefront.m_hitInfos[i];
+		const RTMaterial* material = hitInfo.m_material;
+		surfaces[i] = PixelSurface();
+		if (!wavefront.m_hits[i] || material->RefractsLight() || material->ReflectsLight()) continue;
+
+		// The path tracer sees the lights in front of the surfaces
+		float lightDistance;
+		const Ray ray = cameraRays.GetRay(i);
+		if (m_settings.m_integrator == RT_PATH_TRACING && m_scene.IntersectLight(ray.m_origin, ray.m_direction, hitInfo.m_distanceHit, lightDistance) >= 0) continue;
+
+		surfaces[i].m_position = hitInfo.m_positionHit;
+		surfaces[i].m_normal = hitInfo.m_normalHit;
+		surfaces[i].m_valid = true;
+	}
+}
+
+void RayTracer::TraceCameraRays(int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	const int numPixels = context.m_wavefront.m_rays.Size();
+	context.m_stats.m_rays[RT_RAY_PRIMARY] += numPixels;
+
+	if (features)
+	{
+		for (int i = 0; i < numPixels; ++i) features[i].m_depth = features[i].m_albedo.r = -1.f;
+	}
+
+	if (m_settings.m_integrator == RT_PATH_TRACING)
+		TracePaths(startDepth, context, colors, features);
+	else
+		TraceWavefront(startDepth, context, colors, features);
+
+	// Paths ended before reaching a diffuse surface see no texture
+	if (features)
+	{
+		for (int i = 0; i < numPixels; ++i) RecordSurface(features, i, glm::vec3(0.f), Color(1.f));
+	}
+}
+
+void RayTracer::TraceWavefront(int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	Wavefront& wavefront = context.m_wavefront;
+	RTStats& stats = context.m_stats;
+
+	for (int depth = startDepth; wavefront.m_rays.Size() > 0; ++depth)
+	{
+		wavefront.m_nextRays.Clear();
+		wavefront.m_shadowRays.Clear();
+
+		CountWave(stats, depth - startDepth, wavefront.m_rays.Size());
+		TraceClock::time_point start = TraceClock::now();
+
+		IntersectWave(wavefront, stats);
+		EndPhase(stats, depth == startDepth ? RT_PHASE_PRIMARY : RT_PHASE_SECONDARY, start);
+		ShadeWave(depth, context, colors, features);
+		EndPhase(stats, RT_PHASE_SHADING, start);
+		TraceShadowRays(context, colors);
+		EndPhase(stats, RT_PHASE_SHADOW, start);
+
+		std::swap(wavefront.m_rays, wavefront.m_nextRays);
+	}
+}
+
+void RayTracer::IntersectWave(Wavefront& wavefront, RTStats& stats)const
+{
+	RayQueue& queue = wavefront.m_rays;
+	const int numRays = queue.Size();
+
+	// Like TraceRay the directions are normalized again, the far away sphere hits depend on the last bits
+	for (int i = 0; i < numRays; ++i)
+	{
+		const glm::vec3 direction = glm::normalize(glm::vec3(queue.m_dirX[i], queue.m_dirY[i], queue.m_dirZ[i]));
+		queue.m_dirX[i] = direction.x;
+		queue.m_dirY[i] = direction.y;
+		queue.m_dirZ[i] = direction.z;
+	}
+
+	wavefront.m_hitInfos.resize(numRays);
+	wavefront.m_hits.resize(numRays);
+
+	// Neighbouring rays of the queue are traced together as packets. The camera rays
+	// are coherent, the children of a wave keep the order of their parents.
+	Ray rays[RT_SIMD_WIDTH];
+	bool hits[RT_SIMD_WIDTH];
+
+	for (int first = 0; first < numRays; first += RT_SIMD_WIDTH)
+	{
+		const int packetSize = std::min(RT_SIMD_WIDTH, numRays - first);
+		for (int lane = 0; lane < packetSize; ++lane) rays[lane] = queue.GetRay(first + lane);
+
+		m_scene.IntersectPacket(rays, packetSize, &wavefront.m_hitInfos[first], hits, &stats);
+
+		for (int lane = 0; lane < packetSize; ++lane) wavefront.m_hits[first + lane] = hits[lane];
+	}
+}
+
+void RayTracer::ShadeWave(int depth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	Wavefront& wavefront = context.m_wavefront;
+	const RayQueue& queue = wavefront.m_rays;
+	wavefront.m_diffuseHits.clear();
+	wavefront.m_specularHits.clear();
+
+	// Background and emission are added right away, the rest is sorted by material
+	for (int i = 0; i < queue.Size(); ++i)
+	{
+		const int pixel = queue.m_pixel[i];
+
+		if (!wavefront.m_hits[i])
+		{
+			colors[pixel] += queue.Weight(i) * m_settings.m_backgroundColor;
+			RecordDepth(features, pixel, 0.f);
+			RecordSurface(features, pixel, glm::vec3(0.f), Color(1.f));
+			continue;
+		}
+
+		const HitInfo& hitInfo = wavefront.m_hitInfos[i];
+		const RTMaterial* material = hitInfo.m_material;
+		colors[pixel] += queue.Weight(i) * material->m_lightColor * material->m_emission;
+		RecordDepth(features, pixel, hitInfo.m_distanceHit);
+
+		if ((material->RefractsLight() || material->ReflectsLight()) && depth < m_settings.m_maxRayDepth)
+		{
+			wavefront.m_specularHits.push_back(i);
+			if (material->RefractsLight()) RecordSurface(features, pixel, hitInfo.m_normalHit, material->m_surfaceColor);
+		}
+		else
+		{
+			wavefront.m_diffuseHits.push_back(i);
+			RecordSurface(features, pixel, hitInfo.m_normalHit, material->m_surfaceColor);
+		}
+	}
+
+	// Diffuse surfaces queue a shadow ray towards each light they face, or the ones picked
+	const std::vector<Sphere>& spheres = m_scene.Spheres();
+	const std::vector<RTLight>& lights = m_scene.LightSampler().Lights();
+	const int numShadowRays = NumShadowRays();
+
+	const int lightDimension = BounceDimension(depth) + RT_BOUNCE_LIGHTS;
+
+	for (int i : wavefront.m_diffuseHits)
+	{
+		const HitInfo& hitInfo = wavefront.m_hitInfos[i];
+		const Color albedo = queue.Weight(i) * hitInfo.m_material->m_surfaceColor;
+		const glm::vec3 epsilon = hitInfo.m_normalHit * m_settings.m_epsilonFactor;
+		const glm::vec3 origin = hitInfo.m_positionHit + (hitInfo.m_isInside ? -epsilon : epsilon);
+
+		for (int s = 0; s < numShadowRays; ++s)
+		{
+			float share;
+			const int l = PickLight(s, hitInfo.m_positionHit, context, queue.m_pixel[i], lightDimension + s * RT_LIGHT_DIMENSIONS, share);
+			if (l < 0) continue;
+
+			const Sphere& light = spheres[lights[l].m_sphere];
+			const glm::vec3 direction = glm::normalize(light.getCenter() - hitInfo.m_positionHit);
+			const float cosine = glm::dot(hitInfo.m_normalHit, direction);
+			if (cosine <= 0.f) continue;
+
+			const Color contribution = albedo * cosine * light.getLightColor() * light.emissionFactor() * share;
+			wavefront.m_shadowRays.Push(origin, direction, glm::length(light.getCenter() - origin), lights[l].m_sphere, contribution, queue.m_pixel[i]);
+		}
+	}
+
+	// Mirrors and glass queue their children with their share of the blended color
+	for (int i : wavefront.m_specularHits)
+	{
+		const HitInfo& hitInfo = wavefront.m_hitInfos[i];
+		const RTMaterial* material = hitInfo.m_material;
+		const Ray ray = queue.GetRay(i);
+
+		const float fresnel = FresnelWeight(ray.m_direction, hitInfo.m_normalHit);
+		const Color tint = queue.Weight(i) * material->m_surfaceColor;
+
+		wavefront.m_nextRays.Push(CalcReflectionRay(ray, hitInfo), tint * fresnel, queue.m_pixel[i]);
+		++context.m_stats.m_rays[RT_RAY_REFLECTION];
+
+		if (material->RefractsLight() && material->m_transparency > 0.f)
+		{
+			++context.m_stats.m_rays[RT_RAY_REFRACTION];
+			wavefront.m_nextRays.Push(CalcRefractionRay(ray, hitInfo, material), tint * (1 - fresnel) * material->m_transparency, queue.m_pixel[i]);
+		}
+	}
+}
+
+void RayTracer::TraceShadowRays(TraceContext& context, Color* colors)const
+{
+	const ShadowQueue& queue = context.m_wavefront.m_shadowRays;
+	context.m_stats.m_rays[RT_RAY_SHADOW] += queue.Size();
+
+	for (int i = 0; i < queue.Size(); ++i)
+	{
+		const int light = queue.m_light[i];
+		if (!m_scene.Occluded(queue.Origin(i), queue.Direction(i), queue.m_maxDistance[i], &context.LastOccluder(light), &context.m_stats))
+		{
+			colors[queue.m_pixel[i]] += queue.Contribution(i);
+		}
+	}
+}
+
+void RayTracer::TracePaths(int startDepth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	Wavefront& wavefront = context.m_wavefront;
+	RTStats& stats = context.m_stats;
+
+	for (int depth = startDepth; wavefront.m_rays.Size() > 0; ++depth)
+	{
+		wavefront.m_nextRays.Clear();
+		wavefront.m_shadowRays.Clear();
+
+		CountWave(stats, depth - startDepth, wavefront.m_rays.Size());
+		TraceClock::time_point start = TraceClock::now();
+
+		IntersectWave(wavefront, stats);
+		EndPhase(stats, depth == startDepth ? RT_PHASE_PRIMARY : RT_PHASE_SECONDARY, start);
+		ShadePathWave(depth, context, colors, features);
+		EndPhase(stats, RT_PHASE_SHADING, start);
+		TraceShadowRays(context, colors);
+		EndPhase(stats, RT_PHASE_SHADOW, start);
+
+		std::swap(wavefront.m_rays, wavefront.m_nextRays);
+	}
+}
+
+void RayTracer::ShadePathWave(int depth, TraceContext& context, Color* colors, PixelFeatures* features)const
+{
+	Wavefront& wavefront = context.m_wavefront;
+	const RayQueue& queue = wavefront.m_rays;
+	const int dimension = BounceDimension(depth);
+
+	for (int i = 0; i < queue.Size(); ++i)
+	{
+		const Ray ray = queue.GetRay(i);
+		const int pixel = queue.m_pixel[i];
+		const HitInfo& hitInfo = wavefront.m_hitInfos[i];
+		const bool hit = wavefront.m_hits[i] != 0;
+
+		// The lights are not in the BVH, a ray that reaches one ends there
+		float lightDistance;
+		const int light = m_scene.IntersectLight(ray.m_origin, ray.m_direction, hit ? hitInfo.m_distanceHit : INFINITY, lightDistance);
+		if (light >= 0)
+		{
+			const float misWeight = m_settings.m_nextEventEstimation ? MISWeight(queue.m_pdf[i], LightPdf(light, ray.m_origin)) : 1.f;
+			colors[pixel] += queue.Weight(i) * LightRadiance(light) * misWeight;
+			RecordDepth(features, pixel, lightDistance);
+			RecordSurface(features, pixel, glm::vec3(0.f), Color(1.f));
+			continue;
+		}
+
+		if (!hit)
+		{
+			colors[pixel] += queue.Weight(i) * m_settings.m_backgroundColor;
+			RecordDepth(features, pixel, 0.f);
+			RecordSurface(features, pixel, glm::vec3(0.f), Color(1.f));
+			continue;
+		}
+
+		RecordDepth(features, pixel, hitInfo.m_distanceHit);
+
+		const RTMaterial* material = hitInfo.m_material;
+		const bool specular = material->RefractsLight() || material->ReflectsLight();
+		Color weight = queue.Weight(i);
+		Ray bounce;
+		RTRayType bounceType = RT_RAY_DIFFUSE;
+		float pdf = 0.f;
+
+		if (specular)
+		{
+			// Reflection or refraction picked with their share of the Whitted blend
+			const float reflectWeight = FresnelWeight(ray.m_direction, hitInfo.m_normalHit);
+			const float refractWeight = material->RefractsLight() ? (1.f - reflectWeight) * material->m_transparency : 0.f;
+			const float totalWeight = reflectWeight + refractWeight;
+
+			weight *= material->m_surfaceColor * totalWeight;
+			bounceType = Sample1D(context, pixel, dimension + RT_BOUNCE_SPECULAR) * totalWeight < reflectWeight ? RT_RAY_REFLECTION : RT_RAY_REFRACTION;
+			bounce = bounceType == RT_RAY_REFLECTION ? CalcReflectionRay(ray, hitInfo) : CalcRefractionRay(ray, hitInfo, material);
+
+			// What is seen through glass changes with the side picked, the denoiser sees the glass itself
+			if (material->RefractsLight()) RecordSurface(features, pixel, hitInfo.m_normalHit, material->m_surfaceColor);
+		}
+		else
+		{
+			const glm::vec3 epsilon = hitInfo.m_normalHit * m_settings.m_epsilonFactor;
+			const glm::vec3 origin = hitInfo.m_positionHit + (hitInfo.m_isInside ? -epsilon : epsilon);
+
+			RecordSurface(features, pixel, hitInfo.m_normalHit, material->m_surfaceColor);
+			if (m_settings.m_nextEventEstimation) SampleLights(hitInfo, origin, weight, pixel, dimension + RT_BOUNCE_LIGHTS, context);
+
+			// Cosine distributed bounce, the cosine and the density cancel out with the BRDF
+			glm::vec3 tangent, bitangent;
+			BuildBasis(hitInfo.m_normalHit, tangent, bitangent);
+
+			float cosine;
+			const glm::vec2 u = Sample2D(context, pixel, dimension + RT_BOUNCE_DIRECTION);
+			bounce = Ray(origin, SampleCosineHemisphere(u, hitInfo.m_normalHit, tangent, bitangent, &cosine));
+			weight *= material->m_surfaceColor;
+			pdf = cosine / PI;
+		}
+
+		if (depth + 1 > m_settings.m_maxRayDepth) continue;
+
+		// Paths that carry little light are stopped early, the others are weighted up
+		if (depth + 1 >= RT_PATH_ROULETTE_DEPTH)
+		{
+			const float survival = std::min(0.95f, std::max(weight.r, std::max(weight.g, weight.b)));
+			if (Sample1D(context, pixel, dimension + RT_BOUNCE_ROULETTE) >= survival)
+			{
+				++context.m_stats.m_rouletteStops;
+				continue;
+			}
+			weight /= survival;
+		}
+
+		wavefront.m_nextRays.Push(bounce, weight, pixel, pdf);
+		++context.m_stats.m_rays[bounceType];
+	}
+}
+
+void RayTracer::SampleLights(const HitInfo& hitInfo, const glm::vec3& origin, const Color& weight, int pixel, int dimension, TraceContext& context)const
+{
+	const std::vector<Sphere>& spheres = m_scene.Spheres();
+	const std::vector<RTLight>& lights = m_scene.LightSampler().Lights();
+	const Color brdf = hitInfo.m_material->m_surfaceColor / PI;
+	const int numShadowRays = NumShadowRays();
+
+	for (int s = 0; s < numShadowRays; ++s)
+	{
+		float share;
+		const int rayDimension = dimension + s * RT_LIGHT_DIMENSIONS;
+		const int l = PickLight(s, origin, context, pixel, rayDimension, share);
+		if (l < 0) continue;
+
+		const int light = lights[l].m_sphere;
+		const Sphere& sphere = spheres[light];
+		const glm::vec3 toCenter = sphere.getCenter() - origin;
+		const float distance2 = glm::dot(toCenter, toCenter);
+		const float radius2 = sphere.getRadius() * sphere.getRadius();
+		if (distance2 <= radius2) continue;
+
+		// Uniform direction in the cone of the sphere
+		const float cosMax = std::sqrt(1.f - radius2 / distance2);
+		const glm::vec2 u = Sample2D(context, pixel, rayDimension + RT_LIGHT_CONE);
+		const float cosTheta = 1.f - u.x * (1.f - cosMax);
+		const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+		const float phi = 2.f * PI * u.y;
+
+		const glm::vec3 axis = toCenter / std::sqrt(distance2);
+		glm::vec3 tangent, bitangent;
+		BuildBasis(axis, tangent, bitangent);
+		const glm::vec3 direction = glm::normalize(tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + axis * cosTheta);
+
+		const float cosine = glm::dot(hitInfo.m_normalHit, direction);
+		if (cosine <= 0.f) continue;
+
+		const float lightDistance = RTScene::HitDistance(sphere, origin, direction);
+		if (lightDistance == INFINITY) continue;
+
+		// A light picked at random is as likely as all its rays together, share is one over their number
+		const float lightPdf = 1.f / (2.f * PI * (1.f - cosMax));
+		const float misWeight = MISWeight(lightPdf / share, cosine / PI);
+		const Color contribution = weight * brdf * LightRadiance(light) * (cosine * misWeight / lightPdf) * share;
+
+		context.m_wavefront.m_shadowRays.Push(origin, direction, lightDistance, light, contribution, pixel);
+	}
+}
+
+Color RayTracer::LightRadiance(int light)const
+{
+	const Sphere& sphere = m_scene.Spheres()[light];
+	return sphere.getLightColor() * sphere.emissionFactor() * RT_PATH_LIGHT_RADIANCE_SCALE;
+}
+
+float RayTracer::LightPdf(int light, const glm::vec3& point)const
+{
+	// Density of the direction towards the light when sampling its cone from the point
+	const Sphere& sphere = m_scene.Spheres()[light];
+	const glm::vec3 toCenter = sphere.getCenter() - point;
+	const float sin2Max = sphere.getRadius() * sphere.getRadius() / glm::dot(toCenter, toCenter);
+	if (sin2Max >= 1.f) return 0.f;
+
+	const float conePdf = 1.f / (2.f * PI * (1.f - std::sqrt(1.f - sin2Max)));
+
+	// Picked lights get m_shadowRays chances to be chosen
+	const RTLightSampler& sampler = m_scene.LightSampler();
+	if (sampler.Size() <= m_settings.m_shadowRays) return conePdf;
+
+	return conePdf * m_settings.m_shadowRays * sampler.Pdf(LightSelection(), sampler.LightIndex(light), point);
+}
+
+RTLightSelection RayTracer::LightSelection()const
+{
+	return m_settings.m_integrator == RT_PATH_TRACING ? m_settings.m_lightSelection : RT_LIGHTS_POWER;
+}
+
+float RayTracer::Sample1D(const TraceContext& context, int pixel, int dimension)const
+{
+	const int imagePixel = context.m_samplePixels[pixel];
+	return m_sampler.Get1D(imagePixel % m_settings.m_width, imagePixel / m_settings.m_width, context.m_sampleIndices[pixel], dimension);
+}
+
+glm::vec2 RayTracer::Sample2D(const TraceContext& context, int pixel, int dimension)const
+{
+	const int imagePixel = context.m_samplePixels[pixel];
+	return m_sampler.Get2D(imagePixel % m_settings.m_width, imagePixel / m_settings.m_width, context.m_sampleIndices[pixel], dimension);
+}
+
+int RayTracer::BounceDimension(int depth)const
+{
+	return RT_DIMENSION_FIRST_BOUNCE + depth * (RT_BOUNCE_LIGHTS + RT_LIGHT_DIMENSIONS * m_settings.m_shadowRays);
+}
+
+int RayTracer::NumShadowRays()const
+{
+	return std::min(m_scene.LightSampler().Size(), m_settings.m_shadowRays);
+}
+
+int RayTracer::PickLight(int ray, const glm::vec3& point, TraceContext& context, int pixel, int dimension, float& share)const
+{
+	const RTLightSampler& sampler = m_scene.LightSampler();
+	share = 1.f;
+	if (sampler.Size() <= m_settings.m_shadowRays) return ray;
+
+	const float u = pixel < 0 ? context.m_random.NextFloat() : Sample1D(context, pixel, dimension);
+	float pdf;
+	const int light = sampler.Sample(LightSelection(), point, u, pdf);
+	if (light < 0) return -1;
+
+	share = 1.f / (m_settings.m_shadowRays * pdf);
+	return light;
+}
+
+float RayTracer::FresnelWeight(const glm::vec3& rayDir, const glm::vec3& normalHit)const
+{
+	const float facingRatio = -glm::dot(rayDir, normalHit);
+	return 0.5f + pow(1 - facingRatio, 3) * 0.5;
+}
+
+Color RayTracer::BlendReflRefrColors(const RTMaterial* material, const glm::vec3 &raydir, const glm::vec3 &normalHit, const Color &reflColor, const Color &refrColor)const
+{
+	const float fresnel = FresnelWeight(raydir, normalHit);
+
+	Color blendColor = (reflColor * fresnel + refrColor * (1 - fresnel) * material->m_transparency) * material->m_surfaceColor;
+	return blendColor;
+}
+
+Ray RayTracer::CalcReflectionRay(const Ray & ray, const HitInfo & hitInfo)const
+{
+	Ray reflection;
+
+	reflection.m_direction = glm::normalize(glm::reflect(ray.m_direction, hitInfo.m_normalHit));
+
+	glm::vec3 epsilon = hitInfo.m_normalHit * m_settings.m_epsilonFactor;
+	reflection.m_origin = hitInfo.m_positionHit + epsilon; // (hitInfo.m_isInside ? -epsilon : epsilon);
+
+	return reflection;
+}
+
+Ray RayTracer::CalcRefractionRay(const Ray & ray, const HitInfo & hitInfo, const RTMaterial * material)const
+{
+	Ray refraction;
+
+	float index = hitInfo.m_isInside ? material->m_refractionIndex : 1.f / material->m_refractionIndex;
+
+	refraction.m_direction = glm::normalize(glm::refract(ray.m_direction, hitInfo.m_normalHit, index));
+
+	glm::vec3 epsilon = hitInfo.m_normalHit * m_settings.m_epsilonFactor;
+	refraction.m_origin = hitInfo.m_positionHit + (hitInfo.m_isInside ? -epsilon : epsilon);
+
+	return refraction;
+}
+
+Color RayTracer::CalcDiffuseColor(const HitInfo& hitInfo, const RTMaterial* material, TraceContext& context)const
+{
+	Color diffuse(0.f);
+
+	const std::vector<Sphere>& spheres = m_scene.Spheres();
+	const std::vector<RTLight>& lights = m_scene.LightSampler().Lights();
+	const int numShadowRays = NumShadowRays();
+
+	for (int s = 0; s < numShadowRays; ++s)
+	{
+		float share;
+		const int picked = PickLight(s, hitInfo.m_positionHit, context, -1, 0, share);
+		const int l = picked < 0 ? -1 : lights[picked].m_sphere;
+
+		if (l >= 0)
+		{
+			const Sphere* light = &spheres[l];
+
+			Ray shadowRay;
+			shadowRay.m_direction = glm::normalize(light->getCenter() - hitInfo.m_positionHit);
+			const glm::vec3 epsilon = hitInfo.m_normalHit * m_settings.m_epsilonFactor;
+			shadowRay.m_origin = hitInfo.m_positionHit + (hitInfo.m_isInside ? -epsilon : epsilon);
+
+			// Only what lies between the point and the light can shadow it
+			const float lightDistance = glm::length(light->getCenter() - shadowRay.m_origin);
+			const bool occluded = m_scene.Occluded(shadowRay.m_origin, shadowRay.m_direction, lightDistance, &context.LastOccluder(l), &context.m_stats);
+			++context.m_stats.m_rays[RT_RAY_SHADOW];
+			const float invShadow = occluded ? 0.f : 1.f;
+
+			diffuse += material->m_surfaceColor * invShadow * std::max(0.f, glm::dot(hitInfo.m_normalHit, shadowRay.m_direction)) * light->getLightColor() * light->emissionFactor() * share;
+		}
+	}
+
+	return diffuse;
+}
@@ -1,16 +1,26 @@
 #include "Files/RT/headers/raytracingwindow.h"
+#include "Files/RT/headers/rtimage.h"
 #include "Files/mainwindow.h"
 #include <QDesktopWidget>
 #include <QApplication>
 #include <QFileDialog>
 #include <QMessageBox>
-#include <QImage>
+#include <QGraphicsPixmapItem>
+#include <QKeyEvent>
+#include <QMouseEvent>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
+// Time between two refreshes of the view and the progress bar while rendering
+#define RT_REFRESH_INTERVAL_MS 66
 
-RayTracingWindow::RayTracingWindow(MainWindow* mw) : AbstractWindow(mw)
+// Step of the camera for a key press, in scene units, and turn for a pixel of mouse drag, in degrees
+#define RT_CAMERA_MOVE_SPEED 0.5f
+#define RT_CAMERA_MOUSE_SENSITIVITY 0.25f
+
+RayTracingWindow::RayTracingWindow(MainWindow* mw) : AbstractWindow(mw), m_viewScene(nullptr), m_imageItem(nullptr)
 {
 	m_ui.setupUi(this);
 
@@ -26,17 +36,46 @@ RayTracingWindow::RayTracingWindow(MainWindow* mw) : AbstractWindow(mw)
 
 	m_maxRayDepth = MAX_RAY_DEPTH;
 
+	m_shownVersion = 0;
+
 	m_ui.maxRayDepthSpinBox->setValue(m_maxRayDepth);
 
+	// Models that can be traced instead of the spheres of the scene
+	m_ui.qSceneComboBox->addItem(QString("Spheres"));
+	m_ui.qSceneComboBox->addItem(QString("Patricio"), QString("./Files/SSAO/models/Patricio.obj"));
+	m_ui.qSceneComboBox->addItem(QString("Legoman"), QString("./Files/SSAO/models/legoman.obj"));
+	m_ui.qSceneComboBox->addItem(QString("Sponza"), QString("./Files/SSAO/models/sponza.obj"));
+	m_ui.qSceneComboBox->setCurrentIndex(0);
+
+	m_ui.qIntegratorComboBox->addItem(QString("Whitted"), int(RT_WHITTED));
+	m_ui.qIntegratorComboBox->addItem(QString("Path tracing"), int(RT_PATH_TRACING));
+	m_ui.qIntegratorComboBox->setCurrentIndex(0);
+
 	connect(m_ui.qUndockButton, SIGNAL(clicked()), this, SLOT(DockUndock()));
 	connect(m_ui.qRenderButton, SIGNAL(clicked()), this, SLOT(RaytraceScene()));
 	connect(this, SIGNAL(RenderingProgress(int)), m_ui.qProgressBar, SLOT(setValue(int)));
 	connect(m_ui.maxRayDepthSpinBox, SIGNAL(valueChanged(int)), this, SLOT(MaxRayDepthChanged(int)));
+	connect(m_ui.qSceneComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(SceneModelChanged(int)));
 	connect(m_ui.qRenderProgressCheckBox, SIGNAL(clicked(bool)), this, SLOT(ShowRenderProgressChanged(bool)));
 	connect(m_ui.qSaveToTexture, SIGNAL(clicked()), this, SLOT(OnSave()));
+	connect(m_ui.qCancelButton, SIGNAL(clicked()), this, SLOT(CancelRender()));
+	connect(m_ui.qSamplesSpinBox, SIGNAL(valueChanged(int)), this, SLOT(SamplesChanged(int)));
+	connect(m_ui.qAdaptiveCheckBox, SIGNAL(clicked(bool)), this, SLOT(AdaptiveChanged(bool)));
+	connect(m_ui.qIntegratorComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(IntegratorChanged(int)));
+	connect(m_ui.qDenoiseCheckBox, SIGNAL(clicked(bool)), this, SLOT(DenoiseChanged(bool)));
+	connect(m_ui.qFilmicCheckBox, SIGNAL(clicked(bool)), this, SLOT(ToneMapChanged(bool)));
+	connect(&m_refreshTimer, SIGNAL(timeout()), this, SLOT(RefreshRender()));
+
+	m_ui.qRayTracingView->setFocusPolicy(Qt::StrongFocus);
+	m_ui.qRayTracingView->installEventFilter(this);
+	m_ui.qRayTracingView->viewport()->installEventFilter(this);
 }
 
-RayTracingWindow::~RayTracingWindow(){ }
+RayTracingWindow::~RayTracingWindow()
+{
+	// The threads use the scene, stop them before it goes away
+	CancelRender();
+}
 
 void RayTracingWindow::DockUndock()
 {
@@ -74,313 +113,268 @@ void RayTracingWindow::DockUndock()
 
 void RayTracingWindow::InitGUI()
 {
-	QGraphicsScene *scene = new QGraphicsScene();
-	scene->clear();
-	scene->addText("(Empty)");
+	m_viewScene = new QGraphicsScene(this);
+	m_viewScene->addText("(Empty)");
 
 	m_ui.qRayTracingView->resetMatrix();
-	m_ui.qRayTracingView->setScene(scene);
-	m_ui.qRayTracingView->show();
-}
-
-void RayTracingWindow::RenderIntoTexture(glm::vec3* image, int width, int height)
-{
-	QImage img(width, height, QImage::Format_ARGB32);
-
-	int id_img = 0;
-	for (unsigned j = 0; j < height; ++j) {
-		for (unsigned i = 0; i < width; ++i) {
-			QColor col(MIN(255, image[id_img].x * 255),
-				MIN(255, image[id_img].y * 255),
-				MIN(255, image[id_img].z * 255));
-			img.setPixelColor(i, j, col);
-			id_img++;
-		}
-	}
-
-	QGraphicsScene* imgView = new QGraphicsScene();
-	imgView->addPixmap(QPixmap::fromImage(img));
-	m_ui.qRayTracingView->setScene(imgView);
+	m_ui.qRayTracingView->setScene(m_viewScene);
 	m_ui.qRayTracingView->show();
 }
 
-void RayTracingWindow::ClearImage(glm::vec3* image, int width, int height)
+void RayTracingWindow::RenderIntoTexture(const Color* image, int width, int height)
 {
-	glm::vec3* pixel = image;
-	for (int x = 0; x < width; ++x)
+	if (m_framebuffer.width() != width || m_framebuffer.height() != height)
 	{
-		for (int y = 0; y < height; ++y, ++pixel)
-		{
-			*pixel = m_backgroundColor;
-		}
+		m_framebuffer = QImage(width, height, QImage::Format_RGB32);
 	}
 
-	RenderIntoTexture(image, m_width, m_height);
-}
-
-Color RayTracingWindow::TraceRay(Ray& ray, const int &depth)const
-{
-	ray.m_direction = glm::normalize(ray.m_direction);
-
-	Sphere* sphere = nullptr;
-	float minDist = INFINITY;
-	HitInfo closestHitInfo;
-
-	for(int i = 0; i < m_spheres.size(); ++i)
+	const RTToneMap toneMap = m_ui.qFilmicCheckBox->isChecked() ? RT_TONEMAP_FILMIC : RT_TONEMAP_CLAMP;
+	for (int y = 0; y < height; ++y)
 	{
-		const Sphere* it = &m_spheres[i];
-
-		if(!it->isLight())
-		{
-			if (Intersection(*it, ray, closestHitInfo))
-			{
-				// Calc the distance
-				if (closestHitInfo.m_distanceHit < minDist)
-				{
-					// Assign the closer sphere
-					sphere = (Sphere*)it;
-					minDist = closestHitInfo.m_distanceHit;
-				}
-			}
-		}
+		ColorsToRGB32(image + y * width, width, (uint32_t*)m_framebuffer.scanLine(y), toneMap);
 	}
 
-	if(!sphere)
+	// The first image replaces the placeholder text
+	if (!m_imageItem)
 	{
-		// If no collision take the background color
-		return m_backgroundColor;
+		m_viewScene->clear();
+		m_imageItem = m_viewScene->addPixmap(QPixmap::fromImage(m_framebuffer));
 	}
-
-	/*if (sphere->isLight())
+	else
 	{
-		// If the closest intersection is a light return its color
-		return sphere->getLightColor(); // *sphere->emissionFactor();
-	}*/
-
-	// ---------------------------------------
+		m_imageItem->setPixmap(QPixmap::fromImage(m_framebuffer));
+	}
+	m_viewScene->setSceneRect(0, 0, width, height);
+}
 
-	Color colorRay(0.f);
+bool RayTracingWindow::IsRendering() const
+{
+	return m_renderJob && !m_renderJob->IsFinished();
+}
 
-	if((sphere->refractsLight() || sphere->reflectsLight()) && depth < m_maxRayDepth)
-	{
-		// Reflection
-		Ray reflectRay = CalcReflectionRay(ray, closestHitInfo);
+void RayTracingWindow::StartRender()
+{
+	CancelRender();
 
-		const Color reflColor = TraceRay(reflectRay, depth + 1);
+	m_width = m_ui.qRayTracingView->width() - 2;
+	m_height = m_ui.qRayTracingView->height() - 2;
 
+	RenderSettings settings;
+	settings.m_width = m_width;
+	settings.m_height = m_height;
+	settings.m_maxRayDepth = m_maxRayDepth;
+	settings.m_backgroundColor = m_backgroundColor;
+	settings.m_epsilonFactor = m_epsilonFactor;
+	// The progressive mode shows a preview and refines it, the other one traces a single sample
+	const bool progressive = m_ui.qProgressiveCheckBox->isChecked();
+	settings.m_samplesPerPixel = progressive ? m_ui.qSamplesSpinBox->value() : 1;
+	settings.m_preview = progressive;
+
+	// The samples become an average budget spent on the noisy pixels
+	settings.m_adaptive = progressive && m_ui.qAdaptiveCheckBox->isChecked();
+	settings.m_integrator = RTIntegrator(m_ui.qIntegratorComboBox->currentData().toInt());
+	settings.m_denoise = m_ui.qDenoiseCheckBox->isChecked();
+
+	// The frames after a camera move start from the pixels that still see the same surface
+	settings.m_camera = m_camera;
+	settings.m_temporalReuse = true;
+	m_cameraMoved = false;
+
+	m_ui.qStatsLabel->clear();
+	m_renderJob.reset(new RenderJob(m_scene, settings));
+	m_renderJob->Start();
+	m_shownVersion = 0;
+
+	emit RenderingProgress(0);
+	m_ui.qCancelButton->setEnabled(true);
+	m_refreshTimer.start(RT_REFRESH_INTERVAL_MS);
+}
 
-		// Refraction
-		Color refrColor(0.f);
+void RayTracingWindow::RefreshRender()
+{
+	if (!m_renderJob) return;
 
-		if (sphere->refractsLight())
-		{
-			// Calc refraction ray
-			Ray refractionRay = CalcRefractionRay(ray, closestHitInfo, sphere);
+	const bool finished = m_renderJob->IsFinished();
+	emit RenderingProgress((int)(m_renderJob->Progress() * 100.f));
 
-			refrColor = TraceRay(refractionRay, depth + 1);
-		}
+	// Without "Show progress" a single sample render is only shown once finished
+	const bool showImage = finished || m_renderJob->Settings().m_preview || m_renderProgress;
+	const unsigned int version = m_renderJob->Version();
 
-		colorRay = BlendReflRefrColors(sphere, ray.m_direction, closestHitInfo.m_normalHit, reflColor, refrColor);
-	}
-	else
+	if (showImage && version != m_shownVersion)
 	{
-		// Diffuse object
-
-		colorRay = CalcDiffuseColor(closestHitInfo, sphere);
+		m_shownVersion = version;
+		m_renderJob->CopyImage(m_image);
+		RenderIntoTexture(m_image.data(), m_width, m_height);
 	}
 
+	if (finished)
+	{
+		m_refreshTimer.stop();
+		m_ui.qCancelButton->setEnabled(false);
+
+		const RTStats stats = m_renderJob->Stats();
+		const double seconds = m_renderJob->ElapsedSeconds();
+		QString summary = QString::fromStdString(stats.Summary(seconds));
+		if (m_renderJob->ReusedPixels() > 0) summary += QString("\nReused pixels %1").arg(m_renderJob->ReusedPixels());
+		m_ui.qStatsLabel->setText(summary);
+		std::cout << stats.ToJSON(seconds) << std::flush;
+	}
 
-	return colorRay + sphere->getLightColor() * sphere->emissionFactor(); 
+	// Once the whole view shows the current camera, the next move can be traced
+	if (m_cameraMoved && !m_renderJob->IsCancelled() && (finished || m_renderJob->FirstPassDone())) RestartFromCamera();
 }
 
-void RayTracingWindow::Render()
+void RayTracingWindow::CancelRender()
 {
-	m_width = m_ui.qRayTracingView->width() - 2;
-	m_height = m_ui.qRayTracingView->height() - 2;
-	
-	glm::vec3 *image = new glm::vec3[m_width * m_height], *pixel = image;
-	
-	ClearImage(image, m_width, m_height);
-
-	float invWidth = 1 / float(m_width), invHeight = 1 / float(m_height);
-	float fov = 30, aspectratio = m_width / float(m_height);
-	float angle = tan(PI * 0.5 * fov / 180.);
-	
-	int progress = 0;
-	int numPixels = m_width * m_height;
-	
-	int nextPercentageToRender = 10, incrementPercentage = 10;
-	// Trace rays
-	for (unsigned y = 0; y < m_height; ++y) 
-	{
-		for (unsigned x = 0; x < m_width; ++x, ++pixel) 
-		{
-			float xx = (2 * ((x + 0.5) * invWidth) - 1) * angle * aspectratio;
-			float yy = (1 - 2 * ((y + 0.5) * invHeight)) * angle;
-			glm::vec3 rayDir(xx, yy, -1);
-			rayDir = glm::normalize(rayDir);
-			glm::vec3 rayOrig(0.0f, 0.0f, 0.0f);
-
-			Ray ray(rayOrig, rayDir);
-			*pixel = TraceRay(ray, 0);// / Color(m_maxRayDepth);
-			
-			progress++;
-
-			int percentage = (int)(float)progress / (float)numPixels * 100;
-			emit RenderingProgress(percentage);
-
-			if(m_renderProgress && percentage >= nextPercentageToRender)
-			{
-				// Each 10% render the image
-				RenderIntoTexture(image, m_width, m_height);
-				nextPercentageToRender += incrementPercentage;
-			}
-		}
-	}
+	if (!m_renderJob) return;
 
-	if(!m_renderProgress) RenderIntoTexture(image, m_width, m_height);
+	m_renderJob->Cancel();
 
-	delete[] image;
+	// Show what was rendered so far
+	RefreshRender();
 }
 
-void RayTracingWindow::RaytraceScene() 
+void RayTracingWindow::CameraChanged()
 {
-	m_spheres.clear();
-	//m_lights.clear();
-
-	// Lights
-	m_spheres.push_back(Sphere(glm::vec3(10.0f, 20.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
-	m_spheres.push_back(Sphere(glm::vec3(-10.0f, 20.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
-	m_spheres.push_back(Sphere(glm::vec3(0.0f, 10.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
-
-	// Spheres of the scene
-	m_spheres.push_back(Sphere(glm::vec3(0.0, -10004, -30), 10000, glm::vec3(0.0f, 0.2f, 0.5f), false, 0.0, 0.0));
-	m_spheres.push_back(Sphere(glm::vec3(0.0f, 0.0f, -20.0f), 2, glm::vec3(1.0f, 1.0f, 1.0f), true, 0.9f, 1.1f));
-	m_spheres.push_back(Sphere(glm::vec3(4.0f, 0.0f, -32.5f), 4, glm::vec3(0.0f, 0.5f, 0.0f), true, 0.0f, 0.0f));
-	m_spheres.push_back(Sphere(glm::vec3(-5.0f, 0.0f, -35.0f), 3, glm::vec3(0.5f, 0.5f, 0.5f), true, 0.0f, 0.0f));
-	m_spheres.push_back(Sphere(glm::vec3(-4.5f, -1.0f, -19.0f), 1.5f, glm::vec3(0.5f, 0.1f, 0.0f), true, 0.0f, 0.0f));
-
-	Render();
-}
+	m_cameraMoved = true;
 
-void RayTracingWindow::MaxRayDepthChanged(int value)
-{
-	m_maxRayDepth = value;
+	// A running job picks the camera up from the refreshes
+	if (m_renderJob && m_renderJob->IsFinished()) RestartFromCamera();
 }
 
-void RayTracingWindow::ShowRenderProgressChanged(bool value)
+void RayTracingWindow::RestartFromCamera()
 {
-	m_renderProgress = value;
-}
+	m_cameraMoved = false;
 
-bool RayTracingWindow::Intersection(const Sphere &sphere, const Ray& ray, HitInfo& hitInfo)const
-{
+	m_renderJob->Cancel();
+	m_renderJob->SetCamera(m_camera);
+	m_renderJob->Start();
+	m_shownVersion = 0;
 
-	float inter0 = INFINITY;
-	float inter1 = INFINITY;
+	m_ui.qCancelButton->setEnabled(true);
+	m_refreshTimer.start(RT_REFRESH_INTERVAL_MS);
+}
 
-	if (sphere.intersect(ray.m_origin, ray.m_direction, inter0, inter1)) 
+bool RayTracingWindow::eventFilter(QObject* object, QEvent* event)
+{
+	if (event->type() == QEvent::KeyPress)
 	{
-		if (inter0 < 0)
-			inter0 = inter1;
-
-		hitInfo.m_distanceHit = inter0;
-		hitInfo.m_positionHit = ray.m_origin + ray.m_direction * inter0;
-		hitInfo.m_normalHit = hitInfo.m_positionHit - sphere.getCenter();
-		hitInfo.m_normalHit = glm::normalize(hitInfo.m_normalHit);
-
-		// If the normal and the view direction are not opposite to each other
-		// reverse the normal direction. That also means we are inside the sphere so set
-		// the inside bool to true.
-		hitInfo.m_isInside = false;
-		float dotProd = glm::dot(ray.m_direction, hitInfo.m_normalHit);
-		
-		if (dotProd > 0) {
-			hitInfo.m_normalHit = -hitInfo.m_normalHit;
-			hitInfo.m_isInside = true;
-		}
+		const float speed = RT_CAMERA_MOVE_SPEED;
 
-		hitInfo.m_colorHit = sphere.getSurfaceColor();
+		switch (static_cast<QKeyEvent*>(event)->key())
+		{
+		case Qt::Key_W: m_camera.Move(speed, 0.f, 0.f); break;
+		case Qt::Key_S: m_camera.Move(-speed, 0.f, 0.f); break;
+		case Qt::Key_A: m_camera.Move(0.f, -speed, 0.f); break;
+		case Qt::Key_D: m_camera.Move(0.f, speed, 0.f); break;
+		case Qt::Key_Q: m_camera.Move(0.f, 0.f, -speed); break;
+		case Qt::Key_E: m_camera.Move(0.f, 0.f, speed); break;
+		case Qt::Key_R: m_camera = RTCamera(); break;
+		default: return AbstractWindow::eventFilter(object, event);
+		}
 
+		CameraChanged();
 		return true;
 	}
-	else 
+
+	if (event->type() == QEvent::MouseButtonPress)
 	{
-		return false;
+		m_lastMousePos = static_cast<QMouseEvent*>(event)->pos();
 	}
+	else if (event->type() == QEvent::MouseMove)
+	{
+		const QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
+		if (mouseEvent->buttons() & Qt::LeftButton)
+		{
+			const QPoint offset = mouseEvent->pos() - m_lastMousePos;
+			m_camera.Turn(offset.x() * RT_CAMERA_MOUSE_SENSITIVITY, -offset.y() * RT_CAMERA_MOUSE_SENSITIVITY);
+			CameraChanged();
+		}
+		m_lastMousePos = mouseEvent->pos();
+	}
+
+	return AbstractWindow::eventFilter(object, event);
 }
 
-Color& RayTracingWindow::BlendReflRefrColors(const Sphere* sphere, const glm::vec3 &raydir, const glm::vec3 &normalHit, const Color &reflColor, const Color &refrColor)const
+void RayTracingWindow::RaytraceScene() 
 {
-	const float facingRatio = -glm::dot(raydir, normalHit);
-	const float fresnel = 0.5f + pow(1 - facingRatio, 3) * 0.5;
+	// The scene is about to change under the rendering threads
+	CancelRender();
 
-	Color blendColor = (reflColor * fresnel + refrColor * (1 - fresnel) * sphere->transparencyFactor()) * sphere->getSurfaceColor();
-	return blendColor;
-}
+	m_scene.Clear();
 
-Ray & RayTracingWindow::CalcReflectionRay(const Ray & ray, const HitInfo & hitInfo)const
-{
-	Ray reflection;
+	m_scene.LoadDefaultScene(m_modelFilename.isEmpty());
 
-	reflection.m_direction = glm::normalize(glm::reflect(ray.m_direction, hitInfo.m_normalHit));
+	if (!m_modelFilename.isEmpty())
+	{
+		AddSceneModel();
+	}
 
-	glm::vec3 epsilon = hitInfo.m_normalHit * m_epsilonFactor;
-	reflection.m_origin = hitInfo.m_positionHit + epsilon; // (hitInfo.m_isInside ? -epsilon : epsilon);
+	m_scene.BuildAccelerationStructure();
 
-	return reflection;
+	StartRender();
 }
 
-Ray & RayTracingWindow::CalcRefractionRay(const Ray & ray, const HitInfo & hitInfo, const Sphere * sphere)const
+void RayTracingWindow::MaxRayDepthChanged(int value)
 {
-	Ray refraction;
+	m_maxRayDepth = value;
 
-	float index = hitInfo.m_isInside ? sphere->getRefractionIndex() : 1.f / sphere->getRefractionIndex();
+	// Restart with the new depth, the scene did not change
+	if (IsRendering()) StartRender();
+}
 
-	refraction.m_direction = glm::normalize(glm::refract(ray.m_direction, hitInfo.m_normalHit, index));
+void RayTracingWindow::SamplesChanged(int)
+{
+	if (IsRendering()) StartRender();
+}
 
-	glm::vec3 epsilon = hitInfo.m_normalHit * m_epsilonFactor;
-	refraction.m_origin = hitInfo.m_positionHit + (hitInfo.m_isInside ? -epsilon : epsilon);
+void RayTracingWindow::AdaptiveChanged(bool)
+{
+	if (IsRendering()) StartRender();
+}
 
-	return refraction;
+void RayTracingWindow::IntegratorChanged(int)
+{
+	if (IsRendering()) StartRender();
 }
 
-Color& RayTracingWindow::CalcDiffuseColor(HitInfo& hitInfo, Sphere* sphere)const
+void RayTracingWindow::DenoiseChanged(bool)
 {
-	Color diffuse(0.f);
+	if (IsRendering()) StartRender();
+}
 
-	for (int l = 0; l < m_spheres.size(); ++l)
+void RayTracingWindow::ToneMapChanged(bool)
+{
+	// Only the conversion of the colors changes, the rendered image is shown again
+	if (!m_image.empty() && (int)m_image.size() == m_framebuffer.width() * m_framebuffer.height())
 	{
-		const Sphere* light = &m_spheres[l];
-
-		if(light->isLight())
-		{
-			Ray shadowRay;
-			shadowRay.m_direction = glm::normalize(light->getCenter() - hitInfo.m_positionHit);
-			const glm::vec3 epsilon = hitInfo.m_normalHit * m_epsilonFactor;
-			shadowRay.m_origin = hitInfo.m_positionHit + (hitInfo.m_isInside ? -epsilon : epsilon);
+		RenderIntoTexture(m_image.data(), m_framebuffer.width(), m_framebuffer.height());
+	}
+}
 
-			float invShadow = 1.f;
+void RayTracingWindow::SceneModelChanged(int index)
+{
+	m_modelFilename = m_ui.qSceneComboBox->itemData(index).toString();
 
-			for (int i = 0; i < m_spheres.size(); ++i)
-			{
-				if (!m_spheres[i].isLight())
-				{
-					HitInfo shadowHitInfo;
-
-					if (Intersection(m_spheres[i], shadowRay, shadowHitInfo))
-					{
-						invShadow = 0.f;
-						break;
-					}
-				}
-			}
+	if (IsRendering()) RaytraceScene();
+}
 
-			diffuse += sphere->getSurfaceColor() * invShadow * std::max(0.f, glm::dot(hitInfo.m_normalHit, shadowRay.m_direction)) * light->getLightColor() * light->emissionFactor();
-		}
+void RayTracingWindow::AddSceneModel()
+{
+	if (m_loadedModelFilename != m_modelFilename)
+	{
+		std::cout << "--- Loading model: " << m_modelFilename.toStdString() << std::endl;
+		m_model.load(m_modelFilename.toStdString());
+		m_loadedModelFilename = m_modelFilename;
 	}
 
-	return diffuse;
+	m_scene.AddModelOnFloor(m_model);
+}
+
+void RayTracingWindow::ShowRenderProgressChanged(bool value)
+{
+	m_renderProgress = value;
 }
 
 void RayTracingWindow::OnSave()
@@ -0,0 +1,730 @@
+#include "Files/RT/headers/renderjob.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The preview traces one ray for each block of RT_PREVIEW_PIXEL_STEP x RT_PREVIEW_PIXEL_STEP pixels
+#define RT_PREVIEW_PIXEL_STEP 4
+
+// Adaptive sampling works on square tiles, all the pixels get RT_ADAPTIVE_MIN_SAMPLES
+// samples first. A pixel never gets more than RT_ADAPTIVE_MAX_SAMPLES_FACTOR times
+// the average budget. The bias keeps the relative error of dark pixels sane.
+#define RT_ADAPTIVE_TILE_SIZE 16
+#define RT_ADAPTIVE_MIN_SAMPLES 4
+#define RT_ADAPTIVE_MAX_SAMPLES_FACTOR 8
+#define RT_ADAPTIVE_LUMINANCE_BIAS 0.1f
+
+// A pixel reuses the previous frame when the four pixels around its surface there saw the same
+// plane: normals this close and points this close to the plane, relative to their distance.
+// The reused samples are capped so new ones still count once the view changed.
+#define RT_REUSE_MIN_NORMAL_COSINE 0.95f
+#define RT_REUSE_PLANE_TOLERANCE 0.01f
+#define RT_REUSE_MAX_SAMPLES 256
+
+RenderJob::RenderJob(const RTScene& scene, const RenderSettings& settings) :
+	m_tracer(scene, settings), m_nextItem(0), m_itemsDone(0), m_runningThreads(0), m_renderingThreads(0), m_cancel(false), m_version(0),
+	m_frame(0), m_quit(false), m_samplesTraced(0), m_firstPassRows(0), m_elapsedSeconds(0.0), m_reproject(false), m_reusedPixels(0),
+	m_tilesX(0), m_tilesY(0), m_sampleBudget(0), m_nextTile(0), m_tilesDone(0), m_scheduleDone(false)
+{
+	const int width = settings.m_width, height = settings.m_height;
+	const int samples = std::max(1, settings.m_samplesPerPixel);
+
+	if (settings.m_adaptive)
+	{
+		m_tilesX = (width + RT_ADAPTIVE_TILE_SIZE - 1) / RT_ADAPTIVE_TILE_SIZE;
+		m_tilesY = (height + RT_ADAPTIVE_TILE_SIZE - 1) / RT_ADAPTIVE_TILE_SIZE;
+		m_sampleBudget = (long long)samples * width * height;
+	}
+
+	ResetFrame();
+}
+
+RenderJob::~RenderJob()
+{
+	Cancel();
+
+	{
+		std::lock_guard<std::mutex> lock(m_frameMutex);
+		m_quit = true;
+	}
+	m_frameCondition.notify_all();
+
+	for (size_t t = 0; t < m_threads.size(); ++t) m_threads[t].join();
+}
+
+void RenderJob::ResetFrame()
+{
+	const RenderSettings& settings = m_tracer.Settings();
+	const int width = settings.m_width, height = settings.m_height;
+
+	// The samples of the previous frame are kept to be reprojected
+	m_reproject = TemporalReuse() && !m_surfaces.empty();
+	if (m_reproject)
+	{
+		m_previousSamples.resize(width * height);
+		for (int pixel = 0; pixel < width * height; ++pixel) m_previousSamples[pixel] = PixelSamples(pixel);
+
+		m_previousAccumulation.swap(m_accumulation);
+		m_previousLuminance2.swap(m_luminance2);
+		m_previousFeatureSums.swap(m_featureSums);
+		m_previousSurfaces.swap(m_surfaces);
+		m_previousCamera = m_frameCamera;
+	}
+	m_frameCamera = settings.m_camera;
+
+	// The tiles replace the rows in adaptive sampling, there is no preview. A reprojected
+	// frame already has something better to show than the preview.
+	const bool preview = settings.m_preview && !settings.m_adaptive && !m_reproject;
+	m_numPreviewItems = preview ? (height + RT_PREVIEW_PIXEL_STEP - 1) / RT_PREVIEW_PIXEL_STEP : 0;
+	m_numItems = settings.m_adaptive ? 0 : m_numPreviewItems + std::max(1, settings.m_samplesPerPixel) * height;
+
+	// The buffers keep their memory from one frame to the next
+	m_nextItem = 0;
+	m_itemsDone = 0;
+	m_samplesTraced = 0;
+	m_firstPassRows = 0;
+	m_reusedPixels = 0;
+
+	m_image.assign(width * height, settings.m_backgroundColor);
+	m_accumulation.assign(width * height, Color(0.f));
+	m_rowSamples.assign(height, 0);
+
+	// The adaptive sampling and the denoiser both need the noise of the pixels
+	if (settings.m_adaptive || settings.m_denoise) m_luminance2.assign(width * height, 0.f);
+	if (settings.m_denoise) m_featureSums.assign(width * height, PixelFeatures());
+
+	if (TemporalReuse())
+	{
+		m_surfaces.assign(width * height, PixelSurface());
+		m_baseSamples.assign(width * height, 0);
+	}
+
+	if (settings.m_adaptive)
+	{
+		m_pixelSamples.assign(width * height, 0);
+		m_pixelActive.assign(width * height, 1);
+
+		// The first round gives every pixel enough samples to estimate its error
+		const TileWork firstWork = { 0, std::min(std::max(1, settings.m_samplesPerPixel), RT_ADAPTIVE_MIN_SAMPLES) };
+		m_round.assign(m_tilesX * m_tilesY, firstWork);
+		for (size_t tile = 0; tile < m_round.size(); ++tile) m_round[tile].m_tile = (int)tile;
+
+		m_nextTile = 0;
+		m_tilesDone = 0;
+		m_scheduleDone = false;
+	}
+
+	m_stats.Clear();
+	m_elapsedSeconds = 0.0;
+}
+
+void RenderJob::Start()
+{
+	const RenderSettings& settings = m_tracer.Settings();
+	if (settings.m_width <= 0 || settings.m_height <= 0) return;
+
+	int numThreads = settings.m_numThreads;
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// The threads are idle between two frames, nothing else touches the buffers
+	if (m_frame > 0) ResetFrame();
+	m_cancel = false;
+	m_startTime = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(m_frameMutex);
+
+		if (!m_threads.empty()) numThreads = (int)m_threads.size();
+		m_runningThreads = numThreads;
+		m_renderingThreads = numThreads;
+		m_frame++;
+
+		for (int t = (int)m_threads.size(); t < numThreads; ++t)
+		{
+			m_threads.push_back(std::thread(&RenderJob::RenderThread, this, t));
+		}
+	}
+	m_frameCondition.notify_all();
+}
+
+void RenderJob::Cancel()
+{
+	m_cancel = true;
+
+	// Wake up the threads waiting for the next adaptive round
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+	}
+	m_roundCondition.notify_all();
+
+	Wait();
+}
+
+void RenderJob::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_frameMutex);
+	m_frameCondition.wait(lock, [this]() { return m_runningThreads == 0; });
+}
+
+float RenderJob::Progress() const
+{
+	// Adaptive renders usually stop before spending their whole budget
+	if (m_tracer.Settings().m_adaptive)
+	{
+		return m_scheduleDone ? 1.f : std::min(1.f, (float)m_samplesTraced / m_sampleBudget);
+	}
+
+	return m_numItems > 0 ? (float)m_itemsDone / m_numItems : 1.f;
+}
+
+int RenderJob::SamplesDone() const
+{
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+
+	const std::vector<int>& samples = m_tracer.Settings().m_adaptive ? m_pixelSamples : m_rowSamples;
+	return samples.empty() ? 0 : *std::min_element(samples.begin(), samples.end());
+}
+
+void RenderJob::CopyImage(std::vector<Color>& image) const
+{
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+	image = m_image;
+}
+
+RTStats RenderJob::Stats() const
+{
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+	return m_stats;
+}
+
+double RenderJob::ElapsedSeconds() const
+{
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+	return m_elapsedSeconds;
+}
+
+void RenderJob::RenderThread(int threadIndex)
+{
+	const RenderSettings& settings = m_tracer.Settings();
+
+	// The samples do not depend on the thread that traces them, the seed only serves
+	// the recursive tracer. The context and the row buffers are kept from one frame to the next.
+	TraceContext context(threadIndex + 1);
+	std::vector<Color> colors(settings.m_width);
+	std::vector<PixelFeatures> features(settings.m_denoise ? settings.m_width : 0);
+	unsigned int frame = 0;
+
+	while (WaitForFrame(frame))
+	{
+		if (settings.m_adaptive)
+		{
+			RenderAdaptive(context);
+		}
+
+		while (!settings.m_adaptive && !m_cancel)
+		{
+			const int item = m_nextItem++;
+			if (item >= m_numItems) break;
+
+			if (item < m_numPreviewItems)
+			{
+				RenderPreviewRow(item * RT_PREVIEW_PIXEL_STEP, context, colors);
+			}
+			else
+			{
+				const int sampleItem = item - m_numPreviewItems;
+				RenderSampleRow(sampleItem % settings.m_height, sampleItem / settings.m_height, context, colors, features);
+			}
+
+			m_itemsDone++;
+		}
+
+		// The last thread done with the samples filters the image, the frame is finished after it
+		if (--m_renderingThreads == 0 && settings.m_denoise && !m_cancel) DenoiseImage();
+
+		FinishFrame(context);
+	}
+}
+
+bool RenderJob::WaitForFrame(unsigned int& frame)
+{
+	std::unique_lock<std::mutex> lock(m_frameMutex);
+	m_frameCondition.wait(lock, [&]() { return m_quit || m_frame != frame; });
+
+	frame = m_frame;
+	return !m_quit;
+}
+
+void RenderJob::FinishFrame(TraceContext& context)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_imageMutex);
+		m_stats.Add(context.m_stats);
+		m_elapsedSeconds = std::max(m_elapsedSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count());
+	}
+	context.m_stats.Clear();
+
+	std::lock_guard<std::mutex> lock(m_frameMutex);
+	if (--m_runningThreads == 0) m_frameCondition.notify_all();
+}
+
+void RenderJob::RenderPreviewRow(int y, TraceContext& context, std::vector<Color>& colors)
+{
+	const RenderSettings& settings = m_tracer.Settings();
+
+	// Cheap first pass: one ray per block of pixels and no reflections or refractions
+	m_tracer.TraceRow(y, RT_PREVIEW_PIXEL_STEP, 0, false, settings.m_maxRayDepth, context, colors.data());
+
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+
+	const int lastRow = std::min(y + RT_PREVIEW_PIXEL_STEP, settings.m_height);
+	for (int row = y; row < lastRow; ++row)
+	{
+		// Rows that already have real samples are better than the preview
+		if (m_rowSamples[row] > 0) continue;
+
+		Color* pixel = &m_image[row * settings.m_width];
+		for (int x = 0; x < settings.m_width; ++x)
+		{
+			pixel[x] = colors[x / RT_PREVIEW_PIXEL_STEP];
+		}
+	}
+
+	m_version++;
+}
+
+void RenderJob::RenderSampleRow(int y, int sample, TraceContext& context, std::vector<Color>& colors, std::vector<PixelFeatures>& features)
+{
+	if (TemporalReuse())
+	{
+		RenderTemporalRow(y, sample, context, colors, features);
+		return;
+	}
+
+	const RenderSettings& settings = m_tracer.Settings();
+	PixelFeatures* rowFeatures = settings.m_denoise ? features.data() : nullptr;
+
+	// Several samples are jittered inside the pixels, a single sample goes through their center
+	m_tracer.TraceRow(y, 1, sample, settings.m_samplesPerPixel > 1, 0, context, colors.data(), rowFeatures);
+
+	// The samples of a row are added in order so the sums come out the same with any number of
+	// threads. The previous sample was handed out first, its thread is already tracing it.
+	std::unique_lock<std::mutex> lock(m_imageMutex);
+	m_rowCondition.wait(lock, [&]() { return m_rowSamples[y] == sample; });
+
+	const float invSamples = 1.f / ++m_rowSamples[y];
+	Color* accumulation = &m_accumulation[y * settings.m_width];
+	Color* pixel = &m_image[y * settings.m_width];
+	for (int x = 0; x < settings.m_width; ++x)
+	{
+		accumulation[x] += colors[x];
+		pixel[x] = accumulation[x] * invSamples;
+	}
+
+	if (rowFeatures)
+	{
+		for (int x = 0; x < settings.m_width; ++x)
+		{
+			const float luminance = Luminance(colors[x]);
+			m_luminance2[y * settings.m_width + x] += luminance * luminance;
+			AccumulateFeatures(y * settings.m_width + x, rowFeatures[x]);
+		}
+	}
+
+	if (sample == 0) m_firstPassRows++;
+	m_samplesTraced += settings.m_width;
+	m_version++;
+	m_rowCondition.notify_all();
+}
+
+void RenderJob::RenderTemporalRow(int y, int sample, TraceContext& context, std::vector<Color>& colors, std::vector<PixelFeatures>& features)
+{
+	const RenderSettings& settings = m_tracer.Settings();
+	const int width = settings.m_width;
+	PixelFeatures* rowFeatures = settings.m_denoise ? features.data() : nullptr;
+
+	// Pixels traced with the index of their sample, and the pixel of the previous frame
+	// each pixel of the row starts from, -1 if it starts from nothing
+	std::vector<int> pixels(width), sampleIndices(width), previous(width, -1);
+	int numPixels = 0;
+
+	if (sample == 0)
+	{
+		// The surfaces are kept for the next frame and looked for in the previous one
+		for (int x = 0; x < width; ++x) pixels[x] = y * width + x;
+		m_tracer.TraceSurfaces(pixels.data(), width, context, &m_surfaces[y * width]);
+
+		for (int x = 0; x < width; ++x)
+		{
+			if (m_reproject) previous[x] = ReprojectPixel(m_surfaces[y * width + x]);
+			if (previous[x] >= 0) continue;
+
+			pixels[numPixels] = y * width + x;
+			sampleIndices[numPixels++] = 0;
+		}
+	}
+	else
+	{
+		// The next passes trace every pixel, the reused ones after their samples of the previous frame
+		std::unique_lock<std::mutex> lock(m_imageMutex);
+		m_rowCondition.wait(lock, [&]() { return m_rowSamples[y] > 0; });
+
+		for (int x = 0; x < width; ++x)
+		{
+			pixels[x] = y * width + x;
+			sampleIndices[x] = m_baseSamples[y * width + x] + sample;
+		}
+		numPixels = width;
+	}
+
+	m_tracer.TracePixels(pixels.data(), sampleIndices.data(), numPixels, settings.m_samplesPerPixel > 1, 0, context, colors.data(), rowFeatures);
+
+	std::unique_lock<std::mutex> lock(m_imageMutex);
+	m_rowCondition.wait(lock, [&]() { return m_rowSamples[y] == sample; });
+
+	for (int x = 0; x < width; ++x)
+	{
+		if (previous[x] >= 0) ReusePixel(y * width + x, previous[x]);
+	}
+
+	for (int i = 0; i < numPixels; ++i)
+	{
+		const int pixel = pixels[i];
+		m_accumulation[pixel] += colors[i];
+		if (!rowFeatures) continue;
+
+		const float luminance = Luminance(colors[i]);
+		m_luminance2[pixel] += luminance * luminance;
+		AccumulateFeatures(pixel, rowFeatures[i]);
+	}
+
+	++m_rowSamples[y];
+	for (int pixel = y * width; pixel < (y + 1) * width; ++pixel) m_image[pixel] = m_accumulation[pixel] / (float)PixelSamples(pixel);
+
+	if (sample == 0) m_firstPassRows++;
+	m_samplesTraced += numPixels;
+	m_version++;
+	m_rowCondition.notify_all();
+}
+
+int RenderJob::ReprojectPixel(const PixelSurface& surface) const
+{
+	const RenderSettings& settings = m_tracer.Settings();
+	const int width = settings.m_width, height = settings.m_height;
+
+	float x, y;
+	if (!surface.m_valid || !m_previousCamera.Project(surface.m_position, width, height, x, y)) return -1;
+
+	// The four pixels around the point must have seen the same surface, otherwise the point
+	// is at an edge or was hidden. Its samples are those of the closest one.
+	const int x0 = (int)std::floor(x - 0.5f), y0 = (int)std::floor(y - 0.5f);
+	if (x0 < 0 || y0 < 0 || x0 + 1 >= width || y0 + 1 >= height) return -1;
+
+	const float tolerance = RT_REUSE_PLANE_TOLERANCE * glm::length(surface.m_position - m_previousCamera.Position());
+	for (int py = y0; py <= y0 + 1; ++py)
+	{
+		for (int px = x0; px <= x0 + 1; ++px)
+		{
+			const int pixel = py * width + px;
+			const PixelSurface& previous = m_previousSurfaces[pixel];
+			if (!previous.m_valid || m_previousSamples[pixel] == 0) return -1;
+			if (glm::dot(previous.m_normal, surface.m_normal) < RT_REUSE_MIN_NORMAL_COSINE) return -1;
+			if (std::abs(glm::dot(previous.m_position - surface.m_position, surface.m_normal)) > tolerance) return -1;
+		}
+	}
+
+	return (int)y * width + (int)x;
+}
+
+void RenderJob::ReusePixel(int pixel, int previous)
+{
+	// The reused samples take the place of the first pass of the pixel
+	const int samples = std::min(m_previousSamples[previous], RT_REUSE_MAX_SAMPLES);
+	const float scale = (float)samples / m_previousSamples[previous];
+
+	m_accumulation[pixel] = m_previousAccumulation[previous] * scale;
+	if (!m_luminance2.empty()) m_luminance2[pixel] = m_previousLuminance2[previous] * scale;
+	if (!m_featureSums.empty())
+	{
+		m_featureSums[pixel].m_normal = m_previousFeatureSums[previous].m_normal * scale;
+		m_featureSums[pixel].m_albedo = m_previousFeatureSums[previous].m_albedo * scale;
+		m_featureSums[pixel].m_depth = m_previousFeatureSums[previous].m_depth * scale;
+	}
+
+	m_baseSamples[pixel] = samples - 1;
+	m_reusedPixels++;
+}
+
+int RenderJob::PixelSamples(int pixel) const
+{
+	const int rowSamples = m_rowSamples[pixel / m_tracer.Settings().m_width];
+	return m_baseSamples.empty() ? rowSamples : m_baseSamples[pixel] + rowSamples;
+}
+
+bool RenderJob::TemporalReuse() const
+{
+	return m_tracer.Settings().m_temporalReuse && !m_tracer.Settings().m_adaptive;
+}
+
+void RenderJob::RenderAdaptive(TraceContext& context)
+{
+	std::vector<Color> colors(RT_ADAPTIVE_TILE_SIZE * RT_ADAPTIVE_TILE_SIZE * 2);
+	std::vector<PixelFeatures> features(m_tracer.Settings().m_denoise ? RT_ADAPTIVE_TILE_SIZE * RT_ADAPTIVE_TILE_SIZE * 2 : 0);
+
+	TileWork work;
+	while (NextTile(work))
+	{
+		RenderTile(work, context, colors, features);
+		FinishTile();
+	}
+}
+
+void RenderJob::RenderTile(const TileWork& work, TraceContext& context, std::vector<Color>& colors, std::vector<PixelFeatures>& features)
+{
+	const RenderSettings& settings = m_tracer.Settings();
+
+	int x0, y0, x1, y1;
+	TileBounds(work.m_tile, x0, y0, x1, y1);
+
+	// Pixels of the tile picked for this round, the flags do not change during the round
+	int pixels[RT_ADAPTIVE_TILE_SIZE * RT_ADAPTIVE_TILE_SIZE];
+	int numPixels = 0;
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int x = x0; x < x1; ++x)
+		{
+			if (m_pixelActive[y * settings.m_width + x]) pixels[numPixels++] = y * settings.m_width + x;
+		}
+	}
+
+	// The samples are summed in the tile first, the image is only locked to add them
+	Color* sums = colors.data();
+	Color* sampleColors = sums + numPixels;
+	float luminance2[RT_ADAPTIVE_TILE_SIZE * RT_ADAPTIVE_TILE_SIZE];
+	std::fill(sums, sums + numPixels, Color(0.f));
+	std::fill(luminance2, luminance2 + numPixels, 0.f);
+
+	// Same for the features of the samples when the image is denoised
+	PixelFeatures* featureSums = settings.m_denoise ? features.data() : nullptr;
+	PixelFeatures* sampleFeatures = settings.m_denoise ? featureSums + numPixels : nullptr;
+	if (featureSums) std::fill(featureSums, featureSums + numPixels, PixelFeatures());
+
+	// Only this thread adds samples to the pixels of the tile, they can be read without the lock
+	int sampleIndices[RT_ADAPTIVE_TILE_SIZE * RT_ADAPTIVE_TILE_SIZE];
+	for (int i = 0; i < numPixels; ++i) sampleIndices[i] = m_pixelSamples[pixels[i]];
+
+	int samples = 0;
+	for (; samples < work.m_samples && !m_cancel; ++samples)
+	{
+		m_tracer.TracePixels(pixels, sampleIndices, numPixels, settings.m_samplesPerPixel > 1, 0, context, sampleColors, sampleFeatures);
+		for (int i = 0; i < numPixels; ++i) ++sampleIndices[i];
+
+		for (int i = 0; i < numPixels; ++i)
+		{
+			const float luminance = Luminance(sampleColors[i]);
+			sums[i] += sampleColors[i];
+			luminance2[i] += luminance * luminance;
+		}
+
+		for (int i = 0; featureSums && i < numPixels; ++i)
+		{
+			featureSums[i].m_normal += sampleFeatures[i].m_normal;
+			featureSums[i].m_albedo += sampleFeatures[i].m_albedo;
+			featureSums[i].m_depth += sampleFeatures[i].m_depth;
+		}
+	}
+
+	if (samples == 0) return;
+
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+
+	for (int i = 0; i < numPixels; ++i)
+	{
+		const int pixel = pixels[i];
+		m_accumulation[pixel] += sums[i];
+		m_luminance2[pixel] += luminance2[i];
+		m_pixelSamples[pixel] += samples;
+		m_image[pixel] = m_accumulation[pixel] / (float)m_pixelSamples[pixel];
+		if (featureSums) AccumulateFeatures(pixel, featureSums[i]);
+	}
+
+	m_samplesTraced += (long long)samples * numPixels;
+	m_version++;
+}
+
+void RenderJob::AccumulateFeatures(int pixel, const PixelFeatures& features)
+{
+	PixelFeatures& sum = m_featureSums[pixel];
+	sum.m_normal += features.m_normal;
+	sum.m_albedo += features.m_albedo;
+	sum.m_depth += features.m_depth;
+}
+
+void RenderJob::DenoiseImage()
+{
+	const RenderSettings& settings = m_tracer.Settings();
+	const int width = settings.m_width, height = settings.m_height;
+
+	// No thread writes to the image anymore, it is only locked to be replaced
+	std::vector<PixelFeatures> features(width * height);
+	std::vector<float> variances(width * height);
+	bool singleSamples = false;
+
+	for (int pixel = 0; pixel < width * height; ++pixel)
+	{
+		const int samples = settings.m_adaptive ? m_pixelSamples[pixel] : PixelSamples(pixel);
+		if (samples == 0) return;
+
+		const float invSamples = 1.f / samples;
+		features[pixel].m_normal = m_featureSums[pixel].m_normal * invSamples;
+		features[pixel].m_albedo = m_featureSums[pixel].m_albedo * invSamples;
+		features[pixel].m_depth = m_featureSums[pixel].m_depth * invSamples;
+
+		// Variance of the mean of the samples, the denoiser estimates it itself from single samples
+		const float sum = Luminance(m_accumulation[pixel]);
+		variances[pixel] = samples > 1 ? std::max(0.f, (m_luminance2[pixel] - sum * sum * invSamples) / (samples - 1)) * invSamples : 0.f;
+		singleSamples |= samples < 2;
+	}
+
+	std::vector<Color> denoised(width * height);
+	m_denoiser.Denoise(width, height, m_image.data(), features.data(), singleSamples ? nullptr : variances.data(), settings.m_numThreads, denoised.data());
+
+	std::lock_guard<std::mutex> lock(m_imageMutex);
+	m_image.swap(denoised);
+	m_version++;
+}
+
+bool RenderJob::NextTile(TileWork& work)
+{
+	std::unique_lock<std::mutex> lock(m_scheduleMutex);
+
+	while (!m_cancel && !m_scheduleDone)
+	{
+		if (m_nextTile < m_round.size())
+		{
+			work = m_round[m_nextTile++];
+			return true;
+		}
+
+		// The last tile of the round is done, the samples can go where they are needed
+		if (m_tilesDone == m_round.size())
+		{
+			if (!PlanNextRound())
+			{
+				m_scheduleDone = true;
+				m_roundCondition.notify_all();
+			}
+			continue;
+		}
+
+		m_roundCondition.wait(lock);
+	}
+
+	return false;
+}
+
+void RenderJob::FinishTile()
+{
+	std::lock_guard<std::mutex> lock(m_scheduleMutex);
+	if (++m_tilesDone == m_round.size()) m_roundCondition.notify_all();
+}
+
+bool RenderJob::PlanNextRound()
+{
+	const RenderSettings& settings = m_tracer.Settings();
+	const int width = settings.m_width, height = settings.m_height;
+	const int maxSamples = std::max(1, settings.m_samplesPerPixel) * RT_ADAPTIVE_MAX_SAMPLES_FACTOR;
+
+	// No tile is being rendered, the accumulation can be read without the image lock
+	std::vector<float> errors(width * height);
+	for (int pixel = 0; pixel < width * height; ++pixel) errors[pixel] = PixelError(pixel);
+
+	struct TileRequest
+	{
+		float m_error;
+		int m_tile, m_numPixels, m_samples;
+		bool operator<(const TileRequest& other) const { return m_error > other.m_error; }
+	};
+	std::vector<TileRequest> requests;
+
+	for (int tile = 0; tile < m_tilesX * m_tilesY; ++tile)
+	{
+		int x0, y0, x1, y1;
+		TileBounds(tile, x0, y0, x1, y1);
+
+		TileRequest request = { 0.f, tile, 0, maxSamples };
+		int mostSamples = 0;
+
+		for (int y = y0; y < y1; ++y)
+		{
+			for (int x = x0; x < x1; ++x)
+			{
+				const int pixel = y * width + x;
+
+				// An edge found by a pixel is likely to go through its neighbours too
+				float error = 0.f;
+				for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny)
+				{
+					for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx)
+					{
+						error = std::max(error, errors[ny * width + nx]);
+					}
+				}
+
+				m_pixelActive[pixel] = error > settings.m_adaptiveThreshold && m_pixelSamples[pixel] < maxSamples;
+				if (!m_pixelActive[pixel]) continue;
+
+				request.m_error = std::max(request.m_error, error);
+				request.m_numPixels++;
+				request.m_samples = std::min(request.m_samples, m_pixelSamples[pixel]);
+				mostSamples = std::max(mostSamples, m_pixelSamples[pixel]);
+			}
+		}
+
+		// Doubling the samples of a pixel divides its error by about 1.4
+		request.m_samples = std::min(request.m_samples, maxSamples - mostSamples);
+		if (request.m_numPixels > 0) requests.push_back(request);
+	}
+
+	// The noisiest tiles are served first in case the budget runs out
+	std::sort(requests.begin(), requests.end());
+
+	long long budgetLeft = m_sampleBudget - m_samplesTraced;
+	m_round.clear();
+
+	for (size_t i = 0; i < requests.size() && budgetLeft > 0; ++i)
+	{
+		const int samples = (int)std::min<long long>(requests[i].m_samples, budgetLeft / requests[i].m_numPixels);
+		if (samples <= 0) continue;
+
+		const TileWork work = { requests[i].m_tile, samples };
+		m_round.push_back(work);
+		budgetLeft -= (long long)samples * requests[i].m_numPixels;
+	}
+
+	m_nextTile = 0;
+	m_tilesDone = 0;
+
+	return !m_round.empty();
+}
+
+float RenderJob::PixelError(int pixel) const
+{
+	const int samples = m_pixelSamples[pixel];
+	if (samples < 2) return INFINITY;
+
+	// Relative standard error of the mean, estimated from the luminance
+	const float sum = Luminance(m_accumulation[pixel]);
+	const float mean = sum / samples;
+	const float variance = std::max(0.f, (m_luminance2[pixel] - sum * mean) / (samples - 1));
+
+	return std::sqrt(variance / samples) / (mean + RT_ADAPTIVE_LUMINANCE_BIAS);
+}
+
+void RenderJob::TileBounds(int tile, int& x0, int& y0, int& x1, int& y1) const
+{
+	x0 = (tile % m_tilesX) * RT_ADAPTIVE_TILE_SIZE;
+	y0 = (tile / m_tilesX) * RT_ADAPTIVE_TILE_SIZE;
+	x1 = std::min(x0 + RT_ADAPTIVE_TILE_SIZE, m_tracer.Settings().m_width);
+	y1 = std::min(y0 + RT_ADAPTIVE_TILE_SIZE, m_tracer.Settings().m_height);
+}
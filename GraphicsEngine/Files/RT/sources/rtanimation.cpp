@@ -0,0 +1,144 @@
+#include "Files/RT/headers/rtanimation.h"
+#include "Files/RT/headers/rtscene.h"
+#include "Files/definitions.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// Spheres at least this big stand for the ground, the turntable leaves them in place
+#define RT_ANIMATION_GROUND_RADIUS 1000.f
+
+// Keys of a turntable for a whole turn, the spheres move along the chords in between
+#define RT_TURNTABLE_KEYS 64
+
+void RTAnimation::AddKey(int sphere, const SphereKeyframe& key)
+{
+	std::vector<Track>::iterator track = std::find_if(m_tracks.begin(), m_tracks.end(), [sphere](const Track& t) { return t.m_sphere == sphere; });
+	if (track == m_tracks.end())
+	{
+		m_tracks.push_back(Track());
+		track = m_tracks.end() - 1;
+		track->m_sphere = sphere;
+	}
+
+	// The keys are kept sorted by time
+	std::vector<SphereKeyframe>& keys = track->m_keys;
+	keys.insert(std::upper_bound(keys.begin(), keys.end(), key, [](const SphereKeyframe& a, const SphereKeyframe& b) { return a.m_time < b.m_time; }), key);
+}
+
+float RTAnimation::Duration() const
+{
+	float duration = 0.f;
+	for (const Track& track : m_tracks) duration = std::max(duration, track.m_keys.back().m_time);
+	return duration;
+}
+
+bool RTAnimation::Load(const std::string& filename, std::string& error)
+{
+	Clear();
+
+	std::ifstream file(filename);
+	if (!file)
+	{
+		error = "cannot open " + filename;
+		return false;
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		std::istringstream fields(line);
+		SphereKeyframe key;
+		int sphere;
+		if (!(fields >> key.m_time >> sphere >> key.m_center.x >> key.m_center.y >> key.m_center.z >> key.m_radius) || sphere < 0 || key.m_radius <= 0.f)
+		{
+			std::ostringstream message;
+			message << filename << ":" << lineNumber << ": expected \"time sphere x y z radius\"";
+			error = message.str();
+			Clear();
+			return false;
+		}
+
+		AddKey(sphere, key);
+	}
+
+	return true;
+}
+
+RTAnimation RTAnimation::Turntable(const RTScene& scene, float duration)
+{
+	const std::vector<Sphere>& spheres = scene.Spheres();
+
+	std::vector<int> turning;
+	glm::vec3 pivot(0.f);
+	for (int i = 0; i < (int)spheres.size(); ++i)
+	{
+		if (spheres[i].isLight() || spheres[i].getRadius() >= RT_ANIMATION_GROUND_RADIUS) continue;
+
+		turning.push_back(i);
+		pivot += spheres[i].getCenter();
+	}
+
+	RTAnimation animation;
+	if (turning.empty()) return animation;
+	pivot /= (float)turning.size();
+
+	for (int i : turning)
+	{
+		const glm::vec3 offset = spheres[i].getCenter() - pivot;
+
+		for (int k = 0; k <= RT_TURNTABLE_KEYS; ++k)
+		{
+			const float fraction = (float)k / RT_TURNTABLE_KEYS;
+			const float angle = 2.f * PI * fraction;
+			const float c = std::cos(angle), s = std::sin(angle);
+
+			SphereKeyframe key;
+			key.m_time = duration * fraction;
+			key.m_center = pivot + glm::vec3(c * offset.x + s * offset.z, offset.y, c * offset.z - s * offset.x);
+			key.m_radius = spheres[i].getRadius();
+			animation.AddKey(i, key);
+		}
+	}
+
+	return animation;
+}
+
+bool RTAnimation::Apply(RTScene& scene, float time) const
+{
+	const std::vector<Sphere>& spheres = scene.Spheres();
+
+	for (const Track& track : m_tracks)
+	{
+		if (track.m_sphere >= (int)spheres.size()) return false;
+
+		const std::vector<SphereKeyframe>& keys = track.m_keys;
+		std::vector<SphereKeyframe>::const_iterator next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const SphereKeyframe& key) { return t < key.m_time; });
+
+		glm::vec3 center;
+		float radius;
+		if (next == keys.begin() || next == keys.end())
+		{
+			const SphereKeyframe& key = next == keys.begin() ? keys.front() : keys.back();
+			center = key.m_center;
+			radius = key.m_radius;
+		}
+		else
+		{
+			const SphereKeyframe& previous = *(next - 1);
+			const float t = (time - previous.m_time) / (next->m_time - previous.m_time);
+			center = glm::mix(previous.m_center, next->m_center, t);
+			radius = glm::mix(previous.m_radius, next->m_radius, t);
+		}
+
+		const Sphere& sphere = spheres[track.m_sphere];
+		scene.SetSphere(track.m_sphere, Sphere(center, radius, sphere.getSurfaceColor(), sphere.reflectsLight(), sphere.transparencyFactor(),
+			sphere.getRefractionIndex(), sphere.emissionFactor(), sphere.getLightColor()));
+	}
+
+	return true;
+}
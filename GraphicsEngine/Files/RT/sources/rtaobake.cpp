@@ -0,0 +1,236 @@
+#include "Files/RT/headers/rtaobake.h"
+#include "Files/RT/headers/rtsampler.h"
+#include "Files/RT/headers/rtscene.h"
+#include "Files/RT/headers/rtstream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <thread>
+#include <utility>
+
+#define RT_AO_CACHE_MAGIC 0x4f415452 // "RTAO"
+#define RT_AO_CACHE_VERSION 2
+#define RT_AO_BAKE_CHUNK 64 // Vertices a thread takes at a time
+#define RT_AO_RADIUS_FACTOR 0.1f // Default radius, relative to the size of the model
+
+static glm::vec3 ModelVertex(const Model& model, int index)
+{
+	const std::vector<Vertex>& vertices = model.vertices();
+	return glm::vec3((float)vertices[index], (float)vertices[index + 1], (float)vertices[index + 2]);
+}
+
+// Same normal the VBOs of the model get for a corner
+static glm::vec3 CornerNormal(const Model& model, const Face& face, int corner)
+{
+	const std::vector<Normal>& normals = model.normals();
+	if (!normals.empty() && face.n.size() == face.v.size())
+	{
+		const int index = face.n[corner];
+		return glm::vec3((float)normals[index], (float)normals[index + 1], (float)normals[index + 2]);
+	}
+	return glm::vec3((float)face.normalC[0], (float)face.normalC[1], (float)face.normalC[2]);
+}
+
+static float ModelSize(const Model& model)
+{
+	const std::vector<Vertex>& vertices = model.vertices();
+	if (vertices.size() < 3) return 0.f;
+
+	glm::vec3 low = ModelVertex(model, 0), high = low;
+	for (size_t i = 3; i + 2 < vertices.size(); i += 3)
+	{
+		const glm::vec3 vertex = ModelVertex(model, (int)i);
+		low = glm::min(low, vertex);
+		high = glm::max(high, vertex);
+	}
+	return glm::length(high - low);
+}
+
+void BakeAmbientOcclusion(const Model& model, const RTAOBakeSettings& settings, std::vector<float>& visibility)
+{
+	const std::vector<Face>& faces = model.faces();
+	visibility.assign(faces.size() * 3, 1.f);
+	if (faces.empty()) return;
+
+	// The corners with the same position and normal are one vertex of the mesh
+	std::vector<std::pair<glm::vec3, glm::vec3>> vertices;
+	std::vector<int> cornerVertex(faces.size() * 3);
+	std::map<std::pair<int, int>, int> vertexIds;
+	for (size_t f = 0; f < faces.size(); ++f)
+	{
+		const Face& face = faces[f];
+		for (int i = 0; i < 3; ++i)
+		{
+			const bool sharedNormal = !model.normals().empty() && face.n.size() == face.v.size();
+			const std::pair<int, int> key(face.v[i], sharedNormal ? face.n[i] : -1 - (int)f);
+			std::map<std::pair<int, int>, int>::const_iterator found = vertexIds.find(key);
+			if (found == vertexIds.end())
+			{
+				found = vertexIds.insert(std::make_pair(key, (int)vertices.size())).first;
+				glm::vec3 normal = CornerNormal(model, face, i);
+				if (glm::dot(normal, normal) > 0.f) normal = glm::normalize(normal);
+				vertices.push_back(std::make_pair(ModelVertex(model, face.v[i]), normal));
+			}
+			cornerVertex[f * 3 + i] = found->second;
+		}
+	}
+
+	RTScene scene;
+	scene.AddMesh(model, glm::mat4(1.f));
+	scene.BuildAccelerationStructure();
+
+	const float size = ModelSize(model);
+	const float radius = settings.m_radius > 0.f ? settings.m_radius : RT_AO_RADIUS_FACTOR * size;
+	const float epsilon = settings.m_epsilonFactor * size;
+	const RTSampler sampler(RT_SAMPLER_SOBOL);
+
+	std::vector<float> vertexVisibility(vertices.size(), 1.f);
+
+	int numThreads = settings.m_numThreads;
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::atomic<int> nextChunk(0);
+	auto bakeVertices = [&]()
+	{
+		for (int begin = nextChunk++ * RT_AO_BAKE_CHUNK; begin < (int)vertices.size(); begin = nextChunk++ * RT_AO_BAKE_CHUNK)
+		{
+			const int end = std::min(begin + RT_AO_BAKE_CHUNK, (int)vertices.size());
+			for (int v = begin; v < end; ++v)
+			{
+				const glm::vec3& normal = vertices[v].second;
+				if (settings.m_rays <= 0 || glm::dot(normal, normal) == 0.f) continue;
+
+				glm::vec3 tangent, bitangent;
+				BuildBasis(normal, tangent, bitangent);
+				const glm::vec3 origin = vertices[v].first + normal * epsilon;
+
+				// Each vertex gets its own scrambling of the same cosine distributed points. The last
+				// occluder is only kept among the rays of a vertex, so the result does not depend on
+				// which thread baked the vertex before.
+				Occluder occluder;
+				int unoccluded = 0;
+				for (int i = 0; i < settings.m_rays; ++i)
+				{
+					const glm::vec3 direction = SampleCosineHemisphere(sampler.Get2D(v, 0, i, 0), normal, tangent, bitangent);
+
+					if (!scene.Occluded(origin, direction, radius, &occluder)) ++unoccluded;
+				}
+				vertexVisibility[v] = (float)unoccluded / settings.m_rays;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; ++t) threads.push_back(std::thread(bakeVertices));
+	bakeVertices();
+	for (std::thread& thread : threads) thread.join();
+
+	for (size_t c = 0; c < cornerVertex.size(); ++c) visibility[c] = vertexVisibility[cornerVertex[c]];
+}
+
+std::string AOCacheFilename(const std::string& modelFilename)
+{
+	return modelFilename + ".ao";
+}
+
+uint64_t ModelGeometryHash(const Model& model)
+{
+	// Everything the bake depends on
+	RTHash hash;
+	const std::vector<Face>& faces = model.faces();
+	for (const Face& face : faces)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			hash.AddVec3(ModelVertex(model, face.v[i]));
+			hash.AddVec3(CornerNormal(model, face, i));
+		}
+	}
+	return hash.m_value;
+}
+
+bool SaveAOCache(const std::string& filename, const Model& model, const RTAOBakeSettings& settings, const std::vector<float>& visibility)
+{
+	const uint64_t hash = ModelGeometryHash(model);
+
+	RTStreamWriter writer;
+	writer.WriteUInt32(RT_AO_CACHE_MAGIC);
+	writer.WriteUInt32(RT_AO_CACHE_VERSION);
+	writer.WriteUInt32((uint32_t)hash);
+	writer.WriteUInt32((uint32_t)(hash >> 32));
+	writer.WriteUInt32((uint32_t)visibility.size());
+	writer.WriteInt32(settings.m_rays);
+	writer.WriteFloat(settings.m_radius);
+	writer.WriteFloats(visibility.data(), visibility.size());
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file) return false;
+	file.write((const char*)writer.m_data.data(), writer.m_data.size());
+	return (bool)file;
+}
+
+bool LoadAOCache(const std::string& filename, const Model& model, std::vector<float>& visibility)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+	const std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	RTStreamReader reader(data.data(), data.size());
+	if (reader.ReadUInt32() != RT_AO_CACHE_MAGIC || reader.ReadUInt32() != RT_AO_CACHE_VERSION) return false;
+
+	uint64_t hash = reader.ReadUInt32();
+	hash |= (uint64_t)reader.ReadUInt32() << 32;
+	const uint32_t count = reader.ReadUInt32();
+	reader.ReadInt32(); // Rays
+	reader.ReadFloat(); // Radius
+	if (reader.m_failed || count != model.faces().size() * 3 || hash != ModelGeometryHash(model)) return false;
+
+	visibility.resize(count);
+	for (uint32_t i = 0; i < count; ++i) visibility[i] = reader.ReadFloat();
+	if (reader.m_failed)
+	{
+		visibility.clear();
+		return false;
+	}
+	return true;
+}
+
+int RunAOBake(const RTAOBakeOptions& options)
+{
+	std::cout << "--- Loading model: " << options.m_modelFilename << std::endl;
+	Model model;
+	model.load(options.m_modelFilename);
+	if (model.faces().empty())
+	{
+		std::cerr << "No triangles in " << options.m_modelFilename << std::endl;
+		return 1;
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<float> visibility;
+	BakeAmbientOcclusion(model, options.m_settings, visibility);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	float average = 0.f;
+	for (float value : visibility) average += value;
+	if (!visibility.empty()) average /= visibility.size();
+
+	std::cout << "--- Baked " << model.faces().size() << " triangles, " << options.m_settings.m_rays << " rays per vertex in "
+		<< seconds << " s, average visibility " << average << std::endl;
+
+	const std::string filename = AOCacheFilename(options.m_modelFilename);
+	if (!SaveAOCache(filename, model, options.m_settings, visibility))
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return 1;
+	}
+
+	std::cout << "--- Saved " << filename << std::endl;
+	return 0;
+}
@@ -0,0 +1,1182 @@
+#include "Files/RT/headers/rtbenchmark.h"
+#include "Files/RT/headers/raytracer.h"
+#include "Files/RT/headers/rtbvhcache.h"
+#include "Files/RT/headers/renderjob.h"
+#include "Files/RT/headers/rthybrid.h"
+#include "Files/RT/headers/rtquery.h"
+#include "Files/RT/headers/rtscene.h"
+#include "Files/definitions.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_IMAGE_SIZE 256
+#define BENCH_MODEL_FILENAME "./Files/SSAO/models/legoman.obj"
+#define BENCH_ADAPTIVE_IMAGE_SIZE 128
+#define BENCH_ADAPTIVE_REFERENCE_SAMPLES 1024
+#define BENCH_PATH_IMAGE_SIZE 64
+#define BENCH_PATH_REFERENCE_SAMPLES 2048
+#define BENCH_DENOISE_IMAGE_SIZE 128
+#define BENCH_DENOISE_REFERENCE_SAMPLES 1024
+#define BENCH_LIGHTS_IMAGE_SIZE 128
+#define BENCH_SAMPLER_IMAGE_SIZE 64
+#define BENCH_SAMPLER_REFERENCE_SAMPLES 4096
+#define BENCH_HYBRID_FRAMES 4
+#define BENCH_QUERY_SIZE 1000 // Square of the rays of a batch query
+#define BENCH_GRID_CHECK_RAYS 65536 // Of each kind, besides the primary rays
+#define BENCH_GRID_TIE_TOLERANCE 1e-4f // Relative, two spheres hit at the same distance are both right
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double ElapsedSeconds(const BenchClock::time_point& start)
+{
+	return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// Random spheres inside a cube that grows with the number of spheres so the
+// density, and therefore the depth complexity, stays similar between scenes
+static void CreateRandomScene(RTScene& scene, int numSpheres)
+{
+	std::mt19937 rng(1234);
+	const float halfSize = 10.f * std::cbrt((float)numSpheres);
+	std::uniform_real_distribution<float> position(-halfSize, halfSize);
+	std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+	std::uniform_real_distribution<float> color(0.f, 1.f);
+
+	scene.Clear();
+	scene.AddSphere(Sphere(glm::vec3(0.f, 2.f * halfSize, 0.f), 2, glm::vec3(0.f), false, 0.f, 0.f, 2.f, glm::vec3(1.f)));
+
+	for (int i = 0; i < numSpheres; ++i)
+	{
+		const glm::vec3 center(position(rng), position(rng), position(rng) - 3.f * halfSize);
+		scene.AddSphere(Sphere(center, radius(rng), glm::vec3(color(rng), color(rng), color(rng))));
+	}
+}
+
+static glm::vec3 PrimaryRayDirection(int x, int y)
+{
+	const float angle = tan(PI * 0.5f * 60.f / 180.f);
+	const float xx = (2.f * ((x + 0.5f) / BENCH_IMAGE_SIZE) - 1.f) * angle;
+	const float yy = (1.f - 2.f * ((y + 0.5f) / BENCH_IMAGE_SIZE)) * angle;
+	return glm::normalize(glm::vec3(xx, yy, -1.f));
+}
+
+static int ClosestHitLinear(const RTScene& scene, const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+	const std::vector<Sphere>& spheres = scene.Spheres();
+	int closest = -1;
+	distance = INFINITY;
+
+	for (int i = 0; i < (int)spheres.size(); ++i)
+	{
+		if (spheres[i].isLight()) continue;
+
+		const float t = RTScene::HitDistance(spheres[i], origin, direction);
+		if (t < distance)
+		{
+			distance = t;
+			closest = i;
+		}
+	}
+
+	return closest;
+}
+
+// Traces every rayStep-th primary ray and returns the number of rays per second
+template <typename ClosestHitFunc>
+static double TracePrimaryRays(int rayStep, int& hits, ClosestHitFunc closestHit)
+{
+	const glm::vec3 origin(0.f);
+	int numRays = 0;
+	hits = 0;
+
+	const BenchClock::time_point start = BenchClock::now();
+	for (int p = 0; p < BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE; p += rayStep, ++numRays)
+	{
+		float distance;
+		if (closestHit(origin, PrimaryRayDirection(p % BENCH_IMAGE_SIZE, p / BENCH_IMAGE_SIZE), distance) >= 0)
+			hits++;
+	}
+
+	return numRays / ElapsedSeconds(start);
+}
+
+static void BenchmarkBVH()
+{
+	const int sceneSizes[] = { 10, 1000, 100000, 1000000 };
+
+	std::cout << "=== BVH closest hit, " << BENCH_IMAGE_SIZE << "x" << BENCH_IMAGE_SIZE << " primary rays" << std::endl;
+	std::cout << std::setw(10) << "spheres" << std::setw(12) << "build ms" << std::setw(10) << "nodes"
+		<< std::setw(10) << "SAH" << std::setw(14) << "linear Kr/s" << std::setw(12) << "BVH Kr/s"
+		<< std::setw(10) << "speedup" << std::endl;
+
+	RTScene scene;
+	scene.SetAcceleration(RT_ACCELERATION_BVH);
+	for (int numSpheres : sceneSizes)
+	{
+		CreateRandomScene(scene, numSpheres);
+
+		const BenchClock::time_point start = BenchClock::now();
+		scene.BuildAccelerationStructure();
+		const double buildTime = ElapsedSeconds(start);
+
+		int bvhHits, linearHits;
+		const double bvhRate = TracePrimaryRays(1, bvhHits, [&](const glm::vec3& o, const glm::vec3& d, float& t)
+		{
+			return scene.ClosestHit(o, d, t);
+		});
+
+		// The linear search is sampled on a subset of the rays for the big scenes
+		const int linearStep = std::max(1, numSpheres / 1000);
+		const double linearRate = TracePrimaryRays(linearStep, linearHits, [&](const glm::vec3& o, const glm::vec3& d, float& t)
+		{
+			return ClosestHitLinear(scene, o, d, t);
+		});
+
+		std::cout << std::setw(10) << numSpheres
+			<< std::setw(12) << std::fixed << std::setprecision(2) << buildTime * 1000.0
+			<< std::setw(10) << scene.GetBVH().Nodes().size()
+			<< std::setw(10) << std::setprecision(1) << scene.GetBVH().SAHCost()
+			<< std::setw(14) << std::setprecision(2) << linearRate * 1e-3
+			<< std::setw(12) << bvhRate * 1e-3
+			<< std::setw(9) << std::setprecision(1) << bvhRate / linearRate << "x" << std::endl;
+	}
+}
+
+// True unless the two closest hits are at different distances, the sphere may differ on a tie
+static bool SameClosestHit(int sphereA, float distanceA, int sphereB, float distanceB)
+{
+	if (sphereA < 0 || sphereB < 0) return sphereA == sphereB;
+	return std::fabs(distanceA - distanceB) <= BENCH_GRID_TIE_TOLERANCE * std::max(1.f, std::max(distanceA, distanceB));
+}
+
+// Rays the primary rays do not cover, traced with the grid and then the BVH of the scene:
+// from outside the grid towards any point of it, from inside it, and from outside straight
+// along a face at the boundary between two layers of cells, where the entry point is rounded.
+// Returns the rays whose closest hits differ.
+static int CompareGridToBVH(RTScene& scene)
+{
+	scene.SetAcceleration(RT_ACCELERATION_GRID);
+	scene.BuildAccelerationStructure();
+	const UniformGrid& grid = scene.Grid();
+	const AABB bounds = grid.Bounds();
+	const glm::vec3 cellSize = grid.CellSize();
+	const glm::ivec3 resolution = grid.Resolution();
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::normal_distribution<float> normal;
+	auto pointInside = [&]() { return bounds.m_min + glm::vec3(unit(rng), unit(rng), unit(rng)) * bounds.Extent(); };
+	const glm::vec3 center = (bounds.m_min + bounds.m_max) * 0.5f;
+
+	std::vector<glm::vec3> origins, directions;
+	for (int i = 0; i < BENCH_GRID_CHECK_RAYS; ++i)
+	{
+		const glm::vec3 outside = center + glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng))) * glm::length(bounds.Extent());
+		origins.push_back(outside);
+		directions.push_back(glm::normalize(pointInside() - outside));
+
+		const glm::vec3 inside = pointInside();
+		origins.push_back(inside);
+		directions.push_back(glm::normalize(pointInside() - inside));
+
+		// Enters through the face of axis a at a boundary of the cells along the next axis,
+		// with a slight slope across it either way
+		const int a = i % 3, b = (a + 1) % 3, c = (a + 2) % 3;
+		glm::vec3 origin, direction;
+		origin[a] = bounds.m_min[a] - cellSize[a];
+		origin[b] = bounds.m_min[b] + (1 + (int)(unit(rng) * std::max(1, resolution[b] - 1))) * cellSize[b];
+		origin[c] = bounds.m_min[c] + unit(rng) * bounds.Extent()[c];
+		direction[a] = 1.f;
+		direction[b] = (unit(rng) - 0.5f) * 1e-3f;
+		direction[c] = (unit(rng) - 0.5f) * 1e-3f;
+		origins.push_back(origin);
+		directions.push_back(glm::normalize(direction));
+	}
+
+	std::vector<int> closest[2];
+	std::vector<float> distances[2];
+	const RTAcceleration accelerations[2] = { RT_ACCELERATION_GRID, RT_ACCELERATION_BVH };
+	for (int a = 0; a < 2; ++a)
+	{
+		// The grid is already built
+		if (a > 0)
+		{
+			scene.SetAcceleration(accelerations[a]);
+			scene.BuildAccelerationStructure();
+		}
+
+		for (size_t i = 0; i < origins.size(); ++i)
+		{
+			float distance;
+			closest[a].push_back(scene.ClosestHit(origins[i], directions[i], distance));
+			distances[a].push_back(distance);
+		}
+	}
+
+	int mismatches = 0;
+	for (size_t i = 0; i < origins.size(); ++i)
+	{
+		if (!SameClosestHit(closest[0][i], distances[0][i], closest[1][i], distances[1][i])) mismatches++;
+	}
+	return mismatches;
+}
+
+// Grid against BVH on the same scenes, the last one has a sphere many times larger than the rest.
+// Returns the rays on which they found different closest hits.
+static int BenchmarkGrid()
+{
+	const int sceneSizes[] = { 10000, 100000, 1000000, -100000 };
+
+	std::cout << "=== Uniform grid against BVH, " << BENCH_IMAGE_SIZE << "x" << BENCH_IMAGE_SIZE << " primary rays" << std::endl;
+	std::cout << std::setw(10) << "spheres" << std::setw(14) << "BVH build ms" << std::setw(15) << "grid build ms"
+		<< std::setw(12) << "BVH Kr/s" << std::setw(12) << "grid Kr/s" << std::setw(12) << "mismatches"
+		<< std::setw(8) << "auto" << std::endl;
+
+	RTScene scene;
+	int totalMismatches = 0;
+	for (int sceneSize : sceneSizes)
+	{
+		const int numSpheres = std::abs(sceneSize);
+		CreateRandomScene(scene, numSpheres);
+		if (sceneSize < 0) scene.AddSphere(Sphere(glm::vec3(0.f, -1000.f, -30.f * std::cbrt((float)numSpheres)), 900.f, glm::vec3(0.5f)));
+
+		double buildTimes[2], rates[2];
+		std::vector<int> closest[2];
+		std::vector<float> distances[2];
+		const RTAcceleration accelerations[2] = { RT_ACCELERATION_BVH, RT_ACCELERATION_GRID };
+		for (int a = 0; a < 2; ++a)
+		{
+			scene.SetAcceleration(accelerations[a]);
+			const BenchClock::time_point start = BenchClock::now();
+			scene.BuildAccelerationStructure();
+			buildTimes[a] = ElapsedSeconds(start);
+
+			int hits;
+			rates[a] = TracePrimaryRays(1, hits, [&](const glm::vec3& o, const glm::vec3& d, float& t)
+			{
+				const int sphere = scene.ClosestHit(o, d, t);
+				closest[a].push_back(sphere);
+				distances[a].push_back(t);
+				return sphere;
+			});
+		}
+
+		int mismatches = CompareGridToBVH(scene);
+		for (size_t i = 0; i < closest[0].size(); ++i)
+			if (!SameClosestHit(closest[0][i], distances[0][i], closest[1][i], distances[1][i])) mismatches++;
+		totalMismatches += mismatches;
+
+		scene.SetAcceleration(RT_ACCELERATION_AUTO);
+		scene.BuildAccelerationStructure();
+
+		std::cout << std::setw(9) << numSpheres << (sceneSize < 0 ? "+" : " ")
+			<< std::setw(14) << std::fixed << std::setprecision(2) << buildTimes[0] * 1000.0
+			<< std::setw(15) << buildTimes[1] * 1000.0
+			<< std::setw(12) << rates[0] * 1e-3
+			<< std::setw(12) << rates[1] * 1e-3
+			<< std::setw(12) << mismatches
+			<< std::setw(8) << (scene.UsesGrid() ? "grid" : "BVH") << std::endl;
+	}
+
+	return totalMismatches;
+}
+
+// Build of the BVH of a triangle soup against its load from the cache. The file was
+// just written, it is read from the disk cache of the system.
+static void BenchmarkBVHCache()
+{
+	const int sceneSizes[] = { 100000, 1000000, 4000000 };
+
+	const char* tempDirectory = getenv("TMPDIR");
+	RTBVHCache cache(tempDirectory ? tempDirectory : ".");
+
+	std::cout << "=== BVH cache, triangle soup in " << cache.Directory() << std::endl;
+	std::cout << std::setw(10) << "triangles" << std::setw(12) << "build ms" << std::setw(10) << "hash ms"
+		<< std::setw(10) << "save ms" << std::setw(10) << "load ms" << std::setw(10) << "MB"
+		<< std::setw(10) << "speedup" << std::setw(8) << "same" << std::endl;
+
+	for (int numTriangles : sceneSizes)
+	{
+		// Small boxes like the triangles of a finely tessellated model
+		std::mt19937 rng(1234);
+		const float halfSize = std::cbrt((float)numTriangles);
+		std::uniform_real_distribution<float> position(-halfSize, halfSize);
+		std::uniform_real_distribution<float> extent(0.05f, 1.f);
+
+		std::vector<AABB> bounds(numTriangles);
+		for (AABB& box : bounds)
+		{
+			box.m_min = glm::vec3(position(rng), position(rng), position(rng));
+			box.m_max = box.m_min + glm::vec3(extent(rng), extent(rng), extent(rng));
+		}
+
+		BenchClock::time_point start = BenchClock::now();
+		BVH built;
+		built.Build(bounds);
+		const double buildTime = ElapsedSeconds(start);
+
+		start = BenchClock::now();
+		const RTBVHCacheKey key = RTBVHCache::Key(bounds, 4, 1);
+		const double hashTime = ElapsedSeconds(start);
+
+		const std::string filename = cache.Filename(key);
+		start = BenchClock::now();
+		const bool saved = RTBVHCache::Save(filename, key, built);
+		const double saveTime = ElapsedSeconds(start);
+
+		start = BenchClock::now();
+		BVH loaded;
+		const bool found = saved && RTBVHCache::Load(filename, key, loaded);
+		const double loadTime = ElapsedSeconds(start);
+		std::remove(filename.c_str());
+
+		if (!found)
+		{
+			std::cout << std::setw(10) << numTriangles << "  cannot write " << filename << std::endl;
+			continue;
+		}
+
+		const bool same = loaded.Nodes().size() == built.Nodes().size() && loaded.PrimIndices().size() == built.PrimIndices().size()
+			&& std::equal(built.PrimIndices().begin(), built.PrimIndices().end(), loaded.PrimIndices().begin())
+			&& memcmp(loaded.Nodes().data(), built.Nodes().data(), built.Nodes().size() * sizeof(BVHNode)) == 0;
+		const double megabytes = (built.Nodes().size() * sizeof(BVHNode) + built.PrimIndices().size() * sizeof(unsigned int)) / 1e6;
+
+		std::cout << std::setw(10) << numTriangles
+			<< std::setw(12) << std::fixed << std::setprecision(2) << buildTime * 1000.0
+			<< std::setw(10) << hashTime * 1000.0
+			<< std::setw(10) << saveTime * 1000.0
+			<< std::setw(10) << loadTime * 1000.0
+			<< std::setw(10) << std::setprecision(1) << megabytes
+			<< std::setw(9) << buildTime / (hashTime + loadTime) << "x"
+			<< std::setw(8) << (same ? "yes" : "no") << std::endl;
+	}
+}
+
+// One ray against every sphere, scalar loop over the Sphere objects against the SoA sweep
+static void BenchmarkSphereSweep()
+{
+	const int sceneSizes[] = { 8, 32, 128, 512 };
+
+	std::cout << "=== Sphere sweep without BVH, " << RT_SIMD_WIDTH << " spheres per test" << std::endl;
+	std::cout << std::setw(10) << "spheres" << std::setw(14) << "scalar Kr/s" << std::setw(14) << "SoA Kr/s"
+		<< std::setw(10) << "speedup" << std::setw(12) << "mismatches" << std::endl;
+
+	RTScene scene;
+	SphereSoA sphereSoA;
+	for (int numSpheres : sceneSizes)
+	{
+		CreateRandomScene(scene, numSpheres);
+
+		std::vector<int> order;
+		for (int i = 0; i < (int)scene.Spheres().size(); ++i)
+		{
+			if (!scene.Spheres()[i].isLight()) order.push_back(i);
+		}
+		sphereSoA.Load(scene.Spheres(), order);
+
+		int scalarHits, soaHits;
+		const double scalarRate = TracePrimaryRays(1, scalarHits, [&](const glm::vec3& o, const glm::vec3& d, float& t)
+		{
+			return ClosestHitLinear(scene, o, d, t);
+		});
+
+		const double soaRate = TracePrimaryRays(1, soaHits, [&](const glm::vec3& o, const glm::vec3& d, float& t)
+		{
+			t = INFINITY;
+			const int slot = sphereSoA.ClosestHit(0, sphereSoA.Size(), o, d, t);
+			return slot < 0 ? -1 : sphereSoA.MaterialIndex(slot);
+		});
+
+		// Both searches hit the same spheres, the speedup is meaningless otherwise
+		int mismatches = 0;
+		for (int p = 0; p < BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE; ++p)
+		{
+			const glm::vec3 direction = PrimaryRayDirection(p % BENCH_IMAGE_SIZE, p / BENCH_IMAGE_SIZE);
+			float scalarT, soaT = INFINITY;
+			const int scalarHit = ClosestHitLinear(scene, glm::vec3(0.f), direction, scalarT);
+			const int slot = sphereSoA.ClosestHit(0, sphereSoA.Size(), glm::vec3(0.f), direction, soaT);
+			if (scalarHit != (slot < 0 ? -1 : sphereSoA.MaterialIndex(slot)) && scalarT != soaT)
+				mismatches++;
+		}
+
+		std::cout << std::setw(10) << numSpheres
+			<< std::setw(14) << std::fixed << std::setprecision(2) << scalarRate * 1e-3
+			<< std::setw(14) << soaRate * 1e-3
+			<< std::setw(9) << std::setprecision(1) << soaRate / scalarRate << "x"
+			<< std::setw(12) << mismatches << std::endl;
+	}
+}
+
+// Scalar against packet tracing of the primary rays, the packets go along the image rows
+static void BenchmarkPacketScene(const std::string& name, const RTScene& scene)
+{
+	const int numRays = BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE;
+	const glm::vec3 origin(0.f);
+
+	std::vector<Ray> rays;
+	rays.reserve(numRays);
+	for (int p = 0; p < numRays; ++p)
+	{
+		rays.push_back(Ray(origin, PrimaryRayDirection(p % BENCH_IMAGE_SIZE, p / BENCH_IMAGE_SIZE)));
+	}
+
+	std::vector<HitInfo> scalarHits(numRays);
+	std::vector<char> scalarHit(numRays);
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int p = 0; p < numRays; ++p)
+	{
+		scalarHit[p] = scene.Intersect(rays[p], scalarHits[p]);
+	}
+	const double scalarRate = numRays / ElapsedSeconds(start);
+
+	std::vector<HitInfo> packetHits(numRays);
+	bool hits[RT_SIMD_WIDTH];
+	int mismatches = 0;
+
+	start = BenchClock::now();
+	for (int p = 0; p < numRays; p += RT_SIMD_WIDTH)
+	{
+		const int count = std::min(RT_SIMD_WIDTH, numRays - p);
+		scene.IntersectPacket(&rays[p], count, &packetHits[p], hits);
+
+		for (int lane = 0; lane < count; ++lane)
+		{
+			if (hits[lane] != (bool)scalarHit[p + lane] ||
+				(hits[lane] && packetHits[p + lane].m_material != scalarHits[p + lane].m_material))
+				mismatches++;
+		}
+	}
+	const double packetRate = numRays / ElapsedSeconds(start);
+
+	std::cout << std::setw(16) << name
+		<< std::setw(14) << std::fixed << std::setprecision(2) << scalarRate * 1e-3
+		<< std::setw(14) << packetRate * 1e-3
+		<< std::setw(9) << std::setprecision(1) << packetRate / scalarRate << "x"
+		<< std::setw(12) << mismatches << std::endl;
+}
+
+// Shadow rays from the primary hits towards every light. The full closest hit query
+// is compared with the occlusion query, clipped at the light and with the occluder cache.
+static void BenchmarkShadowScene(const std::string& name, const RTScene& scene)
+{
+	const std::vector<Sphere>& spheres = scene.Spheres();
+	std::vector<glm::vec3> origins, directions;
+	std::vector<float> distances;
+	std::vector<int> lights;
+
+	for (int p = 0; p < BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE; ++p)
+	{
+		HitInfo hitInfo;
+		if (!scene.Intersect(Ray(glm::vec3(0.f), PrimaryRayDirection(p % BENCH_IMAGE_SIZE, p / BENCH_IMAGE_SIZE)), hitInfo))
+			continue;
+
+		const glm::vec3 origin = hitInfo.m_positionHit + hitInfo.m_normalHit * 1e-4f;
+		for (int l = 0; l < (int)spheres.size(); ++l)
+		{
+			if (!spheres[l].isLight()) continue;
+
+			origins.push_back(origin);
+			directions.push_back(glm::normalize(spheres[l].getCenter() - origin));
+			distances.push_back(glm::length(spheres[l].getCenter() - origin));
+			lights.push_back(l);
+		}
+	}
+
+	const int numRays = (int)origins.size();
+	int occluded = 0;
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int r = 0; r < numRays; ++r)
+	{
+		HitInfo hitInfo;
+		if (scene.Intersect(Ray(origins[r], directions[r]), hitInfo)) occluded++;
+	}
+	const double intersectRate = numRays / ElapsedSeconds(start);
+
+	std::vector<char> clipped(numRays);
+	start = BenchClock::now();
+	for (int r = 0; r < numRays; ++r)
+	{
+		clipped[r] = scene.Occluded(origins[r], directions[r], distances[r]);
+	}
+	const double occludedRate = numRays / ElapsedSeconds(start);
+
+	TraceContext context;
+	int mismatches = 0;
+	start = BenchClock::now();
+	for (int r = 0; r < numRays; ++r)
+	{
+		if (scene.Occluded(origins[r], directions[r], distances[r], &context.LastOccluder(lights[r])) != (bool)clipped[r])
+			mismatches++;
+	}
+	const double cachedRate = numRays / ElapsedSeconds(start);
+
+	int inShadow = 0;
+	for (int r = 0; r < numRays; ++r) inShadow += clipped[r];
+
+	std::cout << std::setw(16) << name << std::setw(10) << numRays
+		<< std::setw(9) << std::fixed << std::setprecision(1) << 100.0 * inShadow / std::max(1, numRays) << "%"
+		<< std::setw(14) << std::setprecision(2) << intersectRate * 1e-3
+		<< std::setw(14) << occludedRate * 1e-3
+		<< std::setw(14) << cachedRate * 1e-3
+		<< std::setw(12) << mismatches << std::endl;
+}
+
+static void BenchmarkShadowRays()
+{
+	std::cout << "=== Shadow rays" << std::endl;
+	std::cout << std::setw(16) << "scene" << std::setw(10) << "rays" << std::setw(10) << "shadow"
+		<< std::setw(14) << "closest Kr/s" << std::setw(14) << "any hit Kr/s" << std::setw(14) << "cached Kr/s"
+		<< std::setw(12) << "mismatches" << std::endl;
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.SetAcceleration(RT_ACCELERATION_BVH);
+	scene.BuildAccelerationStructure();
+	BenchmarkShadowScene("default", scene);
+
+	CreateRandomScene(scene, 100000);
+	scene.BuildAccelerationStructure();
+	BenchmarkShadowScene("100000 spheres", scene);
+
+	// Same model as the Legoman scene of the window, only if run from the project folder
+	Model model;
+	model.load(BENCH_MODEL_FILENAME);
+	if (!model.vertices().empty())
+	{
+		scene.Clear();
+		scene.LoadDefaultScene(false);
+		scene.AddModelOnFloor(model);
+		scene.BuildAccelerationStructure();
+		BenchmarkShadowScene("legoman", scene);
+	}
+}
+
+static void BenchmarkPackets()
+{
+	std::cout << "=== Packet closest hit, " << RT_SIMD_WIDTH << " rays per packet" << std::endl;
+	std::cout << std::setw(16) << "scene" << std::setw(14) << "scalar Kr/s" << std::setw(14) << "packet Kr/s"
+		<< std::setw(10) << "speedup" << std::setw(12) << "mismatches" << std::endl;
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+	BenchmarkPacketScene("default", scene);
+
+	CreateRandomScene(scene, 100000);
+	scene.BuildAccelerationStructure();
+	BenchmarkPacketScene("100000 spheres", scene);
+}
+
+// Recursive tracing of each pixel against the wavefront tracing of the rows, one sample through the pixel centers
+static void BenchmarkWavefrontScene(const std::string& name, const RTScene& scene)
+{
+	RenderSettings settings;
+	settings.m_width = BENCH_IMAGE_SIZE;
+	settings.m_height = BENCH_IMAGE_SIZE;
+	settings.m_maxRayDepth = MAX_RAY_DEPTH;
+
+	const RayTracer tracer(scene, settings);
+	const int numPixels = BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE;
+	TraceContext context;
+
+	std::vector<Color> recursive(numPixels);
+	BenchClock::time_point start = BenchClock::now();
+	for (int p = 0; p < numPixels; ++p)
+	{
+		Ray ray = tracer.CameraRay(p % BENCH_IMAGE_SIZE + 0.5f, p / BENCH_IMAGE_SIZE + 0.5f);
+		recursive[p] = tracer.TraceRay(ray, 0, context);
+	}
+	const double recursiveRate = numPixels / ElapsedSeconds(start);
+
+	std::vector<Color> wavefront(numPixels);
+	start = BenchClock::now();
+	for (int y = 0; y < BENCH_IMAGE_SIZE; ++y)
+	{
+		tracer.TraceRow(y, 1, 0, false, 0, context, &wavefront[y * BENCH_IMAGE_SIZE]);
+	}
+	const double wavefrontRate = numPixels / ElapsedSeconds(start);
+
+	// The children are summed in another order, only rounding differences are expected
+	int differences = 0;
+	for (int p = 0; p < numPixels; ++p)
+	{
+		if (glm::length(recursive[p] - wavefront[p]) > 1e-3f) differences++;
+	}
+
+	std::cout << std::setw(16) << name
+		<< std::setw(16) << std::fixed << std::setprecision(2) << recursiveRate * 1e-3
+		<< std::setw(16) << wavefrontRate * 1e-3
+		<< std::setw(9) << std::setprecision(1) << wavefrontRate / recursiveRate << "x"
+		<< std::setw(14) << differences << std::endl;
+}
+
+static void BenchmarkWavefront()
+{
+	std::cout << "=== Wavefront against recursive tracing, depth " << MAX_RAY_DEPTH << std::endl;
+	std::cout << std::setw(16) << "scene" << std::setw(16) << "recursive Kpx/s" << std::setw(16) << "wavefront Kpx/s"
+		<< std::setw(10) << "speedup" << std::setw(14) << "differing px" << std::endl;
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+	BenchmarkWavefrontScene("default", scene);
+
+	CreateRandomScene(scene, 100000);
+	scene.BuildAccelerationStructure();
+	BenchmarkWavefrontScene("100000 spheres", scene);
+
+	Model model;
+	model.load(BENCH_MODEL_FILENAME);
+	if (!model.vertices().empty())
+	{
+		scene.Clear();
+		scene.LoadDefaultScene(false);
+		scene.AddModelOnFloor(model);
+		scene.BuildAccelerationStructure();
+		BenchmarkWavefrontScene("legoman", scene);
+	}
+}
+
+static std::vector<Color> RenderImage(const RTScene& scene, const RenderSettings& settings, double& seconds, long long& samples)
+{
+	RenderJob job(scene, settings);
+
+	const BenchClock::time_point start = BenchClock::now();
+	job.Start();
+	job.Wait();
+	seconds = ElapsedSeconds(start);
+	samples = job.SamplesTraced();
+
+	std::vector<Color> image;
+	job.CopyImage(image);
+	return image;
+}
+
+static double RMSE(const std::vector<Color>& image, const std::vector<Color>& reference)
+{
+	double sum = 0.0;
+	for (size_t p = 0; p < image.size(); ++p)
+	{
+		const Color difference = image[p] - reference[p];
+		sum += glm::dot(difference, difference) / 3.0;
+	}
+	return std::sqrt(sum / image.size());
+}
+
+// Uniform against adaptive sampling of the default scene, the error is measured against
+// a uniform render with many samples. Each adaptive render is compared with the uniform
+// render of the same error, interpolated between the uniform runs.
+static void BenchmarkAdaptiveSampling()
+{
+	const int uniformSamples[] = { 4, 8, 16, 32, 64, 128 };
+	const int adaptiveBudgets[] = { 8, 16, 32 };
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+
+	RenderSettings settings;
+	settings.m_width = BENCH_ADAPTIVE_IMAGE_SIZE;
+	settings.m_height = BENCH_ADAPTIVE_IMAGE_SIZE;
+	settings.m_maxRayDepth = MAX_RAY_DEPTH;
+
+	std::cout << "=== Adaptive sampling, " << BENCH_ADAPTIVE_IMAGE_SIZE << "x" << BENCH_ADAPTIVE_IMAGE_SIZE
+		<< " default scene, error against " << BENCH_ADAPTIVE_REFERENCE_SAMPLES << " spp" << std::endl;
+
+	double seconds;
+	long long samples;
+	settings.m_samplesPerPixel = BENCH_ADAPTIVE_REFERENCE_SAMPLES;
+	const std::vector<Color> reference = RenderImage(scene, settings, seconds, samples);
+
+	std::cout << std::setw(10) << "mode" << std::setw(8) << "spp" << std::setw(12) << "avg spp" << std::setw(10) << "ms"
+		<< std::setw(10) << "RMSE" << std::setw(30) << "uniform at equal RMSE" << std::endl;
+
+	std::vector<double> uniformErrors, uniformTimes;
+	for (int spp : uniformSamples)
+	{
+		settings.m_samplesPerPixel = spp;
+		const double error = RMSE(RenderImage(scene, settings, seconds, samples), reference);
+		uniformErrors.push_back(error);
+		uniformTimes.push_back(seconds);
+
+		std::cout << std::setw(10) << "uniform" << std::setw(8) << spp
+			<< std::setw(12) << std::fixed << std::setprecision(2) << (double)samples / reference.size()
+			<< std::setw(10) << std::setprecision(1) << seconds * 1000.0
+			<< std::setw(10) << std::setprecision(4) << error << std::endl;
+	}
+
+	settings.m_adaptive = true;
+	for (int budget : adaptiveBudgets)
+	{
+		settings.m_samplesPerPixel = budget;
+		const double error = RMSE(RenderImage(scene, settings, seconds, samples), reference);
+
+		std::cout << std::setw(10) << "adaptive" << std::setw(8) << budget
+			<< std::setw(12) << std::fixed << std::setprecision(2) << (double)samples / reference.size()
+			<< std::setw(10) << std::setprecision(1) << seconds * 1000.0
+			<< std::setw(10) << std::setprecision(4) << error;
+
+		// The uniform error goes down as a power of the samples between two runs
+		size_t match = 1;
+		while (match + 1 < uniformErrors.size() && uniformErrors[match] > error) ++match;
+
+		const double samples0 = uniformSamples[match - 1], samples1 = uniformSamples[match];
+		const double exponent = std::log(uniformErrors[match - 1] / uniformErrors[match]) / std::log(samples1 / samples0);
+		const double uniformSpp = samples0 * std::pow(uniformErrors[match - 1] / error, 1.0 / exponent);
+		const double uniformTime = uniformTimes[match - 1] + (uniformTimes[match] - uniformTimes[match - 1]) * (uniformSpp - samples0) / (samples1 - samples0);
+
+		std::cout << std::setw(9) << std::setprecision(1) << uniformSpp << " spp " << std::setw(8) << uniformTime * 1000.0 << " ms "
+			<< std::setw(5) << uniformTime / seconds << "x" << std::endl;
+	}
+}
+
+// Path tracing with and without next event estimation, the error is measured against
+// a render with many samples that samples the lights
+static void BenchmarkPathScene(const std::string& name, const RTScene& scene)
+{
+	const int samplesPerPixel[] = { 4, 16, 64 };
+
+	RenderSettings settings;
+	settings.m_width = BENCH_PATH_IMAGE_SIZE;
+	settings.m_height = BENCH_PATH_IMAGE_SIZE;
+	settings.m_maxRayDepth = MAX_RAY_DEPTH;
+	settings.m_integrator = RT_PATH_TRACING;
+
+	double seconds;
+	long long samples;
+	settings.m_samplesPerPixel = BENCH_PATH_REFERENCE_SAMPLES;
+	const std::vector<Color> reference = RenderImage(scene, settings, seconds, samples);
+
+	for (int spp : samplesPerPixel)
+	{
+		settings.m_samplesPerPixel = spp;
+
+		settings.m_nextEventEstimation = false;
+		double naiveSeconds;
+		const double naiveError = RMSE(RenderImage(scene, settings, naiveSeconds, samples), reference);
+
+		settings.m_nextEventEstimation = true;
+		double neeSeconds;
+		const double neeError = RMSE(RenderImage(scene, settings, neeSeconds, samples), reference);
+
+		// The error of both estimators goes down as 1 / sqrt(spp)
+		const double naiveRatio = (naiveError / neeError) * (naiveError / neeError);
+
+		std::cout << std::setw(10) << name << std::setw(6) << spp
+			<< std::setw(12) << std::fixed << std::setprecision(1) << naiveSeconds * 1000.0
+			<< std::setw(12) << std::setprecision(4) << naiveError
+			<< std::setw(10) << std::setprecision(1) << neeSeconds * 1000.0
+			<< std::setw(10) << std::setprecision(4) << neeError
+			<< std::setw(14) << std::setprecision(0) << spp * naiveRatio
+			<< std::setw(11) << std::setprecision(1) << naiveRatio * naiveSeconds / neeSeconds << "x" << std::endl;
+	}
+}
+
+static void BenchmarkPathTracing()
+{
+	std::cout << "=== Path tracing, " << BENCH_PATH_IMAGE_SIZE << "x" << BENCH_PATH_IMAGE_SIZE << ", "
+		<< MAX_RAY_DEPTH << " bounces, error against " << BENCH_PATH_REFERENCE_SAMPLES << " spp" << std::endl;
+	std::cout << std::setw(10) << "scene" << std::setw(6) << "spp" << std::setw(12) << "naive ms" << std::setw(12) << "naive RMSE"
+		<< std::setw(10) << "NEE ms" << std::setw(10) << "NEE RMSE" << std::setw(14) << "naive equal" << std::setw(12) << "NEE gain" << std::endl;
+
+	// Only lights and the floor, then the mirror spheres whose caustics no light sampling can reach
+	RTScene scene;
+	scene.LoadDefaultScene(false);
+	scene.BuildAccelerationStructure();
+	BenchmarkPathScene("floor", scene);
+
+	scene.Clear();
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+	BenchmarkPathScene("default", scene);
+}
+
+// Colors as the window and the 8 bit images show them
+static std::vector<Color> Clamped(const std::vector<Color>& image)
+{
+	std::vector<Color> clamped(image.size());
+	for (size_t p = 0; p < image.size(); ++p) clamped[p] = glm::clamp(image[p], 0.f, 1.f);
+	return clamped;
+}
+
+// Error of path traced renders with few samples once denoised, against the number of
+// samples the noisy renders need for the same error. The reference is not denoised.
+// The images are compared as shown, the fireflies of the caustics would outweigh the rest.
+static void BenchmarkDenoiserScene(const std::string& name, const RTScene& scene)
+{
+	const int noisySamples[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+	const int denoisedSamples[] = { 1, 2, 4, 8, 16 };
+
+	RenderSettings settings;
+	settings.m_width = BENCH_DENOISE_IMAGE_SIZE;
+	settings.m_height = BENCH_DENOISE_IMAGE_SIZE;
+	settings.m_maxRayDepth = MAX_RAY_DEPTH;
+	settings.m_integrator = RT_PATH_TRACING;
+
+	double seconds;
+	long long samples;
+	settings.m_samplesPerPixel = BENCH_DENOISE_REFERENCE_SAMPLES;
+	const std::vector<Color> reference = Clamped(RenderImage(scene, settings, seconds, samples));
+
+	std::vector<double> noisyErrors, noisyTimes;
+	for (int spp : noisySamples)
+	{
+		settings.m_samplesPerPixel = spp;
+		noisyErrors.push_back(RMSE(Clamped(RenderImage(scene, settings, seconds, samples)), reference));
+		noisyTimes.push_back(seconds);
+	}
+
+	settings.m_denoise = true;
+	for (int spp : denoisedSamples)
+	{
+		settings.m_samplesPerPixel = spp;
+		const double error = RMSE(Clamped(RenderImage(scene, settings, seconds, samples)), reference);
+
+		// Same interpolation of the noisy runs as for the adaptive sampling
+		size_t match = 1;
+		while (match + 1 < noisyErrors.size() && noisyErrors[match] > error) ++match;
+
+		const double samples0 = noisySamples[match - 1], samples1 = noisySamples[match];
+		const double exponent = std::log(noisyErrors[match - 1] / noisyErrors[match]) / std::log(samples1 / samples0);
+		const double noisySpp = samples0 * std::pow(noisyErrors[match - 1] / error, 1.0 / exponent);
+		const double noisyTime = noisyTimes[match - 1] + (noisyTimes[match] - noisyTimes[match - 1]) * (noisySpp - samples0) / (samples1 - samples0);
+		const size_t same = std::find(std::begin(noisySamples), std::end(noisySamples), spp) - std::begin(noisySamples);
+
+		std::cout << std::setw(10) << name << std::setw(6) << spp
+			<< std::setw(12) << std::fixed << std::setprecision(4) << noisyErrors[same]
+			<< std::setw(10) << std::setprecision(1) << noisyTimes[same] * 1000.0
+			<< std::setw(12) << std::setprecision(4) << error
+			<< std::setw(10) << std::setprecision(1) << seconds * 1000.0
+			<< std::setw(14) << std::setprecision(1) << noisySpp
+			<< std::setw(11) << noisyTime / seconds << "x" << std::endl;
+	}
+}
+
+static void BenchmarkDenoiser()
+{
+	std::cout << "=== Denoiser, " << BENCH_DENOISE_IMAGE_SIZE << "x" << BENCH_DENOISE_IMAGE_SIZE << " path traced, error against "
+		<< BENCH_DENOISE_REFERENCE_SAMPLES << " spp" << std::endl;
+	std::cout << std::setw(10) << "scene" << std::setw(6) << "spp" << std::setw(12) << "noisy RMSE" << std::setw(10) << "ms"
+		<< std::setw(12) << "denoised" << std::setw(10) << "ms" << std::setw(14) << "noisy equal" << std::setw(12) << "gain" << std::endl;
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+	BenchmarkDenoiserScene("default", scene);
+
+	Model model;
+	model.load(BENCH_MODEL_FILENAME);
+	if (!model.vertices().empty())
+	{
+		scene.Clear();
+		scene.LoadDefaultScene(false);
+		scene.AddModelOnFloor(model);
+		scene.BuildAccelerationStructure();
+		BenchmarkDenoiserScene("legoman", scene);
+	}
+}
+
+// Direct lighting of the default scene under many small lights, through the pixel
+// centers: a shadow ray to each light against a few to lights picked by power or
+// down the light BVH. The error is the noise of the picks, against the render that
+// has a ray to each light.
+static void BenchmarkManyLights()
+{
+	const int numLights[] = { 16, 256, 1024, 4096 };
+	const int shadowRays = 4;
+
+	std::cout << "=== Many lights, " << BENCH_LIGHTS_IMAGE_SIZE << "x" << BENCH_LIGHTS_IMAGE_SIZE << " path traced direct lighting, "
+		<< shadowRays << " shadow rays per hit" << std::endl;
+	std::cout << std::setw(8) << "lights" << std::setw(10) << "picked" << std::setw(16) << "shadow rays/px" << std::setw(10) << "ms"
+		<< std::setw(10) << "RMSE" << std::setw(10) << "speedup" << std::endl;
+
+	RenderSettings settings;
+	settings.m_width = BENCH_LIGHTS_IMAGE_SIZE;
+	settings.m_height = BENCH_LIGHTS_IMAGE_SIZE;
+	settings.m_maxRayDepth = 0;
+	settings.m_integrator = RT_PATH_TRACING;
+
+	for (int lights : numLights)
+	{
+		RTScene scene;
+		scene.LoadDefaultScene(true, lights);
+		scene.BuildAccelerationStructure();
+
+		std::vector<Color> reference;
+		double allSeconds = 0.0;
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			settings.m_shadowRays = mode == 0 ? lights : shadowRays;
+			settings.m_lightSelection = mode == 2 ? RT_LIGHTS_TREE : RT_LIGHTS_POWER;
+
+			RenderJob job(scene, settings);
+			const BenchClock::time_point start = BenchClock::now();
+			job.Start();
+			job.Wait();
+			const double seconds = ElapsedSeconds(start);
+
+			std::vector<Color> image;
+			job.CopyImage(image);
+			if (mode == 0)
+			{
+				reference = image;
+				allSeconds = seconds;
+			}
+
+			std::cout << std::setw(8) << lights << std::setw(10) << (mode == 0 ? "all" : mode == 1 ? "power" : "tree")
+				<< std::setw(16) << std::fixed << std::setprecision(1) << (double)job.Stats().m_rays[RT_RAY_SHADOW] / image.size()
+				<< std::setw(10) << seconds * 1000.0
+				<< std::setw(10) << std::setprecision(4) << RMSE(image, reference)
+				<< std::setw(9) << std::setprecision(1) << allSeconds / seconds << "x" << std::endl;
+		}
+	}
+}
+
+// Error of the path traced default scene against a render with many samples, for each
+// sampler, as the window shows the colors. The stratified points help most where few
+// dimensions vary, like the soft shadows of the direct lighting, and less along long paths.
+static void BenchmarkSamplerDepth(const std::string& name, const RTScene& scene, int depth)
+{
+	const int samplesPerPixel[] = { 1, 4, 16, 64 };
+	const RTSamplerType samplers[] = { RT_SAMPLER_RANDOM, RT_SAMPLER_SOBOL, RT_SAMPLER_BLUE_NOISE };
+
+	RenderSettings settings;
+	settings.m_width = BENCH_SAMPLER_IMAGE_SIZE;
+	settings.m_height = BENCH_SAMPLER_IMAGE_SIZE;
+	settings.m_maxRayDepth = depth;
+	settings.m_integrator = RT_PATH_TRACING;
+
+	double seconds;
+	long long samples;
+	settings.m_samplesPerPixel = BENCH_SAMPLER_REFERENCE_SAMPLES;
+	const std::vector<Color> reference = Clamped(RenderImage(scene, settings, seconds, samples));
+
+	for (int spp : samplesPerPixel)
+	{
+		settings.m_samplesPerPixel = spp;
+		std::cout << std::setw(10) << name << std::setw(6) << spp;
+
+		double errors[3];
+		for (int s = 0; s < 3; ++s)
+		{
+			settings.m_sampler = samplers[s];
+			errors[s] = RMSE(Clamped(RenderImage(scene, settings, seconds, samples)), reference);
+			std::cout << std::setw(12) << std::fixed << std::setprecision(4) << errors[s];
+		}
+
+		// Samples the random numbers need for the error of the Sobol points
+		const double gain = (errors[0] / errors[1]) * (errors[0] / errors[1]);
+		std::cout << std::setw(13) << std::setprecision(2) << gain << "x" << std::endl;
+	}
+}
+
+static void BenchmarkSamplers()
+{
+	std::cout << "=== Samplers, " << BENCH_SAMPLER_IMAGE_SIZE << "x" << BENCH_SAMPLER_IMAGE_SIZE << " path traced default scene, "
+		<< "error against " << BENCH_SAMPLER_REFERENCE_SAMPLES << " spp" << std::endl;
+	std::cout << std::setw(10) << "bounces" << std::setw(6) << "spp" << std::setw(12) << "random" << std::setw(12) << "sobol"
+		<< std::setw(12) << "blue noise" << std::setw(14) << "sobol gain" << std::endl;
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+
+	BenchmarkSamplerDepth("0", scene, 0);
+	BenchmarkSamplerDepth(std::to_string(MAX_RAY_DEPTH), scene, MAX_RAY_DEPTH);
+}
+
+// Time the CPU spends on the first hits, which the rasterized G-buffer of the hybrid
+// mode gives for free, against the secondary rays it still traces from them. The
+// G-buffer is made from primary rays here, from the default camera whose view space is
+// the space of the scene.
+static void BenchmarkHybrid()
+{
+	RTScene scene;
+	scene.LoadDefaultScene(false);
+	Model model;
+	model.load(BENCH_MODEL_FILENAME);
+	if (!model.vertices().empty()) scene.AddModelOnFloor(model);
+	scene.BuildAccelerationStructure();
+
+	const RTHybridSettings settings;
+	std::cout << "=== Hybrid shading, " << BENCH_IMAGE_SIZE << "x" << BENCH_IMAGE_SIZE << " model on the floor, "
+		<< settings.m_ambientRays << " ambient occlusion rays and a shadow ray per pixel" << std::endl;
+
+	RTGBuffer gbuffer;
+	gbuffer.m_width = BENCH_IMAGE_SIZE;
+	gbuffer.m_height = BENCH_IMAGE_SIZE;
+	gbuffer.m_positions.resize(BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE);
+	gbuffer.m_normals.resize(BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE);
+	gbuffer.m_lightPosition = scene.Spheres()[scene.Lights()[0]].getCenter();
+
+	const RTCamera camera;
+	BenchClock::time_point start = BenchClock::now();
+	for (int frame = 0; frame < BENCH_HYBRID_FRAMES; ++frame)
+	{
+		for (int y = 0; y < BENCH_IMAGE_SIZE; ++y)
+		{
+			for (int x = 0; x < BENCH_IMAGE_SIZE; ++x)
+			{
+				// The G-buffer rows start at the bottom
+				HitInfo hitInfo;
+				const int pixel = (BENCH_IMAGE_SIZE - 1 - y) * BENCH_IMAGE_SIZE + x;
+				const bool hit = scene.Intersect(camera.GenerateRay(x + 0.5f, y + 0.5f, BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE), hitInfo);
+				gbuffer.m_positions[pixel] = hit ? glm::vec4(hitInfo.m_positionHit, 1.f) : glm::vec4(0.f);
+				gbuffer.m_normals[pixel] = glm::vec4(hitInfo.m_normalHit, 0.f);
+			}
+		}
+	}
+	const double primarySeconds = ElapsedSeconds(start) / BENCH_HYBRID_FRAMES;
+
+	RTHybridSettings singleThread = settings;
+	singleThread.m_numThreads = 1;
+	RTHybridShader shader(scene, singleThread);
+	std::vector<glm::vec2> shading;
+
+	start = BenchClock::now();
+	for (int frame = 0; frame < BENCH_HYBRID_FRAMES; ++frame) shader.Shade(gbuffer, shading);
+	const double secondarySeconds = ElapsedSeconds(start) / BENCH_HYBRID_FRAMES;
+
+	double ambient = 0.0;
+	for (const glm::vec2& pixel : shading) ambient += pixel.x;
+
+	std::cout << std::fixed << std::setprecision(2) << "Primary rays " << primarySeconds * 1e3 << " ms, secondary rays "
+		<< secondarySeconds * 1e3 << " ms (" << shader.LastRays() << " rays), one thread" << std::endl;
+	std::cout << "The G-buffer saves the primary rays, " << std::setprecision(1) << 100.0 * primarySeconds / (primarySeconds + secondarySeconds)
+		<< "% of the ray traced frame, average ambient visibility " << std::setprecision(3) << ambient / shading.size() << std::endl;
+}
+
+// Batches of 1M rays through the camera, and from random points in random directions
+static void BenchmarkQueryScene(const std::string& name, const RTScene& scene)
+{
+	const int numRays = BENCH_QUERY_SIZE * BENCH_QUERY_SIZE;
+	RTRayBatch camera, random;
+	camera.Resize(numRays);
+	random.Resize(numRays);
+
+	const RTCamera view;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> offset(-5.f, 5.f);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	for (int i = 0; i < numRays; ++i)
+	{
+		const Ray ray = view.GenerateRay(i % BENCH_QUERY_SIZE + 0.5f, i / BENCH_QUERY_SIZE + 0.5f, BENCH_QUERY_SIZE, BENCH_QUERY_SIZE);
+		camera.SetRay(i, ray.m_origin, ray.m_direction);
+
+		const float z = 1.f - 2.f * unit(rng), phi = 2.f * PI * unit(rng);
+		const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+		const glm::vec3 origin = view.Position() + glm::vec3(offset(rng), offset(rng), offset(rng) - 10.f);
+		random.SetRay(i, origin, glm::vec3(r * std::cos(phi), r * std::sin(phi), z));
+	}
+
+	RTQuerySettings scalarSettings;
+	scalarSettings.m_packets = false;
+	const RTRayQuery scalarQuery(scene, scalarSettings);
+	const RTRayQuery packetQuery(scene);
+
+	const RTRayBatch* batches[] = { &camera, &random };
+	const char* batchNames[] = { "camera", "random" };
+	for (int b = 0; b < 2; ++b)
+	{
+		const RTRayBatch& rays = *batches[b];
+		RTHitBatch scalarHits, packetHits;
+		std::vector<unsigned char> occluded;
+
+		BenchClock::time_point start = BenchClock::now();
+		scalarQuery.Closest(rays, scalarHits);
+		const double scalarRate = numRays / ElapsedSeconds(start);
+
+		start = BenchClock::now();
+		packetQuery.Closest(rays, packetHits);
+		const double packetRate = numRays / ElapsedSeconds(start);
+
+		start = BenchClock::now();
+		packetQuery.Any(rays, occluded);
+		const double anyRate = numRays / ElapsedSeconds(start);
+
+		// An occluded ray must have a closest hit and the other way round
+		int hits = 0, mismatches = 0;
+		for (int i = 0; i < numRays; ++i)
+		{
+			if (scalarHits.Hit(i)) hits++;
+			if (scalarHits.Hit(i) != packetHits.Hit(i) || scalarHits.Hit(i) != (occluded[i] != 0) ||
+				(scalarHits.Hit(i) && std::abs(scalarHits.m_distance[i] - packetHits.m_distance[i]) > 1e-3f)) mismatches++;
+		}
+
+		std::cout << std::setw(16) << name << std::setw(8) << batchNames[b]
+			<< std::setw(14) << std::fixed << std::setprecision(2) << scalarRate * 1e-6
+			<< std::setw(14) << packetRate * 1e-6
+			<< std::setw(14) << anyRate * 1e-6
+			<< std::setw(8) << std::setprecision(1) << 100.0 * hits / numRays << "%"
+			<< std::setw(12) << mismatches << std::endl;
+	}
+}
+
+static void BenchmarkQueries()
+{
+	std::cout << "=== Batch ray queries, " << BENCH_QUERY_SIZE * BENCH_QUERY_SIZE << " rays per batch, "
+		<< std::max(1u, std::thread::hardware_concurrency()) << " threads" << std::endl;
+	std::cout << std::setw(16) << "scene" << std::setw(8) << "rays" << std::setw(14) << "closest Mr/s" << std::setw(14) << "packet Mr/s"
+		<< std::setw(14) << "any Mr/s" << std::setw(9) << "hits" << std::setw(12) << "mismatches" << std::endl;
+
+	RTScene scene;
+	scene.LoadDefaultScene();
+	scene.BuildAccelerationStructure();
+	BenchmarkQueryScene("default", scene);
+
+	CreateRandomScene(scene, 100000);
+	scene.BuildAccelerationStructure();
+	BenchmarkQueryScene("100000 spheres", scene);
+
+	Model model;
+	model.load(BENCH_MODEL_FILENAME);
+	if (!model.vertices().empty())
+	{
+		scene.Clear();
+		scene.LoadDefaultScene(false);
+		scene.AddModelOnFloor(model);
+		scene.BuildAccelerationStructure();
+		BenchmarkQueryScene("legoman", scene);
+	}
+}
+
+int RunRTBenchmark()
+{
+	BenchmarkBVH();
+	const int gridMismatches = BenchmarkGrid();
+	BenchmarkBVHCache();
+	BenchmarkSphereSweep();
+	BenchmarkPackets();
+	BenchmarkShadowRays();
+	BenchmarkWavefront();
+	BenchmarkAdaptiveSampling();
+	BenchmarkPathTracing();
+	BenchmarkDenoiser();
+	BenchmarkManyLights();
+	BenchmarkSamplers();
+	BenchmarkHybrid();
+	BenchmarkQueries();
+
+	// The grid must find the same spheres as the BVH, the rest only measures
+	if (gridMismatches > 0)
+	{
+		std::cerr << "The grid and the BVH found different closest hits on " << gridMismatches << " rays" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include "Files/RT/headers/rtbvhcache.h"
+#include "Files/RT/headers/rtstream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define RT_BVH_CACHE_MAGIC 0x48564252 // "RBVH", reads backwards on a machine of the other byte order
+#define RT_BVH_CACHE_VERSION 1 // To raise whenever BVH::Build would build another tree from the same input
+#define RT_BVH_CACHE_ALIGNMENT 64
+
+// First bytes of a file, the arrays follow at the offsets it gives
+struct BVHCacheHeader
+{
+	uint32_t m_magic;
+	uint32_t m_version;
+	uint32_t m_nodeSize; // sizeof(BVHNode) of the machine that wrote it
+	uint32_t m_primCount;
+	uint32_t m_maxLeafSize;
+	uint32_t m_primsPerTest;
+	uint64_t m_geometryHash;
+	uint64_t m_nodeOffset;
+	uint64_t m_nodeCount;
+	uint64_t m_indexOffset;
+	uint64_t m_indexCount;
+};
+
+static_assert(sizeof(BVHCacheHeader) == RT_BVH_CACHE_ALIGNMENT, "The nodes follow the header at the first aligned offset");
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + RT_BVH_CACHE_ALIGNMENT - 1) / RT_BVH_CACHE_ALIGNMENT * RT_BVH_CACHE_ALIGNMENT;
+}
+
+// True if the header is the one of key and its arrays fit in a file of fileSize bytes,
+// at offsets the node and index types can be read from in place
+static bool CheckHeader(const BVHCacheHeader& header, const RTBVHCacheKey& key, uint64_t fileSize)
+{
+	if (header.m_magic != RT_BVH_CACHE_MAGIC || header.m_version != RT_BVH_CACHE_VERSION || header.m_nodeSize != sizeof(BVHNode)
+		|| header.m_geometryHash != key.m_geometryHash || header.m_primCount != key.m_primCount
+		|| header.m_maxLeafSize != key.m_maxLeafSize || header.m_primsPerTest != key.m_primsPerTest)
+	{
+		return false;
+	}
+
+	// Every primitive is in one leaf, and a binary tree has at most 2N - 1 nodes
+	if (header.m_indexCount != key.m_primCount || header.m_nodeCount > 2 * (uint64_t)key.m_primCount
+		|| (header.m_nodeCount == 0) != (key.m_primCount == 0))
+	{
+		return false;
+	}
+
+	return header.m_nodeOffset >= sizeof(header) && header.m_nodeOffset % RT_BVH_CACHE_ALIGNMENT == 0
+		&& header.m_indexOffset >= header.m_nodeOffset + header.m_nodeCount * sizeof(BVHNode)
+		&& header.m_indexOffset % sizeof(unsigned int) == 0
+		&& fileSize >= header.m_indexOffset + header.m_indexCount * sizeof(unsigned int);
+}
+
+RTBVHCache::RTBVHCache(const std::string& directory) : m_directory(directory), m_numLoaded(0), m_numSaved(0)
+{
+}
+
+RTBVHCacheKey RTBVHCache::Key(const std::vector<AABB>& primBounds, int maxLeafSize, int primsPerTest)
+{
+	RTHash hash;
+	for (const AABB& bounds : primBounds)
+	{
+		hash.AddVec3(bounds.m_min);
+		hash.AddVec3(bounds.m_max);
+	}
+
+	RTBVHCacheKey key;
+	key.m_geometryHash = hash.m_value;
+	key.m_primCount = (uint32_t)primBounds.size();
+	key.m_maxLeafSize = (uint32_t)std::max(1, maxLeafSize);
+	key.m_primsPerTest = (uint32_t)std::max(1, primsPerTest);
+	return key;
+}
+
+std::string RTBVHCache::Filename(const RTBVHCacheKey& key) const
+{
+	std::ostringstream name;
+	if (!m_directory.empty()) name << m_directory << "/";
+	name << std::hex << std::setw(16) << std::setfill('0') << key.m_geometryHash << std::dec
+		<< "_" << key.m_maxLeafSize << "_" << key.m_primsPerTest << ".bvh";
+	return name.str();
+}
+
+bool RTBVHCache::Build(BVH& bvh, const std::vector<AABB>& primBounds, int maxLeafSize, int primsPerTest)
+{
+	const RTBVHCacheKey key = Key(primBounds, maxLeafSize, primsPerTest);
+	const std::string filename = Filename(key);
+	if (Load(filename, key, bvh))
+	{
+		m_numLoaded++;
+		return true;
+	}
+
+	bvh.Build(primBounds, maxLeafSize, primsPerTest);
+	if (Save(filename, key, bvh)) m_numSaved++;
+	return false;
+}
+
+bool RTBVHCache::Save(const std::string& filename, const RTBVHCacheKey& key, const BVH& bvh)
+{
+	const BVHArray<BVHNode> nodes = bvh.Nodes();
+	const BVHArray<unsigned int> primIndices = bvh.PrimIndices();
+
+	BVHCacheHeader header;
+	header.m_magic = RT_BVH_CACHE_MAGIC;
+	header.m_version = RT_BVH_CACHE_VERSION;
+	header.m_nodeSize = sizeof(BVHNode);
+	header.m_primCount = key.m_primCount;
+	header.m_maxLeafSize = key.m_maxLeafSize;
+	header.m_primsPerTest = key.m_primsPerTest;
+	header.m_geometryHash = key.m_geometryHash;
+	header.m_nodeOffset = sizeof(BVHCacheHeader);
+	header.m_nodeCount = nodes.size();
+	header.m_indexOffset = AlignOffset(header.m_nodeOffset + nodes.size() * sizeof(BVHNode));
+	header.m_indexCount = primIndices.size();
+
+	// Written aside and renamed once complete, a reader never sees half a file
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename, std::ios::binary);
+		if (!file) return false;
+
+		const char padding[RT_BVH_CACHE_ALIGNMENT] = {};
+		const uint64_t nodeEnd = header.m_nodeOffset + nodes.size() * sizeof(BVHNode);
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)nodes.data(), nodes.size() * sizeof(BVHNode));
+		file.write(padding, header.m_indexOffset - nodeEnd);
+		file.write((const char*)primIndices.data(), primIndices.size() * sizeof(unsigned int));
+		if (!file)
+		{
+			file.close();
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool RTBVHCache::Load(const std::string& filename, const RTBVHCacheKey& key, BVH& bvh)
+{
+#if !defined(_WIN32)
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat status;
+	const bool mappable = fstat(fd, &status) == 0 && (uint64_t)status.st_size >= sizeof(BVHCacheHeader);
+	void* address = mappable ? mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (address == MAP_FAILED) return false;
+
+	// The BVH keeps the mapping for as long as any copy of it traverses the arrays. A
+	// save over the file renames a new one in its place, this one stays as it was.
+	const size_t size = (size_t)status.st_size;
+	std::shared_ptr<const void> mapping(address, [size](const void* mapped) { munmap((void*)mapped, size); });
+
+	const char* bytes = (const char*)address;
+	const BVHCacheHeader& header = *(const BVHCacheHeader*)bytes;
+	if (!CheckHeader(header, key, size)) return false;
+
+	// The pages are read as the traversal touches them
+	bvh.AssignExternal((const BVHNode*)(bytes + header.m_nodeOffset), (size_t)header.m_nodeCount,
+		(const unsigned int*)(bytes + header.m_indexOffset), (size_t)header.m_indexCount, (int)key.m_primsPerTest, mapping);
+	return true;
+#else
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+
+	BVHCacheHeader header;
+	if (!file.read((char*)&header, sizeof(header))) return false;
+
+	file.seekg(0, std::ios::end);
+	if (!CheckHeader(header, key, (uint64_t)file.tellg())) return false;
+
+	// Read as they are, the traversal takes them without any change
+	std::vector<BVHNode> nodes((size_t)header.m_nodeCount);
+	std::vector<unsigned int> primIndices((size_t)header.m_indexCount);
+	file.seekg((std::streamoff)header.m_nodeOffset);
+	file.read((char*)nodes.data(), nodes.size() * sizeof(BVHNode));
+	file.seekg((std::streamoff)header.m_indexOffset);
+	file.read((char*)primIndices.data(), primIndices.size() * sizeof(unsigned int));
+	if (!file) return false;
+
+	bvh.Assign(nodes, primIndices, (int)key.m_primsPerTest);
+	return true;
+#endif
+}
@@ -0,0 +1,78 @@
+#include "Files/RT/headers/rtcamera.h"
+#include "Files/definitions.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The pitch stops short of the vertical, the right axis would flip
+#define RT_CAMERA_MAX_PITCH 89.f
+
+RTCamera::RTCamera()
+{
+	Set(glm::vec3(0.f), 0.f, 0.f, 30.f);
+}
+
+void RTCamera::Set(const glm::vec3& position, float yaw, float pitch, float fov)
+{
+	m_position = position;
+	m_yaw = yaw;
+	m_pitch = std::max(-RT_CAMERA_MAX_PITCH, std::min(RT_CAMERA_MAX_PITCH, pitch));
+	m_fov = fov;
+	UpdateVectors();
+}
+
+void RTCamera::Move(float forward, float right, float up)
+{
+	m_position += m_front * forward + m_right * right + m_up * up;
+}
+
+void RTCamera::Turn(float yaw, float pitch)
+{
+	Set(m_position, m_yaw + yaw, m_pitch + pitch, m_fov);
+}
+
+Ray RTCamera::GenerateRay(float x, float y, int width, int height) const
+{
+	const float aspectratio = width / float(height);
+
+	float xx = (2 * (x / width) - 1) * m_tanHalfFov * aspectratio;
+	float yy = (1 - 2 * (y / height)) * m_tanHalfFov;
+	glm::vec3 rayDir = m_right * xx + m_up * yy + m_front;
+	rayDir = glm::normalize(rayDir);
+
+	return Ray(m_position, rayDir);
+}
+
+bool RTCamera::Project(const glm::vec3& point, int width, int height, float& x, float& y) const
+{
+	const glm::vec3 toPoint = point - m_position;
+	const float depth = glm::dot(toPoint, m_front);
+	if (depth <= 0.f) return false;
+
+	const float aspectratio = width / float(height);
+	const float xx = glm::dot(toPoint, m_right) / depth;
+	const float yy = glm::dot(toPoint, m_up) / depth;
+
+	x = (xx / (m_tanHalfFov * aspectratio) + 1) * 0.5f * width;
+	y = (1 - yy / m_tanHalfFov) * 0.5f * height;
+
+	// A point just in front of the camera plane projects far away or to no number at all,
+	// the comparisons are false for NaNs
+	return x >= 0.f && x <= width && y >= 0.f && y <= height;
+}
+
+bool RTCamera::operator==(const RTCamera& other) const
+{
+	return m_position == other.m_position && m_yaw == other.m_yaw && m_pitch == other.m_pitch && m_fov == other.m_fov;
+}
+
+void RTCamera::UpdateVectors()
+{
+	const float yaw = glm::radians(m_yaw), pitch = glm::radians(m_pitch);
+	m_tanHalfFov = tan(PI * 0.5 * m_fov / 180.);
+
+	// Exact axes for the default camera, its rays are the ones of the fixed camera
+	m_front = glm::vec3(std::sin(yaw) * std::cos(pitch), std::sin(pitch), -std::cos(yaw) * std::cos(pitch));
+	m_right = glm::vec3(std::cos(yaw), 0.f, std::sin(yaw));
+	m_up = glm::cross(m_right, m_front);
+}
@@ -0,0 +1,689 @@
+#include "Files/RT/headers/rtdistributed.h"
+#include "Files/RT/headers/rtscene.h"
+#include "Files/RT/headers/rtsocket.h"
+#include "Files/RT/headers/rtstream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+#define RT_DISTRIBUTED_MAGIC 0x31445452 // "RTD1", to change with the messages
+#define RT_DISTRIBUTED_TILE_SIZE 32
+#define RT_DISTRIBUTED_TILES_PER_WORKER 2 // The next tile is already there when a worker sends its result
+#define RT_DISTRIBUTED_MAX_COPIES 2 // Workers rendering a slow tile at once
+#define RT_DISTRIBUTED_SLOW_FACTOR 3.0 // Tiles held this many times longer than the mean are given to another worker
+#define RT_DISTRIBUTED_POLL_MS 100
+#define RT_DISTRIBUTED_RECEIVE_SIZE 65536
+#define RT_DISTRIBUTED_MAX_MESSAGE (1u << 30)
+#define RT_DISTRIBUTED_MAX_IMAGE_SIZE 32768
+#define RT_DISTRIBUTED_SEND_TIMEOUT_SECONDS 10.0
+#define RT_DISTRIBUTED_WAIT_SECONDS 30.0 // Time without any worker before the rendering gives up
+#define RT_WORKER_CONNECT_SECONDS 30.0
+#define RT_WORKER_CONNECT_RETRY_MS 100
+#define RT_WORKER_EXIT_WAIT_MS 2000
+
+enum RTMessageType
+{
+	RT_MESSAGE_SCENE = 1, // Magic, settings and scene, sent once to each worker
+	RT_MESSAGE_TILE, // Tile index and bounds
+	RT_MESSAGE_RESULT, // Tile index and its colors
+	RT_MESSAGE_QUIT
+};
+
+typedef std::chrono::steady_clock DistributedClock;
+
+static double ElapsedSeconds(const DistributedClock::time_point& start)
+{
+	return std::chrono::duration<double>(DistributedClock::now() - start).count();
+}
+
+// Messages are their type and payload size followed by the payload
+static bool SendRTMessage(RTSocket& socket, uint32_t type, const std::vector<unsigned char>& payload)
+{
+	RTStreamWriter header;
+	header.WriteUInt32(type);
+	header.WriteUInt32((uint32_t)payload.size());
+
+	return socket.SendAll(header.m_data.data(), header.m_data.size()) && (payload.empty() || socket.SendAll(payload.data(), payload.size()));
+}
+
+static bool ReceiveRTMessage(RTSocket& socket, uint32_t& type, std::vector<unsigned char>& payload)
+{
+	unsigned char header[8];
+	if (!socket.ReceiveAll(header, sizeof(header))) return false;
+
+	RTStreamReader reader(header, sizeof(header));
+	type = reader.ReadUInt32();
+	const uint32_t size = reader.ReadUInt32();
+	if (size > RT_DISTRIBUTED_MAX_MESSAGE) return false;
+
+	payload.resize(size);
+	return size == 0 || socket.ReceiveAll(payload.data(), size);
+}
+
+// Only what the tracer uses, the workers know nothing of the preview, adaptive sampling or denoising
+static void WriteSettings(RTStreamWriter& stream, const RenderSettings& settings)
+{
+	stream.WriteInt32(settings.m_width);
+	stream.WriteInt32(settings.m_height);
+	stream.WriteInt32(settings.m_maxRayDepth);
+	stream.WriteVec3(settings.m_backgroundColor);
+	stream.WriteFloat(settings.m_epsilonFactor);
+	stream.WriteInt32(settings.m_samplesPerPixel);
+	stream.WriteInt32((int)settings.m_integrator);
+	stream.WriteUInt32(settings.m_nextEventEstimation ? 1 : 0);
+	stream.WriteInt32((int)settings.m_lightSelection);
+	stream.WriteInt32(settings.m_shadowRays);
+	stream.WriteInt32((int)settings.m_sampler);
+
+	const RTCamera& camera = settings.m_camera;
+	stream.WriteVec3(camera.Position());
+	stream.WriteFloat(camera.Yaw());
+	stream.WriteFloat(camera.Pitch());
+	stream.WriteFloat(camera.FieldOfView());
+}
+
+static bool ReadSettings(RTStreamReader& stream, RenderSettings& settings)
+{
+	settings.m_width = stream.ReadInt32();
+	settings.m_height = stream.ReadInt32();
+	settings.m_maxRayDepth = stream.ReadInt32();
+	settings.m_backgroundColor = stream.ReadVec3();
+	settings.m_epsilonFactor = stream.ReadFloat();
+	settings.m_samplesPerPixel = stream.ReadInt32();
+	const int integrator = stream.ReadInt32();
+	settings.m_nextEventEstimation = stream.ReadUInt32() != 0;
+	const int lightSelection = stream.ReadInt32();
+	settings.m_shadowRays = stream.ReadInt32();
+	const int sampler = stream.ReadInt32();
+	const glm::vec3 cameraPosition = stream.ReadVec3();
+	const float cameraYaw = stream.ReadFloat();
+	const float cameraPitch = stream.ReadFloat();
+	const float cameraFov = stream.ReadFloat();
+	settings.m_camera.Set(cameraPosition, cameraYaw, cameraPitch, cameraFov);
+
+	settings.m_integrator = integrator == RT_PATH_TRACING ? RT_PATH_TRACING : RT_WHITTED;
+	settings.m_lightSelection = lightSelection == RT_LIGHTS_POWER ? RT_LIGHTS_POWER : RT_LIGHTS_TREE;
+	settings.m_sampler = sampler == RT_SAMPLER_RANDOM ? RT_SAMPLER_RANDOM : sampler == RT_SAMPLER_BLUE_NOISE ? RT_SAMPLER_BLUE_NOISE : RT_SAMPLER_SOBOL;
+	return !stream.m_failed && integrator >= RT_WHITTED && integrator <= RT_PATH_TRACING
+		&& lightSelection >= RT_LIGHTS_POWER && lightSelection <= RT_LIGHTS_TREE && settings.m_shadowRays > 0
+		&& sampler >= RT_SAMPLER_RANDOM && sampler <= RT_SAMPLER_BLUE_NOISE
+		&& cameraFov > 0.f && cameraFov < 180.f
+		&& settings.m_width > 0 && settings.m_width <= RT_DISTRIBUTED_MAX_IMAGE_SIZE
+		&& settings.m_height > 0 && settings.m_height <= RT_DISTRIBUTED_MAX_IMAGE_SIZE
+		&& settings.m_maxRayDepth >= 0 && settings.m_samplesPerPixel > 0;
+}
+
+// Averages the samples of the pixels of the tile into colors, row by row over the threads.
+// The sampler keys the samples by pixel, a tile rendered again by another worker comes out
+// the same, and the same as the tile rendered by the workstation itself.
+static void RenderWorkerTile(const RayTracer& tracer, int x0, int y0, int x1, int y1, int numThreads, std::vector<Color>& colors)
+{
+	const RenderSettings& settings = tracer.Settings();
+	const int tileWidth = x1 - x0;
+	colors.assign(tileWidth * (y1 - y0), Color(0.f));
+
+	std::atomic<int> nextRow(y0);
+	auto renderRows = [&]()
+	{
+		TraceContext context;
+		std::vector<int> pixels(tileWidth);
+		std::vector<int> sampleIndices(tileWidth);
+		std::vector<Color> sampleColors(tileWidth);
+
+		for (int y = nextRow++; y < y1; y = nextRow++)
+		{
+			for (int x = x0; x < x1; ++x) pixels[x - x0] = y * settings.m_width + x;
+
+			Color* rowColors = &colors[(y - y0) * tileWidth];
+			for (int sample = 0; sample < settings.m_samplesPerPixel; ++sample)
+			{
+				// Several samples are jittered inside the pixels, a single sample goes through their center
+				std::fill(sampleIndices.begin(), sampleIndices.end(), sample);
+				tracer.TracePixels(pixels.data(), sampleIndices.data(), tileWidth, settings.m_samplesPerPixel > 1, 0, context, sampleColors.data());
+				for (int x = 0; x < tileWidth; ++x) rowColors[x] += sampleColors[x];
+			}
+
+			const float invSamples = 1.f / settings.m_samplesPerPixel;
+			for (int x = 0; x < tileWidth; ++x) rowColors[x] *= invSamples;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < std::min(numThreads, y1 - y0); ++t) threads.push_back(std::thread(renderRows));
+	renderRows();
+	for (std::thread& thread : threads) thread.join();
+}
+
+struct DistributedTile
+{
+	int m_x0, m_y0, m_x1, m_y1;
+	bool m_done;
+	int m_copies; // Workers rendering it now
+	DistributedClock::time_point m_sentTime; // When the first of these copies was sent
+};
+
+struct WorkerConnection
+{
+	RTSocket m_socket;
+	std::vector<unsigned char> m_received; // Start of the next messages
+	std::vector<int> m_tiles; // Sent and not returned yet
+};
+
+// Hands out the tiles and gathers them from a single thread, waiting on all the
+// sockets at once
+class DistributedCoordinator
+{
+public:
+	DistributedCoordinator(const RenderSettings& settings, std::vector<Color>& image);
+	~DistributedCoordinator();
+
+	bool Run(const RTScene& scene, const RTDistributedOptions& options);
+
+private:
+	bool StartLocalWorkers(const RTDistributedOptions& options);
+	void ReapLocalWorkers(bool wait);
+
+	void AcceptWorker();
+	void ReceiveFrom(WorkerConnection& worker);
+	bool HandleResult(WorkerConnection& worker, const unsigned char* payload, size_t size);
+	void DropWorker(WorkerConnection& worker, const char* reason);
+
+	void HandOutTiles();
+	int SlowTile(const WorkerConnection& worker) const;
+	bool SendTile(WorkerConnection& worker, int tile);
+
+	void ShowProgress();
+
+private:
+	RenderSettings m_settings;
+	std::vector<Color>& m_image;
+
+	RTSocket m_listener;
+	std::vector<unsigned char> m_sceneMessage;
+	std::deque<WorkerConnection> m_workers;
+	std::vector<pid_t> m_localWorkers;
+	int m_workersConnected;
+
+	std::vector<DistributedTile> m_tiles;
+	std::deque<int> m_pendingTiles; // Never sent or taken back from a lost worker
+	int m_tilesDone;
+	double m_tileSecondsSum; // Time from sending a tile to its result, summed over the first copies
+	int m_tilesTimed;
+	int m_tilesReissued;
+	int m_tilesDuplicated;
+	int m_shownPercent;
+};
+
+DistributedCoordinator::DistributedCoordinator(const RenderSettings& settings, std::vector<Color>& image) :
+	m_settings(settings), m_image(image), m_workersConnected(0), m_tilesDone(0), m_tileSecondsSum(0.0), m_tilesTimed(0),
+	m_tilesReissued(0), m_tilesDuplicated(0), m_shownPercent(-1)
+{
+	for (int y = 0; y < settings.m_height; y += RT_DISTRIBUTED_TILE_SIZE)
+	{
+		for (int x = 0; x < settings.m_width; x += RT_DISTRIBUTED_TILE_SIZE)
+		{
+			DistributedTile tile;
+			tile.m_x0 = x;
+			tile.m_y0 = y;
+			tile.m_x1 = std::min(x + RT_DISTRIBUTED_TILE_SIZE, settings.m_width);
+			tile.m_y1 = std::min(y + RT_DISTRIBUTED_TILE_SIZE, settings.m_height);
+			tile.m_done = false;
+			tile.m_copies = 0;
+
+			m_pendingTiles.push_back((int)m_tiles.size());
+			m_tiles.push_back(tile);
+		}
+	}
+
+	m_image.assign(settings.m_width * settings.m_height, Color(0.f));
+}
+
+DistributedCoordinator::~DistributedCoordinator()
+{
+	// Workers still running are told to stop, the local ones are waited for
+	const std::vector<unsigned char> noPayload;
+	for (WorkerConnection& worker : m_workers)
+	{
+		if (worker.m_socket.IsValid()) SendRTMessage(worker.m_socket, RT_MESSAGE_QUIT, noPayload);
+		worker.m_socket.Close();
+	}
+	m_listener.Close();
+
+	ReapLocalWorkers(true);
+}
+
+bool DistributedCoordinator::Run(const RTScene& scene, const RTDistributedOptions& options)
+{
+	// Without an address the local workers come through a socket of this process only
+	const std::string address = options.m_address.empty() ? "unix:/tmp/rt-coordinator-" + std::to_string(getpid()) + ".sock" : options.m_address;
+
+	std::string error;
+	if (!m_listener.Listen(address, error))
+	{
+		std::cerr << "Cannot listen for workers: " << error << std::endl;
+		return false;
+	}
+
+	std::cout << "Waiting for workers on " << m_listener.Address() << std::endl;
+
+	RTStreamWriter sceneMessage;
+	sceneMessage.WriteUInt32(RT_DISTRIBUTED_MAGIC);
+	WriteSettings(sceneMessage, m_settings);
+	scene.Write(sceneMessage);
+	m_sceneMessage.swap(sceneMessage.m_data);
+
+	if (!StartLocalWorkers(options)) return false;
+
+	// Only the local workers can reach a socket nobody was told about
+	const bool onlyLocalWorkers = options.m_address.empty();
+	DistributedClock::time_point lastWorkerTime = DistributedClock::now();
+
+	std::vector<pollfd> handles;
+	while (m_tilesDone < (int)m_tiles.size())
+	{
+		ReapLocalWorkers(false);
+
+		if (!m_workers.empty())
+		{
+			lastWorkerTime = DistributedClock::now();
+		}
+		else if ((onlyLocalWorkers && m_localWorkers.empty()) || ElapsedSeconds(lastWorkerTime) > RT_DISTRIBUTED_WAIT_SECONDS)
+		{
+			std::cerr << std::endl << "No worker left to render the image" << std::endl;
+			return false;
+		}
+
+		handles.clear();
+		pollfd handle;
+		handle.fd = m_listener.Handle();
+		handle.events = POLLIN;
+		handle.revents = 0;
+		handles.push_back(handle);
+		for (const WorkerConnection& worker : m_workers)
+		{
+			handle.fd = worker.m_socket.Handle();
+			handles.push_back(handle);
+		}
+
+		if (poll(handles.data(), handles.size(), RT_DISTRIBUTED_POLL_MS) < 0 && errno != EINTR)
+		{
+			std::cerr << "Waiting for the workers failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+
+		// Workers accepted below are not in handles, they are polled from the next round
+		const size_t numPolled = handles.size() - 1;
+		for (size_t i = 0; i < numPolled; ++i)
+		{
+			if (handles[i + 1].revents != 0) ReceiveFrom(m_workers[i]);
+		}
+
+		if (handles[0].revents & POLLIN) AcceptWorker();
+
+		for (auto worker = m_workers.begin(); worker != m_workers.end();)
+		{
+			worker = worker->m_socket.IsValid() ? worker + 1 : m_workers.erase(worker);
+		}
+
+		HandOutTiles();
+		ShowProgress();
+	}
+
+	std::cout << "\r" << m_tiles.size() << " tiles rendered by " << m_workersConnected << " workers";
+	if (m_tilesReissued > 0) std::cout << ", " << m_tilesReissued << " taken back from lost workers";
+	if (m_tilesDuplicated > 0) std::cout << ", " << m_tilesDuplicated << " also given to a second worker";
+	std::cout << std::endl;
+	return true;
+}
+
+bool DistributedCoordinator::StartLocalWorkers(const RTDistributedOptions& options)
+{
+	if (options.m_numLocalWorkers <= 0) return true;
+
+	if (options.m_workerProgram.empty())
+	{
+		std::cerr << "No program to start the workers with" << std::endl;
+		return false;
+	}
+
+	const std::string address = m_listener.Address();
+	const std::string threads = std::to_string(options.m_workerThreads);
+	const char* arguments[] = { options.m_workerProgram.c_str(), "--rt-worker", address.c_str(), "--threads", threads.c_str(), nullptr };
+
+	for (int i = 0; i < options.m_numLocalWorkers; ++i)
+	{
+		pid_t pid;
+		const int status = posix_spawn(&pid, options.m_workerProgram.c_str(), nullptr, nullptr, (char* const*)arguments, environ);
+		if (status != 0)
+		{
+			std::cerr << "Cannot start the worker " << options.m_workerProgram << ": " << strerror(status) << std::endl;
+			return false;
+		}
+
+		m_localWorkers.push_back(pid);
+	}
+
+	return true;
+}
+
+void DistributedCoordinator::ReapLocalWorkers(bool wait)
+{
+	// The workers quit on their own once they have nothing more to do, the
+	// ones that do not in time are killed
+	const DistributedClock::time_point start = DistributedClock::now();
+	bool killed = false;
+
+	while (!m_localWorkers.empty())
+	{
+		for (auto pid = m_localWorkers.begin(); pid != m_localWorkers.end();)
+		{
+			pid = waitpid(*pid, nullptr, WNOHANG) != 0 ? m_localWorkers.erase(pid) : pid + 1;
+		}
+
+		if (!wait || m_localWorkers.empty()) break;
+
+		if (!killed && ElapsedSeconds(start) * 1000.0 > RT_WORKER_EXIT_WAIT_MS)
+		{
+			for (pid_t pid : m_localWorkers) kill(pid, SIGKILL);
+			killed = true;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void DistributedCoordinator::AcceptWorker()
+{
+	WorkerConnection worker;
+	worker.m_socket = m_listener.Accept();
+	if (!worker.m_socket.IsValid()) return;
+
+	worker.m_socket.SetSendTimeout(RT_DISTRIBUTED_SEND_TIMEOUT_SECONDS);
+	if (!SendRTMessage(worker.m_socket, RT_MESSAGE_SCENE, m_sceneMessage)) return;
+
+	m_workers.push_back(std::move(worker));
+	m_workersConnected++;
+}
+
+void DistributedCoordinator::ReceiveFrom(WorkerConnection& worker)
+{
+	unsigned char buffer[RT_DISTRIBUTED_RECEIVE_SIZE];
+	const long received = worker.m_socket.Receive(buffer, sizeof(buffer));
+	if (received <= 0)
+	{
+		DropWorker(worker, "disconnected");
+		return;
+	}
+
+	worker.m_received.insert(worker.m_received.end(), buffer, buffer + received);
+
+	size_t position = 0;
+	while (worker.m_received.size() - position >= 8)
+	{
+		RTStreamReader header(&worker.m_received[position], 8);
+		const uint32_t type = header.ReadUInt32();
+		const uint32_t size = header.ReadUInt32();
+		if (type != RT_MESSAGE_RESULT || size > RT_DISTRIBUTED_MAX_MESSAGE)
+		{
+			DropWorker(worker, "sent an invalid message");
+			return;
+		}
+
+		if (worker.m_received.size() - position - 8 < size) break;
+
+		if (!HandleResult(worker, &worker.m_received[position + 8], size))
+		{
+			DropWorker(worker, "sent an invalid tile");
+			return;
+		}
+		position += 8 + size;
+	}
+
+	worker.m_received.erase(worker.m_received.begin(), worker.m_received.begin() + position);
+}
+
+bool DistributedCoordinator::HandleResult(WorkerConnection& worker, const unsigned char* payload, size_t size)
+{
+	RTStreamReader reader(payload, size);
+	const int index = reader.ReadInt32();
+
+	auto sent = std::find(worker.m_tiles.begin(), worker.m_tiles.end(), index);
+	if (reader.m_failed || sent == worker.m_tiles.end()) return false;
+
+	DistributedTile& tile = m_tiles[index];
+	const int tileWidth = tile.m_x1 - tile.m_x0;
+	if (size != 4 + sizeof(float) * 3 * tileWidth * (tile.m_y1 - tile.m_y0)) return false;
+
+	worker.m_tiles.erase(sent);
+	tile.m_copies--;
+
+	// The first copy of a tile to come back is kept
+	if (tile.m_done) return true;
+
+	for (int y = tile.m_y0; y < tile.m_y1; ++y)
+	{
+		Color* pixel = &m_image[y * m_settings.m_width + tile.m_x0];
+		for (int x = 0; x < tileWidth; ++x) pixel[x] = reader.ReadVec3();
+	}
+
+	tile.m_done = true;
+	m_tilesDone++;
+	m_tileSecondsSum += ElapsedSeconds(tile.m_sentTime);
+	m_tilesTimed++;
+	return true;
+}
+
+void DistributedCoordinator::DropWorker(WorkerConnection& worker, const char* reason)
+{
+	int reissued = 0;
+	for (int index : worker.m_tiles)
+	{
+		DistributedTile& tile = m_tiles[index];
+		if (--tile.m_copies == 0 && !tile.m_done)
+		{
+			m_pendingTiles.push_front(index);
+			reissued++;
+		}
+	}
+	m_tilesReissued += reissued;
+
+	std::cout << "\rA worker " << reason << ", " << reissued << " of its tiles go to the others" << std::endl;
+	m_shownPercent = -1;
+
+	worker.m_tiles.clear();
+	worker.m_socket.Close();
+}
+
+void DistributedCoordinator::HandOutTiles()
+{
+	for (WorkerConnection& worker : m_workers)
+	{
+		while (worker.m_socket.IsValid() && worker.m_tiles.size() < RT_DISTRIBUTED_TILES_PER_WORKER)
+		{
+			int tile = -1;
+			bool duplicate = false;
+			if (!m_pendingTiles.empty())
+			{
+				tile = m_pendingTiles.front();
+				m_pendingTiles.pop_front();
+			}
+			else
+			{
+				tile = SlowTile(worker);
+				if (tile < 0) break;
+				duplicate = true;
+			}
+
+			// A copy only counts once a worker has it
+			if (!SendTile(worker, tile)) DropWorker(worker, "stopped taking tiles");
+			else if (duplicate) m_tilesDuplicated++;
+		}
+	}
+}
+
+int DistributedCoordinator::SlowTile(const WorkerConnection& worker) const
+{
+	// Nothing is known of the time a tile takes before the first ones come back
+	if (m_tilesTimed == 0) return -1;
+
+	const double slowSeconds = RT_DISTRIBUTED_SLOW_FACTOR * m_tileSecondsSum / m_tilesTimed;
+
+	int slowest = -1;
+	double slowestSeconds = slowSeconds;
+	for (const WorkerConnection& other : m_workers)
+	{
+		if (&other == &worker) continue;
+
+		for (int index : other.m_tiles)
+		{
+			const DistributedTile& tile = m_tiles[index];
+			if (tile.m_done || tile.m_copies >= RT_DISTRIBUTED_MAX_COPIES) continue;
+			if (std::find(worker.m_tiles.begin(), worker.m_tiles.end(), index) != worker.m_tiles.end()) continue;
+
+			const double seconds = ElapsedSeconds(tile.m_sentTime);
+			if (seconds > slowestSeconds)
+			{
+				slowest = index;
+				slowestSeconds = seconds;
+			}
+		}
+	}
+
+	return slowest;
+}
+
+bool DistributedCoordinator::SendTile(WorkerConnection& worker, int index)
+{
+	DistributedTile& tile = m_tiles[index];
+	if (tile.m_copies++ == 0) tile.m_sentTime = DistributedClock::now();
+	worker.m_tiles.push_back(index);
+
+	RTStreamWriter message;
+	message.WriteInt32(index);
+	message.WriteInt32(tile.m_x0);
+	message.WriteInt32(tile.m_y0);
+	message.WriteInt32(tile.m_x1);
+	message.WriteInt32(tile.m_y1);
+	return SendRTMessage(worker.m_socket, RT_MESSAGE_TILE, message.m_data);
+}
+
+void DistributedCoordinator::ShowProgress()
+{
+	const int percent = (int)(100.0 * m_tilesDone / m_tiles.size());
+	if (percent == m_shownPercent) return;
+
+	std::cout << "\rRendering " << std::setw(3) << percent << "% on " << m_workers.size() << " workers " << std::flush;
+	m_shownPercent = percent;
+}
+
+bool RenderDistributed(const RTScene& scene, const RenderSettings& settings, const RTDistributedOptions& options, std::vector<Color>& image)
+{
+	DistributedCoordinator coordinator(settings, image);
+	return coordinator.Run(scene, options);
+}
+
+int RunRTWorker(const std::string& address, int numThreads)
+{
+	// The coordinator may not listen yet when its workers start
+	RTSocket socket;
+	std::string error;
+	const DistributedClock::time_point start = DistributedClock::now();
+	while (!socket.Connect(address, error))
+	{
+		if (ElapsedSeconds(start) > RT_WORKER_CONNECT_SECONDS)
+		{
+			std::cerr << "Cannot connect to the coordinator: " << error << std::endl;
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(RT_WORKER_CONNECT_RETRY_MS));
+	}
+
+	uint32_t type;
+	std::vector<unsigned char> payload;
+	if (!ReceiveRTMessage(socket, type, payload) || type != RT_MESSAGE_SCENE)
+	{
+		std::cerr << "The coordinator sent no scene" << std::endl;
+		return 1;
+	}
+
+	RTStreamReader sceneReader(payload.data(), payload.size());
+	if (sceneReader.ReadUInt32() != RT_DISTRIBUTED_MAGIC)
+	{
+		std::cerr << "The coordinator is another version of the renderer" << std::endl;
+		return 1;
+	}
+
+	RenderSettings settings;
+	RTScene scene;
+	if (!ReadSettings(sceneReader, settings) || !scene.Read(sceneReader))
+	{
+		std::cerr << "The coordinator sent an invalid scene" << std::endl;
+		return 1;
+	}
+
+	scene.BuildAccelerationStructure();
+	RayTracer tracer(scene, settings);
+
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<Color> colors;
+	while (ReceiveRTMessage(socket, type, payload))
+	{
+		if (type == RT_MESSAGE_QUIT) return 0;
+
+		RTStreamReader tileReader(payload.data(), payload.size());
+		const int index = tileReader.ReadInt32();
+		const int x0 = tileReader.ReadInt32();
+		const int y0 = tileReader.ReadInt32();
+		const int x1 = tileReader.ReadInt32();
+		const int y1 = tileReader.ReadInt32();
+		if (type != RT_MESSAGE_TILE || tileReader.m_failed || x0 < 0 || y0 < 0 || x1 <= x0 || y1 <= y0 || x1 > settings.m_width || y1 > settings.m_height)
+		{
+			std::cerr << "The coordinator sent an invalid tile" << std::endl;
+			return 1;
+		}
+
+		RenderWorkerTile(tracer, x0, y0, x1, y1, numThreads, colors);
+
+		RTStreamWriter result;
+		result.WriteInt32(index);
+		result.WriteFloats(&colors[0].x, colors.size() * 3);
+		if (!SendRTMessage(socket, RT_MESSAGE_RESULT, result.m_data)) break;
+	}
+
+	// The coordinator went away, it either has the image or gave up on it
+	return 0;
+}
+
+#else
+
+bool RenderDistributed(const RTScene&, const RenderSettings&, const RTDistributedOptions&, std::vector<Color>&)
+{
+	std::cerr << "Distributed rendering is only supported on POSIX systems" << std::endl;
+	return false;
+}
+
+int RunRTWorker(const std::string&, int)
+{
+	std::cerr << "Distributed rendering is only supported on POSIX systems" << std::endl;
+	return 1;
+}
+
+#endif
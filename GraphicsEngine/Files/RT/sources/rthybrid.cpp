@@ -0,0 +1,191 @@
+#include "Files/RT/headers/rthybrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// The ambient rays of a pixel are the same from one frame to the next, a blue noise
+// sampler spreads their error over the neighbouring pixels instead of making it flicker
+#define RT_HYBRID_AMBIENT_DIMENSION 0
+
+RTHybridShader::RTHybridShader(const RTScene& scene, const RTHybridSettings& settings) :
+	m_scene(scene), m_settings(settings), m_sampler(RT_SAMPLER_BLUE_NOISE), m_quit(false),
+	m_frame(0), m_busyWorkers(0), m_frameGBuffer(nullptr), m_frameShading(nullptr), m_nextRow(0), m_frameRays(0),
+	m_hasPending(false), m_hasResult(false), m_resultWidth(0), m_resultHeight(0), m_lastRays(0), m_lastSeconds(0.0)
+{
+	int numThreads = m_settings.m_numThreads;
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// The thread calling Shade is the last one
+	for (int t = 1; t < numThreads; ++t) m_workers.push_back(std::thread(&RTHybridShader::WorkerThread, this));
+	m_thread = std::thread(&RTHybridShader::ShadeThread, this);
+}
+
+RTHybridShader::~RTHybridShader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+	for (std::thread& worker : m_workers) worker.join();
+}
+
+void RTHybridShader::Submit(RTGBuffer& gbuffer)
+{
+	{
+		// A frame still waiting is dropped, its buffer goes back to the caller
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::swap(m_pending, gbuffer);
+		m_hasPending = true;
+	}
+	m_condition.notify_all();
+}
+
+bool RTHybridShader::TakeResult(std::vector<glm::vec2>& shading, int& width, int& height)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_hasResult) return false;
+
+	shading.swap(m_result);
+	width = m_resultWidth;
+	height = m_resultHeight;
+	m_hasResult = false;
+	return true;
+}
+
+void RTHybridShader::ShadeThread()
+{
+	std::vector<glm::vec2> shading;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_quit || m_hasPending; });
+			if (m_quit) return;
+
+			std::swap(m_shading, m_pending);
+			m_hasPending = false;
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Shade(m_shading, shading);
+		m_lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_result.swap(shading);
+		m_resultWidth = m_shading.m_width;
+		m_resultHeight = m_shading.m_height;
+		m_hasResult = true;
+	}
+}
+
+void RTHybridShader::WorkerThread()
+{
+	unsigned int frame = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [&]() { return m_quit || m_frame != frame; });
+
+			// A frame started before the quit is still waited for by Shade
+			if (m_frame == frame) return;
+			frame = m_frame;
+		}
+
+		ShadeRows();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0) m_condition.notify_all();
+	}
+}
+
+void RTHybridShader::Shade(const RTGBuffer& gbuffer, std::vector<glm::vec2>& shading)
+{
+	std::lock_guard<std::mutex> shadeLock(m_shadeMutex);
+	shading.assign(gbuffer.m_width * gbuffer.m_height, glm::vec2(1.f));
+
+	m_frameGBuffer = &gbuffer;
+	m_frameShading = &shading;
+	m_nextRow = 0;
+	m_frameRays = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_busyWorkers = (int)m_workers.size();
+		m_frame++;
+	}
+	m_condition.notify_all();
+
+	ShadeRows();
+
+	// The buffers belong to the caller, the workers must be done with them
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this]() { return m_busyWorkers == 0; });
+
+	m_lastRays = m_frameRays.load();
+}
+
+void RTHybridShader::ShadeRows()
+{
+	const RTGBuffer& gbuffer = *m_frameGBuffer;
+	std::vector<glm::vec2>& shading = *m_frameShading;
+
+	long long rays = 0;
+	for (int y = m_nextRow++; y < gbuffer.m_height; y = m_nextRow++)
+	{
+		for (int x = 0; x < gbuffer.m_width; ++x) shading[y * gbuffer.m_width + x] = ShadePixel(gbuffer, x, y, rays);
+	}
+	m_frameRays += rays;
+}
+
+glm::vec2 RTHybridShader::ShadePixel(const RTGBuffer& gbuffer, int x, int y, long long& rays) const
+{
+	const int pixel = y * gbuffer.m_width + x;
+	const glm::vec4& position = gbuffer.m_positions[pixel];
+	if (position.w == 0.f) return glm::vec2(1.f);
+
+	// Into the scene, the transform only rotates, moves and scales the same along every axis
+	const glm::mat4& toScene = gbuffer.m_viewToScene;
+	const float scale = glm::length(glm::vec3(toScene[0]));
+	const glm::vec3 point = glm::vec3(toScene * glm::vec4(glm::vec3(position), 1.f));
+	const glm::vec3 normal = glm::normalize(glm::mat3(toScene) * glm::vec3(gbuffer.m_normals[pixel]));
+
+	// The camera is at the origin of the view space
+	const float distance = glm::length(glm::vec3(position)) * scale;
+	const glm::vec3 origin = point + normal * (m_settings.m_epsilonFactor * distance);
+
+	glm::vec2 shading(0.f);
+
+	// Cosine distributed ambient rays
+	glm::vec3 tangent, bitangent;
+	BuildBasis(normal, tangent, bitangent);
+
+	const float ambientDistance = m_settings.m_ambientRadius * scale;
+	Occluder occluder;
+	for (int i = 0; i < m_settings.m_ambientRays; ++i)
+	{
+		const glm::vec3 direction = SampleCosineHemisphere(m_sampler.Get2D(x, y, i, RT_HYBRID_AMBIENT_DIMENSION), normal, tangent, bitangent);
+
+		if (!m_scene.Occluded(origin, direction, ambientDistance, &occluder)) shading.x += 1.f;
+	}
+	if (m_settings.m_ambientRays > 0) shading.x /= m_settings.m_ambientRays;
+	else shading.x = 1.f;
+	rays += m_settings.m_ambientRays;
+
+	// Shadow ray, the faces turned away from the light are not lit anyway
+	const glm::vec3 light = glm::vec3(toScene * glm::vec4(gbuffer.m_lightPosition, 1.f));
+	const glm::vec3 toLight = light - origin;
+	const float lightDistance = glm::length(toLight);
+	if (lightDistance > 0.f && glm::dot(toLight, normal) > 0.f)
+	{
+		shading.y = m_scene.Occluded(origin, toLight / lightDistance, lightDistance) ? 0.f : 1.f;
+		++rays;
+	}
+
+	return shading;
+}
@@ -0,0 +1,278 @@
+#include "Files/RT/headers/rtimage.h"
+#include "Files/RT/headers/simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdint.h>
+
+// Linear values in [0, 1] the sRGB bytes are looked up from, fine enough for the darkest steps
+#define RT_SRGB_TABLE_SIZE 4096
+
+// Past it the filmic curve is already clamped to 1, the squares stay finite
+#define RT_FILMIC_MAX_INPUT 64.f
+
+static std::string Extension(const std::string& filename)
+{
+	const size_t dot = filename.rfind('.');
+	if (dot == std::string::npos) return "";
+
+	std::string extension = filename.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension;
+}
+
+// Narkowicz's fit of the ACES curve, from [0, inf) to [0, 1]
+static float Filmic(float x)
+{
+	x = std::min(RT_FILMIC_MAX_INPUT, std::max(0.f, x));
+	return std::min(1.f, x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f));
+}
+
+static vfloat Filmic(const vfloat& value)
+{
+	const vfloat x = Min(Max(value, vfloat(0.f)), vfloat(RT_FILMIC_MAX_INPUT));
+	return Min(x * (vfloat(2.51f) * x + vfloat(0.03f)) / (x * (vfloat(2.43f) * x + vfloat(0.59f)) + vfloat(0.14f)), vfloat(1.f));
+}
+
+// sRGB bytes of the linear values i / (RT_SRGB_TABLE_SIZE - 1), the power is only computed once
+static const unsigned char* SRGBTable()
+{
+	static const std::vector<unsigned char> table = []()
+	{
+		std::vector<unsigned char> bytes(RT_SRGB_TABLE_SIZE);
+		for (int i = 0; i < RT_SRGB_TABLE_SIZE; ++i)
+		{
+			const float linear = i / float(RT_SRGB_TABLE_SIZE - 1);
+			const float encoded = linear <= 0.0031308f ? 12.92f * linear : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f;
+			bytes[i] = (unsigned char)(std::min(1.f, encoded) * 255.f + 0.5f);
+		}
+		return bytes;
+	}();
+	return table.data();
+}
+
+static unsigned char ToByte(float value, RTToneMap toneMap)
+{
+	if (toneMap == RT_TONEMAP_FILMIC) return SRGBTable()[(int)(Filmic(value) * (RT_SRGB_TABLE_SIZE - 1) + 0.5f)];
+
+	return (unsigned char)(std::min(1.f, std::max(0.f, value)) * 255.f);
+}
+
+static uint32_t ToRGB32(int red, int green, int blue)
+{
+	return 0xff000000u | ((uint32_t)red << 16) | ((uint32_t)green << 8) | (uint32_t)blue;
+}
+
+void ColorsToRGB32(const Color* colors, int count, uint32_t* pixels, RTToneMap toneMap)
+{
+	// The colors are packed floats, RT_SIMD_WIDTH pixels are 3 full vectors of channels
+	const float* channels = &colors[0].x;
+	const vfloat zero(0.f), one(1.f), scale(255.f), tableScale(float(RT_SRGB_TABLE_SIZE - 1)), half(0.5f);
+	const unsigned char* srgb = SRGBTable();
+	const bool filmic = toneMap == RT_TONEMAP_FILMIC;
+	RT_ALIGN(RT_SIMD_ALIGNMENT) int bytes[3 * RT_SIMD_WIDTH];
+
+	int first = 0;
+	for (; first + RT_SIMD_WIDTH <= count; first += RT_SIMD_WIDTH)
+	{
+		for (int v = 0; v < 3; ++v)
+		{
+			// NaNs come out of Max as 0 like from ToByte
+			const vfloat value = LoadFloatsUnaligned(channels + 3 * first + v * RT_SIMD_WIDTH);
+			if (filmic) StoreInts(bytes + v * RT_SIMD_WIDTH, ToInts(Filmic(value) * tableScale + half));
+			else StoreInts(bytes + v * RT_SIMD_WIDTH, ToInts(Min(Max(value, zero), one) * scale));
+		}
+
+		// The curve is computed on the vectors, only the sRGB encoding is a lookup
+		if (filmic)
+		{
+			for (int i = 0; i < 3 * RT_SIMD_WIDTH; ++i) bytes[i] = srgb[bytes[i]];
+		}
+
+		for (int i = 0; i < RT_SIMD_WIDTH; ++i)
+		{
+			pixels[first + i] = ToRGB32(bytes[3 * i], bytes[3 * i + 1], bytes[3 * i + 2]);
+		}
+	}
+
+	for (; first < count; ++first)
+	{
+		pixels[first] = ToRGB32(ToByte(colors[first].x, toneMap), ToByte(colors[first].y, toneMap), ToByte(colors[first].z, toneMap));
+	}
+}
+
+bool SaveRTImage(const std::string& filename, const std::vector<Color>& image, int width, int height, RTToneMap toneMap)
+{
+	const std::string extension = Extension(filename);
+
+	// The floats are written linear, whatever the 8 bit images are shown with
+	if (extension == "pfm") return SavePFM(filename, image, width, height);
+	if (extension == "ppm") return SavePPM(filename, image, width, height, toneMap);
+	if (extension == "png") return SavePNG(filename, image, width, height, toneMap);
+
+	return false;
+}
+
+bool IsRTImageFormat(const std::string& filename)
+{
+	const std::string extension = Extension(filename);
+	return extension == "pfm" || extension == "ppm" || extension == "png";
+}
+
+bool SavePFM(const std::string& filename, const std::vector<Color>& image, int width, int height)
+{
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file) return false;
+
+	// A negative scale means little endian, the rows go from the bottom to the top
+	file << "PF\n" << width << " " << height << "\n-1.0\n";
+
+	const uint16_t endianTest = 1;
+	const bool littleEndian = *(const unsigned char*)&endianTest == 1;
+
+	std::vector<float> row(width * 3);
+	for (int y = height - 1; y >= 0; --y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			const Color& color = image[y * width + x];
+			for (int c = 0; c < 3; ++c)
+			{
+				float value = color[c];
+				if (!littleEndian)
+				{
+					unsigned char* bytes = (unsigned char*)&value;
+					std::swap(bytes[0], bytes[3]);
+					std::swap(bytes[1], bytes[2]);
+				}
+				row[x * 3 + c] = value;
+			}
+		}
+		file.write((const char*)row.data(), row.size() * sizeof(float));
+	}
+
+	return (bool)file;
+}
+
+bool SavePPM(const std::string& filename, const std::vector<Color>& image, int width, int height, RTToneMap toneMap)
+{
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file) return false;
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	std::vector<unsigned char> row(width * 3);
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			for (int c = 0; c < 3; ++c) row[x * 3 + c] = ToByte(image[y * width + x][c], toneMap);
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+
+	return (bool)file;
+}
+
+static uint32_t CRC32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+	static uint32_t table[256];
+	static bool tableReady = false;
+	if (!tableReady)
+	{
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		tableReady = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void PutBigEndian(std::vector<unsigned char>& out, uint32_t value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static void WriteChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> chunk;
+	PutBigEndian(chunk, (uint32_t)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	PutBigEndian(chunk, CRC32(&chunk[4], chunk.size() - 4));
+
+	file.write((const char*)chunk.data(), chunk.size());
+}
+
+bool SavePNG(const std::string& filename, const std::vector<Color>& image, int width, int height, RTToneMap toneMap)
+{
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file) return false;
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write((const char*)signature, sizeof(signature));
+
+	// 8 bit RGB, no interlacing
+	std::vector<unsigned char> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	const unsigned char format[5] = { 8, 2, 0, 0, 0 };
+	header.insert(header.end(), format, format + 5);
+	WriteChunk(file, "IHDR", header);
+
+	// Scanlines with no filter
+	std::vector<unsigned char> pixels;
+	pixels.reserve(height * (width * 3 + 1));
+	for (int y = 0; y < height; ++y)
+	{
+		pixels.push_back(0);
+		for (int x = 0; x < width; ++x)
+		{
+			for (int c = 0; c < 3; ++c) pixels.push_back(ToByte(image[y * width + x][c], toneMap));
+		}
+	}
+
+	// zlib stream made of stored deflate blocks
+	std::vector<unsigned char> data;
+	data.push_back(0x78);
+	data.push_back(0x01);
+
+	uint32_t adlerA = 1, adlerB = 0;
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		adlerA = (adlerA + pixels[i]) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+	}
+
+	size_t offset = 0;
+	do
+	{
+		const size_t blockSize = std::min<size_t>(65535, pixels.size() - offset);
+		const bool last = offset + blockSize == pixels.size();
+
+		data.push_back(last ? 1 : 0);
+		data.push_back((unsigned char)(blockSize & 0xff));
+		data.push_back((unsigned char)(blockSize >> 8));
+		data.push_back((unsigned char)(~blockSize & 0xff));
+		data.push_back((unsigned char)((~blockSize >> 8) & 0xff));
+		data.insert(data.end(), pixels.begin() + offset, pixels.begin() + offset + blockSize);
+
+		offset += blockSize;
+	} while (offset < pixels.size());
+
+	PutBigEndian(data, (adlerB << 16) | adlerA);
+	WriteChunk(file, "IDAT", data);
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+	return (bool)file;
+}
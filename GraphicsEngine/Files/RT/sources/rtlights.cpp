@@ -0,0 +1,212 @@
+#include "Files/RT/headers/rtlights.h"
+
+#include <algorithm>
+
+// Largest float under 1, a random number rescaled to a branch must stay in [0, 1)
+#define RT_LIGHT_ONE_MINUS_EPSILON 0.99999994f
+
+void RTLightSampler::Build(const std::vector<Sphere>& spheres)
+{
+	Clear();
+
+	std::vector<AABB> bounds;
+	m_lightOfSphere.assign(spheres.size(), -1);
+
+	for (int i = 0; i < (int)spheres.size(); ++i)
+	{
+		const Sphere& sphere = spheres[i];
+		if (!sphere.isLight()) continue;
+
+		RTLight light;
+		light.m_center = sphere.getCenter();
+		light.m_radius = sphere.getRadius();
+		light.m_power = Luminance(sphere.getLightColor() * sphere.emissionFactor()) * light.m_radius * light.m_radius;
+		light.m_sphere = i;
+
+		m_lightOfSphere[i] = (int)m_lights.size();
+		m_lights.push_back(light);
+
+		m_totalPower += light.m_power;
+		m_cumulatedPower.push_back(m_totalPower);
+
+		const glm::vec3 radius(light.m_radius);
+		bounds.push_back(AABB(light.m_center - radius, light.m_center + radius));
+	}
+
+	m_bvh.Build(bounds, 1);
+
+	// The children come after their parent, backwards the power of both is known
+	const BVHArray<BVHNode> nodes = m_bvh.Nodes();
+	const BVHArray<unsigned int> primIndices = m_bvh.PrimIndices();
+	m_nodePower.assign(nodes.size(), 0.f);
+	m_parents.assign(nodes.size(), -1);
+	m_leafOfLight.assign(m_lights.size(), -1);
+
+	for (int i = (int)nodes.size() - 1; i >= 0; --i)
+	{
+		const BVHNode& node = nodes[i];
+		if (node.IsLeaf())
+		{
+			for (unsigned int p = 0; p < node.m_primCount; ++p)
+			{
+				const unsigned int light = primIndices[node.m_leftFirst + p];
+				m_nodePower[i] += m_lights[light].m_power;
+				m_leafOfLight[light] = i;
+			}
+		}
+		else
+		{
+			m_nodePower[i] = m_nodePower[node.m_leftFirst] + m_nodePower[node.m_leftFirst + 1];
+			m_parents[node.m_leftFirst] = i;
+			m_parents[node.m_leftFirst + 1] = i;
+		}
+	}
+}
+
+void RTLightSampler::Clear()
+{
+	m_lights.clear();
+	m_lightOfSphere.clear();
+	m_cumulatedPower.clear();
+	m_totalPower = 0.f;
+
+	m_bvh.Clear();
+	m_nodePower.clear();
+	m_parents.clear();
+	m_leafOfLight.clear();
+}
+
+int RTLightSampler::Sample(RTLightSelection selection, const glm::vec3& point, float u, float& pdf) const
+{
+	pdf = 0.f;
+	if (m_lights.empty()) return -1;
+
+	return selection == RT_LIGHTS_TREE ? SampleTree(point, u, pdf) : SamplePower(u, pdf);
+}
+
+float RTLightSampler::Pdf(RTLightSelection selection, int light, const glm::vec3& point) const
+{
+	if (selection == RT_LIGHTS_TREE) return TreePdf(light, point);
+
+	return m_totalPower > 0.f ? m_lights[light].m_power / m_totalPower : 0.f;
+}
+
+int RTLightSampler::SamplePower(float u, float& pdf) const
+{
+	if (m_totalPower <= 0.f) return -1;
+
+	const size_t light = std::upper_bound(m_cumulatedPower.begin(), m_cumulatedPower.end(), u * m_totalPower) - m_cumulatedPower.begin();
+	const int index = (int)std::min(light, m_lights.size() - 1);
+	if (m_lights[index].m_power <= 0.f) return -1;
+
+	pdf = m_lights[index].m_power / m_totalPower;
+	return index;
+}
+
+int RTLightSampler::SampleTree(const glm::vec3& point, float u, float& pdf) const
+{
+	const BVHArray<BVHNode> nodes = m_bvh.Nodes();
+	int node = 0;
+	pdf = 1.f;
+
+	// Down the side that matters most for the point, u is rescaled to the side taken
+	while (!nodes[node].IsLeaf())
+	{
+		const int left = nodes[node].m_leftFirst;
+		const float leftImportance = Importance(left, point);
+		const float total = leftImportance + Importance(left + 1, point);
+		if (total <= 0.f) return -1;
+
+		const float leftProbability = leftImportance / total;
+		if (u < leftProbability)
+		{
+			u /= leftProbability;
+			pdf *= leftProbability;
+			node = left;
+		}
+		else
+		{
+			u = (u - leftProbability) / (1.f - leftProbability);
+			pdf *= 1.f - leftProbability;
+			node = left + 1;
+		}
+		u = std::min(u, RT_LIGHT_ONE_MINUS_EPSILON);
+	}
+
+	float leafPdf;
+	const int light = SampleLeaf(nodes[node], point, u, leafPdf);
+	pdf *= leafPdf;
+	return light;
+}
+
+float RTLightSampler::TreePdf(int light, const glm::vec3& point) const
+{
+	const BVHArray<BVHNode> nodes = m_bvh.Nodes();
+	int node = m_leafOfLight[light];
+	float pdf = LeafPdf(nodes[node], light, point);
+
+	// Up to the root with the probability of each branch taken on the way down
+	for (int parent = m_parents[node]; parent >= 0 && pdf > 0.f; node = parent, parent = m_parents[node])
+	{
+		const int left = nodes[parent].m_leftFirst;
+		const float total = Importance(left, point) + Importance(left + 1, point);
+		if (total <= 0.f) return 0.f;
+
+		pdf *= Importance(node, point) / total;
+	}
+
+	return pdf;
+}
+
+float RTLightSampler::Importance(int nodeIndex, const glm::vec3& point) const
+{
+	const BVHNode& node = m_bvh.Nodes()[nodeIndex];
+	const glm::vec3 toCenter = (node.m_boundsMin + node.m_boundsMax) * 0.5f - point;
+	const glm::vec3 halfExtent = (node.m_boundsMax - node.m_boundsMin) * 0.5f;
+
+	return m_nodePower[nodeIndex] / std::max(glm::dot(toCenter, toCenter), glm::dot(halfExtent, halfExtent));
+}
+
+float RTLightSampler::Importance(const RTLight& light, const glm::vec3& point) const
+{
+	const glm::vec3 toCenter = light.m_center - point;
+	return light.m_power / std::max(glm::dot(toCenter, toCenter), light.m_radius * light.m_radius);
+}
+
+int RTLightSampler::SampleLeaf(const BVHNode& leaf, const glm::vec3& point, float u, float& pdf) const
+{
+	const BVHArray<unsigned int> primIndices = m_bvh.PrimIndices();
+	pdf = 0.f;
+
+	float total = 0.f;
+	for (unsigned int p = 0; p < leaf.m_primCount; ++p) total += Importance(m_lights[primIndices[leaf.m_leftFirst + p]], point);
+	if (total <= 0.f) return -1;
+
+	// The last light with any importance takes what rounding leaves over
+	const float target = u * total;
+	float cumulated = 0.f;
+	int picked = -1;
+	for (unsigned int p = 0; p < leaf.m_primCount; ++p)
+	{
+		const int light = (int)primIndices[leaf.m_leftFirst + p];
+		const float importance = Importance(m_lights[light], point);
+		if (importance <= 0.f) continue;
+
+		picked = light;
+		pdf = importance / total;
+		cumulated += importance;
+		if (target < cumulated) break;
+	}
+
+	return picked;
+}
+
+float RTLightSampler::LeafPdf(const BVHNode& leaf, int light, const glm::vec3& point) const
+{
+	const BVHArray<unsigned int> primIndices = m_bvh.PrimIndices();
+
+	float total = 0.f;
+	for (unsigned int p = 0; p < leaf.m_primCount; ++p) total += Importance(m_lights[primIndices[leaf.m_leftFirst + p]], point);
+
+	return total > 0.f ? Importance(m_lights[light], point) / total : 0.f;
+}
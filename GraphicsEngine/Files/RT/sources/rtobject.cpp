@@ -0,0 +1,183 @@
+#include "Files/RT/headers/rtobject.h"
+#include "Files/RT/headers/rtscene.h"
+
+#include <algorithm>
+
+void WriteSphere(RTStreamWriter& stream, const Sphere& sphere)
+{
+	stream.WriteVec3(sphere.getCenter());
+	stream.WriteFloat(sphere.getRadius());
+	stream.WriteVec3(sphere.getSurfaceColor());
+	stream.WriteUInt32(sphere.reflectsLight() ? 1 : 0);
+	stream.WriteFloat(sphere.transparencyFactor());
+	stream.WriteFloat(sphere.getRefractionIndex());
+	stream.WriteFloat(sphere.emissionFactor());
+	stream.WriteVec3(sphere.getLightColor());
+}
+
+Sphere ReadSphere(RTStreamReader& stream)
+{
+	const glm::vec3 center = stream.ReadVec3();
+	const float radius = stream.ReadFloat();
+	const glm::vec3 surfaceColor = stream.ReadVec3();
+	const bool reflects = stream.ReadUInt32() != 0;
+	const float transparency = stream.ReadFloat();
+	const float refractionIndex = stream.ReadFloat();
+	const float emission = stream.ReadFloat();
+	const glm::vec3 lightColor = stream.ReadVec3();
+	return Sphere(center, radius, surfaceColor, reflects, transparency, refractionIndex, emission, lightColor);
+}
+
+RTObject::RTObject() { }
+
+RTObject::~RTObject() { }
+
+void RTObject::AddSphere(const Sphere& sphere)
+{
+	m_spheres.push_back(sphere);
+	m_sphereMaterials.push_back(RTMaterial::FromSphere(sphere));
+}
+
+void RTObject::SetMesh(const Model& model, const glm::mat4& transform, RTBVHCache* bvhCache)
+{
+	m_mesh.Load(model, transform, bvhCache);
+}
+
+void RTObject::Clear()
+{
+	m_spheres.clear();
+	m_sphereMaterials.clear();
+	m_sphereSoA.Clear();
+	m_sphereBVH.Clear();
+	m_mesh.Clear();
+	m_bounds = AABB();
+}
+
+void RTObject::Build()
+{
+	std::vector<AABB> bounds(m_spheres.size());
+	m_bounds = AABB();
+
+	for (size_t i = 0; i < m_spheres.size(); ++i)
+	{
+		const glm::vec3 radius(m_spheres[i].getRadius());
+		bounds[i] = AABB(m_spheres[i].getCenter() - radius, m_spheres[i].getCenter() + radius);
+		m_bounds.Grow(bounds[i]);
+	}
+
+	// Same leaves as the spheres of the scene
+	m_sphereBVH.Build(bounds, std::max(4, 2 * RT_SIMD_WIDTH), RT_SIMD_WIDTH);
+
+	const BVHArray<unsigned int> primIndices = m_sphereBVH.PrimIndices();
+	m_sphereSoA.Load(m_spheres, std::vector<int>(primIndices.begin(), primIndices.end()));
+
+	if (!m_mesh.IsEmpty())
+	{
+		const BVHNode& root = m_mesh.GetBVH().Nodes()[0];
+		m_bounds.Grow(AABB(root.m_boundsMin, root.m_boundsMax));
+	}
+}
+
+void RTObject::Write(RTStreamWriter& stream) const
+{
+	stream.WriteUInt32((uint32_t)m_spheres.size());
+	for (const Sphere& sphere : m_spheres) WriteSphere(stream, sphere);
+
+	m_mesh.Write(stream);
+}
+
+bool RTObject::Read(RTStreamReader& stream)
+{
+	Clear();
+
+	const uint32_t numSpheres = stream.ReadCount(56);
+	for (uint32_t i = 0; i < numSpheres; ++i) AddSphere(ReadSphere(stream));
+
+	// An object without triangles has an empty mesh
+	if (stream.m_failed || !m_mesh.Read(stream))
+	{
+		Clear();
+		return false;
+	}
+
+	Build();
+	return true;
+}
+
+bool RTObject::ClosestHit(const glm::vec3& origin, const glm::vec3& direction, float& tMax, ObjectHit& hit, RTStats* stats) const
+{
+	bool found = false;
+
+	m_sphereBVH.TraverseLeaves(origin, direction, tMax, [&](unsigned int first, unsigned int count, float& t)
+	{
+		const int slot = m_sphereSoA.ClosestHit(first, count, origin, direction, t);
+		if (slot < 0) return false;
+
+		hit.m_sphere = m_sphereSoA.MaterialIndex(slot);
+		hit.m_triangle = -1;
+		found = true;
+		return true;
+	}, stats);
+
+	float u, v;
+	const int triangle = m_mesh.IsEmpty() ? -1 : m_mesh.ClosestHit(origin, direction, tMax, u, v, stats);
+	if (triangle >= 0)
+	{
+		hit.m_sphere = -1;
+		hit.m_triangle = triangle;
+		hit.m_u = u;
+		hit.m_v = v;
+		found = true;
+	}
+
+	return found;
+}
+
+bool RTObject::Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax, Occluder* occluder, RTStats* stats) const
+{
+	int slot = -1;
+	if (m_sphereBVH.TraverseAnyLeaves(origin, direction, tMax, [&](unsigned int first, unsigned int count, float t)
+	{
+		return m_sphereSoA.AnyHit(first, count, origin, direction, t, &slot);
+	}, stats))
+	{
+		occluder->m_mesh = -1;
+		occluder->m_prim = m_sphereSoA.MaterialIndex(slot);
+		return true;
+	}
+
+	int triangle = -1;
+	if (!m_mesh.IsEmpty() && m_mesh.Occluded(origin, direction, tMax, &triangle, stats))
+	{
+		occluder->m_mesh = 0;
+		occluder->m_prim = triangle;
+		return true;
+	}
+
+	return false;
+}
+
+bool RTObject::OccludedBy(const Occluder& occluder, const glm::vec3& origin, const glm::vec3& direction, float tMax) const
+{
+	if (occluder.m_mesh < 0)
+	{
+		return RTScene::HitDistance(m_spheres[occluder.m_prim], origin, direction) < tMax;
+	}
+
+	float t, u, v;
+	return m_mesh.IntersectTriangle(occluder.m_prim, WatertightRay(origin, direction), tMax, t, u, v);
+}
+
+glm::vec3 RTObject::Normal(const ObjectHit& hit, const glm::vec3& position) const
+{
+	if (hit.m_sphere >= 0) return glm::normalize(position - m_spheres[hit.m_sphere].getCenter());
+
+	return m_mesh.Normal(hit.m_triangle, hit.m_u, hit.m_v);
+}
+
+const RTMaterial& RTObject::GetMaterial(const ObjectHit& hit) const
+{
+	if (hit.m_sphere >= 0) return m_sphereMaterials[hit.m_sphere];
+
+	return m_mesh.GetMaterial(hit.m_triangle);
+}
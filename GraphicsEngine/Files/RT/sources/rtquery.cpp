@@ -0,0 +1,142 @@
+#include "Files/RT/headers/rtquery.h"
+#include "Files/RT/headers/simd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// Rays a thread takes at a time, a multiple of RT_SIMD_WIDTH so the packets never straddle two chunks
+#define RT_QUERY_CHUNK 1024
+
+void RTRayBatch::Resize(size_t count)
+{
+	m_originX.resize(count); m_originY.resize(count); m_originZ.resize(count);
+	m_directionX.resize(count); m_directionY.resize(count); m_directionZ.resize(count);
+	m_tMin.resize(count, 0.f);
+	m_tMax.resize(count, INFINITY);
+}
+
+void RTRayBatch::SetRay(size_t i, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax)
+{
+	m_originX[i] = origin.x; m_originY[i] = origin.y; m_originZ[i] = origin.z;
+	m_directionX[i] = direction.x; m_directionY[i] = direction.y; m_directionZ[i] = direction.z;
+	m_tMin[i] = tMin;
+	m_tMax[i] = tMax;
+}
+
+void RTHitBatch::Resize(size_t count)
+{
+	m_distance.resize(count);
+	m_normalX.resize(count); m_normalY.resize(count); m_normalZ.resize(count);
+	m_instance.resize(count); m_mesh.resize(count); m_prim.resize(count);
+}
+
+// The scene has no minimum distance, the rays start at m_tMin instead
+static Ray BatchRay(const RTRayBatch& rays, size_t i)
+{
+	const glm::vec3 direction(rays.m_directionX[i], rays.m_directionY[i], rays.m_directionZ[i]);
+	const glm::vec3 origin(rays.m_originX[i], rays.m_originY[i], rays.m_originZ[i]);
+	return Ray(origin + direction * rays.m_tMin[i], direction);
+}
+
+static void StoreHit(const RTRayBatch& rays, size_t i, bool hit, const HitInfo& hitInfo, RTHitBatch& hits)
+{
+	// Only the closest hit is known, if it is past m_tMax there is none before
+	const float distance = hit ? rays.m_tMin[i] + hitInfo.m_distanceHit : INFINITY;
+	if (distance > rays.m_tMax[i])
+	{
+		hits.m_distance[i] = INFINITY;
+		hits.m_normalX[i] = hits.m_normalY[i] = hits.m_normalZ[i] = 0.f;
+		hits.m_instance[i] = hits.m_mesh[i] = hits.m_prim[i] = -1;
+		return;
+	}
+
+	hits.m_distance[i] = distance;
+	hits.m_normalX[i] = hitInfo.m_normalHit.x;
+	hits.m_normalY[i] = hitInfo.m_normalHit.y;
+	hits.m_normalZ[i] = hitInfo.m_normalHit.z;
+	hits.m_instance[i] = hitInfo.m_instance;
+	hits.m_mesh[i] = hitInfo.m_mesh;
+	hits.m_prim[i] = hitInfo.m_prim;
+}
+
+RTRayQuery::RTRayQuery(const RTScene& scene, const RTQuerySettings& settings) : m_scene(scene), m_settings(settings)
+{
+}
+
+template <typename ChunkFunc>
+void RTRayQuery::ForEachChunk(size_t count, ChunkFunc queryChunk) const
+{
+	const int numChunks = (int)((count + RT_QUERY_CHUNK - 1) / RT_QUERY_CHUNK);
+
+	int numThreads = m_settings.m_numThreads;
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, numChunks);
+
+	std::atomic<int> nextChunk(0);
+	auto queryChunks = [&]()
+	{
+		for (int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+		{
+			const size_t begin = (size_t)chunk * RT_QUERY_CHUNK;
+			queryChunk(begin, std::min(begin + RT_QUERY_CHUNK, count));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; ++t) threads.push_back(std::thread(queryChunks));
+	queryChunks();
+	for (std::thread& thread : threads) thread.join();
+}
+
+void RTRayQuery::Closest(const RTRayBatch& rays, RTHitBatch& hits) const
+{
+	hits.Resize(rays.Size());
+	ForEachChunk(rays.Size(), [&](size_t begin, size_t end) { ClosestChunk(rays, begin, end, hits); });
+}
+
+void RTRayQuery::Any(const RTRayBatch& rays, std::vector<unsigned char>& occluded) const
+{
+	occluded.resize(rays.Size());
+	ForEachChunk(rays.Size(), [&](size_t begin, size_t end) { AnyChunk(rays, begin, end, occluded); });
+}
+
+void RTRayQuery::ClosestChunk(const RTRayBatch& rays, size_t begin, size_t end, RTHitBatch& hits) const
+{
+	if (!m_settings.m_packets)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			HitInfo hitInfo;
+			const bool hit = m_scene.Intersect(BatchRay(rays, i), hitInfo);
+			StoreHit(rays, i, hit, hitInfo, hits);
+		}
+		return;
+	}
+
+	Ray packetRays[RT_SIMD_WIDTH];
+	HitInfo hitInfos[RT_SIMD_WIDTH];
+	bool packetHits[RT_SIMD_WIDTH];
+
+	for (size_t first = begin; first < end; first += RT_SIMD_WIDTH)
+	{
+		const int count = (int)std::min((size_t)RT_SIMD_WIDTH, end - first);
+		for (int lane = 0; lane < count; ++lane) packetRays[lane] = BatchRay(rays, first + lane);
+
+		m_scene.IntersectPacket(packetRays, count, hitInfos, packetHits);
+		for (int lane = 0; lane < count; ++lane) StoreHit(rays, first + lane, packetHits[lane], hitInfos[lane], hits);
+	}
+}
+
+void RTRayQuery::AnyChunk(const RTRayBatch& rays, size_t begin, size_t end, std::vector<unsigned char>& occluded) const
+{
+	// Neighbouring rays of a batch are often stopped by the same surface. The last occluder
+	// is only kept within a chunk, so the answers do not depend on the threads.
+	Occluder occluder;
+	for (size_t i = begin; i < end; ++i)
+	{
+		const Ray ray = BatchRay(rays, i);
+		const float maxDistance = rays.m_tMax[i] - rays.m_tMin[i];
+		occluded[i] = maxDistance >= 0.f && m_scene.Occluded(ray.m_origin, ray.m_direction, maxDistance, &occluder) ? 1 : 0;
+	}
+}
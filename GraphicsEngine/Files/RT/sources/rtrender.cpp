@@ -0,0 +1,323 @@
+#include "Files/RT/headers/rtrender.h"
+#include "Files/RT/headers/rtanimation.h"
+#include "Files/RT/headers/renderjob.h"
+#include "Files/RT/headers/rtimage.h"
+#include "Files/RT/headers/rtscene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#define RT_RENDER_POLL_INTERVAL_MS 20
+
+typedef std::chrono::steady_clock RenderClock;
+
+static double ElapsedSeconds(const RenderClock::time_point& start)
+{
+	return std::chrono::duration<double>(RenderClock::now() - start).count();
+}
+
+static bool WriteStats(const std::string& filename, const RTStats& stats, double seconds)
+{
+	std::ofstream file(filename);
+	file << stats.ToJSON(seconds);
+	if (file) return true;
+
+	std::cerr << "Could not write " << filename << std::endl;
+	return false;
+}
+
+// Numbered file of a frame, before the extension
+static std::string FrameFilename(const std::string& filename, int frame)
+{
+	const size_t dot = filename.rfind('.');
+
+	std::ostringstream name;
+	name << filename.substr(0, dot) << "_" << std::setw(4) << std::setfill('0') << frame << filename.substr(dot);
+	return name.str();
+}
+
+// The model or a few spheres, as one object shared by the instances on the floor
+static void AddInstances(RTScene& scene, const Model* model, int count, RTBVHCache* bvhCache)
+{
+	RTObject object;
+	if (model)
+	{
+		object.SetMesh(*model, glm::mat4(1.0f), bvhCache);
+	}
+	else
+	{
+		object.AddSphere(Sphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, glm::vec3(1.0f, 1.0f, 1.0f), true, 0.9f, 1.1f));
+		object.AddSphere(Sphere(glm::vec3(1.2f, 0.5f, 0.3f), 0.5f, glm::vec3(0.0f, 0.5f, 0.0f), true, 0.0f, 0.0f));
+		object.AddSphere(Sphere(glm::vec3(-0.8f, 0.4f, -0.6f), 0.4f, glm::vec3(0.5f, 0.1f, 0.0f), true, 0.0f, 0.0f));
+	}
+
+	const int index = scene.AddObject(object);
+	scene.AddInstancesOnFloor(index, count);
+}
+
+// Memory of the instances and of the geometry they share
+static void PrintInstancing(const RTScene& scene)
+{
+	size_t objectBytes = 0;
+	for (const RTObject& object : scene.Objects())
+	{
+		objectBytes += object.Spheres().size() * sizeof(Sphere) + object.Mesh().NumTriangles() * sizeof(Triangle)
+			+ object.Mesh().GetBVH().Nodes().size() * sizeof(BVHNode);
+	}
+	const size_t instanceBytes = scene.Instances().size() * (sizeof(RTInstance) + sizeof(unsigned int))
+		+ scene.InstanceBVH().Nodes().size() * sizeof(BVHNode);
+
+	std::cout << scene.Instances().size() << " instances of " << scene.Objects().size() << " objects, top level BVH of "
+		<< scene.InstanceBVH().Nodes().size() << " nodes, " << std::fixed << std::setprecision(1) << instanceBytes / 1048576.0
+		<< " MB for the instances and " << objectBytes / 1048576.0 << " MB for the objects" << std::endl;
+}
+
+static int RenderSequence(const RTRenderOptions& options, RTScene& scene, const RenderSettings& jobSettings)
+{
+	const int numFrames = options.m_numFrames;
+	const float framesPerSecond = options.m_framesPerSecond > 0.f ? options.m_framesPerSecond : 24.f;
+
+	RTAnimation animation;
+	if (options.m_animationFilename.empty())
+	{
+		// One whole turn over the frames, the sequence loops
+		animation = RTAnimation::Turntable(scene, numFrames / framesPerSecond);
+	}
+	else
+	{
+		std::string error;
+		if (!animation.Load(options.m_animationFilename, error))
+		{
+			std::cerr << "Could not load the animation: " << error << std::endl;
+			return 1;
+		}
+	}
+
+	if (animation.IsEmpty()) std::cout << "No sphere moves, every frame is the same" << std::endl;
+	if (options.m_distributed.IsEnabled()) std::cout << "Animations are not distributed, this process renders the frames" << std::endl;
+
+	RenderJob job(scene, jobSettings);
+	std::vector<Color> image;
+	RTStats stats;
+	float builtCost = scene.GetBVH().SAHCost();
+	double traceTime = 0.0, overheadTime = 0.0;
+	int rebuilds = 0;
+
+	const RenderClock::time_point sequenceStart = RenderClock::now();
+	for (int frame = 0; frame < numFrames; ++frame)
+	{
+		const RenderClock::time_point frameStart = RenderClock::now();
+
+		// The threads of the job wait between two frames, the scene can change under them
+		if (!animation.Apply(scene, frame / framesPerSecond))
+		{
+			std::cerr << "The animation moves spheres the scene does not have" << std::endl;
+			return 1;
+		}
+		const double animateTime = ElapsedSeconds(frameStart);
+
+		RenderClock::time_point start = RenderClock::now();
+		scene.RefitAccelerationStructure();
+		const float cost = scene.GetBVH().SAHCost();
+		const float costRatio = builtCost > 0.f ? cost / builtCost : 1.f;
+		const bool rebuild = costRatio > options.m_rebuildThreshold;
+		if (rebuild)
+		{
+			scene.BuildAccelerationStructure();
+			builtCost = scene.GetBVH().SAHCost();
+			rebuilds++;
+		}
+		const double bvhTime = ElapsedSeconds(start);
+
+		job.Start();
+		job.Wait();
+		const double frameTraceTime = job.ElapsedSeconds();
+		stats.Add(job.Stats());
+
+		start = RenderClock::now();
+		job.CopyImage(image);
+		const std::string filename = FrameFilename(options.m_outFilename, frame);
+		if (!SaveRTImage(filename, image, jobSettings.m_width, jobSettings.m_height, options.m_toneMap))
+		{
+			std::cerr << "Could not write " << filename << std::endl;
+			return 1;
+		}
+		const double writeTime = ElapsedSeconds(start);
+
+		// Everything but the tracing itself
+		const double frameOverhead = std::max(0.0, ElapsedSeconds(frameStart) - frameTraceTime);
+		traceTime += frameTraceTime;
+		overheadTime += frameOverhead;
+
+		std::cout << "Frame " << frame + 1 << "/" << numFrames << " " << filename << std::fixed << std::setprecision(3)
+			<< ": traced in " << frameTraceTime * 1000.0 << " ms, overhead " << frameOverhead * 1000.0 << " ms (animation "
+			<< animateTime * 1000.0 << ", " << (scene.UsesGrid() ? "grid build " : rebuild ? "rebuild " : "refit ") << bvhTime * 1000.0 << " at SAH cost x"
+			<< std::setprecision(2) << costRatio << std::setprecision(3) << ", write " << writeTime * 1000.0 << ")" << std::endl;
+	}
+	const double sequenceTime = ElapsedSeconds(sequenceStart);
+
+	std::cout << "Rendered " << numFrames << " frames of " << jobSettings.m_width << "x" << jobSettings.m_height << ", "
+		<< jobSettings.m_samplesPerPixel << " spp in " << std::setprecision(3) << sequenceTime << " s, per frame "
+		<< traceTime * 1000.0 / numFrames << " ms traced and " << overheadTime * 1000.0 / numFrames << " ms of overhead ("
+		<< std::setprecision(1) << 100.0 * overheadTime / std::max(sequenceTime, 1e-9) << "%), " << rebuilds << " BVH rebuilds" << std::endl;
+	std::cout << stats.Summary(traceTime) << std::endl;
+
+	if (!options.m_statsFilename.empty() && !WriteStats(options.m_statsFilename, stats, traceTime)) return 1;
+	return 0;
+}
+
+int RunRTRender(const RTRenderOptions& options)
+{
+	const RenderSettings& settings = options.m_settings;
+	if (settings.m_width <= 0 || settings.m_height <= 0)
+	{
+		std::cerr << "Invalid image size " << settings.m_width << "x" << settings.m_height << std::endl;
+		return 1;
+	}
+
+	if (!IsRTImageFormat(options.m_outFilename))
+	{
+		std::cerr << "Cannot write " << options.m_outFilename << ", the extension must be .png, .ppm or .pfm" << std::endl;
+		return 1;
+	}
+
+	RTScene scene;
+	RTBVHCache bvhCache(options.m_bvhCacheDirectory);
+	if (!options.m_bvhCacheDirectory.empty()) scene.SetBVHCache(&bvhCache);
+
+	RenderClock::time_point start = RenderClock::now();
+	if (options.m_modelFilename.empty())
+	{
+		scene.LoadDefaultScene(options.m_numInstances <= 0, options.m_numLights);
+		if (options.m_numInstances > 0) AddInstances(scene, nullptr, options.m_numInstances, nullptr);
+	}
+	else
+	{
+		Model model;
+		model.load(options.m_modelFilename);
+		if (model.vertices().empty())
+		{
+			std::cerr << "Could not load the model " << options.m_modelFilename << std::endl;
+			return 1;
+		}
+
+		// Without the parsing of the file, only the meshes and their BVHs
+		start = RenderClock::now();
+		scene.LoadDefaultScene(false, options.m_numLights);
+		if (options.m_numInstances > 0) AddInstances(scene, &model, options.m_numInstances, scene.BVHCache());
+		else scene.AddModelOnFloor(model);
+	}
+
+	const double meshTime = ElapsedSeconds(start);
+
+	start = RenderClock::now();
+	scene.SetAcceleration(options.m_acceleration);
+	scene.BuildAccelerationStructure();
+	const double buildTime = ElapsedSeconds(start);
+
+	if (scene.BVHCache())
+	{
+		std::cout << "BVH cache " << options.m_bvhCacheDirectory << ": " << bvhCache.NumLoaded() << " loaded, "
+			<< bvhCache.NumSaved() << " built and saved, meshes ready in " << meshTime * 1000.0 << " ms" << std::endl;
+
+		// The spheres of an animation move every frame, their new BVHs are not worth keeping
+		scene.SetBVHCache(nullptr);
+	}
+
+	if (scene.UsesGrid())
+	{
+		const glm::ivec3& resolution = scene.Grid().Resolution();
+		std::cout << "Spheres in a " << resolution.x << "x" << resolution.y << "x" << resolution.z << " grid, "
+			<< scene.Grid().PrimIndices().size() << " references" << std::endl;
+	}
+
+	if (options.m_numInstances > 0) PrintInstancing(scene);
+
+	// Every sample goes to the file, there is no one to show a preview to
+	RenderSettings jobSettings = settings;
+	jobSettings.m_preview = false;
+
+	if (options.m_numFrames > 0) return RenderSequence(options, scene, jobSettings);
+
+	std::vector<Color> image;
+	RTStats stats;
+	bool hasStats = false;
+	if (options.m_distributed.IsEnabled())
+	{
+		if (settings.m_adaptive || settings.m_denoise)
+		{
+			std::cout << "Adaptive sampling and denoising are not distributed, they are left out" << std::endl;
+		}
+
+		start = RenderClock::now();
+		if (!RenderDistributed(scene, jobSettings, options.m_distributed, image)) return 1;
+	}
+	else
+	{
+		RenderJob job(scene, jobSettings);
+
+		start = RenderClock::now();
+		job.Start();
+
+		int shownPercent = -1;
+		while (!job.IsFinished())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(RT_RENDER_POLL_INTERVAL_MS));
+
+			const int percent = (int)(job.Progress() * 100.f);
+			if (percent != shownPercent)
+			{
+				std::cout << "\rRendering " << std::setw(3) << percent << "%" << std::flush;
+				shownPercent = percent;
+			}
+		}
+		job.Wait();
+
+		if (settings.m_adaptive)
+		{
+			std::cout << "\rAdaptive sampling traced " << std::fixed << std::setprecision(2)
+				<< (double)job.SamplesTraced() / ((double)settings.m_width * settings.m_height) << " spp on average" << std::endl;
+		}
+
+		job.CopyImage(image);
+		stats = job.Stats();
+		hasStats = true;
+	}
+	const double renderTime = ElapsedSeconds(start);
+
+	std::cout << "\rRendered " << settings.m_width << "x" << settings.m_height << ", " << settings.m_samplesPerPixel
+		<< " spp, depth " << settings.m_maxRayDepth << " in " << std::fixed << std::setprecision(3) << renderTime
+		<< " s (" << (scene.UsesGrid() ? "grid" : "BVH") << " build " << buildTime * 1000.0 << " ms)" << std::endl;
+
+	// The workers keep their counters, only the rendering in this process has them
+	if (hasStats)
+	{
+		std::cout << stats.Summary(renderTime) << std::endl;
+	}
+
+	if (!options.m_statsFilename.empty())
+	{
+		if (!hasStats)
+		{
+			std::cerr << "The counters of a distributed rendering stay in the workers, " << options.m_statsFilename << " is not written" << std::endl;
+		}
+		else if (!WriteStats(options.m_statsFilename, stats, renderTime))
+		{
+			return 1;
+		}
+	}
+
+	if (!SaveRTImage(options.m_outFilename, image, settings.m_width, settings.m_height, options.m_toneMap))
+	{
+		std::cerr << "Could not write " << options.m_outFilename << std::endl;
+		return 1;
+	}
+
+	std::cout << "Saved " << options.m_outFilename << std::endl;
+	return 0;
+}
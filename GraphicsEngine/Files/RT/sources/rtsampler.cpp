@@ -0,0 +1,259 @@
+#include "Files/RT/headers/rtsampler.h"
+#include "Files/RT/headers/rtrandom.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Side of the blue noise tile, a power of two the pixels wrap around
+#define RT_BLUE_NOISE_SIZE 64
+
+// Spread of the energy of a point of the void and cluster method, in texels
+#define RT_BLUE_NOISE_SIGMA 1.5f
+
+// Fraction of the texels set in the initial pattern of the void and cluster method
+#define RT_BLUE_NOISE_INITIAL_DENSITY 0.1f
+
+// Uniform in [0, 1) from the high bits
+static float ToFloat(uint32_t x)
+{
+	return (x >> 8) * (1.f / 16777216.f);
+}
+
+static uint32_t ReverseBits(uint32_t x)
+{
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+}
+
+// Hash where each bit only depends on the bits below it (Laine and Karras 2011, constants of Burley 2020)
+static uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed)
+{
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+// Owen scrambling of the bits of a number in [0, 1) as a 32 bit fraction:
+// each bit is flipped or not depending on the bits above it
+static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+{
+	return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+// First two dimensions of the Sobol sequence, the second one from the polynomial x + 1
+static uint32_t Sobol0(uint32_t index)
+{
+	return ReverseBits(index);
+}
+
+static uint32_t Sobol1(uint32_t index)
+{
+	uint32_t result = 0;
+	for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+	{
+		if (index & 1) result ^= v;
+	}
+	return result;
+}
+
+// Owen scrambled Sobol points in 32 bit fixed point, the seed scrambles both the index and
+// the digits. Shuffling the index keeps the first power of two of samples stratified, and
+// the pairs of dimensions of a path that each take their own seed are not correlated.
+static uint32_t ScrambledSobol0(uint32_t index, uint32_t seed)
+{
+	return NestedUniformScramble(Sobol0(NestedUniformScramble(index, seed)), RTSampler::HashCombine(seed, 0));
+}
+
+static void ScrambledSobol2D(uint32_t index, uint32_t seed, uint32_t& x, uint32_t& y)
+{
+	index = NestedUniformScramble(index, seed);
+	x = NestedUniformScramble(Sobol0(index), RTSampler::HashCombine(seed, 0));
+	y = NestedUniformScramble(Sobol1(index), RTSampler::HashCombine(seed, 1));
+}
+
+// Energy of the points of a binary pattern on the tile, each one spreads a Gaussian
+// around it that wraps over the edges
+struct VoidAndCluster
+{
+	VoidAndCluster() : m_kernel(RT_BLUE_NOISE_SIZE * RT_BLUE_NOISE_SIZE), m_energy(m_kernel.size(), 0.f), m_pattern(m_kernel.size(), 0)
+	{
+		for (int dy = 0; dy < RT_BLUE_NOISE_SIZE; ++dy)
+		{
+			for (int dx = 0; dx < RT_BLUE_NOISE_SIZE; ++dx)
+			{
+				const float x = (float)std::min(dx, RT_BLUE_NOISE_SIZE - dx), y = (float)std::min(dy, RT_BLUE_NOISE_SIZE - dy);
+				m_kernel[dy * RT_BLUE_NOISE_SIZE + dx] = std::exp(-(x * x + y * y) / (2.f * RT_BLUE_NOISE_SIGMA * RT_BLUE_NOISE_SIGMA));
+			}
+		}
+	}
+
+	void Set(int texel, bool value)
+	{
+		m_pattern[texel] = value ? 1 : 0;
+
+		const float sign = value ? 1.f : -1.f;
+		const int px = texel % RT_BLUE_NOISE_SIZE, py = texel / RT_BLUE_NOISE_SIZE;
+		for (int y = 0; y < RT_BLUE_NOISE_SIZE; ++y)
+		{
+			const float* kernel = &m_kernel[((y - py) & (RT_BLUE_NOISE_SIZE - 1)) * RT_BLUE_NOISE_SIZE];
+			float* energy = &m_energy[y * RT_BLUE_NOISE_SIZE];
+			for (int x = 0; x < RT_BLUE_NOISE_SIZE; ++x) energy[x] += sign * kernel[(x - px) & (RT_BLUE_NOISE_SIZE - 1)];
+		}
+	}
+
+	// Point with the most energy around it
+	int TightestCluster() const
+	{
+		int best = -1;
+		for (int t = 0; t < (int)m_pattern.size(); ++t)
+		{
+			if (m_pattern[t] && (best < 0 || m_energy[t] > m_energy[best])) best = t;
+		}
+		return best;
+	}
+
+	// Empty texel with the least energy around it
+	int LargestVoid() const
+	{
+		int best = -1;
+		for (int t = 0; t < (int)m_pattern.size(); ++t)
+		{
+			if (!m_pattern[t] && (best < 0 || m_energy[t] < m_energy[best])) best = t;
+		}
+		return best;
+	}
+
+	std::vector<float> m_kernel; // Indexed by the wrapped offset to the point
+	std::vector<float> m_energy;
+	std::vector<char> m_pattern;
+};
+
+// Rank of each texel of a tile of blue noise (Ulichney 1993). The initial points are
+// moved from their tightest cluster to the largest void until they are even, then
+// ranked by taking them out cluster first, and the other texels by filling the voids.
+static std::vector<uint16_t> BuildBlueNoise()
+{
+	const int numTexels = RT_BLUE_NOISE_SIZE * RT_BLUE_NOISE_SIZE;
+	const int numInitial = (int)(numTexels * RT_BLUE_NOISE_INITIAL_DENSITY);
+
+	VoidAndCluster points;
+	RTRandom random;
+	for (int set = 0; set < numInitial;)
+	{
+		const int texel = (int)(random.Next() % numTexels);
+		if (points.m_pattern[texel]) continue;
+
+		points.Set(texel, true);
+		++set;
+	}
+
+	// A point that would go back where it was leaves the pattern as even as it gets
+	for (int moves = 0; moves < numTexels; ++moves)
+	{
+		const int cluster = points.TightestCluster();
+		points.Set(cluster, false);
+		const int emptiest = points.LargestVoid();
+		points.Set(emptiest, true);
+		if (emptiest == cluster) break;
+	}
+
+	std::vector<uint16_t> ranks(numTexels);
+	VoidAndCluster removed = points;
+	for (int rank = numInitial - 1; rank >= 0; --rank)
+	{
+		const int cluster = removed.TightestCluster();
+		removed.Set(cluster, false);
+		ranks[cluster] = (uint16_t)rank;
+	}
+
+	for (int rank = numInitial; rank < numTexels; ++rank)
+	{
+		const int emptiest = points.LargestVoid();
+		points.Set(emptiest, true);
+		ranks[emptiest] = (uint16_t)rank;
+	}
+
+	return ranks;
+}
+
+static const std::vector<uint16_t>& BlueNoiseTile()
+{
+	// Built by the first blue noise sampler, the initialization is thread safe
+	static const std::vector<uint16_t> tile = BuildBlueNoise();
+	return tile;
+}
+
+RTSampler::RTSampler(RTSamplerType type, uint32_t seed) : m_type(type), m_seed(seed), m_blueNoise(nullptr)
+{
+	if (m_type == RT_SAMPLER_BLUE_NOISE) m_blueNoise = &BlueNoiseTile();
+}
+
+uint32_t RTSampler::Hash(uint32_t x)
+{
+	// lowbias32 (Wellons 2018)
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+uint32_t RTSampler::HashCombine(uint32_t seed, uint32_t value)
+{
+	return Hash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+float RTSampler::Get1D(int x, int y, int sample, int dimension) const
+{
+	switch (m_type)
+	{
+	case RT_SAMPLER_SOBOL:
+		return ToFloat(ScrambledSobol0((uint32_t)sample, PixelSeed(x, y, dimension)));
+	case RT_SAMPLER_BLUE_NOISE:
+		return ToFloat(ScrambledSobol0((uint32_t)sample, HashCombine(m_seed, (uint32_t)dimension)) + BlueNoise(x, y, dimension));
+	default:
+		return ToFloat(HashCombine(PixelSeed(x, y, dimension), (uint32_t)sample));
+	}
+}
+
+glm::vec2 RTSampler::Get2D(int x, int y, int sample, int dimension) const
+{
+	uint32_t u, v;
+
+	switch (m_type)
+	{
+	case RT_SAMPLER_SOBOL:
+		ScrambledSobol2D((uint32_t)sample, PixelSeed(x, y, dimension), u, v);
+		return glm::vec2(ToFloat(u), ToFloat(v));
+	case RT_SAMPLER_BLUE_NOISE:
+		ScrambledSobol2D((uint32_t)sample, HashCombine(m_seed, (uint32_t)dimension), u, v);
+		return glm::vec2(ToFloat(u + BlueNoise(x, y, dimension)), ToFloat(v + BlueNoise(x, y, dimension + 1)));
+	default:
+		return glm::vec2(Get1D(x, y, sample, dimension), Get1D(x, y, sample, dimension + 1));
+	}
+}
+
+uint32_t RTSampler::PixelSeed(int x, int y, int dimension) const
+{
+	return HashCombine(HashCombine(HashCombine(m_seed, (uint32_t)dimension), (uint32_t)x), (uint32_t)y);
+}
+
+uint32_t RTSampler::BlueNoise(int x, int y, int dimension) const
+{
+	// Each dimension reads the tile from elsewhere
+	const uint32_t offset = HashCombine(m_seed, (uint32_t)dimension);
+	const int tx = (x + (int)(offset & (RT_BLUE_NOISE_SIZE - 1))) & (RT_BLUE_NOISE_SIZE - 1);
+	const int ty = (y + (int)((offset >> 16) & (RT_BLUE_NOISE_SIZE - 1))) & (RT_BLUE_NOISE_SIZE - 1);
+
+	// The rank gives the high bits, a hash of the pixel spreads the values inside its step
+	const uint32_t rank = (*m_blueNoise)[ty * RT_BLUE_NOISE_SIZE + tx];
+	return (rank << 20) | (PixelSeed(x, y, dimension) >> 12);
+}
@@ -0,0 +1,697 @@
+#include "Files/RT/headers/rtscene.h"
+#include "Files/RT/headers/rtrandom.h"
+#include "Files/definitions.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Floor of the default scene, a huge sphere
+#define RT_FLOOR_CENTER glm::vec3(0.0f, -10004.0f, -30.0f)
+#define RT_FLOOR_RADIUS 10000.0f
+
+// Rows of instances on the floor start in front of the camera, the instances are
+// scaled to fit in a cell and get some room around them
+#define RT_INSTANCE_FIRST_ROW -12.0f
+#define RT_INSTANCE_CELL_SIZE 2.0f
+#define RT_INSTANCE_FILL 0.75f
+
+// Many small lights fill a square above the default scene
+#define RT_LIGHT_GRID_CENTER glm::vec3(0.0f, 6.0f, -25.0f)
+#define RT_LIGHT_GRID_SIZE 80.0f
+#define RT_LIGHT_GRID_RADIUS 0.5f
+#define RT_DEFAULT_LIGHTS_EMISSION 6.0f
+
+// Brings a ray into the space of an instance. The direction is normalized again
+// for the intersection code, distances along it are scale times the world ones.
+static void ToObject(const RTInstance& instance, const glm::vec3& origin, const glm::vec3& direction, glm::vec3& objectOrigin, glm::vec3& objectDirection, float& scale)
+{
+	objectOrigin = instance.m_worldToObject * glm::vec4(origin, 1.f);
+	objectDirection = glm::mat3(instance.m_worldToObject) * direction;
+	scale = glm::length(objectDirection);
+	objectDirection /= scale;
+}
+
+RTScene::RTScene() : m_acceleration(RT_ACCELERATION_AUTO), m_useGrid(false), m_bvhCache(nullptr) { }
+
+RTScene::~RTScene() { }
+
+void RTScene::Clear()
+{
+	m_spheres.clear();
+	m_sphereMaterials.clear();
+	m_lights.clear();
+	m_bvhSpheres.clear();
+	m_sphereSoA.Clear();
+	m_bvh.Clear();
+	m_grid.Clear();
+	m_useGrid = false;
+	m_meshes.clear();
+	m_lightSampler.Clear();
+	m_objects.clear();
+	m_instances.clear();
+	m_instanceBVH.Clear();
+}
+
+void RTScene::AddSphere(const Sphere& sphere)
+{
+	if (sphere.isLight()) m_lights.push_back((int)m_spheres.size());
+
+	m_spheres.push_back(sphere);
+	m_sphereMaterials.push_back(RTMaterial::FromSphere(sphere));
+}
+
+void RTScene::AddMesh(const Model& model, const glm::mat4& transform)
+{
+	m_meshes.push_back(TriangleMesh());
+	m_meshes.back().Load(model, transform, m_bvhCache);
+
+	if (m_meshes.back().IsEmpty()) m_meshes.pop_back();
+}
+
+void RTScene::LoadDefaultScene(bool withSpheres, int numLights)
+{
+	// Lights
+	if (numLights <= 0)
+	{
+		AddSphere(Sphere(glm::vec3(10.0f, 20.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
+		AddSphere(Sphere(glm::vec3(-10.0f, 20.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
+		AddSphere(Sphere(glm::vec3(0.0f, 10.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
+	}
+	else
+	{
+		// Same lights every time, the emission of the three lights is shared among them
+		RTRandom random;
+		const int columns = (int)std::ceil(std::sqrt((double)numLights));
+		const float spacing = RT_LIGHT_GRID_SIZE / columns;
+
+		for (int i = 0; i < numLights; ++i)
+		{
+			const glm::vec3 position = RT_LIGHT_GRID_CENTER + glm::vec3(((i % columns) + 0.5f) * spacing - RT_LIGHT_GRID_SIZE * 0.5f,
+				0.0f, ((i / columns) + 0.5f) * spacing - RT_LIGHT_GRID_SIZE * 0.5f);
+			const glm::vec3 color(0.5f + 0.5f * random.NextFloat(), 0.5f + 0.5f * random.NextFloat(), 0.5f + 0.5f * random.NextFloat());
+
+			AddSphere(Sphere(position, std::min(RT_LIGHT_GRID_RADIUS, spacing * 0.25f), glm::vec3(0.0f), false, 0.0f, 0.0f,
+				RT_DEFAULT_LIGHTS_EMISSION / numLights, color));
+		}
+	}
+
+	// Spheres of the scene
+	AddSphere(Sphere(RT_FLOOR_CENTER, RT_FLOOR_RADIUS, glm::vec3(0.0f, 0.2f, 0.5f), false, 0.0, 0.0));
+
+	if (withSpheres)
+	{
+		AddSphere(Sphere(glm::vec3(0.0f, 0.0f, -20.0f), 2, glm::vec3(1.0f, 1.0f, 1.0f), true, 0.9f, 1.1f));
+		AddSphere(Sphere(glm::vec3(4.0f, 0.0f, -32.5f), 4, glm::vec3(0.0f, 0.5f, 0.0f), true, 0.0f, 0.0f));
+		AddSphere(Sphere(glm::vec3(-5.0f, 0.0f, -35.0f), 3, glm::vec3(0.5f, 0.5f, 0.5f), true, 0.0f, 0.0f));
+		AddSphere(Sphere(glm::vec3(-4.5f, -1.0f, -19.0f), 1.5f, glm::vec3(0.5f, 0.1f, 0.0f), true, 0.0f, 0.0f));
+	}
+}
+
+void RTScene::AddModelOnFloor(const Model& model)
+{
+	const std::vector<Vertex>& vertices = model.vertices();
+	if (vertices.empty()) return;
+
+	glm::vec3 minBox(INFINITY), maxBox(-INFINITY);
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+	{
+		const glm::vec3 vertex(vertices[i], vertices[i + 1], vertices[i + 2]);
+		minBox = glm::min(minBox, vertex);
+		maxBox = glm::max(maxBox, vertex);
+	}
+
+	const glm::vec3 size = maxBox - minBox;
+	const glm::vec3 base((minBox.x + maxBox.x) * 0.5f, minBox.y, (minBox.z + maxBox.z) * 0.5f);
+	const float scale = 10.0f / glm::max(size.x, glm::max(size.y, size.z));
+
+	glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -25.0f));
+	transform = glm::scale(transform, glm::vec3(scale));
+	transform = glm::translate(transform, -base);
+
+	AddMesh(model, transform);
+}
+
+int RTScene::AddObject(const RTObject& object)
+{
+	m_objects.push_back(object);
+	m_objects.back().Build();
+	return (int)m_objects.size() - 1;
+}
+
+void RTScene::AddInstance(int object, const glm::mat4& transform)
+{
+	if (object < 0 || object >= (int)m_objects.size() || m_objects[object].IsEmpty()) return;
+
+	RTInstance instance;
+	instance.m_worldToObject = glm::mat4x3(glm::inverse(transform));
+	instance.m_object = object;
+	m_instances.push_back(instance);
+}
+
+void RTScene::AddInstancesOnFloor(int object, int count)
+{
+	if (object < 0 || object >= (int)m_objects.size() || m_objects[object].IsEmpty()) return;
+
+	const AABB& bounds = m_objects[object].Bounds();
+	const glm::vec3 size = bounds.Extent();
+	const glm::vec3 base((bounds.m_min.x + bounds.m_max.x) * 0.5f, bounds.m_min.y, (bounds.m_min.z + bounds.m_max.z) * 0.5f);
+	const float fitScale = RT_INSTANCE_CELL_SIZE * RT_INSTANCE_FILL / std::max(size.x, std::max(size.y, size.z));
+
+	// Same instances every time, the rows are centered in front of the camera
+	RTRandom random;
+	const int columns = (int)std::ceil(std::sqrt((double)count));
+	m_instances.reserve(m_instances.size() + count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const float x = ((i % columns) - (columns - 1) * 0.5f) * RT_INSTANCE_CELL_SIZE;
+		const float z = RT_INSTANCE_FIRST_ROW - (i / columns) * RT_INSTANCE_CELL_SIZE;
+
+		// Far away the floor curves down
+		const float dx = x - RT_FLOOR_CENTER.x, dz = z - RT_FLOOR_CENTER.z;
+		const float floorHeight2 = RT_FLOOR_RADIUS * RT_FLOOR_RADIUS - dx * dx - dz * dz;
+		if (floorHeight2 <= 0.f) break;
+		const float y = RT_FLOOR_CENTER.y + std::sqrt(floorHeight2);
+
+		const float angle = random.NextFloat() * 2.f * PI;
+		const float scale = fitScale * (0.7f + 0.3f * random.NextFloat());
+
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+		transform = glm::rotate(transform, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		transform = glm::scale(transform, glm::vec3(scale));
+		transform = glm::translate(transform, -base);
+
+		AddInstance(object, transform);
+	}
+}
+
+void RTScene::Write(RTStreamWriter& stream) const
+{
+	stream.WriteUInt32((uint32_t)m_spheres.size());
+	for (const Sphere& sphere : m_spheres) WriteSphere(stream, sphere);
+
+	stream.WriteUInt32((uint32_t)m_meshes.size());
+	for (const TriangleMesh& mesh : m_meshes) mesh.Write(stream);
+
+	stream.WriteUInt32((uint32_t)m_objects.size());
+	for (const RTObject& object : m_objects) object.Write(stream);
+
+	stream.WriteUInt32((uint32_t)m_instances.size());
+	for (const RTInstance& instance : m_instances)
+	{
+		for (int column = 0; column < 4; ++column) stream.WriteVec3(instance.m_worldToObject[column]);
+		stream.WriteInt32(instance.m_object);
+	}
+}
+
+bool RTScene::Read(RTStreamReader& stream)
+{
+	Clear();
+
+	const uint32_t numSpheres = stream.ReadCount(56);
+	for (uint32_t i = 0; i < numSpheres; ++i) AddSphere(ReadSphere(stream));
+
+	const uint32_t numMeshes = stream.ReadCount(16);
+	m_meshes.resize(numMeshes);
+	for (TriangleMesh& mesh : m_meshes)
+	{
+		if (!mesh.Read(stream)) break;
+	}
+	bool valid = m_meshes.empty() || !m_meshes.back().IsEmpty();
+
+	const uint32_t numObjects = stream.ReadCount(20);
+	m_objects.resize(numObjects);
+	for (RTObject& object : m_objects)
+	{
+		valid &= !stream.m_failed && object.Read(stream);
+		if (!valid) break;
+	}
+
+	const uint32_t numInstances = stream.ReadCount(52);
+	m_instances.resize(numInstances);
+	for (RTInstance& instance : m_instances)
+	{
+		for (int column = 0; column < 4; ++column) instance.m_worldToObject[column] = stream.ReadVec3();
+		instance.m_object = stream.ReadInt32();
+		valid &= instance.m_object >= 0 && instance.m_object < (int)m_objects.size() && !m_objects[instance.m_object].IsEmpty();
+	}
+
+	if (stream.m_failed || !valid)
+	{
+		Clear();
+		return false;
+	}
+
+	return true;
+}
+
+void RTScene::SphereBounds(std::vector<AABB>& bounds) const
+{
+	bounds.resize(m_bvhSpheres.size());
+	for (size_t i = 0; i < m_bvhSpheres.size(); ++i)
+	{
+		const Sphere& sphere = m_spheres[m_bvhSpheres[i]];
+		const glm::vec3 radius(sphere.getRadius());
+		bounds[i] = AABB(sphere.getCenter() - radius, sphere.getCenter() + radius);
+	}
+}
+
+void RTScene::BuildAccelerationStructure()
+{
+	m_bvhSpheres.clear();
+	for (int i = 0; i < (int)m_spheres.size(); ++i)
+	{
+		if (!m_spheres[i].isLight()) m_bvhSpheres.push_back(i);
+	}
+
+	std::vector<AABB> bounds;
+	SphereBounds(bounds);
+
+	m_useGrid = m_acceleration == RT_ACCELERATION_GRID || (m_acceleration == RT_ACCELERATION_AUTO && UniformGrid::Suits(bounds));
+	if (m_useGrid)
+	{
+		m_bvh.Clear();
+		BuildGrid(bounds);
+	}
+	else
+	{
+		m_grid.Clear();
+
+		// The leaves test RT_SIMD_WIDTH spheres at once so they can be wider
+		if (m_bvhCache) m_bvhCache->Build(m_bvh, bounds, std::max(4, 2 * RT_SIMD_WIDTH), RT_SIMD_WIDTH);
+		else m_bvh.Build(bounds, std::max(4, 2 * RT_SIMD_WIDTH), RT_SIMD_WIDTH);
+
+		// Lay out the spheres in the order of the leaves
+		const BVHArray<unsigned int> primIndices = m_bvh.PrimIndices();
+		std::vector<int> order(primIndices.size());
+		for (size_t i = 0; i < primIndices.size(); ++i)
+		{
+			order[i] = m_bvhSpheres[primIndices[i]];
+		}
+
+		m_sphereSoA.Load(m_spheres, order);
+	}
+
+	m_lightSampler.Build(m_spheres);
+
+	// Top level over the instances, their objects have their own BVHs
+	std::vector<AABB> instanceBounds(m_instances.size());
+	for (size_t i = 0; i < m_instances.size(); ++i) instanceBounds[i] = InstanceBounds(m_instances[i]);
+
+	m_instanceBVH.Build(instanceBounds, 2);
+}
+
+void RTScene::BuildGrid(const std::vector<AABB>& bounds)
+{
+	m_grid.Build(bounds);
+
+	// A sphere is copied in every cell it overlaps so the cells are swept like the leaves
+	const std::vector<unsigned int>& primIndices = m_grid.PrimIndices();
+	std::vector<int> order(primIndices.size());
+	for (size_t i = 0; i < primIndices.size(); ++i)
+	{
+		order[i] = m_bvhSpheres[primIndices[i]];
+	}
+
+	m_sphereSoA.Load(m_spheres, order);
+}
+
+AABB RTScene::InstanceBounds(const RTInstance& instance) const
+{
+	const glm::mat4x3& w = instance.m_worldToObject;
+	const glm::mat4 toWorld = glm::inverse(glm::mat4(glm::vec4(w[0], 0.f), glm::vec4(w[1], 0.f), glm::vec4(w[2], 0.f), glm::vec4(w[3], 1.f)));
+	const AABB& objectBounds = m_objects[instance.m_object].Bounds();
+
+	AABB bounds;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const glm::vec3 point((corner & 1) ? objectBounds.m_max.x : objectBounds.m_min.x,
+			(corner & 2) ? objectBounds.m_max.y : objectBounds.m_min.y,
+			(corner & 4) ? objectBounds.m_max.z : objectBounds.m_min.z);
+		bounds.Grow(glm::vec3(toWorld * glm::vec4(point, 1.f)));
+	}
+
+	return bounds;
+}
+
+bool RTScene::SetSphere(int index, const Sphere& sphere)
+{
+	if (index < 0 || index >= (int)m_spheres.size() || sphere.isLight() != m_spheres[index].isLight()) return false;
+
+	m_spheres[index] = sphere;
+	m_sphereMaterials[index] = RTMaterial::FromSphere(sphere);
+	return true;
+}
+
+void RTScene::RefitAccelerationStructure()
+{
+	std::vector<AABB> bounds;
+	SphereBounds(bounds);
+
+	if (m_useGrid)
+	{
+		BuildGrid(bounds);
+		m_lightSampler.Build(m_spheres);
+		return;
+	}
+
+	m_bvh.Refit(bounds);
+
+	// The slots keep the order of the leaves, only their geometry changes
+	std::vector<int> order(m_sphereSoA.Size());
+	for (int slot = 0; slot < m_sphereSoA.Size(); ++slot) order[slot] = m_sphereSoA.MaterialIndex(slot);
+
+	m_sphereSoA.Load(m_spheres, order);
+
+	// Few lights move, their BVH is cheap to build again
+	m_lightSampler.Build(m_spheres);
+}
+
+bool RTScene::Intersect(const Ray& ray, HitInfo& hitInfo, RTStats* stats) const
+{
+	float distance = INFINITY;
+	const int sphereIndex = ClosestHit(ray.m_origin, ray.m_direction, distance, stats);
+
+	int triangle = -1;
+	float u = 0.f, v = 0.f;
+	const int meshIndex = ClosestMeshHit(ray, distance, triangle, u, v, stats);
+
+	ObjectHit objectHit;
+	const int instance = ClosestInstanceHit(ray, distance, objectHit, stats);
+
+	if (instance >= 0)
+	{
+		FillInstanceHitInfo(ray, distance, instance, objectHit, hitInfo);
+		return true;
+	}
+
+	if (sphereIndex < 0 && meshIndex < 0) return false;
+
+	FillHitInfo(ray, distance, sphereIndex, meshIndex, triangle, u, v, hitInfo);
+	return true;
+}
+
+void RTScene::IntersectPacket(const Ray* rays, int count, HitInfo* hitInfos, bool* hits, RTStats* stats) const
+{
+	RT_ALIGN(64) float distances[RT_SIMD_WIDTH];
+	RT_ALIGN(64) int spheres[RT_SIMD_WIDTH];
+
+	if (m_useGrid)
+	{
+		// The grid has no packet traversal, each ray walks its own cells
+		for (int lane = 0; lane < count; ++lane) spheres[lane] = ClosestHit(rays[lane].m_origin, rays[lane].m_direction, distances[lane], stats);
+	}
+	else
+	{
+		const RayPacket packet(rays, count);
+		vfloat tMax(INFINITY);
+		vint sphereHit(-1);
+
+		m_bvh.TraversePacket(packet, tMax, [&](unsigned int first, unsigned int count, const vmask& active, vfloat& t)
+		{
+			for (unsigned int slot = first; slot < first + count; ++slot)
+			{
+				const glm::vec3 center = m_sphereSoA.Center(slot);
+				const vfloat radius2(m_sphereSoA.Radius2(slot));
+
+				const vfloat lx = vfloat(center.x) - packet.m_originX;
+				const vfloat ly = vfloat(center.y) - packet.m_originY;
+				const vfloat lz = vfloat(center.z) - packet.m_originZ;
+				const vfloat tca = lx * packet.m_dirX + ly * packet.m_dirY + lz * packet.m_dirZ;
+				const vfloat ox = lx - tca * packet.m_dirX, oy = ly - tca * packet.m_dirY, oz = lz - tca * packet.m_dirZ;
+				const vfloat d2 = ox * ox + oy * oy + oz * oz;
+
+				vmask hit = active & (tca >= vfloat(0.f)) & (d2 <= radius2);
+				if (None(hit)) continue;
+
+				const vfloat thc = Sqrt(Max(radius2 - d2, vfloat(0.f)));
+				const vfloat t0 = tca - thc;
+				const vfloat tHit = Select(t0 < vfloat(0.f), tca + thc, t0);
+
+				hit = hit & (tHit < t);
+				t = Select(hit, tHit, t);
+				sphereHit = Select(hit, vint(m_sphereSoA.MaterialIndex(slot)), sphereHit);
+			}
+		}, stats);
+
+		StoreFloats(distances, tMax);
+		StoreInts(spheres, sphereHit);
+	}
+
+	// Meshes and shading data are resolved one ray at a time
+	for (int lane = 0; lane < count; ++lane)
+	{
+		float distance = distances[lane];
+		int triangle = -1;
+		float u = 0.f, v = 0.f;
+		const int meshIndex = ClosestMeshHit(rays[lane], distance, triangle, u, v, stats);
+
+		ObjectHit objectHit;
+		const int instance = ClosestInstanceHit(rays[lane], distance, objectHit, stats);
+
+		hits[lane] = spheres[lane] >= 0 || meshIndex >= 0 || instance >= 0;
+		if (instance >= 0)
+		{
+			FillInstanceHitInfo(rays[lane], distance, instance, objectHit, hitInfos[lane]);
+		}
+		else if (hits[lane])
+		{
+			FillHitInfo(rays[lane], distance, spheres[lane], meshIndex, triangle, u, v, hitInfos[lane]);
+		}
+	}
+}
+
+int RTScene::ClosestMeshHit(const Ray& ray, float& distance, int& triangle, float& u, float& v, RTStats* stats) const
+{
+	int meshIndex = -1;
+
+	for (int m = 0; m < (int)m_meshes.size(); ++m)
+	{
+		const int hit = m_meshes[m].ClosestHit(ray.m_origin, ray.m_direction, distance, u, v, stats);
+		if (hit >= 0)
+		{
+			meshIndex = m;
+			triangle = hit;
+		}
+	}
+
+	return meshIndex;
+}
+
+int RTScene::ClosestInstanceHit(const Ray& ray, float& distance, ObjectHit& hit, RTStats* stats) const
+{
+	int closest = -1;
+
+	m_instanceBVH.Traverse(ray.m_origin, ray.m_direction, distance, [&](unsigned int i, float& tMax)
+	{
+		const RTInstance& instance = m_instances[i];
+		glm::vec3 origin, direction;
+		float scale;
+		ToObject(instance, ray.m_origin, ray.m_direction, origin, direction, scale);
+
+		float t = tMax * scale;
+		if (!m_objects[instance.m_object].ClosestHit(origin, direction, t, hit, stats)) return false;
+
+		tMax = t / scale;
+		closest = (int)i;
+		return true;
+	}, stats);
+
+	return closest;
+}
+
+void RTScene::FillHitInfo(const Ray& ray, float distance, int sphereIndex, int meshIndex, int triangle, float u, float v, HitInfo& hitInfo) const
+{
+	hitInfo.m_distanceHit = distance;
+	hitInfo.m_positionHit = ray.m_origin + ray.m_direction * distance;
+	hitInfo.m_isInside = false;
+	hitInfo.m_instance = -1;
+	hitInfo.m_mesh = meshIndex;
+	hitInfo.m_prim = meshIndex >= 0 ? triangle : sphereIndex;
+
+	if (meshIndex >= 0)
+	{
+		// Triangles are two sided, the normal always faces the ray
+		const TriangleMesh& mesh = m_meshes[meshIndex];
+		hitInfo.m_normalHit = mesh.Normal(triangle, u, v);
+		if (glm::dot(ray.m_direction, hitInfo.m_normalHit) > 0) hitInfo.m_normalHit = -hitInfo.m_normalHit;
+		hitInfo.m_material = &mesh.GetMaterial(triangle);
+	}
+	else
+	{
+		const Sphere& sphere = m_spheres[sphereIndex];
+		hitInfo.m_normalHit = glm::normalize(hitInfo.m_positionHit - sphere.getCenter());
+
+		// If the normal and the view direction are not opposite to each other
+		// reverse the normal direction. That also means we are inside the sphere so set
+		// the inside bool to true.
+		if (glm::dot(ray.m_direction, hitInfo.m_normalHit) > 0)
+		{
+			hitInfo.m_normalHit = -hitInfo.m_normalHit;
+			hitInfo.m_isInside = true;
+		}
+		hitInfo.m_material = &m_sphereMaterials[sphereIndex];
+	}
+
+	hitInfo.m_colorHit = hitInfo.m_material->m_surfaceColor;
+}
+
+void RTScene::FillInstanceHitInfo(const Ray& ray, float distance, int instanceIndex, const ObjectHit& hit, HitInfo& hitInfo) const
+{
+	const RTInstance& instance = m_instances[instanceIndex];
+	const RTObject& object = m_objects[instance.m_object];
+
+	hitInfo.m_distanceHit = distance;
+	hitInfo.m_positionHit = ray.m_origin + ray.m_direction * distance;
+	hitInfo.m_isInside = false;
+	hitInfo.m_instance = instanceIndex;
+	hitInfo.m_mesh = hit.m_sphere >= 0 ? -1 : 0;
+	hitInfo.m_prim = hit.m_sphere >= 0 ? hit.m_sphere : hit.m_triangle;
+
+	// Normals go out of the object with the transpose of the transform that brought the ray in
+	const glm::vec3 objectPosition = instance.m_worldToObject * glm::vec4(hitInfo.m_positionHit, 1.f);
+	hitInfo.m_normalHit = glm::normalize(glm::transpose(glm::mat3(instance.m_worldToObject)) * object.Normal(hit, objectPosition));
+
+	// Like the spheres and triangles of the scene, only a sphere has an inside
+	if (glm::dot(ray.m_direction, hitInfo.m_normalHit) > 0)
+	{
+		hitInfo.m_normalHit = -hitInfo.m_normalHit;
+		hitInfo.m_isInside = hit.m_sphere >= 0;
+	}
+
+	hitInfo.m_material = &object.GetMaterial(hit);
+	hitInfo.m_colorHit = hitInfo.m_material->m_surfaceColor;
+}
+
+int RTScene::IntersectLight(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+	int closest = -1;
+	distance = maxDistance;
+
+	const std::vector<RTLight>& lights = m_lightSampler.Lights();
+	m_lightSampler.GetBVH().Traverse(origin, direction, distance, [&](unsigned int light, float& tMax)
+	{
+		const float t = HitDistance(m_spheres[lights[light].m_sphere], origin, direction);
+		if (t >= tMax) return false;
+
+		tMax = t;
+		closest = lights[light].m_sphere;
+		return true;
+	});
+
+	return closest;
+}
+
+int RTScene::ClosestHit(const glm::vec3& origin, const glm::vec3& direction, float& distance, RTStats* stats) const
+{
+	int closest = -1;
+	distance = INFINITY;
+
+	// The leaves or cells are swept RT_SIMD_WIDTH spheres at a time
+	auto intersectSpheres = [&](unsigned int first, unsigned int count, float& tMax)
+	{
+		const int slot = m_sphereSoA.ClosestHit(first, count, origin, direction, tMax);
+		if (slot < 0) return false;
+
+		closest = m_sphereSoA.MaterialIndex(slot);
+		return true;
+	};
+
+	if (m_useGrid) m_grid.TraverseCells(origin, direction, distance, intersectSpheres, stats);
+	else m_bvh.TraverseLeaves(origin, direction, distance, intersectSpheres, stats);
+
+	return closest;
+}
+
+bool RTScene::Occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Occluder* lastOccluder, RTStats* stats) const
+{
+	if (lastOccluder && lastOccluder->IsValid())
+	{
+		if (stats) stats->m_primTests++;
+		if (OccludedBy(*lastOccluder, origin, direction, maxDistance))
+		{
+			if (stats) stats->m_occluderHits++;
+			return true;
+		}
+	}
+
+	int slot = -1;
+	auto spheresOcclude = [&](unsigned int first, unsigned int count, float tMax)
+	{
+		return m_sphereSoA.AnyHit(first, count, origin, direction, tMax, &slot);
+	};
+	const bool sphereOccludes = m_useGrid ? m_grid.TraverseAnyCells(origin, direction, maxDistance, spheresOcclude, stats)
+		: m_bvh.TraverseAnyLeaves(origin, direction, maxDistance, spheresOcclude, stats);
+
+	if (sphereOccludes)
+	{
+		if (lastOccluder)
+		{
+			lastOccluder->m_instance = -1;
+			lastOccluder->m_mesh = -1;
+			lastOccluder->m_prim = m_sphereSoA.MaterialIndex(slot);
+		}
+		return true;
+	}
+
+	for (int m = 0; m < (int)m_meshes.size(); ++m)
+	{
+		int triangle = -1;
+		if (m_meshes[m].Occluded(origin, direction, maxDistance, &triangle, stats))
+		{
+			if (lastOccluder)
+			{
+				lastOccluder->m_instance = -1;
+				lastOccluder->m_mesh = m;
+				lastOccluder->m_prim = triangle;
+			}
+			return true;
+		}
+	}
+
+	Occluder instanceOccluder;
+	const bool instanceOccludes = m_instanceBVH.TraverseAny(origin, direction, maxDistance, [&](unsigned int i, float tMax)
+	{
+		const RTInstance& instance = m_instances[i];
+		glm::vec3 objectOrigin, objectDirection;
+		float scale;
+		ToObject(instance, origin, direction, objectOrigin, objectDirection, scale);
+
+		if (!m_objects[instance.m_object].Occluded(objectOrigin, objectDirection, tMax * scale, &instanceOccluder, stats)) return false;
+
+		instanceOccluder.m_instance = (int)i;
+		return true;
+	}, stats);
+
+	if (instanceOccludes)
+	{
+		if (lastOccluder) *lastOccluder = instanceOccluder;
+		return true;
+	}
+
+	// Lit points usually come in runs too, they do not pay for a stale occluder
+	if (lastOccluder) *lastOccluder = Occluder();
+
+	return false;
+}
+
+bool RTScene::OccludedBy(const Occluder& occluder, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	if (occluder.m_instance >= 0)
+	{
+		const RTInstance& instance = m_instances[occluder.m_instance];
+		glm::vec3 objectOrigin, objectDirection;
+		float scale;
+		ToObject(instance, origin, direction, objectOrigin, objectDirection, scale);
+
+		return m_objects[instance.m_object].OccludedBy(occluder, objectOrigin, objectDirection, maxDistance * scale);
+	}
+
+	if (occluder.m_mesh < 0)
+	{
+		return HitDistance(m_spheres[occluder.m_prim], origin, direction) < maxDistance;
+	}
+
+	float t, u, v;
+	return m_meshes[occluder.m_mesh].IntersectTriangle(occluder.m_prim, WatertightRay(origin, direction), maxDistance, t, u, v);
+}
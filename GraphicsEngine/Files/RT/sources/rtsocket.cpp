@@ -0,0 +1,351 @@
+#include "Files/RT/headers/rtsocket.h"
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define RT_SOCKET_BACKLOG 64
+
+// A worker that went away must not kill the coordinator with SIGPIPE
+#if defined(MSG_NOSIGNAL)
+#define RT_SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define RT_SOCKET_SEND_FLAGS 0
+#endif
+
+static bool SplitAddress(const std::string& address, std::string& scheme, std::string& rest)
+{
+	const size_t colon = address.find(':');
+	if (colon == std::string::npos) return false;
+
+	scheme = address.substr(0, colon);
+	rest = address.substr(colon + 1);
+	return scheme == "tcp" || scheme == "unix";
+}
+
+static bool SplitHostPort(const std::string& hostPort, std::string& host, std::string& port)
+{
+	const size_t colon = hostPort.rfind(':');
+	if (colon == std::string::npos || colon + 1 == hostPort.size()) return false;
+
+	host = hostPort.substr(0, colon);
+	port = hostPort.substr(colon + 1);
+	if (host.empty()) host = "127.0.0.1";
+	return true;
+}
+
+static bool UnixAddress(const std::string& path, sockaddr_un& address, std::string& error)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(address.sun_path))
+	{
+		error = "invalid socket path " + path;
+		return false;
+	}
+
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+static void SetNoSigPipe(int handle)
+{
+#if defined(SO_NOSIGPIPE)
+	int on = 1;
+	setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+	(void)handle;
+#endif
+}
+
+RTSocket::RTSocket() : m_handle(-1) { }
+
+RTSocket::~RTSocket()
+{
+	Close();
+}
+
+RTSocket::RTSocket(RTSocket&& other) : m_handle(other.m_handle), m_unixPath(other.m_unixPath)
+{
+	other.m_handle = -1;
+	other.m_unixPath.clear();
+}
+
+RTSocket& RTSocket::operator=(RTSocket&& other)
+{
+	if (this != &other)
+	{
+		Close();
+		m_handle = other.m_handle;
+		m_unixPath = other.m_unixPath;
+		other.m_handle = -1;
+		other.m_unixPath.clear();
+	}
+	return *this;
+}
+
+void RTSocket::Close()
+{
+	if (m_handle >= 0) close(m_handle);
+	m_handle = -1;
+
+	if (!m_unixPath.empty()) unlink(m_unixPath.c_str());
+	m_unixPath.clear();
+}
+
+bool RTSocket::Listen(const std::string& address, std::string& error)
+{
+	Close();
+
+	std::string scheme, rest;
+	if (!SplitAddress(address, scheme, rest))
+	{
+		error = "invalid address " + address + ", expected tcp:host:port or unix:path";
+		return false;
+	}
+
+	if (scheme == "unix")
+	{
+		sockaddr_un unixAddress;
+		if (!UnixAddress(rest, unixAddress, error)) return false;
+
+		m_handle = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_handle < 0 || bind(m_handle, (sockaddr*)&unixAddress, sizeof(unixAddress)) != 0 || listen(m_handle, RT_SOCKET_BACKLOG) != 0)
+		{
+			error = address + ": " + strerror(errno);
+			Close();
+			return false;
+		}
+
+		m_unixPath = rest;
+		return true;
+	}
+
+	std::string host, port;
+	if (!SplitHostPort(rest, host, port))
+	{
+		error = "invalid address " + address + ", expected tcp:host:port";
+		return false;
+	}
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	addrinfo* results = nullptr;
+	const int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &results);
+	if (status != 0)
+	{
+		error = address + ": " + gai_strerror(status);
+		return false;
+	}
+
+	for (addrinfo* result = results; result && m_handle < 0; result = result->ai_next)
+	{
+		m_handle = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+		if (m_handle < 0) continue;
+
+		int on = 1;
+		setsockopt(m_handle, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		if (bind(m_handle, result->ai_addr, result->ai_addrlen) != 0 || listen(m_handle, RT_SOCKET_BACKLOG) != 0)
+		{
+			error = address + ": " + strerror(errno);
+			Close();
+		}
+	}
+	freeaddrinfo(results);
+
+	return m_handle >= 0;
+}
+
+bool RTSocket::Connect(const std::string& address, std::string& error)
+{
+	Close();
+
+	std::string scheme, rest;
+	if (!SplitAddress(address, scheme, rest))
+	{
+		error = "invalid address " + address + ", expected tcp:host:port or unix:path";
+		return false;
+	}
+
+	if (scheme == "unix")
+	{
+		sockaddr_un unixAddress;
+		if (!UnixAddress(rest, unixAddress, error)) return false;
+
+		m_handle = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_handle < 0 || connect(m_handle, (sockaddr*)&unixAddress, sizeof(unixAddress)) != 0)
+		{
+			error = address + ": " + strerror(errno);
+			Close();
+			return false;
+		}
+
+		SetNoSigPipe(m_handle);
+		return true;
+	}
+
+	std::string host, port;
+	if (!SplitHostPort(rest, host, port))
+	{
+		error = "invalid address " + address + ", expected tcp:host:port";
+		return false;
+	}
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* results = nullptr;
+	const int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &results);
+	if (status != 0)
+	{
+		error = address + ": " + gai_strerror(status);
+		return false;
+	}
+
+	for (addrinfo* result = results; result && m_handle < 0; result = result->ai_next)
+	{
+		m_handle = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+		if (m_handle < 0) continue;
+
+		if (connect(m_handle, result->ai_addr, result->ai_addrlen) != 0)
+		{
+			error = address + ": " + strerror(errno);
+			Close();
+		}
+	}
+	freeaddrinfo(results);
+
+	if (m_handle < 0) return false;
+
+	// Tiles are small messages that must not wait for more data
+	int on = 1;
+	setsockopt(m_handle, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	SetNoSigPipe(m_handle);
+	return true;
+}
+
+RTSocket RTSocket::Accept()
+{
+	RTSocket connection;
+	connection.m_handle = accept(m_handle, nullptr, nullptr);
+	if (connection.m_handle < 0) return connection;
+
+	if (m_unixPath.empty())
+	{
+		int on = 1;
+		setsockopt(connection.m_handle, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	SetNoSigPipe(connection.m_handle);
+	return connection;
+}
+
+std::string RTSocket::Address() const
+{
+	if (!m_unixPath.empty()) return "unix:" + m_unixPath;
+
+	sockaddr_storage address;
+	socklen_t length = sizeof(address);
+	if (m_handle < 0 || getsockname(m_handle, (sockaddr*)&address, &length) != 0) return "";
+
+	char host[NI_MAXHOST], port[NI_MAXSERV];
+	if (getnameinfo((sockaddr*)&address, length, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV) != 0) return "";
+
+	// Bound to every interface, the workers of this machine come through the loopback
+	std::string hostName = host;
+	if (hostName == "0.0.0.0") hostName = "127.0.0.1";
+	if (hostName == "::") hostName = "::1";
+	return "tcp:" + hostName + ":" + port;
+}
+
+void RTSocket::SetSendTimeout(double seconds)
+{
+	timeval timeout;
+	timeout.tv_sec = (time_t)seconds;
+	timeout.tv_usec = (suseconds_t)((seconds - (double)timeout.tv_sec) * 1e6);
+	setsockopt(m_handle, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+bool RTSocket::SendAll(const void* data, size_t size)
+{
+	const char* bytes = (const char*)data;
+	while (size > 0)
+	{
+		const ssize_t sent = send(m_handle, bytes, size, RT_SOCKET_SEND_FLAGS);
+		if (sent < 0 && errno == EINTR) continue;
+		if (sent <= 0) return false;
+
+		bytes += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+bool RTSocket::ReceiveAll(void* data, size_t size)
+{
+	char* bytes = (char*)data;
+	while (size > 0)
+	{
+		const long received = Receive(bytes, size);
+		if (received <= 0) return false;
+
+		bytes += received;
+		size -= received;
+	}
+	return true;
+}
+
+long RTSocket::Receive(void* data, size_t size)
+{
+	ssize_t received;
+	do
+	{
+		received = recv(m_handle, data, size, 0);
+	} while (received < 0 && errno == EINTR);
+
+	return (long)received;
+}
+
+#else
+
+RTSocket::RTSocket() : m_handle(-1) { }
+RTSocket::~RTSocket() { }
+RTSocket::RTSocket(RTSocket&& other) : m_handle(-1) { (void)other; }
+RTSocket& RTSocket::operator=(RTSocket&&) { return *this; }
+
+void RTSocket::Close() { }
+
+bool RTSocket::Listen(const std::string&, std::string& error)
+{
+	error = "distributed rendering is only supported on POSIX systems";
+	return false;
+}
+
+bool RTSocket::Connect(const std::string&, std::string& error)
+{
+	error = "distributed rendering is only supported on POSIX systems";
+	return false;
+}
+
+RTSocket RTSocket::Accept() { return RTSocket(); }
+std::string RTSocket::Address() const { return ""; }
+void RTSocket::SetSendTimeout(double) { }
+bool RTSocket::SendAll(const void*, size_t) { return false; }
+bool RTSocket::ReceiveAll(void*, size_t) { return false; }
+long RTSocket::Receive(void*, size_t) { return -1; }
+
+#endif
@@ -0,0 +1,122 @@
+#include "Files/RT/headers/rtstats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+static const char* const s_rayTypeNames[RT_RAY_TYPE_COUNT] = { "primary", "reflection", "refraction", "diffuse", "shadow" };
+static const char* const s_phaseNames[RT_PHASE_COUNT] = { "primary", "secondary", "shadow", "shading" };
+
+static double PerRay(double value, uint64_t rays)
+{
+	return rays > 0 ? value / (double)rays : 0.0;
+}
+
+void RTStats::Clear()
+{
+	std::fill(m_rays, m_rays + RT_RAY_TYPE_COUNT, 0);
+	m_nodesVisited = 0;
+	m_primTests = 0;
+	m_waveRays = 0;
+	m_waveDepthSum = 0;
+	m_maxDepth = 0;
+	m_occluderHits = 0;
+	m_rouletteStops = 0;
+	std::fill(m_phaseSeconds, m_phaseSeconds + RT_PHASE_COUNT, 0.0);
+}
+
+void RTStats::Add(const RTStats& other)
+{
+	for (int i = 0; i < RT_RAY_TYPE_COUNT; ++i) m_rays[i] += other.m_rays[i];
+	m_nodesVisited += other.m_nodesVisited;
+	m_primTests += other.m_primTests;
+	m_waveRays += other.m_waveRays;
+	m_waveDepthSum += other.m_waveDepthSum;
+	m_maxDepth = std::max(m_maxDepth, other.m_maxDepth);
+	m_occluderHits += other.m_occluderHits;
+	m_rouletteStops += other.m_rouletteStops;
+	for (int i = 0; i < RT_PHASE_COUNT; ++i) m_phaseSeconds[i] += other.m_phaseSeconds[i];
+}
+
+uint64_t RTStats::TotalRays() const
+{
+	uint64_t total = 0;
+	for (int i = 0; i < RT_RAY_TYPE_COUNT; ++i) total += m_rays[i];
+	return total;
+}
+
+// Rays whose intersection is timed by the phase, shading is spread over all of them
+static uint64_t PhaseRays(const RTStats& stats, int phase)
+{
+	switch (phase)
+	{
+	case RT_PHASE_PRIMARY: return stats.m_rays[RT_RAY_PRIMARY];
+	case RT_PHASE_SECONDARY: return stats.m_rays[RT_RAY_REFLECTION] + stats.m_rays[RT_RAY_REFRACTION] + stats.m_rays[RT_RAY_DIFFUSE];
+	case RT_PHASE_SHADOW: return stats.m_rays[RT_RAY_SHADOW];
+	default: return stats.m_waveRays;
+	}
+}
+
+std::string RTStats::Summary(double seconds) const
+{
+	const uint64_t totalRays = TotalRays();
+	const double megaRays = (double)totalRays * 1e-6;
+
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(2);
+	text << megaRays << " Mrays in " << seconds << " s, " << megaRays / std::max(seconds, 1e-9) << " Mrays/s\n";
+	text << "Primary " << m_rays[RT_RAY_PRIMARY] << ", reflection " << m_rays[RT_RAY_REFLECTION] << ", refraction " << m_rays[RT_RAY_REFRACTION]
+		<< ", diffuse " << m_rays[RT_RAY_DIFFUSE] << ", shadow " << m_rays[RT_RAY_SHADOW] << "\n";
+
+	text << "ns per ray:";
+	for (int phase = 0; phase < RT_PHASE_COUNT; ++phase)
+	{
+		text << (phase > 0 ? ", " : " ") << s_phaseNames[phase] << " " << PerRay(m_phaseSeconds[phase] * 1e9, PhaseRays(*this, phase));
+	}
+	text << "\n";
+
+	text << "Per ray: " << PerRay((double)m_nodesVisited, totalRays) << " nodes, " << PerRay((double)m_primTests, totalRays) << " primitive tests. "
+		<< "Average depth " << PerRay((double)m_waveDepthSum, m_waveRays) << ", max " << m_maxDepth << "\n";
+	text << "Early outs: " << m_occluderHits << " cached occluders, " << m_rouletteStops << " roulette stops";
+
+	return text.str();
+}
+
+std::string RTStats::ToJSON(double seconds) const
+{
+	const uint64_t totalRays = TotalRays();
+
+	std::ostringstream json;
+	json << std::setprecision(6);
+	json << "{\n";
+	json << "  \"seconds\": " << seconds << ",\n";
+	json << "  \"rays\": " << totalRays << ",\n";
+	json << "  \"mrays_per_second\": " << (double)totalRays * 1e-6 / std::max(seconds, 1e-9) << ",\n";
+
+	json << "  \"rays_by_type\": {";
+	for (int type = 0; type < RT_RAY_TYPE_COUNT; ++type)
+	{
+		json << (type > 0 ? ", " : " ") << "\"" << s_rayTypeNames[type] << "\": " << m_rays[type];
+	}
+	json << " },\n";
+
+	json << "  \"phases\": {\n";
+	for (int phase = 0; phase < RT_PHASE_COUNT; ++phase)
+	{
+		json << "    \"" << s_phaseNames[phase] << "\": { \"thread_seconds\": " << m_phaseSeconds[phase]
+			<< ", \"ns_per_ray\": " << PerRay(m_phaseSeconds[phase] * 1e9, PhaseRays(*this, phase)) << " }"
+			<< (phase + 1 < RT_PHASE_COUNT ? ",\n" : "\n");
+	}
+	json << "  },\n";
+
+	json << "  \"nodes_visited\": " << m_nodesVisited << ",\n";
+	json << "  \"primitive_tests\": " << m_primTests << ",\n";
+	json << "  \"nodes_per_ray\": " << PerRay((double)m_nodesVisited, totalRays) << ",\n";
+	json << "  \"primitive_tests_per_ray\": " << PerRay((double)m_primTests, totalRays) << ",\n";
+	json << "  \"average_depth\": " << PerRay((double)m_waveDepthSum, m_waveRays) << ",\n";
+	json << "  \"max_depth\": " << m_maxDepth << ",\n";
+	json << "  \"early_outs\": { \"cached_occluders\": " << m_occluderHits << ", \"roulette_stops\": " << m_rouletteStops << " }\n";
+	json << "}\n";
+
+	return json.str();
+}
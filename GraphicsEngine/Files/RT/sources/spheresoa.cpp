@@ -0,0 +1,99 @@
+#include "Files/RT/headers/spheresoa.h"
+
+SphereSoA::SphereSoA() : m_size(0) { }
+
+SphereSoA::~SphereSoA() { }
+
+void SphereSoA::Clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_radius2.clear();
+	m_material.clear();
+	m_size = 0;
+}
+
+void SphereSoA::Load(const std::vector<Sphere>& spheres, const std::vector<int>& order)
+{
+	Clear();
+
+	m_size = (int)order.size();
+	const size_t paddedSize = order.size() + RT_SIMD_WIDTH;
+
+	// Padding spheres have a negative squared radius so they are never hit
+	m_centerX.assign(paddedSize, 0.f);
+	m_centerY.assign(paddedSize, 0.f);
+	m_centerZ.assign(paddedSize, 0.f);
+	m_radius2.assign(paddedSize, -1.f);
+	m_material.assign(order.begin(), order.end());
+
+	for (int i = 0; i < m_size; ++i)
+	{
+		const Sphere& sphere = spheres[order[i]];
+		const glm::vec3 center = sphere.getCenter();
+		m_centerX[i] = center.x;
+		m_centerY[i] = center.y;
+		m_centerZ[i] = center.z;
+		m_radius2[i] = sphere.getRadius() * sphere.getRadius();
+	}
+}
+
+int SphereSoA::ClosestHit(int first, int count, const glm::vec3& origin, const glm::vec3& direction, float& tMax) const
+{
+	const vfloat originX(origin.x), originY(origin.y), originZ(origin.z);
+	const vfloat dirX(direction.x), dirY(direction.y), dirZ(direction.z);
+
+	// Closest distance and first slot of its block for each lane
+	vfloat closest(tMax);
+	vint closestBlock(-1);
+
+	for (int slot = first; slot < first + count; slot += RT_SIMD_WIDTH)
+	{
+		const vfloat t = HitDistances(slot, originX, originY, originZ, dirX, dirY, dirZ);
+		const vmask hit = (t < closest) & FirstLanes(first + count - slot);
+
+		closest = Select(hit, t, closest);
+		closestBlock = Select(hit, vint(slot), closestBlock);
+	}
+
+	RT_ALIGN(64) float distances[RT_SIMD_WIDTH];
+	RT_ALIGN(64) int blocks[RT_SIMD_WIDTH];
+	StoreFloats(distances, closest);
+	StoreInts(blocks, closestBlock);
+
+	int hitSlot = -1;
+	for (int lane = 0; lane < RT_SIMD_WIDTH; ++lane)
+	{
+		if (blocks[lane] >= 0 && distances[lane] < tMax)
+		{
+			tMax = distances[lane];
+			hitSlot = blocks[lane] + lane;
+		}
+	}
+
+	return hitSlot;
+}
+
+bool SphereSoA::AnyHit(int first, int count, const glm::vec3& origin, const glm::vec3& direction, float tMax, int* hitSlot) const
+{
+	const vfloat originX(origin.x), originY(origin.y), originZ(origin.z);
+	const vfloat dirX(direction.x), dirY(direction.y), dirZ(direction.z);
+
+	for (int slot = first; slot < first + count; slot += RT_SIMD_WIDTH)
+	{
+		const vfloat t = HitDistances(slot, originX, originY, originZ, dirX, dirY, dirZ);
+		const int hits = MaskBits((t < vfloat(tMax)) & FirstLanes(first + count - slot));
+		if (hits == 0) continue;
+
+		if (hitSlot)
+		{
+			int lane = 0;
+			while (!(hits & (1 << lane))) ++lane;
+			*hitSlot = slot + lane;
+		}
+		return true;
+	}
+
+	return false;
+}
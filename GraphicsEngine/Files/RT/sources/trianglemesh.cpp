@@ -0,0 +1,278 @@
+#include "Files/RT/headers/trianglemesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define RT_MESH_LEAF_SIZE 4 // Triangles of a BVH leaf at most, tested one by one
+
+WatertightRay::WatertightRay(const glm::vec3& origin, const glm::vec3& direction) : m_origin(origin)
+{
+	// The dimension where the ray direction is maximal becomes z
+	const glm::vec3 absDir = glm::abs(direction);
+	m_kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+	m_kx = (m_kz + 1) % 3;
+	m_ky = (m_kx + 1) % 3;
+
+	// Swap to preserve the winding of the triangles
+	if (direction[m_kz] < 0.f) std::swap(m_kx, m_ky);
+
+	m_sx = direction[m_kx] / direction[m_kz];
+	m_sy = direction[m_ky] / direction[m_kz];
+	m_sz = 1.f / direction[m_kz];
+}
+
+TriangleMesh::TriangleMesh() { }
+
+TriangleMesh::~TriangleMesh() { }
+
+void TriangleMesh::Clear()
+{
+	m_vertices.clear();
+	m_normals.clear();
+	m_faceNormals.clear();
+	m_triangles.clear();
+	m_materials.clear();
+	m_bvh.Clear();
+}
+
+void TriangleMesh::Load(const Model& model, const glm::mat4& transform, RTBVHCache* bvhCache)
+{
+	Clear();
+
+	const std::vector<Vertex>& vertices = model.vertices();
+	const std::vector< ::Normal>& normals = model.normals();
+	const std::vector<Face>& faces = model.faces();
+	const glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+	m_vertices.reserve(vertices.size() / 3);
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+	{
+		const glm::vec4 position(vertices[i], vertices[i + 1], vertices[i + 2], 1.0);
+		m_vertices.push_back(glm::vec3(transform * position));
+	}
+
+	for (size_t i = 0; i < Materials.size(); ++i)
+	{
+		m_materials.push_back(RTMaterial::FromMTL(Materials[i]));
+	}
+
+	bool smoothNormals = !normals.empty();
+	m_triangles.reserve(faces.size());
+	m_faceNormals.reserve(faces.size());
+
+	for (size_t f = 0; f < faces.size(); ++f)
+	{
+		const Face& face = faces[f];
+		if (face.v.size() < 3) continue;
+
+		// Face indices point to the first component of the vertex
+		Triangle triangle;
+		for (int i = 0; i < 3; ++i) triangle.m_vertex[i] = face.v[i] / 3;
+		triangle.m_material = (face.mat >= 0 && face.mat < (int)m_materials.size()) ? face.mat : 0;
+
+		// Degenerate triangles can never be hit, keep them out of the BVH
+		const glm::vec3 edge0 = m_vertices[triangle.m_vertex[1]] - m_vertices[triangle.m_vertex[0]];
+		const glm::vec3 edge1 = m_vertices[triangle.m_vertex[2]] - m_vertices[triangle.m_vertex[0]];
+		const glm::vec3 faceNormal = glm::cross(edge0, edge1);
+		if (glm::dot(faceNormal, faceNormal) == 0.f) continue;
+
+		m_triangles.push_back(triangle);
+		m_faceNormals.push_back(glm::normalize(faceNormal));
+
+		if (smoothNormals && face.n.size() >= 3)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				const int n = face.n[i];
+				m_normals.push_back(glm::normalize(normalTransform * glm::vec3(normals[n], normals[n + 1], normals[n + 2])));
+			}
+		}
+		else
+		{
+			smoothNormals = false;
+		}
+	}
+
+	// Fall back to flat shading if any face is missing its normals
+	if (!smoothNormals) m_normals.clear();
+
+	BuildBVH(bvhCache);
+}
+
+void TriangleMesh::BuildBVH(RTBVHCache* bvhCache)
+{
+	std::vector<AABB> bounds(m_triangles.size());
+	for (size_t t = 0; t < m_triangles.size(); ++t)
+	{
+		for (int i = 0; i < 3; ++i) bounds[t].Grow(m_vertices[m_triangles[t].m_vertex[i]]);
+	}
+
+	if (bvhCache) bvhCache->Build(m_bvh, bounds, RT_MESH_LEAF_SIZE, 1);
+	else m_bvh.Build(bounds, RT_MESH_LEAF_SIZE, 1);
+}
+
+void TriangleMesh::Write(RTStreamWriter& stream) const
+{
+	stream.WriteUInt32((uint32_t)m_vertices.size());
+	for (const glm::vec3& vertex : m_vertices) stream.WriteVec3(vertex);
+
+	stream.WriteUInt32((uint32_t)m_normals.size());
+	for (const glm::vec3& normal : m_normals) stream.WriteVec3(normal);
+
+	stream.WriteUInt32((uint32_t)m_triangles.size());
+	for (size_t t = 0; t < m_triangles.size(); ++t)
+	{
+		for (int i = 0; i < 3; ++i) stream.WriteUInt32(m_triangles[t].m_vertex[i]);
+		stream.WriteInt32(m_triangles[t].m_material);
+		stream.WriteVec3(m_faceNormals[t]);
+	}
+
+	stream.WriteUInt32((uint32_t)m_materials.size());
+	for (const RTMaterial& material : m_materials)
+	{
+		stream.WriteVec3(material.m_surfaceColor);
+		stream.WriteVec3(material.m_lightColor);
+		stream.WriteFloat(material.m_emission);
+		stream.WriteFloat(material.m_transparency);
+		stream.WriteFloat(material.m_refractionIndex);
+		stream.WriteUInt32(material.m_reflects ? 1 : 0);
+	}
+}
+
+bool TriangleMesh::Read(RTStreamReader& stream)
+{
+	Clear();
+
+	m_vertices.resize(stream.ReadCount(12));
+	for (glm::vec3& vertex : m_vertices) vertex = stream.ReadVec3();
+
+	m_normals.resize(stream.ReadCount(12));
+	for (glm::vec3& normal : m_normals) normal = stream.ReadVec3();
+
+	m_triangles.resize(stream.ReadCount(28));
+	m_faceNormals.resize(m_triangles.size());
+	for (size_t t = 0; t < m_triangles.size(); ++t)
+	{
+		for (int i = 0; i < 3; ++i) m_triangles[t].m_vertex[i] = stream.ReadUInt32();
+		m_triangles[t].m_material = stream.ReadInt32();
+		m_faceNormals[t] = stream.ReadVec3();
+	}
+
+	m_materials.resize(stream.ReadCount(40));
+	for (RTMaterial& material : m_materials)
+	{
+		material.m_surfaceColor = stream.ReadVec3();
+		material.m_lightColor = stream.ReadVec3();
+		material.m_emission = stream.ReadFloat();
+		material.m_transparency = stream.ReadFloat();
+		material.m_refractionIndex = stream.ReadFloat();
+		material.m_reflects = stream.ReadUInt32() != 0;
+	}
+
+	// Indices out of range would be followed by the intersection code
+	bool valid = !stream.m_failed && (m_normals.empty() || m_normals.size() == m_triangles.size() * 3);
+	for (size_t t = 0; valid && t < m_triangles.size(); ++t)
+	{
+		for (int i = 0; i < 3; ++i) valid &= m_triangles[t].m_vertex[i] < m_vertices.size();
+		valid &= m_triangles[t].m_material >= 0 && m_triangles[t].m_material < (int)m_materials.size();
+	}
+
+	if (!valid)
+	{
+		Clear();
+		return false;
+	}
+
+	BuildBVH(nullptr);
+	return true;
+}
+
+bool TriangleMesh::IntersectTriangle(int triangle, const WatertightRay& ray, float tMax, float& t, float& u, float& v) const
+{
+	const Triangle& tri = m_triangles[triangle];
+	const glm::vec3 a = m_vertices[tri.m_vertex[0]] - ray.m_origin;
+	const glm::vec3 b = m_vertices[tri.m_vertex[1]] - ray.m_origin;
+	const glm::vec3 c = m_vertices[tri.m_vertex[2]] - ray.m_origin;
+
+	// Shear and scale the vertices so the ray goes along +z
+	const float ax = a[ray.m_kx] - ray.m_sx * a[ray.m_kz];
+	const float ay = a[ray.m_ky] - ray.m_sy * a[ray.m_kz];
+	const float bx = b[ray.m_kx] - ray.m_sx * b[ray.m_kz];
+	const float by = b[ray.m_ky] - ray.m_sy * b[ray.m_kz];
+	const float cx = c[ray.m_kx] - ray.m_sx * c[ray.m_kz];
+	const float cy = c[ray.m_ky] - ray.m_sy * c[ray.m_kz];
+
+	float U = cx * by - cy * bx;
+	float V = ax * cy - ay * cx;
+	float W = bx * ay - by * ax;
+
+	// Edges hit exactly are recomputed in double precision to stay watertight
+	if (U == 0.f || V == 0.f || W == 0.f)
+	{
+		U = (float)((double)cx * (double)by - (double)cy * (double)bx);
+		V = (float)((double)ax * (double)cy - (double)ay * (double)cx);
+		W = (float)((double)bx * (double)ay - (double)by * (double)ax);
+	}
+
+	if ((U < 0.f || V < 0.f || W < 0.f) && (U > 0.f || V > 0.f || W > 0.f)) return false;
+
+	const float det = U + V + W;
+	if (det == 0.f) return false;
+
+	const float az = ray.m_sz * a[ray.m_kz];
+	const float bz = ray.m_sz * b[ray.m_kz];
+	const float cz = ray.m_sz * c[ray.m_kz];
+	const float T = U * az + V * bz + W * cz;
+
+	// Distance test without the division, both sides are scaled by det
+	if (det > 0.f ? (T <= 0.f || T >= tMax * det) : (T >= 0.f || T <= tMax * det)) return false;
+
+	const float invDet = 1.f / det;
+	t = T * invDet;
+	u = V * invDet;
+	v = W * invDet;
+
+	return true;
+}
+
+int TriangleMesh::ClosestHit(const glm::vec3& origin, const glm::vec3& direction, float& tMax, float& u, float& v, RTStats* stats) const
+{
+	const WatertightRay ray(origin, direction);
+	int closest = -1;
+
+	m_bvh.Traverse(origin, direction, tMax, [&](unsigned int prim, float& t)
+	{
+		float tHit, uHit, vHit;
+		if (!IntersectTriangle(prim, ray, t, tHit, uHit, vHit)) return false;
+
+		t = tHit;
+		u = uHit;
+		v = vHit;
+		closest = prim;
+		return true;
+	}, stats);
+
+	return closest;
+}
+
+bool TriangleMesh::Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax, int* occluder, RTStats* stats) const
+{
+	const WatertightRay ray(origin, direction);
+
+	return m_bvh.TraverseAny(origin, direction, tMax, [&](unsigned int prim, float t)
+	{
+		float tHit, uHit, vHit;
+		if (!IntersectTriangle(prim, ray, t, tHit, uHit, vHit)) return false;
+
+		if (occluder) *occluder = prim;
+		return true;
+	}, stats);
+}
+
+glm::vec3 TriangleMesh::Normal(int triangle, float u, float v) const
+{
+	if (m_normals.empty()) return m_faceNormals[triangle];
+
+	const glm::vec3* n = &m_normals[3 * triangle];
+	return glm::normalize(n[0] * (1.f - u - v) + n[1] * u + n[2] * v);
+}
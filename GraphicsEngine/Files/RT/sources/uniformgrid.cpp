@@ -0,0 +1,140 @@
+#include "Files/RT/headers/uniformgrid.h"
+
+#include <atomic>
+#include <thread>
+
+#define RT_GRID_MAX_CELLS (1 << 24) // 64 MB of cell starts
+#define RT_GRID_BUILD_CHUNK 4096 // Primitives or cells a thread takes at a time
+
+// Thresholds of Suits
+#define RT_GRID_MIN_PRIMS 1024 // Under that the BVH builds in no time anyway
+#define RT_GRID_MAX_SIZE_VARIATION 0.5f // Standard deviation of the sizes over their mean
+#define RT_GRID_MAX_SIZE_RATIO 4.0f // Largest primitive over the mean size
+
+// Calls work(begin, end) on chunks of [0, count) from numThreads threads
+template <typename WorkFunc>
+static void ParallelFor(size_t count, int numThreads, WorkFunc work)
+{
+	std::atomic<size_t> nextChunk(0);
+	auto runChunks = [&]()
+	{
+		for (size_t begin = RT_GRID_BUILD_CHUNK * nextChunk++; begin < count; begin = RT_GRID_BUILD_CHUNK * nextChunk++)
+		{
+			work(begin, std::min(begin + RT_GRID_BUILD_CHUNK, count));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; ++t) threads.push_back(std::thread(runChunks));
+	runChunks();
+	for (std::thread& thread : threads) thread.join();
+}
+
+UniformGrid::UniformGrid() : m_resolution(0), m_cellSize(0.f), m_invCellSize(0.f) { }
+
+UniformGrid::~UniformGrid() { }
+
+void UniformGrid::Clear()
+{
+	m_bounds = AABB();
+	m_resolution = glm::ivec3(0);
+	m_cellStart.clear();
+	m_primIndices.clear();
+}
+
+void UniformGrid::Build(const std::vector<AABB>& primBounds, float cellsPerPrim, int numThreads)
+{
+	Clear();
+	if (primBounds.empty()) return;
+
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, (int)((primBounds.size() + RT_GRID_BUILD_CHUNK - 1) / RT_GRID_BUILD_CHUNK));
+
+	for (const AABB& bounds : primBounds) m_bounds.Grow(bounds);
+
+	// Cubic cells, about cellsPerPrim of them per primitive. A flat scene gets a single
+	// layer of cells along its thin axis.
+	const glm::vec3 extent = glm::max(m_bounds.Extent(), glm::vec3(1e-6f * std::max(1.f, glm::length(m_bounds.Extent()))));
+	float cellsPerUnit = std::cbrt(cellsPerPrim * primBounds.size() / (extent.x * extent.y * extent.z));
+	while (true)
+	{
+		m_resolution = glm::clamp(glm::ivec3(extent * cellsPerUnit), glm::ivec3(1), glm::ivec3(RT_GRID_MAX_CELLS));
+		if ((double)m_resolution.x * m_resolution.y * m_resolution.z <= RT_GRID_MAX_CELLS) break;
+		cellsPerUnit *= 0.8f;
+	}
+	m_cellSize = extent / glm::vec3(m_resolution);
+	m_invCellSize = 1.f / m_cellSize;
+
+	const size_t numCells = (size_t)m_resolution.x * m_resolution.y * m_resolution.z;
+
+	// Primitives of each cell, counted from all the threads at once
+	std::vector<std::atomic<unsigned int> > counts(numCells);
+	for (std::atomic<unsigned int>& count : counts) count.store(0, std::memory_order_relaxed);
+
+	auto forEachCell = [&](const AABB& bounds, unsigned int prim, std::vector<std::atomic<unsigned int> >& cells, bool fill)
+	{
+		const glm::ivec3 low = CellOf(bounds.m_min), high = CellOf(bounds.m_max);
+		for (int z = low.z; z <= high.z; ++z)
+		{
+			for (int y = low.y; y <= high.y; ++y)
+			{
+				for (int x = low.x; x <= high.x; ++x)
+				{
+					const unsigned int slot = cells[CellIndex(x, y, z)].fetch_add(1, std::memory_order_relaxed);
+					if (fill) m_primIndices[slot] = prim;
+				}
+			}
+		}
+	};
+
+	ParallelFor(primBounds.size(), numThreads, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i) forEachCell(primBounds[i], (unsigned int)i, counts, false);
+	});
+
+	// The counts become the starts of the cells, then the cursors the primitives are written at
+	m_cellStart.resize(numCells + 1);
+	unsigned int total = 0;
+	for (size_t c = 0; c < numCells; ++c)
+	{
+		m_cellStart[c] = total;
+		total += counts[c].load(std::memory_order_relaxed);
+		counts[c].store(m_cellStart[c], std::memory_order_relaxed);
+	}
+	m_cellStart[numCells] = total;
+	m_primIndices.resize(total);
+
+	ParallelFor(primBounds.size(), numThreads, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i) forEachCell(primBounds[i], (unsigned int)i, counts, true);
+	});
+
+	// The threads wrote the cells in any order, sorted the traversal does not depend on them
+	ParallelFor(numCells, numThreads, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; ++c) std::sort(m_primIndices.begin() + m_cellStart[c], m_primIndices.begin() + m_cellStart[c + 1]);
+	});
+}
+
+bool UniformGrid::Suits(const std::vector<AABB>& primBounds)
+{
+	if (primBounds.size() < RT_GRID_MIN_PRIMS) return false;
+
+	// Size of a primitive, the longest side of its bounds
+	double sum = 0.0, sum2 = 0.0;
+	float largest = 0.f;
+	for (const AABB& bounds : primBounds)
+	{
+		const glm::vec3 extent = bounds.Extent();
+		const float size = std::max(extent.x, std::max(extent.y, extent.z));
+		sum += size;
+		sum2 += (double)size * size;
+		largest = std::max(largest, size);
+	}
+
+	const double mean = sum / primBounds.size();
+	if (mean <= 0.0) return false;
+	const double deviation = std::sqrt(std::max(0.0, sum2 / primBounds.size() - mean * mean));
+
+	return deviation <= RT_GRID_MAX_SIZE_VARIATION * mean && largest <= RT_GRID_MAX_SIZE_RATIO * mean;
+}
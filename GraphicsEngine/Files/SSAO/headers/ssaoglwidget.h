@@ -18,6 +18,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "definitions.h"
 #include "Files/model.h"
+#include "Files/RT/headers/rtaobake.h"
+#include "Files/RT/headers/rthybrid.h"
 #include <glm/detail/type_vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include "definitions.h"
@@ -29,6 +31,7 @@ public:
 	GLuint m_transLoc, m_projLoc, m_viewLoc;
 	GLuint m_matAmbLoc, m_matDiffLoc, m_matSpecLoc, m_matShinLoc;
 	GLuint m_VertexLoc, m_NormalLoc;
+	GLuint m_bakedAOLoc;
 	GLuint m_lightPosLoc, m_lightColLoc;
 };
 
@@ -53,6 +56,7 @@ public:
 	QOpenGLShaderProgram * m_program;
 	GLuint m_basicLoc;
 	GLuint m_phongTexLoc, m_ssaoTexLoc, m_ssaoNormalLoc, m_ssaogPositionLoc;
+	GLuint m_rtShadingLoc;
 
 };
 
@@ -186,6 +190,7 @@ private:
 	float m_modelRadius;
 	GLuint m_VAOModel, m_VBOModelVerts, m_VBOModelNorms;
 	GLuint m_VBOModelMatAmb, m_VBOModelMatDiff, m_VBOModelMatSpec, m_VBOModelMatShin;
+	GLuint m_VBOModelBakedAO; // 0 when the model has no baked ambient occlusion
 
 	// Lights
 	glm::vec3 m_lightPos;
@@ -221,9 +226,38 @@ private:
 	void renderSSAOBlur();
 	void renderLight();
 
+	// Hybrid ray tracing: the G-buffer is read back into pixel buffers without waiting for
+	// the GPU, the CPU traces the secondary rays from it in the background and its
+	// visibility replaces the SSAO once done. Only OpenGL 3.3 core, Mesa's llvmpipe runs it.
+	void renderHybrid();
+	void createHybrid();
+	void cleanHybrid();
+	void readBackGBuffer();
+	void collectGBuffer();
+	void uploadHybridShading();
+
 	CameraType m_cameraType = FPS;
 	RenderResult m_renderResult = FINAL_RESULT;
 
+	// Transforms last sent to the G-buffer shader
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_sceneMatrix;
+
+	// Hybrid ray tracing, the scene is the model in its own space
+	RTScene* m_rtScene = nullptr;
+	RTHybridShader* m_hybridShader = nullptr;
+	GLuint m_readbackPBOs[HYBRID_READBACKS][2]; // Positions and normals
+	GLsync m_readbackFences[HYBRID_READBACKS]; // Set while a readback is in flight
+	glm::mat4 m_readbackViewToScene[HYBRID_READBACKS];
+	int m_readbackWidth[HYBRID_READBACKS];
+	int m_readbackHeight[HYBRID_READBACKS];
+	int m_readbackIndex; // Next one to read into, the oldest one in flight
+	RTGBuffer m_hybridGBuffer;
+	std::vector<glm::vec2> m_hybridShading;
+	GLuint m_hybridTexture;
+	int m_hybridWidth;
+	int m_hybridHeight;
+
 
 };
 
@@ -1,7 +1,7 @@
 #version 330 core
-layout (location = 0) out vec3 gPosition;
+layout (location = 0) out vec4 gPosition;
 layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gPhong;
+layout (location = 2) out vec4 gPhong; // Ambient occlusion baked into the vertices in alpha
 
 in vec3 vertexOCS;
 in vec3 normalOCS;
@@ -10,14 +10,15 @@ in vec3 fmatamb;
 in vec3 fmatdiff;
 in vec3 fmatspec;
 in float fmatshin;
+in float fbakedAO;
 
 uniform vec3 lightPos;
 uniform vec3 lightCol;
 
 void main()
 {    
-    // store the fragment position vector in the first gbuffer texture
-    gPosition = vertexOCS;
+    // store the fragment position vector in the first gbuffer texture, w tells it was drawn
+    gPosition = vec4(vertexOCS, 1.0);
     // also store the per-fragment normals into the gbuffer
     gNormal = normalize(normalOCS);
 
@@ -40,5 +41,5 @@ void main()
     else
         specular = lightCol.z * fmatspec * dotRVs;
 
-    gPhong = diffuse + specular + ambient;
+    gPhong = vec4(diffuse + specular + ambient, fbakedAO);
 }
\ No newline at end of file
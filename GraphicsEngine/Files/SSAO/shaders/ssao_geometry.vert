@@ -5,6 +5,7 @@ in vec3 matamb;
 in vec3 matdiff;
 in vec3 matspec;
 in float matshin;
+in float bakedAO;
 
 out vec3 vertexOCS;
 out vec3 normalOCS;
@@ -12,6 +13,7 @@ out vec3 fmatamb;
 out vec3 fmatdiff;
 out vec3 fmatspec;
 out float fmatshin;
+out float fbakedAO;
 
 uniform mat4 projTransform;
 uniform mat4 viewTransform;
@@ -23,6 +25,7 @@ void main()
     fmatamb = matamb;
     fmatspec = matspec;
     fmatshin = matshin;
+    fbakedAO = bakedAO;
 
     vertexOCS = (viewTransform * sceneTransform * vec4(vertex, 1.0)).xyz; 
     
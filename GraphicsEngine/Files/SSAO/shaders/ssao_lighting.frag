@@ -7,6 +7,10 @@ uniform sampler2D gPhong;
 uniform sampler2D ssao;
 uniform sampler2D normal;
 uniform sampler2D gPosition;
+uniform sampler2D rtShading;
+
+// Light left in the shadows of the hybrid ray tracing
+const float shadowAmbient = 0.3;
 
 uniform int renderType;
 
@@ -26,4 +30,12 @@ void main()
         FragColor = vec4(vec3(AmbientOcclusion), 1.0);
     else if(renderType == 4)
         FragColor = vec4(Phong, 1.0);
+    else if(renderType == 5)
+    {
+        // Ambient occlusion and shadow of the light ray traced from the G-buffer
+        vec2 visibility = texture(rtShading, TexCoords).rg;
+        FragColor = vec4(visibility.r * mix(shadowAmbient, 1.0, visibility.g) * Phong, 1.0);
+    }
+    else if(renderType == 6)
+        FragColor = vec4(texture(gPhong, TexCoords).a * Phong, 1.0);
 }
\ No newline at end of file
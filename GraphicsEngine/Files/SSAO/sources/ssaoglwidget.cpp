@@ -9,6 +9,11 @@
 
 #include <iostream>
 #include <random>
+#include <cstring>
+
+// Secondary rays of the hybrid ray tracing, the radius is in view space like the one of the SSAO
+#define HYBRID_AMBIENT_RAYS 8
+#define HYBRID_AMBIENT_RADIUS 5.0f
 
 SSAOGLWidget::SSAOGLWidget(QString modelFilename, bool showFps, QWidget *parent) : QOpenGLWidget(parent)
 {
@@ -63,6 +68,7 @@ SSAOGLWidget::SSAOGLWidget(QString modelFilename, bool showFps, QWidget *parent)
 	m_modelCenter = glm::vec3(0.0f, 0.0f, 0.0f);
 	m_modelRadius = 0.0f;
 	m_modelFilename = modelFilename;
+	m_VBOModelBakedAO = 0;
 
 	// FPS
 	m_frameCount = 0;
@@ -74,6 +80,17 @@ SSAOGLWidget::SSAOGLWidget(QString modelFilename, bool showFps, QWidget *parent)
 	m_SSAOProgram.m_program = nullptr;
 	m_SSAOBlurProgram.m_program = nullptr;
 	m_basciProgram.m_program = nullptr;
+
+	// Hybrid ray tracing, created the first time it is shown
+	m_readbackIndex = 0;
+	m_hybridTexture = 0;
+	m_hybridWidth = 0;
+	m_hybridHeight = 0;
+	for (int i = 0; i < HYBRID_READBACKS; ++i)
+	{
+		m_readbackFences[i] = 0;
+		m_readbackPBOs[i][0] = m_readbackPBOs[i][1] = 0;
+	}
 }
 
 SSAOGLWidget::~SSAOGLWidget()
@@ -93,6 +110,8 @@ QSize SSAOGLWidget::sizeHint() const
 
 void SSAOGLWidget::cleanup()
 {
+	cleanHybrid();
+
 	if (m_modelLoaded)
 		cleanBuffersModel();
 
@@ -385,6 +404,7 @@ void SSAOGLWidget::loadGShader()
 	m_GProgram.m_matDiffLoc = glGetAttribLocation(m_GProgram.m_program->programId(), "matdiff");
 	m_GProgram.m_matSpecLoc = glGetAttribLocation(m_GProgram.m_program->programId(), "matspec");
 	m_GProgram.m_matShinLoc = glGetAttribLocation(m_GProgram.m_program->programId(), "matshin");
+	m_GProgram.m_bakedAOLoc = glGetAttribLocation(m_GProgram.m_program->programId(), "bakedAO");
 
 	// Get the uniforms locations of the vertex shader
 	m_GProgram.m_transLoc = glGetUniformLocation(m_GProgram.m_program->programId(), "sceneTransform");
@@ -495,6 +515,7 @@ void SSAOGLWidget::loadBasicShader()
 	m_basciProgram.m_ssaoTexLoc = glGetUniformLocation(m_basciProgram.m_program->programId(), "ssao");
 	m_basciProgram.m_ssaoNormalLoc = glGetUniformLocation(m_basciProgram.m_program->programId(), "normal");
 	m_basciProgram.m_ssaogPositionLoc = glGetUniformLocation(m_basciProgram.m_program->programId(), "gPosition");
+	m_basciProgram.m_rtShadingLoc = glGetUniformLocation(m_basciProgram.m_program->programId(), "rtShading");
 }
 
 void SSAOGLWidget::reloadShaders()
@@ -591,6 +612,7 @@ void SSAOGLWidget::viewTransform()
 	}
 
 	// Send the matrix to the shader
+	m_viewMatrix = view;
 	m_GProgram.m_program->bind();
 	glUniformMatrix4fv(m_GProgram.m_viewLoc, 1, GL_FALSE, &view[0][0]);
 }
@@ -715,6 +737,26 @@ void SSAOGLWidget::loadModel()
 	glVertexAttribPointer(m_GProgram.m_matShinLoc, 1, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(m_GProgram.m_matShinLoc);
 
+	// VBO Baked ambient occlusion, from the cache written by --bake-ao
+	std::vector<float> bakedAO;
+	if (LoadAOCache(AOCacheFilename(m_modelFilename.toStdString()), m_model, bakedAO))
+	{
+		glGenBuffers(1, &m_VBOModelBakedAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelBakedAO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*bakedAO.size(), bakedAO.data(), GL_STATIC_DRAW);
+
+		// Enable the attribute m_bakedAOLoc
+		glVertexAttribPointer(m_GProgram.m_bakedAOLoc, 1, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(m_GProgram.m_bakedAOLoc);
+	}
+	else
+	{
+		// Nothing occluded until the model is baked
+		std::cout << "--- No baked ambient occlusion, run with --bake-ao " << m_modelFilename.toStdString() << std::endl;
+		glDisableVertexAttribArray(m_GProgram.m_bakedAOLoc);
+		glVertexAttrib1f(m_GProgram.m_bakedAOLoc, 1.0f);
+	}
+
 	glBindVertexArray(0);
 
 	// The model has been loaded
@@ -734,6 +776,9 @@ void SSAOGLWidget::cleanBuffersModel()
 	glDeleteBuffers(1, &m_VBOModelMatDiff);
 	glDeleteBuffers(1, &m_VBOModelMatSpec);
 	glDeleteBuffers(1, &m_VBOModelMatShin);
+	if (m_VBOModelBakedAO != 0)
+		glDeleteBuffers(1, &m_VBOModelBakedAO);
+	m_VBOModelBakedAO = 0;
 	glDeleteVertexArrays(1, &m_VAOModel);
 	glDeleteBuffers(1, &m_quadVBO);
 	glDeleteVertexArrays(1, &m_quadVAO);
@@ -787,6 +832,7 @@ void SSAOGLWidget::modelTransform()
 	geomTransform = glm::scale(geomTransform, glm::vec3(0.05f, 0.05f, 0.05f));
 
 	// Send the matrix to the shader
+	m_sceneMatrix = geomTransform;
 	glUniformMatrix4fv(m_GProgram.m_transLoc, 1, GL_FALSE, &geomTransform[0][0]);
 }
 
@@ -881,12 +927,13 @@ void SSAOGLWidget::createFramebuffers()
 	QOpenGLFramebufferObjectFormat formatgBuffer;
 	formatgBuffer.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
 
-	// gBuffer
+	// gBuffer, the positions and normals are kept as floats, 8 bits would clamp them to [0, 1]
+	formatgBuffer.setInternalTextureFormat(GL_RGBA32F);
 	m_gBuffer = new QOpenGLFramebufferObject(m_width, m_height, formatgBuffer);
-	m_gBuffer->addColorAttachment(m_width, m_height);
-	m_gBuffer->addColorAttachment(m_width, m_height);
-	m_gBuffer->addColorAttachment(m_width, m_height);
-	m_gBuffer->addColorAttachment(m_width, m_height);
+	m_gBuffer->addColorAttachment(m_width, m_height, GL_RGBA32F);
+	m_gBuffer->addColorAttachment(m_width, m_height, GL_RGBA8);
+	m_gBuffer->addColorAttachment(m_width, m_height, GL_RGBA8);
+	m_gBuffer->addColorAttachment(m_width, m_height, GL_RGBA8);
 }
 
 void SSAOGLWidget::paintGL()
@@ -895,8 +942,22 @@ void SSAOGLWidget::paintGL()
 	computeFps();
 
 	renderGBuffer();
-	renderSSAO();
-	renderSSAOBlur();
+
+	// The ray traced ambient occlusion replaces the SSAO
+	if (m_renderResult == HYBRID_RAY_TRACING)
+	{
+		renderHybrid();
+	}
+	else if (m_renderResult == BAKED_AO)
+	{
+		// Baked into the vertices, the G-buffer has it already
+	}
+	else
+	{
+		renderSSAO();
+		renderSSAOBlur();
+	}
+
 	renderLight();
 
 	// Show FPS if they are enabled 
@@ -918,6 +979,10 @@ void SSAOGLWidget::renderGBuffer()
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_DEPTH_TEST);
 
+	// The background has no position, whatever its color
+	const GLfloat noPosition[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, noPosition);
+
 	if (m_backFaceCulling)
 		glEnable(GL_CULL_FACE);
 
@@ -1055,12 +1120,182 @@ void SSAOGLWidget::renderLight()
 	glBindTexture(GL_TEXTURE_2D, texIDs[1]);
 	glUniform1i(m_basciProgram.m_ssaoNormalLoc, 2);
 
+	// Hybrid ray tracing
+	if (m_renderResult == HYBRID_RAY_TRACING)
+	{
+		glActiveTexture(GL_TEXTURE7);
+		glBindTexture(GL_TEXTURE_2D, m_hybridTexture);
+		glUniform1i(m_basciProgram.m_rtShadingLoc, 7);
+	}
+
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glBindVertexArray(0);
 }
 
+void SSAOGLWidget::renderHybrid()
+{
+	makeCurrent();
+
+	if (m_hybridShader == nullptr)
+		createHybrid();
+
+	// The readbacks the GPU is done with go to the CPU, then this frame is read back
+	collectGBuffer();
+	readBackGBuffer();
+	uploadHybridShading();
+}
+
+void SSAOGLWidget::createHybrid()
+{
+	std::cout << "--- Building the ray tracing scene" << std::endl;
+
+	m_rtScene = new RTScene;
+	m_rtScene->AddMesh(m_model, glm::mat4(1.0f));
+	m_rtScene->BuildAccelerationStructure();
+
+	RTHybridSettings settings;
+	settings.m_ambientRays = HYBRID_AMBIENT_RAYS;
+	settings.m_ambientRadius = HYBRID_AMBIENT_RADIUS;
+	m_hybridShader = new RTHybridShader(*m_rtScene, settings);
+
+	for (int i = 0; i < HYBRID_READBACKS; ++i)
+		glGenBuffers(2, m_readbackPBOs[i]);
+
+	// Nothing is occluded until the first frame is traced
+	const glm::vec2 visible(1.0f);
+	glGenTextures(1, &m_hybridTexture);
+	glBindTexture(GL_TEXTURE_2D, m_hybridTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, 1, 1, 0, GL_RG, GL_FLOAT, &visible[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_hybridWidth = 1;
+	m_hybridHeight = 1;
+}
+
+void SSAOGLWidget::cleanHybrid()
+{
+	if (m_hybridShader == nullptr)
+		return;
+
+	// The shader waits for the frame it is tracing, it uses the scene
+	delete m_hybridShader;
+	m_hybridShader = nullptr;
+	delete m_rtScene;
+	m_rtScene = nullptr;
+
+	makeCurrent();
+
+	for (int i = 0; i < HYBRID_READBACKS; ++i)
+	{
+		if (m_readbackFences[i])
+			glDeleteSync(m_readbackFences[i]);
+		m_readbackFences[i] = 0;
+
+		glDeleteBuffers(2, m_readbackPBOs[i]);
+	}
+	glDeleteTextures(1, &m_hybridTexture);
+	m_hybridTexture = 0;
+
+	doneCurrent();
+}
+
+void SSAOGLWidget::readBackGBuffer()
+{
+	const int slot = m_readbackIndex;
+
+	// All the readbacks are still in flight, this frame is skipped
+	if (m_readbackFences[slot])
+		return;
+
+	const int width = m_gBuffer->width();
+	const int height = m_gBuffer->height();
+
+	// glReadPixels into a pixel buffer returns at once, the copy is done by the GPU
+	m_gBuffer->bind();
+	for (int attachment = 0; attachment < 2; ++attachment)
+	{
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readbackPBOs[slot][attachment]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(glm::vec4), nullptr, GL_STREAM_READ);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, nullptr);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_gBuffer->release();
+
+	m_readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_readbackViewToScene[slot] = glm::inverse(m_viewMatrix * m_sceneMatrix);
+	m_readbackWidth[slot] = width;
+	m_readbackHeight[slot] = height;
+	m_readbackIndex = (slot + 1) % HYBRID_READBACKS;
+}
+
+void SSAOGLWidget::collectGBuffer()
+{
+	// From the oldest readback, the first one not done yet stops the others
+	for (int i = 0; i < HYBRID_READBACKS; ++i)
+	{
+		const int slot = (m_readbackIndex + i) % HYBRID_READBACKS;
+		if (!m_readbackFences[slot])
+			continue;
+
+		const GLenum status = glClientWaitSync(m_readbackFences[slot], 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(m_readbackFences[slot]);
+		m_readbackFences[slot] = 0;
+
+		RTGBuffer& gbuffer = m_hybridGBuffer;
+		gbuffer.m_width = m_readbackWidth[slot];
+		gbuffer.m_height = m_readbackHeight[slot];
+		gbuffer.m_viewToScene = m_readbackViewToScene[slot];
+		gbuffer.m_lightPosition = m_lightPos;
+
+		const size_t size = gbuffer.m_width * gbuffer.m_height;
+		std::vector<glm::vec4>* targets[2] = { &gbuffer.m_positions, &gbuffer.m_normals };
+		for (int attachment = 0; attachment < 2; ++attachment)
+		{
+			targets[attachment]->resize(size);
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readbackPBOs[slot][attachment]);
+			const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size * sizeof(glm::vec4), GL_MAP_READ_BIT);
+			if (data)
+				memcpy(targets[attachment]->data(), data, size * sizeof(glm::vec4));
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		// The shader takes the newest frame, the buffers it gives back are filled next time
+		m_hybridShader->Submit(gbuffer);
+	}
+}
+
+void SSAOGLWidget::uploadHybridShading()
+{
+	int width, height;
+	if (!m_hybridShader->TakeResult(m_hybridShading, width, height))
+		return;
+
+	// The rows start from the bottom both in the G-buffer and in the texture
+	glBindTexture(GL_TEXTURE_2D, m_hybridTexture);
+	if (width != m_hybridWidth || height != m_hybridHeight)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, m_hybridShading.data());
+		m_hybridWidth = width;
+		m_hybridHeight = height;
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG, GL_FLOAT, m_hybridShading.data());
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void SSAOGLWidget::setLighting()
 {
 	// Light source attached to the camera
@@ -44,6 +44,8 @@ SSAOWindow::SSAOWindow(MainWindow* mw) : AbstractWindow(mw)
 	m_ui.renderResultComboBox->addItem(QString("Normal"));
 	m_ui.renderResultComboBox->addItem(QString("Ambient oclussion"));
 	m_ui.renderResultComboBox->addItem(QString("Color"));
+	m_ui.renderResultComboBox->addItem(QString("Hybrid ray tracing"));
+	m_ui.renderResultComboBox->addItem(QString("Baked AO"));
 	m_ui.renderResultComboBox->setCurrentIndex(0);
 	connect(m_ui.renderResultComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(renderResultChanged(int)));
 }
@@ -7,6 +7,7 @@
 #define PI 3.14159f
 //#define INFINITY 1e8
 #define MAX_RAY_DEPTH 4
+#define HYBRID_READBACKS 2 // G-buffers read back at the same time by the hybrid ray tracing
 
 
 
@@ -24,7 +25,7 @@
 /* Enumerations */
 enum InteractiveAction { NONE, PAN, ROTATE, ZOOM };
 enum CameraType { STATIC = 0, FPS = 1 };
-enum RenderResult {FINAL_RESULT = 0, G_POSITION = 1, NORMAL = 2, AMBIENT_OCLUSSION = 3, COLOR = 4};
+enum RenderResult {FINAL_RESULT = 0, G_POSITION = 1, NORMAL = 2, AMBIENT_OCLUSSION = 3, COLOR = 4, HYBRID_RAY_TRACING = 5, BAKED_AO = 6};
 
 
 #endif
@@ -54,13 +54,32 @@
 #include <QSurfaceFormat>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
+#include <QScopedPointer>
 
 #include "glwidget.h"
 #include "mainwindow.h"
+#include "Files/RT/headers/rtaobake.h"
+#include "Files/RT/headers/rtbenchmark.h"
+#include "Files/RT/headers/rtrender.h"
+#include "definitions.h"
+
+#include <cstring>
+
+// The ray tracing modes run without a display so no widget may be created
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--rt-render") || !strcmp(argv[i], "--rt-bench") || !strcmp(argv[i], "--rt-worker") ||
+            !strcmp(argv[i], "--bake-ao"))
+            return true;
+    }
+    return false;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    QScopedPointer<QCoreApplication> app(isHeadless(argc, argv) ? new QCoreApplication(argc, argv)
+                                                               : new QApplication(argc, argv));
 
     QCoreApplication::setApplicationName("GG-Graphics engine");
     QCoreApplication::setOrganizationName("Josef21296");
@@ -75,8 +94,121 @@ int main(int argc, char *argv[])
     parser.addOption(coreProfileOption);
     QCommandLineOption transparentOption("transparent", "Transparent window");
     parser.addOption(transparentOption);
+    QCommandLineOption rtBenchmarkOption("rt-bench", "Run the ray tracing benchmarks and exit");
+    parser.addOption(rtBenchmarkOption);
+    QCommandLineOption rtRenderOption("rt-render", "Ray trace the scene to the --out file and exit");
+    parser.addOption(rtRenderOption);
+    QCommandLineOption widthOption("width", "Width of the ray traced image", "pixels", "512");
+    parser.addOption(widthOption);
+    QCommandLineOption heightOption("height", "Height of the ray traced image", "pixels", "512");
+    parser.addOption(heightOption);
+    QCommandLineOption samplesOption("spp", "Samples per pixel of the ray traced image", "samples", "16");
+    parser.addOption(samplesOption);
+    QCommandLineOption depthOption("depth", "Maximum ray depth", "depth", QString::number(MAX_RAY_DEPTH));
+    parser.addOption(depthOption);
+    QCommandLineOption adaptiveOption("adaptive", "Spend the --spp budget on the noisy pixels");
+    parser.addOption(adaptiveOption);
+    QCommandLineOption thresholdOption("threshold", "Relative error of the pixels left alone by --adaptive", "error", "0.02");
+    parser.addOption(thresholdOption);
+    QCommandLineOption integratorOption("integrator", "Light transport of the ray traced image, whitted or path", "name", "whitted");
+    parser.addOption(integratorOption);
+    QCommandLineOption denoiseOption("denoise", "Filter the noise of the ray traced image");
+    parser.addOption(denoiseOption);
+    QCommandLineOption threadsOption("threads", "Ray tracing threads, 0 uses all the cores", "threads", "0");
+    parser.addOption(threadsOption);
+    QCommandLineOption outOption("out", "Ray traced image file (.png, .ppm or .pfm)", "file", "render.png");
+    parser.addOption(outOption);
+    QCommandLineOption toneMapOption("tonemap", "How the .png and .ppm images of --rt-render are made 8 bit, clamp or filmic", "name", "clamp");
+    parser.addOption(toneMapOption);
+    QCommandLineOption modelOption("model", "Model ray traced instead of the spheres", "file");
+    parser.addOption(modelOption);
+    QCommandLineOption statsOption("stats", "JSON file the ray tracing counters of --rt-render are written to", "file");
+    parser.addOption(statsOption);
+    QCommandLineOption framesOption("frames", "Frames of an animation rendered by --rt-render as numbered images", "count", "0");
+    parser.addOption(framesOption);
+    QCommandLineOption fpsOption("fps", "Frames per second of the --frames animation", "fps", "24");
+    parser.addOption(fpsOption);
+    QCommandLineOption animationOption("animation", "Keyframes of the spheres of the --frames animation, a turntable if not given", "file");
+    parser.addOption(animationOption);
+    QCommandLineOption instancesOption("instances", "Copies of the --model, or of a few spheres, instanced on the floor by --rt-render", "count", "0");
+    parser.addOption(instancesOption);
+    QCommandLineOption lightsOption("lights", "Small lights replacing the three lights of the --rt-render scene", "count", "0");
+    parser.addOption(lightsOption);
+    QCommandLineOption shadowRaysOption("shadow-rays", "Shadow rays of a diffuse hit, the lights are sampled when there are more", "rays", "4");
+    parser.addOption(shadowRaysOption);
+    QCommandLineOption lightSamplingOption("light-sampling", "How the path tracer picks the lights of its shadow rays, power or tree", "name", "tree");
+    parser.addOption(lightSamplingOption);
+    QCommandLineOption samplerOption("sampler", "Numbers of the samples of --rt-render, random, sobol or bluenoise", "name", "sobol");
+    parser.addOption(samplerOption);
+    QCommandLineOption accelerationOption("acceleration", "What finds the spheres of --rt-render, auto, bvh or grid", "name", "auto");
+    parser.addOption(accelerationOption);
+    QCommandLineOption bvhCacheOption("bvh-cache", "Directory the BVHs of --rt-render are saved to and loaded from on the next runs", "directory");
+    parser.addOption(bvhCacheOption);
+    QCommandLineOption workersOption("workers", "Worker processes started on this machine to render the tiles of --rt-render", "count", "0");
+    parser.addOption(workersOption);
+    QCommandLineOption listenOption("listen", "Address other workers can join --rt-render at, tcp:host:port or unix:path", "address");
+    parser.addOption(listenOption);
+    QCommandLineOption rtWorkerOption("rt-worker", "Render tiles for the --rt-render listening at address and exit", "address");
+    parser.addOption(rtWorkerOption);
+    QCommandLineOption bakeAOOption("bake-ao", "Ray trace the ambient occlusion of the vertices of a model into its cache and exit", "model");
+    parser.addOption(bakeAOOption);
+    QCommandLineOption aoRaysOption("ao-rays", "Ambient occlusion rays of a vertex baked by --bake-ao", "rays", "256");
+    parser.addOption(aoRaysOption);
+    QCommandLineOption aoRadiusOption("ao-radius", "Longest ambient occlusion ray of --bake-ao, 0 for a tenth of the model", "distance", "0");
+    parser.addOption(aoRadiusOption);
+
+    parser.process(*app);
 
-    parser.process(app);
+    if (parser.isSet(rtBenchmarkOption))
+        return RunRTBenchmark();
+
+    if (parser.isSet(rtWorkerOption))
+        return RunRTWorker(parser.value(rtWorkerOption).toStdString(), qMax(0, parser.value(threadsOption).toInt()));
+
+    if (parser.isSet(bakeAOOption)) {
+        RTAOBakeOptions options;
+        options.m_modelFilename = parser.value(bakeAOOption).toStdString();
+        options.m_settings.m_rays = qMax(1, parser.value(aoRaysOption).toInt());
+        options.m_settings.m_radius = qMax(0.0f, parser.value(aoRadiusOption).toFloat());
+        options.m_settings.m_numThreads = qMax(0, parser.value(threadsOption).toInt());
+        return RunAOBake(options);
+    }
+
+    if (parser.isSet(rtRenderOption)) {
+        RTRenderOptions options;
+        options.m_settings.m_width = parser.value(widthOption).toInt();
+        options.m_settings.m_height = parser.value(heightOption).toInt();
+        options.m_settings.m_samplesPerPixel = qMax(1, parser.value(samplesOption).toInt());
+        options.m_settings.m_maxRayDepth = qMax(1, parser.value(depthOption).toInt());
+        options.m_settings.m_adaptive = parser.isSet(adaptiveOption);
+        options.m_settings.m_adaptiveThreshold = parser.value(thresholdOption).toFloat();
+        options.m_settings.m_integrator = parser.value(integratorOption) == "path" ? RT_PATH_TRACING : RT_WHITTED;
+        options.m_settings.m_denoise = parser.isSet(denoiseOption);
+        options.m_settings.m_numThreads = qMax(0, parser.value(threadsOption).toInt());
+        options.m_modelFilename = parser.value(modelOption).toStdString();
+        options.m_outFilename = parser.value(outOption).toStdString();
+        options.m_toneMap = parser.value(toneMapOption) == "filmic" ? RT_TONEMAP_FILMIC : RT_TONEMAP_CLAMP;
+        options.m_statsFilename = parser.value(statsOption).toStdString();
+        options.m_numFrames = qMax(0, parser.value(framesOption).toInt());
+        options.m_framesPerSecond = parser.value(fpsOption).toFloat();
+        options.m_animationFilename = parser.value(animationOption).toStdString();
+        options.m_numInstances = qMax(0, parser.value(instancesOption).toInt());
+        options.m_numLights = qMax(0, parser.value(lightsOption).toInt());
+        options.m_settings.m_shadowRays = qMax(1, parser.value(shadowRaysOption).toInt());
+        options.m_settings.m_lightSelection = parser.value(lightSamplingOption) == "power" ? RT_LIGHTS_POWER : RT_LIGHTS_TREE;
+        const QString sampler = parser.value(samplerOption);
+        options.m_settings.m_sampler = sampler == "random" ? RT_SAMPLER_RANDOM : sampler == "bluenoise" ? RT_SAMPLER_BLUE_NOISE : RT_SAMPLER_SOBOL;
+        const QString acceleration = parser.value(accelerationOption);
+        options.m_acceleration = acceleration == "bvh" ? RT_ACCELERATION_BVH : acceleration == "grid" ? RT_ACCELERATION_GRID : RT_ACCELERATION_AUTO;
+        options.m_bvhCacheDirectory = parser.value(bvhCacheOption).toStdString();
+        options.m_distributed.m_numLocalWorkers = qMax(0, parser.value(workersOption).toInt());
+        options.m_distributed.m_address = parser.value(listenOption).toStdString();
+        options.m_distributed.m_workerProgram = QCoreApplication::applicationFilePath().toStdString();
+        // The local workers share the cores, one thread each unless told otherwise
+        if (parser.isSet(threadsOption))
+            options.m_distributed.m_workerThreads = options.m_settings.m_numThreads;
+        return RunRTRender(options);
+    }
 
     QSurfaceFormat fmt;
     fmt.setDepthBufferSize(24);
@@ -103,5 +235,5 @@ int main(int argc, char *argv[])
         mainWindow.show();
     else
         mainWindow.showMaximized();
-    return app.exec();
+    return app->exec();
 }
\ No newline at end of file
@@ -50,6 +50,9 @@ Material::Material() : name("__load_object_default_material__") {
   diffuse[0] = diffuse[1] = 0.7f; diffuse[2] = 0.0f; diffuse[3] = 1.0f;
   specular[0] = specular[1] = specular[2] = 1.0f; specular[3] = 1.0f;
   shininess = 64;
+  refractionIndex = 1.0f;
+  opacity = 1.0f;
+  illum = 2;
 }
 
 // ========= Public methods ==========
@@ -417,6 +420,32 @@ static void loadMTL(std::string filename) {
 #endif
       for (int i = 0; i < 3; ++i) 
 	ss >> Materials.back().specular[i];
+    }
+    else if (wrd == "Ni") {
+#if DEBUGPARSER
+    cerr << "Processing '" << wrd << "'" << endl;
+#endif
+      ss >> Materials.back().refractionIndex;
+    }
+    else if (wrd == "d") {
+#if DEBUGPARSER
+    cerr << "Processing '" << wrd << "'" << endl;
+#endif
+      ss >> Materials.back().opacity;
+    }
+    else if (wrd == "Tr") {
+#if DEBUGPARSER
+    cerr << "Processing '" << wrd << "'" << endl;
+#endif
+      float transparency;
+      ss >> transparency;
+      Materials.back().opacity = 1.0f - transparency;
+    }
+    else if (wrd == "illum") {
+#if DEBUGPARSER
+    cerr << "Processing '" << wrd << "'" << endl;
+#endif
+      ss >> Materials.back().illum;
     } else {
 #if DEBUGPARSER
     cerr << "MTL parser: read line of type " << wrd << " which is not supported. Skipped..." << endl;
@@ -18,6 +18,9 @@ struct Material {
   float diffuse[4];
   float specular[4];
   float shininess;
+  float refractionIndex;
+  float opacity;
+  int illum;
   Material();
 };
 #ifndef __MODEL__DEF__ 
@@ -27,7 +27,10 @@ public:
 		glm::vec3 l = center - rayorig;
 		float tca = glm::dot(l, raydir);
 		if (tca < 0) return false;
-		float d2 = glm::dot(l, l) - tca * tca;
+		// Squared distance from the center to the ray, from the offset to the closest point.
+		// dot(l, l) - tca * tca cancels when the sphere is far away and hits spheres it misses.
+		glm::vec3 offset = l - tca * raydir;
+		float d2 = glm::dot(offset, offset);
 		if (d2 > radius2) return false;
 		float thc = sqrt(radius2 - d2);
 		t0 = tca - thc;
@@ -37,6 +40,7 @@ public:
 	}
 
 	glm::vec3 getCenter() const { return center; }
+	float getRadius() const { return radius; }
 	glm::vec3 getSurfaceColor() const { return surfaceColor; }
 	glm::vec3 getLightColor() const { return lightColor; }
 	float getRefractionIndex() const { return refractionIndex; }
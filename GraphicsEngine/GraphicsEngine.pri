@@ -1,10 +1,9 @@
-HEADERS += Files/definitions.h \
-			Files/glwidget.h \
+include(Files/RT/rtcore.pri)
+
+HEADERS += Files/glwidget.h \
 			Files/logo.h \
 			Files/mainwindow.h \
 			Files/window.h \
-			Files/model.h \
-			Files/sphere.h \
 			Files/SSAO/headers/ssaoglwidget.h \
 			Files/SSAO/headers/ssaowindow.h \
 			Files/RT/headers/raytracingwindow.h \
@@ -15,7 +14,6 @@ SOURCES += Files/glwidget.cpp \
 			Files/main.cpp \
 			Files/mainwindow.cpp \
 			Files/window.cpp \
-			Files/model.cpp \
 			Files/SSAO/sources/ssaoglwidget.cpp \
 			Files/SSAO/sources/ssaowindow.cpp \
 			Files/RT/sources/raytracingwindow.cpp \
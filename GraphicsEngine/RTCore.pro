@@ -0,0 +1,11 @@
+#Ray tracing core library, the scenes, the tracers and the batch ray queries without Qt
+
+TEMPLATE = lib
+CONFIG += staticlib c++11
+CONFIG -= qt
+
+INCLUDEPATH += Files \
+				Files/ThirdParty \
+				Files/RT/headers \
+
+include(Files/RT/rtcore.pri)